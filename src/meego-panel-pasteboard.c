@@ -37,8 +37,10 @@
 #include <meego-panel/mpl-panel-common.h>
 #include <meego-panel/mpl-entry.h>
 
+#include "mnb-clipboard-proxy.h"
 #include "mnb-clipboard-store.h"
 #include "mnb-clipboard-view.h"
+#include "mnb-pasteboard-service.h"
 
 #define WIDGET_SPACING 5
 #define ICON_SIZE 48
@@ -52,20 +54,148 @@ typedef struct _SearchClosure   SearchClosure;
 static guint search_timeout_id = 0;
 static MnbClipboardStore *store = NULL;
 
+/* the UI is only built when first needed, see ensure_pasteboard() */
+static ClutterActor *pasteboard = NULL;
+static ClutterActor *pasteboard_entry = NULL;
+static ClutterActor *pasteboard_view = NULL;
+static guint build_pasteboard_id = 0;
+static guint pasteboard_width = 0;
+static guint pasteboard_height = 0;
+
+/* the selection shown by the label, applied before the next frame so
+ * that it is laid out at most once per frame
+ */
+static gchar *pending_selection = NULL;
+static guint selection_repaint_id = 0;
+
+/* time since the start of main(), for the startup marks */
+static GTimer *startup_timer = NULL;
+static gulong first_paint_id = 0;
+
+/* delay before building the UI if the panel has not been shown yet;
+ * building it is off the login critical path
+ */
+#define BUILD_PASTEBOARD_DELAY  (10)
+
+static void
+startup_mark (const gchar *mark)
+{
+  if (startup_timer == NULL)
+    return;
+
+  g_debug ("%s: startup mark '%s' at %.3f seconds",
+           G_STRLOC,
+           mark,
+           g_timer_elapsed (startup_timer, NULL));
+}
+
+static ClutterActor *make_pasteboard (gint           width,
+                                      ClutterActor **entry_out,
+                                      ClutterActor **view_out);
+
+static void
+on_stage_first_paint (ClutterActor *stage,
+                      gpointer      dummy G_GNUC_UNUSED)
+{
+  g_signal_handler_disconnect (stage, first_paint_id);
+  first_paint_id = 0;
+
+  startup_mark ("first-paint");
+}
+
+static void
+ensure_pasteboard (MplPanelClient *client)
+{
+  ClutterActor *stage;
+
+  if (pasteboard != NULL)
+    return;
+
+  if (build_pasteboard_id != 0)
+    {
+      g_source_remove (build_pasteboard_id);
+      build_pasteboard_id = 0;
+    }
+
+  mx_texture_cache_load_cache (mx_texture_cache_get_default (),
+                                 MX_CACHE);
+  mx_style_load_from_file (mx_style_get_default (),
+                             THEMEDIR "/panel.css", NULL);
+
+  stage = mpl_panel_clutter_get_stage (MPL_PANEL_CLUTTER (client));
+
+  pasteboard = make_pasteboard (800, &pasteboard_entry, &pasteboard_view);
+  clutter_container_add_actor (CLUTTER_CONTAINER (stage), pasteboard);
+
+  if (pasteboard_width > 0 && pasteboard_height > 0)
+    clutter_actor_set_size (pasteboard, pasteboard_width, pasteboard_height);
+
+  /* the view is only populated while the panel is showing */
+  mnb_clipboard_view_suspend (MNB_CLIPBOARD_VIEW (pasteboard_view));
+
+  startup_mark ("ui-built");
+}
+
+static gboolean
+build_pasteboard_timeout (gpointer data)
+{
+  build_pasteboard_id = 0;
+
+  ensure_pasteboard (data);
+
+  return FALSE;
+}
+
 static void
 on_dropdown_show (MplPanelClient  *client,
-                  ClutterActor    *filter_entry)
+                  gpointer         dummy G_GNUC_UNUSED)
 {
+  ClutterActor *stage;
+
+  ensure_pasteboard (client);
+
+  if (first_paint_id == 0 && startup_timer != NULL)
+    {
+      stage = mpl_panel_clutter_get_stage (MPL_PANEL_CLUTTER (client));
+      first_paint_id = g_signal_connect_after (stage, "paint",
+                                               G_CALLBACK (on_stage_first_paint),
+                                               NULL);
+    }
+
+  /* a thin client only mirrors the history while it is visible */
+  if (MNB_IS_CLIPBOARD_PROXY (store))
+    mnb_clipboard_proxy_sync (MNB_CLIPBOARD_PROXY (store));
+
+  mnb_clipboard_view_resume (MNB_CLIPBOARD_VIEW (pasteboard_view));
+
   /* give focus to the actor */
-  clutter_actor_grab_key_focus (filter_entry);
+  clutter_actor_grab_key_focus (pasteboard_entry);
 }
 
 static void
 on_dropdown_hide (MplPanelClient  *client,
-                  ClutterActor    *filter_entry)
+                  gpointer         dummy G_GNUC_UNUSED)
 {
+  if (pasteboard == NULL)
+    return;
+
   /* Reset search. */
-  mpl_entry_set_text (MPL_ENTRY (filter_entry), "");
+  mpl_entry_set_text (MPL_ENTRY (pasteboard_entry), "");
+
+  /* the panel is hidden most of the time; only the store needs
+   * to stay around while it is
+   */
+  mnb_clipboard_view_suspend (MNB_CLIPBOARD_VIEW (pasteboard_view));
+
+  if (MNB_IS_CLIPBOARD_PROXY (store))
+    mnb_clipboard_proxy_release (MNB_CLIPBOARD_PROXY (store));
+
+  /* we only measure the first time the panel is shown */
+  if (startup_timer != NULL)
+    {
+      g_timer_destroy (startup_timer);
+      startup_timer = NULL;
+    }
 }
 
 struct _SearchClosure
@@ -131,22 +261,46 @@ on_clear_clicked (MxButton *button,
   mnb_clipboard_store_clear (MNB_CLIPBOARD_STORE (store));
 }
 
-static void
-on_selection_changed (MnbClipboardStore *store,
-                      const gchar       *current_selection,
-                      MxLabel         *label)
+static gboolean
+update_selection_label (gpointer data)
 {
-  if (current_selection == NULL || *current_selection == '\0')
+  MxLabel *label = data;
+
+  selection_repaint_id = 0;
+
+  if (pending_selection == NULL || *pending_selection == '\0')
     mx_label_set_text (label, _("Nothing selected"));
   else
     {
       gchar *text;
 
-      text = g_strdup_printf ("\"%s\"", current_selection);
+      text = g_strdup_printf ("\"%s\"", pending_selection);
       mx_label_set_text (label, text);
 
       g_free (text);
     }
+
+  g_free (pending_selection);
+  pending_selection = NULL;
+
+  return FALSE;
+}
+
+static void
+on_selection_changed (MnbClipboardStore *store,
+                      const gchar       *current_selection,
+                      MxLabel         *label)
+{
+  g_free (pending_selection);
+  pending_selection = g_strdup (current_selection);
+
+  if (selection_repaint_id != 0)
+    return;
+
+  selection_repaint_id =
+    clutter_threads_add_repaint_func (update_selection_label, label, NULL);
+
+  clutter_actor_queue_redraw (CLUTTER_ACTOR (label));
 }
 
 static void
@@ -156,17 +310,17 @@ on_selection_copy_clicked (MxButton *button,
   mnb_clipboard_store_save_selection (store);
 }
 
-static void on_item_added (MnbClipboardStore    *store,
-                           MnbClipboardItemType  item_type,
-                           ClutterActor         *bin);
+static void on_items_added (MnbClipboardStore *store,
+                            GArray            *serials,
+                            ClutterActor      *bin);
 
 static void
-on_item_added (MnbClipboardStore    *store,
-               MnbClipboardItemType  item_type,
-               ClutterActor         *bin)
+on_items_added (MnbClipboardStore *store,
+                GArray            *serials,
+                ClutterActor      *bin)
 {
   g_signal_handlers_disconnect_by_func (store,
-                                        G_CALLBACK (on_item_added),
+                                        G_CALLBACK (on_items_added),
                                         bin);
 
   clutter_actor_destroy (bin);
@@ -174,15 +328,13 @@ on_item_added (MnbClipboardStore    *store,
 
 static ClutterActor *
 make_pasteboard (gint           width,
-                 ClutterActor **entry_out)
+                 ClutterActor **entry_out,
+                 ClutterActor **view_out)
 {
   ClutterActor *vbox, *hbox, *label, *entry, *bin, *button;
   ClutterActor *view, *scroll;
   ClutterText *text;
 
-  /* the object proxying the Clipboard changes and storing them */
-  store = mnb_clipboard_store_new ();
-
   vbox = mx_table_new ();
   mx_table_set_column_spacing (MX_TABLE (vbox), 12);
   mx_table_set_row_spacing (MX_TABLE (vbox), 6);
@@ -258,12 +410,18 @@ make_pasteboard (gint           width,
   clutter_container_add_actor (CLUTTER_CONTAINER (bin),
                                CLUTTER_ACTOR (label));
 
-  g_signal_connect (store, "item-added",
-                    G_CALLBACK (on_item_added),
-                    bin);
+  /* the store might have been capturing for a while already */
+  if (mnb_clipboard_store_get_n_items (store) > 0)
+    clutter_actor_destroy (bin);
+  else
+    g_signal_connect (store, "items-added",
+                      G_CALLBACK (on_items_added),
+                      bin);
 
   /* the actual view */
   view = CLUTTER_ACTOR (mnb_clipboard_view_new (store));
+  if (view_out)
+    *view_out = view;
 
   /* the scroll view is bigger to avoid the horizontal scroll bar */
   scroll = CLUTTER_ACTOR (mx_scroll_view_new ());
@@ -358,6 +516,14 @@ make_pasteboard (gint           width,
                     G_CALLBACK (on_selection_changed),
                     label);
 
+  {
+    gchar *selection = mnb_clipboard_store_get_selection_preview (store);
+
+    on_selection_changed (store, selection, MX_LABEL (label));
+
+    g_free (selection);
+  }
+
 
   return CLUTTER_ACTOR (vbox);
 }
@@ -368,9 +534,11 @@ _client_set_size_cb (MplPanelClient *client,
                      guint           height,
                      gpointer        userdata)
 {
-  clutter_actor_set_size ((ClutterActor *)userdata,
-                          width,
-                          height);
+  pasteboard_width = width;
+  pasteboard_height = height;
+
+  if (pasteboard != NULL)
+    clutter_actor_set_size (pasteboard, width, height);
 
   g_debug (G_STRLOC ": Dimensions for grid view: %d x %d",
            width,
@@ -378,6 +546,8 @@ _client_set_size_cb (MplPanelClient *client,
 }
 
 static gboolean standalone = FALSE;
+static gboolean daemon_mode = FALSE;
+static gboolean native_capture = FALSE;
 
 static GOptionEntry entries[] = {
   {
@@ -386,19 +556,157 @@ static GOptionEntry entries[] = {
     G_OPTION_ARG_NONE, &standalone,
     "Do not embed into the mutter-meego panel", NULL
   },
+  {
+    "daemon", 'd',
+    0,
+    G_OPTION_ARG_NONE, &daemon_mode,
+    "Keep the history without any UI, and serve it on the session bus", NULL
+  },
+  {
+    "xfixes", 'x',
+    0,
+    G_OPTION_ARG_NONE, &native_capture,
+    "Watch the selections through XFixes instead of GTK+", NULL
+  },
 
   { NULL }
 };
 
+/* the store capturing the selections, in the daemon or in the panel */
+static MnbClipboardStore *
+new_capture_store (void)
+{
+  return g_object_new (MNB_TYPE_CLIPBOARD_STORE,
+                       "native-capture", native_capture,
+                       NULL);
+}
+
+/* the history is only built, and the files of a previous daemon only
+ * removed, once the name is ours: a second daemon must not touch the
+ * files of the one running
+ */
+static void
+on_name_acquired (GDBusConnection *connection,
+                  const gchar     *name,
+                  gpointer         data)
+{
+  MnbPasteboardService **service = data;
+  GError *error = NULL;
+
+  if (*service != NULL)
+    return;
+
+  store = new_capture_store ();
+  *service = mnb_pasteboard_service_new (store);
+
+  if (!mnb_pasteboard_service_register (*service, connection, &error))
+    {
+      g_critical (G_STRLOC ": Unable to export the pasteboard: %s",
+                  error->message);
+      g_clear_error (&error);
+
+      gtk_main_quit ();
+    }
+}
+
+static void
+on_name_lost (GDBusConnection *connection,
+              const gchar     *name,
+              gpointer         data)
+{
+  g_warning ("Unable to own the name '%s'; is another pasteboard "
+             "daemon running?",
+             name);
+
+  gtk_main_quit ();
+}
+
+/* the daemon owns the history; it does not need Clutter or the
+ * theme, only the GTK+ clipboard and the session bus
+ */
+static int
+run_daemon (int    *argc,
+            char ***argv)
+{
+  MnbPasteboardService *service = NULL;
+  guint owner_id;
+
+  gtk_init (argc, argv);
+
+  /* a panel keeping the history in-process hands it over to us */
+  owner_id = g_bus_own_name (G_BUS_TYPE_SESSION,
+                             MNB_PASTEBOARD_DBUS_NAME,
+                             G_BUS_NAME_OWNER_FLAGS_REPLACE,
+                             NULL,
+                             on_name_acquired,
+                             on_name_lost,
+                             &service,
+                             NULL);
+
+  gtk_main ();
+
+  g_bus_unown_name (owner_id);
+
+  if (service != NULL)
+    g_object_unref (service);
+
+  if (store != NULL)
+    g_object_unref (store);
+
+  return 0;
+}
+
+/* the panel is always a client of the history on the bus: the proxy
+ * mirrors the daemon while it is running, and otherwise owns the bus
+ * name and keeps the history in-process, like it always did; the
+ * capture only starts, and the service is only registered, once the
+ * name is ours
+ */
+static MnbClipboardStore *
+create_store (void)
+{
+  MnbClipboardStore *retval;
+  GDBusConnection *connection;
+  GError *error = NULL;
+
+  connection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, &error);
+  if (connection == NULL)
+    {
+      g_warning ("Unable to connect to the session bus: %s",
+                 error->message);
+      g_clear_error (&error);
+
+      return new_capture_store ();
+    }
+
+  retval = g_object_new (MNB_TYPE_CLIPBOARD_PROXY,
+                         "capture", FALSE,
+                         "native-capture", native_capture,
+                         "connection", connection,
+                         NULL);
+
+  g_object_unref (connection);
+
+  return retval;
+}
+
 int
 main (int    argc,
       char **argv)
 {
   MplPanelClient *client;
-  ClutterActor *stage, *pasteboard;
+  ClutterActor *stage;
   GOptionContext *context;
   GError *error = NULL;
 
+  /* the store generates the previews of large items in a thread */
+#if !GLIB_CHECK_VERSION (2, 32, 0)
+  if (!g_thread_supported ())
+    g_thread_init (NULL);
+#endif
+
+  startup_timer = g_timer_new ();
+
   setlocale (LC_ALL, "");
   bindtextdomain (GETTEXT_PACKAGE, LOCALEDIR);
   bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
@@ -416,16 +724,19 @@ main (int    argc,
 
   g_option_context_free (context);
 
+  if (daemon_mode)
+    return run_daemon (&argc, &argv);
+
   mpl_panel_clutter_init_with_gtk (&argc, &argv);
 
-  mx_texture_cache_load_cache (mx_texture_cache_get_default (),
-                                 MX_CACHE);
-  mx_style_load_from_file (mx_style_get_default (),
-                             THEMEDIR "/panel.css", NULL);
+  /* the object proxying the Clipboard changes and storing them; it
+   * starts capturing as soon as it owns the history, the UI is built
+   * later
+   */
+  store = create_store ();
 
   if (!standalone)
     {
-      ClutterActor *entry = NULL;
       client = mpl_panel_clutter_new ("pasteboard",
                                       _("pasteboard"),
                                       NULL,
@@ -436,35 +747,54 @@ main (int    argc,
 
       mpl_panel_client_set_height_request (client, 400);
 
-      stage = mpl_panel_clutter_get_stage (MPL_PANEL_CLUTTER (client));
-
-      pasteboard = make_pasteboard (800, &entry);
-      clutter_container_add_actor (CLUTTER_CONTAINER (stage), pasteboard);
       g_signal_connect (client,
                         "set-size", G_CALLBACK (_client_set_size_cb),
-                        pasteboard);
+                        NULL);
       g_signal_connect (client,
                         "show-begin", G_CALLBACK (on_dropdown_show),
-                        entry);
+                        NULL);
       g_signal_connect (client,
                         "hide-end", G_CALLBACK (on_dropdown_hide),
-                        entry);
+                        NULL);
+
+      startup_mark ("ready");
+
+      build_pasteboard_id =
+        g_timeout_add_seconds_full (G_PRIORITY_LOW,
+                                    BUILD_PASTEBOARD_DELAY,
+                                    build_pasteboard_timeout,
+                                    client,
+                                    NULL);
     }
   else
     {
       Window xwin;
 
+      mx_texture_cache_load_cache (mx_texture_cache_get_default (),
+                                     MX_CACHE);
+      mx_style_load_from_file (mx_style_get_default (),
+                                 THEMEDIR "/panel.css", NULL);
+
       stage = clutter_stage_get_default ();
       clutter_actor_realize (stage);
       xwin = clutter_x11_get_stage_window (CLUTTER_STAGE (stage));
 
       mpl_panel_clutter_setup_events_with_gtk_for_xid (xwin);
 
-      pasteboard = make_pasteboard (800, NULL);
+      pasteboard = make_pasteboard (800, &pasteboard_entry, &pasteboard_view);
       clutter_container_add_actor (CLUTTER_CONTAINER (stage), pasteboard);
+
+      /* the window never hides, so a thin client mirrors the history
+       * for as long as it runs
+       */
+      if (MNB_IS_CLIPBOARD_PROXY (store))
+        mnb_clipboard_proxy_sync (MNB_CLIPBOARD_PROXY (store));
       clutter_actor_set_size (pasteboard, 1016, 504);
       clutter_actor_set_size (stage, 1016, 504);
       clutter_actor_show_all (stage);
+
+      g_timer_destroy (startup_timer);
+      startup_timer = NULL;
     }
 
   clutter_main ();
@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2008 - 2009 Intel Corporation.
+ *
+ * Author: Emmanuele Bassi <ebassi@linux.intel.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * MnbClipboardArena: a slab allocator for the strings of the history
+ *
+ * Most of the items are short, so instead of a heap allocation per
+ * string we carve them out of large blocks, in power of two size
+ * classes; freed chunks go on a free list per class and are reused by
+ * the next string of the same class.
+ *
+ * Chunks are never moved by the arena itself: when most of the blocks
+ * are unused the owner copies the live strings into a new arena and
+ * frees the old one, see mnb_clipboard_arena_should_compact().
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "mnb-clipboard-arena.h"
+
+#define BLOCK_SIZE      (64 * 1024)
+
+#define MIN_CHUNK_SHIFT (4)
+#define N_CLASSES       (8)     /* 16 bytes to MNB_CLIPBOARD_ARENA_MAX_CHUNK */
+
+typedef struct _FreeChunk       FreeChunk;
+
+struct _FreeChunk
+{
+  FreeChunk *next;
+};
+
+struct _MnbClipboardArena
+{
+  /* the last block is the one we carve new chunks from */
+  GPtrArray *blocks;
+  gsize block_used;
+
+  FreeChunk *free_lists[N_CLASSES];
+
+  gsize live_bytes;
+};
+
+static inline guint
+size_class (gsize size)
+{
+  guint klass = 0;
+
+  size = (size - 1) >> MIN_CHUNK_SHIFT;
+  while (size != 0)
+    {
+      klass += 1;
+      size >>= 1;
+    }
+
+  return klass;
+}
+
+#define CLASS_SIZE(klass)       ((gsize) 1 << ((klass) + MIN_CHUNK_SHIFT))
+
+MnbClipboardArena *
+mnb_clipboard_arena_new (void)
+{
+  MnbClipboardArena *arena = g_slice_new0 (MnbClipboardArena);
+
+  arena->blocks = g_ptr_array_new ();
+  arena->block_used = BLOCK_SIZE;
+
+  return arena;
+}
+
+void
+mnb_clipboard_arena_free (MnbClipboardArena *arena)
+{
+  if (arena == NULL)
+    return;
+
+  g_ptr_array_foreach (arena->blocks, (GFunc) g_free, NULL);
+  g_ptr_array_free (arena->blocks, TRUE);
+
+  g_slice_free (MnbClipboardArena, arena);
+}
+
+static gpointer
+mnb_clipboard_arena_alloc_chunk (MnbClipboardArena *arena,
+                                 guint              klass)
+{
+  gsize chunk_size = CLASS_SIZE (klass);
+  gchar *block;
+
+  if (arena->free_lists[klass] != NULL)
+    {
+      FreeChunk *chunk = arena->free_lists[klass];
+
+      arena->free_lists[klass] = chunk->next;
+
+      return chunk;
+    }
+
+  /* the rest of the current block stays unused; it is smaller
+   * than the chunk we need
+   */
+  if (arena->block_used + chunk_size > BLOCK_SIZE)
+    {
+      g_ptr_array_add (arena->blocks, g_malloc (BLOCK_SIZE));
+      arena->block_used = 0;
+    }
+
+  block = g_ptr_array_index (arena->blocks, arena->blocks->len - 1);
+  block += arena->block_used;
+
+  arena->block_used += chunk_size;
+
+  return block;
+}
+
+/*
+ * mnb_clipboard_arena_strndup:
+ * @arena: a #MnbClipboardArena
+ * @str: (allow-none): a string
+ * @len: the length of @str, in bytes
+ *
+ * Copies @str. Strings that do not fit in the biggest chunk are
+ * allocated with g_malloc() instead.
+ *
+ * Return value: the copy, to be released with
+ *   mnb_clipboard_arena_release()
+ */
+gchar *
+mnb_clipboard_arena_strndup (MnbClipboardArena *arena,
+                             const gchar       *str,
+                             gsize              len)
+{
+  gchar *res;
+  guint klass;
+
+  if (str == NULL)
+    return NULL;
+
+  if (len + 1 > MNB_CLIPBOARD_ARENA_MAX_CHUNK)
+    return g_strndup (str, len);
+
+  klass = size_class (len + 1);
+
+  res = mnb_clipboard_arena_alloc_chunk (arena, klass);
+  memcpy (res, str, len);
+  res[len] = '\0';
+
+  arena->live_bytes += CLASS_SIZE (klass);
+
+  return res;
+}
+
+void
+mnb_clipboard_arena_release (MnbClipboardArena *arena,
+                             gchar             *str,
+                             gsize              len)
+{
+  FreeChunk *chunk;
+  guint klass;
+
+  if (str == NULL)
+    return;
+
+  if (len + 1 > MNB_CLIPBOARD_ARENA_MAX_CHUNK)
+    {
+      g_free (str);
+      return;
+    }
+
+  klass = size_class (len + 1);
+
+  chunk = (FreeChunk *) str;
+  chunk->next = arena->free_lists[klass];
+  arena->free_lists[klass] = chunk;
+
+  arena->live_bytes -= CLASS_SIZE (klass);
+}
+
+/* whether less than half of the blocks is in use; a single block is
+ * never worth compacting
+ */
+gboolean
+mnb_clipboard_arena_should_compact (MnbClipboardArena *arena)
+{
+  gsize allocated = arena->blocks->len * BLOCK_SIZE;
+
+  return arena->blocks->len > 1 && arena->live_bytes < allocated / 2;
+}
+
+void
+mnb_clipboard_arena_get_stats (MnbClipboardArena *arena,
+                               gsize             *live_bytes,
+                               gsize             *allocated_bytes)
+{
+  if (live_bytes)
+    *live_bytes = arena->live_bytes;
+
+  if (allocated_bytes)
+    *allocated_bytes = arena->blocks->len * BLOCK_SIZE;
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2008 - 2009 Intel Corporation.
+ *
+ * Author: Emmanuele Bassi <ebassi@linux.intel.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __MNB_CLIPBOARD_ARENA_H__
+#define __MNB_CLIPBOARD_ARENA_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* strings longer than this are not kept in the arena */
+#define MNB_CLIPBOARD_ARENA_MAX_CHUNK   (2048)
+
+typedef struct _MnbClipboardArena       MnbClipboardArena;
+
+MnbClipboardArena *mnb_clipboard_arena_new  (void);
+void               mnb_clipboard_arena_free (MnbClipboardArena *arena);
+
+gchar *mnb_clipboard_arena_strndup (MnbClipboardArena *arena,
+                                    const gchar       *str,
+                                    gsize              len);
+void   mnb_clipboard_arena_release (MnbClipboardArena *arena,
+                                    gchar             *str,
+                                    gsize              len);
+
+gboolean mnb_clipboard_arena_should_compact (MnbClipboardArena *arena);
+
+void mnb_clipboard_arena_get_stats (MnbClipboardArena *arena,
+                                    gsize             *live_bytes,
+                                    gsize             *allocated_bytes);
+
+G_END_DECLS
+
+#endif /* __MNB_CLIPBOARD_ARENA_H__ */
@@ -0,0 +1,644 @@
+/*
+ * Copyright (C) 2008 - 2009 Intel Corporation.
+ *
+ * Author: Emmanuele Bassi <ebassi@linux.intel.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * MnbClipboardFetch: a streaming fetch of the text of a selection
+ *
+ * GtkClipboard buffers the whole contents of a selection before
+ * handing them over, and the INCR transfers of the big ones go
+ * through it in one piece. Here we convert the selection ourselves
+ * and read the INCR chunks as they come: a short text stays in memory,
+ * while a long one is written to a file chunk by chunk, keeping only
+ * its start for the preview. Past the size cap the rest of the
+ * transfer is drained without being read, and the text is marked as
+ * truncated.
+ *
+ * The TARGETS of a selection can be fetched the same way, without
+ * going through GtkClipboard at all. Every chunk is read in a single
+ * request, straight into our own buffers.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+#include <gdk/gdkx.h>
+#include <X11/Xatom.h>
+
+#include "mnb-clipboard-fetch.h"
+
+/* texts up to this size are kept in memory */
+#define MEMORY_THRESHOLD        (256 * 1024)
+
+/* the start of a long text, kept for its preview and filter key */
+#define HEAD_SIZE               (16 * 1024)
+
+/* how long we wait for the owner between two chunks */
+#define FETCH_TIMEOUT           (5)
+
+typedef struct {
+  GdkWindow *window;
+  Window xwindow;
+
+  Atom target;
+  Atom property;
+  Atom incr;
+
+  GString *buffer;
+  gchar *path;
+  gint fd;
+
+  gsize size;
+  gsize max_size;
+  guint32 text_hash;
+
+  guint timeout_id;
+
+  /* the TARGETS of the selection */
+  GArray *atoms;
+
+  MnbClipboardFetchProgressFunc progress_func;
+  MnbClipboardFetchDoneFunc done_func;
+  MnbClipboardFetchTargetsFunc targets_func;
+  gpointer user_data;
+
+  guint is_incr      : 1;
+  guint is_truncated : 1;
+  guint is_done      : 1;
+  guint is_failed    : 1;
+} Fetch;
+
+static GdkFilterReturn fetch_filter (GdkXEvent *gdk_xevent,
+                                     GdkEvent  *event,
+                                     gpointer   data);
+
+void
+mnb_clipboard_fetch_result_free (MnbClipboardFetchResult *result)
+{
+  if (result == NULL)
+    return;
+
+  g_free (result->text);
+  g_free (result->path);
+  g_free (result->head);
+
+  g_slice_free (MnbClipboardFetchResult, result);
+}
+
+/* the same hash as g_str_hash(), one chunk at a time */
+static guint32
+hash_update (guint32      hash,
+             const gchar *data,
+             gsize        len)
+{
+  const signed char *p = (const signed char *) data;
+  gsize i;
+
+  for (i = 0; i < len; i++)
+    hash = (hash << 5) + hash + p[i];
+
+  return hash;
+}
+
+/* cuts @len back to the start of a character */
+static gsize
+utf8_boundary (const gchar *data,
+               gsize        len)
+{
+  while (len > 0 && (((guchar) data[len]) & 0xc0) == 0x80)
+    len -= 1;
+
+  return len;
+}
+
+static gboolean
+write_all (gint         fd,
+           const gchar *data,
+           gsize        len)
+{
+  while (len > 0)
+    {
+      gssize res = write (fd, data, len);
+
+      if (res < 0)
+        {
+          if (errno == EINTR)
+            continue;
+
+          return FALSE;
+        }
+
+      data += res;
+      len -= res;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+fetch_append (Fetch       *fetch,
+              const gchar *data,
+              gsize        len)
+{
+  if (fetch->max_size > 0 && fetch->size + len > fetch->max_size)
+    {
+      len = utf8_boundary (data, fetch->max_size - fetch->size);
+      fetch->is_truncated = TRUE;
+    }
+
+  /* a NUL would end the text anyway */
+  len = strnlen (data, len);
+
+  fetch->text_hash = hash_update (fetch->text_hash, data, len);
+  fetch->size += len;
+
+  /* without a directory, the text stays in memory whatever its size */
+  if (fetch->fd == -1 &&
+      (fetch->path == NULL || fetch->buffer->len + len <= MEMORY_THRESHOLD))
+    {
+      g_string_append_len (fetch->buffer, data, len);
+      return TRUE;
+    }
+
+  /* the text is too long to stay in memory: what we have so far goes
+   * to the file, and only the head stays
+   */
+  if (fetch->fd == -1)
+    {
+      fetch->fd = g_mkstemp (fetch->path);
+      if (fetch->fd == -1)
+        {
+          g_warning ("Unable to create '%s': %s",
+                     fetch->path,
+                     g_strerror (errno));
+          return FALSE;
+        }
+
+      if (!write_all (fetch->fd, fetch->buffer->str, fetch->buffer->len))
+        goto fail;
+
+      g_string_truncate (fetch->buffer, HEAD_SIZE);
+    }
+
+  if (fetch->buffer->len < HEAD_SIZE)
+    g_string_append_len (fetch->buffer, data,
+                         MIN (len, HEAD_SIZE - fetch->buffer->len));
+
+  if (!write_all (fetch->fd, data, len))
+    goto fail;
+
+  return TRUE;
+
+fail:
+  g_warning ("Unable to write to '%s': %s",
+             fetch->path,
+             g_strerror (errno));
+
+  return FALSE;
+}
+
+static MnbClipboardFetchResult *
+fetch_steal_result (Fetch *fetch)
+{
+  MnbClipboardFetchResult *result;
+  const gchar *end;
+
+  if (fetch->size == 0)
+    return NULL;
+
+  result = g_slice_new0 (MnbClipboardFetchResult);
+  result->size = fetch->size;
+  result->text_hash = fetch->text_hash;
+  result->is_truncated = fetch->is_truncated;
+
+  if (fetch->fd == -1)
+    {
+      /* UTF8_STRING is not always what it says; the text is cut at
+       * the first invalid byte, like the head of a long one
+       */
+      if (!g_utf8_validate (fetch->buffer->str, fetch->buffer->len, &end))
+        {
+          g_string_truncate (fetch->buffer, end - fetch->buffer->str);
+
+          if (fetch->buffer->len == 0)
+            {
+              g_slice_free (MnbClipboardFetchResult, result);
+              return NULL;
+            }
+
+          result->size = fetch->buffer->len;
+          result->text_hash = g_str_hash (fetch->buffer->str);
+          result->is_truncated = TRUE;
+        }
+
+      result->text = g_string_free (fetch->buffer, FALSE);
+      fetch->buffer = NULL;
+
+      return result;
+    }
+
+  close (fetch->fd);
+  fetch->fd = -1;
+
+  result->path = fetch->path;
+  fetch->path = NULL;
+
+  /* the head might end in the middle of a character */
+  g_utf8_validate (fetch->buffer->str, fetch->buffer->len, &end);
+  result->head = g_strndup (fetch->buffer->str, end - fetch->buffer->str);
+
+  return result;
+}
+
+static void
+fetch_free (Fetch *fetch)
+{
+  if (fetch->timeout_id != 0)
+    g_source_remove (fetch->timeout_id);
+
+  gdk_window_remove_filter (fetch->window, fetch_filter, fetch);
+  gdk_window_destroy (fetch->window);
+
+  if (fetch->fd != -1)
+    {
+      close (fetch->fd);
+      g_unlink (fetch->path);
+    }
+
+  if (fetch->buffer != NULL)
+    g_string_free (fetch->buffer, TRUE);
+
+  if (fetch->atoms != NULL)
+    g_array_free (fetch->atoms, TRUE);
+
+  g_free (fetch->path);
+
+  g_slice_free (Fetch, fetch);
+}
+
+/* the window cannot go away from within its own filter */
+static gboolean
+fetch_complete_idle (gpointer data)
+{
+  Fetch *fetch = data;
+  MnbClipboardFetchResult *result = NULL;
+
+  if (fetch->targets_func != NULL)
+    {
+      if (fetch->is_failed)
+        fetch->targets_func (NULL, 0, fetch->user_data);
+      else
+        fetch->targets_func ((GdkAtom *) fetch->atoms->data,
+                             fetch->atoms->len,
+                             fetch->user_data);
+
+      fetch_free (fetch);
+
+      return FALSE;
+    }
+
+  if (!fetch->is_failed)
+    result = fetch_steal_result (fetch);
+
+  fetch->done_func (result, fetch->user_data);
+
+  fetch_free (fetch);
+
+  return FALSE;
+}
+
+static void
+fetch_complete (Fetch    *fetch,
+                gboolean  is_failed)
+{
+  if (fetch->is_done)
+    return;
+
+  fetch->is_done = TRUE;
+  fetch->is_failed = is_failed;
+
+  if (fetch->timeout_id != 0)
+    {
+      g_source_remove (fetch->timeout_id);
+      fetch->timeout_id = 0;
+    }
+
+  g_idle_add (fetch_complete_idle, fetch);
+}
+
+static gboolean
+fetch_timeout (gpointer data)
+{
+  Fetch *fetch = data;
+
+  fetch->timeout_id = 0;
+
+  g_warning ("The owner of the selection stopped answering");
+  fetch_complete (fetch, TRUE);
+
+  return FALSE;
+}
+
+static void
+fetch_restart_timeout (Fetch *fetch)
+{
+  if (fetch->timeout_id != 0)
+    g_source_remove (fetch->timeout_id);
+
+  fetch->timeout_id = g_timeout_add_seconds (FETCH_TIMEOUT,
+                                             fetch_timeout,
+                                             fetch);
+}
+
+/* the atoms are longs on the client side, whatever their format */
+static void
+fetch_append_atoms (Fetch         *fetch,
+                    Atom           type,
+                    gint           format,
+                    unsigned char *data,
+                    unsigned long  n_items)
+{
+  const Atom *xatoms = (const Atom *) data;
+  unsigned long i;
+
+  if (type != XA_ATOM || format != 32)
+    return;
+
+  for (i = 0; i < n_items; i++)
+    {
+      GdkAtom atom = gdk_x11_xatom_to_atom (xatoms[i]);
+
+      g_array_append_val (fetch->atoms, atom);
+    }
+}
+
+static void
+fetch_read_property (Fetch *fetch)
+{
+  Display *xdisplay = GDK_WINDOW_XDISPLAY (fetch->window);
+  unsigned long n_items, bytes_after;
+  unsigned char *data = NULL;
+  Atom type;
+  gint format, res;
+  glong length;
+
+  /* once truncated, the chunks are only drained: the length of the
+   * read is zero, and the property has to be deleted explicitly
+   */
+  length = fetch->is_truncated ? 0 : G_MAXLONG / 4;
+
+  gdk_error_trap_push ();
+  res = XGetWindowProperty (xdisplay, fetch->xwindow, fetch->property,
+                            0, length,
+                            True,
+                            AnyPropertyType,
+                            &type, &format,
+                            &n_items, &bytes_after,
+                            &data);
+  if (fetch->is_truncated)
+    XDeleteProperty (xdisplay, fetch->xwindow, fetch->property);
+  if (gdk_error_trap_pop () || res != Success)
+    {
+      fetch_complete (fetch, TRUE);
+      return;
+    }
+
+  /* deleting the property tells the owner to send the first chunk */
+  if (type == fetch->incr)
+    {
+      fetch->is_incr = TRUE;
+      XFree (data);
+
+      fetch_restart_timeout (fetch);
+      return;
+    }
+
+  if (fetch->is_truncated)
+    {
+      XFree (data);
+
+      if (!fetch->is_incr || bytes_after == 0)
+        fetch_complete (fetch, FALSE);
+
+      return;
+    }
+
+  if (fetch->targets_func != NULL)
+    {
+      fetch_append_atoms (fetch, type, format, data, n_items);
+      XFree (data);
+
+      if (!fetch->is_incr || n_items == 0)
+        fetch_complete (fetch, FALSE);
+      else
+        fetch_restart_timeout (fetch);
+
+      return;
+    }
+
+  if (type == None || format != 8)
+    {
+      XFree (data);
+      fetch_complete (fetch, TRUE);
+      return;
+    }
+
+  /* a zero length chunk ends an INCR transfer */
+  if (n_items > 0 && !fetch_append (fetch, (const gchar *) data, n_items))
+    {
+      XFree (data);
+      fetch_complete (fetch, TRUE);
+      return;
+    }
+
+  XFree (data);
+
+  if (!fetch->is_incr || n_items == 0)
+    {
+      fetch_complete (fetch, FALSE);
+      return;
+    }
+
+  if (fetch->progress_func != NULL)
+    fetch->progress_func (fetch->size, fetch->user_data);
+
+  fetch_restart_timeout (fetch);
+}
+
+static GdkFilterReturn
+fetch_filter (GdkXEvent *gdk_xevent,
+              GdkEvent  *event,
+              gpointer   data)
+{
+  XEvent *xevent = gdk_xevent;
+  Fetch *fetch = data;
+
+  if (fetch->is_done)
+    return GDK_FILTER_CONTINUE;
+
+  switch (xevent->type)
+    {
+    case SelectionNotify:
+      if (xevent->xselection.requestor != fetch->xwindow)
+        return GDK_FILTER_CONTINUE;
+
+      if (xevent->xselection.property == None)
+        fetch_complete (fetch, TRUE);
+      else
+        fetch_read_property (fetch);
+
+      return GDK_FILTER_REMOVE;
+
+    case PropertyNotify:
+      if (xevent->xproperty.window != fetch->xwindow ||
+          xevent->xproperty.atom != fetch->property)
+        return GDK_FILTER_CONTINUE;
+
+      if (fetch->is_incr && xevent->xproperty.state == PropertyNewValue)
+        fetch_read_property (fetch);
+
+      return GDK_FILTER_REMOVE;
+
+    default:
+      break;
+    }
+
+  return GDK_FILTER_CONTINUE;
+}
+
+static Fetch *
+fetch_new (const gchar *target)
+{
+  GdkWindowAttr attributes;
+  Fetch *fetch;
+
+  memset (&attributes, 0, sizeof (GdkWindowAttr));
+  attributes.x = -100;
+  attributes.y = -100;
+  attributes.width = 1;
+  attributes.height = 1;
+  attributes.window_type = GDK_WINDOW_TOPLEVEL;
+  attributes.wclass = GDK_INPUT_ONLY;
+  attributes.override_redirect = TRUE;
+  attributes.event_mask = GDK_PROPERTY_CHANGE_MASK;
+
+  fetch = g_slice_new0 (Fetch);
+  fetch->window = gdk_window_new (NULL, &attributes,
+                                  GDK_WA_X | GDK_WA_Y | GDK_WA_NOREDIR);
+  fetch->xwindow = GDK_WINDOW_XID (fetch->window);
+  fetch->target = gdk_x11_get_xatom_by_name (target);
+  fetch->property = gdk_x11_get_xatom_by_name ("MNB_CLIPBOARD_FETCH");
+  fetch->incr = gdk_x11_get_xatom_by_name ("INCR");
+  fetch->fd = -1;
+
+  return fetch;
+}
+
+/* the time is the one of the owner change, so that we never get the
+ * contents of a newer owner by mistake
+ */
+static void
+fetch_start (Fetch   *fetch,
+             GdkAtom  selection,
+             guint32  time_)
+{
+  gdk_window_add_filter (fetch->window, fetch_filter, fetch);
+
+  XConvertSelection (GDK_WINDOW_XDISPLAY (fetch->window),
+                     gdk_x11_atom_to_xatom (selection),
+                     fetch->target,
+                     fetch->property,
+                     fetch->xwindow,
+                     time_ != GDK_CURRENT_TIME ? time_ : CurrentTime);
+
+  fetch_restart_timeout (fetch);
+}
+
+/*
+ * mnb_clipboard_fetch_text:
+ * @selection: the selection to fetch
+ * @time_: the time of the owner change, or %GDK_CURRENT_TIME
+ * @dir: (allow-none): the directory where a long text is written
+ * @max_size: the maximum size of the text, or 0 for no limit
+ * @progress_func: (allow-none): called after every chunk
+ * @done_func: called with the result, or %NULL if the fetch failed
+ * @user_data: data for the functions
+ *
+ * Fetches the UTF8_STRING target of @selection, streaming the chunks
+ * of an INCR transfer to a file in @dir once the text gets long; with
+ * no @dir, the text stays in memory. The result is owned by
+ * @done_func, which should also take care of the file.
+ */
+void
+mnb_clipboard_fetch_text (GdkAtom                        selection,
+                          guint32                        time_,
+                          const gchar                   *dir,
+                          gsize                          max_size,
+                          MnbClipboardFetchProgressFunc  progress_func,
+                          MnbClipboardFetchDoneFunc      done_func,
+                          gpointer                       user_data)
+{
+  Fetch *fetch;
+
+  g_return_if_fail (done_func != NULL);
+
+  fetch = fetch_new ("UTF8_STRING");
+  fetch->buffer = g_string_new (NULL);
+  fetch->path = dir != NULL ? g_build_filename (dir, "fetch-XXXXXX", NULL)
+                            : NULL;
+  fetch->max_size = max_size;
+  fetch->text_hash = 5381;
+  fetch->progress_func = progress_func;
+  fetch->done_func = done_func;
+  fetch->user_data = user_data;
+
+  fetch_start (fetch, selection, time_);
+}
+
+/*
+ * mnb_clipboard_fetch_targets:
+ * @selection: the selection to fetch
+ * @time_: the time of the owner change, or %GDK_CURRENT_TIME
+ * @targets_func: called with the targets, or %NULL if the fetch failed
+ * @user_data: data for @targets_func
+ *
+ * Fetches the TARGETS of @selection.
+ */
+void
+mnb_clipboard_fetch_targets (GdkAtom                       selection,
+                             guint32                       time_,
+                             MnbClipboardFetchTargetsFunc  targets_func,
+                             gpointer                      user_data)
+{
+  Fetch *fetch;
+
+  g_return_if_fail (targets_func != NULL);
+
+  fetch = fetch_new ("TARGETS");
+  fetch->atoms = g_array_new (FALSE, FALSE, sizeof (GdkAtom));
+  fetch->targets_func = targets_func;
+  fetch->user_data = user_data;
+
+  fetch_start (fetch, selection, time_);
+}
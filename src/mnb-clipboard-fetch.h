@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2008 - 2009 Intel Corporation.
+ *
+ * Author: Emmanuele Bassi <ebassi@linux.intel.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __MNB_CLIPBOARD_FETCH_H__
+#define __MNB_CLIPBOARD_FETCH_H__
+
+#include <gdk/gdk.h>
+
+G_BEGIN_DECLS
+
+typedef struct _MnbClipboardFetchResult MnbClipboardFetchResult;
+
+struct _MnbClipboardFetchResult
+{
+  /* a short text stays in memory; a long one is written to a file as
+   * it comes in, and only its start is kept for the preview
+   */
+  gchar *text;
+  gchar *path;
+  gchar *head;
+
+  gsize size;
+  guint32 text_hash;
+
+  guint is_truncated : 1;
+};
+
+typedef void (* MnbClipboardFetchProgressFunc) (gsize    n_bytes,
+                                                gpointer user_data);
+typedef void (* MnbClipboardFetchDoneFunc)     (MnbClipboardFetchResult *result,
+                                                gpointer                 user_data);
+typedef void (* MnbClipboardFetchTargetsFunc)  (GdkAtom  *atoms,
+                                                gint      n_atoms,
+                                                gpointer  user_data);
+
+void mnb_clipboard_fetch_text    (GdkAtom                        selection,
+                                  guint32                        time_,
+                                  const gchar                   *dir,
+                                  gsize                          max_size,
+                                  MnbClipboardFetchProgressFunc  progress_func,
+                                  MnbClipboardFetchDoneFunc      done_func,
+                                  gpointer                       user_data);
+void mnb_clipboard_fetch_targets (GdkAtom                        selection,
+                                  guint32                        time_,
+                                  MnbClipboardFetchTargetsFunc   targets_func,
+                                  gpointer                       user_data);
+
+void mnb_clipboard_fetch_result_free (MnbClipboardFetchResult *result);
+
+G_END_DECLS
+
+#endif /* __MNB_CLIPBOARD_FETCH_H__ */
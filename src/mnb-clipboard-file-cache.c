@@ -0,0 +1,387 @@
+/*
+ * Copyright (C) 2008 - 2009 Intel Corporation.
+ *
+ * Author: Emmanuele Bassi <ebassi@linux.intel.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * MnbClipboardFileCache: the name, icon and size of the copied files
+ *
+ * The rows of a list of URIs show the files with their metadata; the
+ * URIs can point to slow or remote file systems, so the metadata is
+ * never queried synchronously. A lookup returns a placeholder built
+ * from the URI right away, and starts an asynchronous query whose
+ * result is handed to the callbacks waiting on the URI. The results
+ * are kept per URI, and the least recently used ones are evicted when
+ * the cache grows past its maximum size.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "mnb-clipboard-file-cache.h"
+
+#define DEFAULT_MAX_ENTRIES     (512)
+
+#define QUERY_ATTRIBUTES        G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME "," \
+                                G_FILE_ATTRIBUTE_STANDARD_ICON "," \
+                                G_FILE_ATTRIBUTE_STANDARD_SIZE "," \
+                                G_FILE_ATTRIBUTE_STANDARD_TYPE
+
+typedef struct _CacheEntry      CacheEntry;
+typedef struct _Waiter          Waiter;
+
+struct _Waiter
+{
+  MnbClipboardFileInfoFunc func;
+  gpointer user_data;
+};
+
+struct _CacheEntry
+{
+  gchar *uri;
+
+  MnbClipboardFileInfo info;
+
+  /* the query in flight, and the callbacks waiting for it */
+  GCancellable *cancellable;
+  GSList *waiters;
+
+  /* link inside the LRU queue */
+  GList *link;
+};
+
+struct _MnbClipboardFileCache
+{
+  /* uri -> CacheEntry */
+  GHashTable *entries;
+
+  /* CacheEntry, most recently used first */
+  GQueue lru;
+
+  guint max_entries;
+};
+
+static void
+cache_entry_free (CacheEntry *entry)
+{
+  g_free (entry->uri);
+  g_free (entry->info.display_name);
+  g_free (entry->info.icon_name);
+
+  g_slice_free (CacheEntry, entry);
+}
+
+/* the entries with a query in flight stay, since the query holds
+ * their URI
+ */
+static void
+mnb_clipboard_file_cache_evict (MnbClipboardFileCache *cache,
+                                guint                  n_entries)
+{
+  GList *l = cache->lru.tail;
+
+  while (l != NULL && cache->lru.length > n_entries)
+    {
+      CacheEntry *entry = l->data;
+      GList *prev = l->prev;
+
+      if (entry->cancellable == NULL)
+        {
+          g_queue_delete_link (&cache->lru, l);
+          g_hash_table_remove (cache->entries, entry->uri);
+          cache_entry_free (entry);
+        }
+
+      l = prev;
+    }
+}
+
+static CacheEntry *
+cache_entry_new (const gchar *uri)
+{
+  CacheEntry *entry = g_slice_new0 (CacheEntry);
+  gchar *basename;
+  GFile *file;
+
+  entry->uri = g_strdup (uri);
+
+  /* this does not touch the file system */
+  file = g_file_new_for_uri (uri);
+  basename = g_file_get_basename (file);
+  g_object_unref (file);
+
+  if (basename != NULL)
+    entry->info.display_name = g_filename_display_name (basename);
+  else
+    entry->info.display_name = g_strdup (uri);
+
+  entry->info.size = -1;
+
+  g_free (basename);
+
+  return entry;
+}
+
+static void
+cache_entry_notify (CacheEntry *entry)
+{
+  GSList *waiters, *l;
+
+  /* the callbacks might look the URI up again */
+  waiters = entry->waiters;
+  entry->waiters = NULL;
+
+  for (l = waiters; l != NULL; l = l->next)
+    {
+      Waiter *waiter = l->data;
+
+      waiter->func (entry->uri, &entry->info, waiter->user_data);
+
+      g_slice_free (Waiter, waiter);
+    }
+
+  g_slist_free (waiters);
+}
+
+static void
+on_query_info_ready (GObject      *source,
+                     GAsyncResult *result,
+                     gpointer      user_data)
+{
+  MnbClipboardFileCache *cache = mnb_clipboard_file_cache_get_default ();
+  gchar *uri = user_data;
+  GError *error = NULL;
+  CacheEntry *entry;
+  GFileInfo *info;
+
+  info = g_file_query_info_finish (G_FILE (source), result, &error);
+
+  /* a cancelled query had nobody waiting for it anymore */
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      g_error_free (error);
+      g_free (uri);
+      return;
+    }
+
+  entry = g_hash_table_lookup (cache->entries, uri);
+  g_free (uri);
+
+  if (entry == NULL)
+    {
+      if (info != NULL)
+        g_object_unref (info);
+
+      if (error != NULL)
+        g_error_free (error);
+
+      return;
+    }
+
+  if (entry->cancellable != NULL)
+    {
+      g_object_unref (entry->cancellable);
+      entry->cancellable = NULL;
+    }
+
+  /* a file that went away keeps the name from its URI */
+  if (info != NULL)
+    {
+      GIcon *icon;
+
+      g_free (entry->info.display_name);
+      entry->info.display_name = g_strdup (g_file_info_get_display_name (info));
+
+      icon = g_file_info_get_icon (info);
+      if (G_IS_THEMED_ICON (icon))
+        {
+          const gchar * const *names = g_themed_icon_get_names (G_THEMED_ICON (icon));
+
+          g_free (entry->info.icon_name);
+          entry->info.icon_name = g_strdup (names != NULL ? names[0] : NULL);
+        }
+
+      if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+        {
+          entry->info.is_directory = TRUE;
+          entry->info.size = -1;
+        }
+      else
+        entry->info.size = g_file_info_get_size (info);
+
+      g_object_unref (info);
+    }
+  else
+    g_error_free (error);
+
+  entry->info.is_resolved = TRUE;
+
+  cache_entry_notify (entry);
+}
+
+MnbClipboardFileCache *
+mnb_clipboard_file_cache_get_default (void)
+{
+  static MnbClipboardFileCache *default_cache = NULL;
+
+  if (G_UNLIKELY (default_cache == NULL))
+    {
+      default_cache = g_slice_new0 (MnbClipboardFileCache);
+      default_cache->entries = g_hash_table_new (g_str_hash, g_str_equal);
+      g_queue_init (&default_cache->lru);
+      default_cache->max_entries = DEFAULT_MAX_ENTRIES;
+    }
+
+  return default_cache;
+}
+
+/*
+ * mnb_clipboard_file_cache_lookup:
+ * @cache: a #MnbClipboardFileCache
+ * @uri: the URI of a file
+ * @func: (allow-none): the function to call once the info is resolved
+ * @user_data: data for @func
+ *
+ * Retrieves the info of @uri. If it is not resolved yet, a query is
+ * started and @func is called when it completes; pending callbacks
+ * must be removed with mnb_clipboard_file_cache_cancel().
+ *
+ * Return value: the info, owned by the cache; it is only valid until
+ *   the next call to the cache
+ */
+const MnbClipboardFileInfo *
+mnb_clipboard_file_cache_lookup (MnbClipboardFileCache    *cache,
+                                 const gchar              *uri,
+                                 MnbClipboardFileInfoFunc  func,
+                                 gpointer                  user_data)
+{
+  CacheEntry *entry;
+
+  g_return_val_if_fail (cache != NULL, NULL);
+  g_return_val_if_fail (uri != NULL, NULL);
+
+  entry = g_hash_table_lookup (cache->entries, uri);
+  if (entry != NULL)
+    {
+      /* move to the front of the LRU queue */
+      g_queue_unlink (&cache->lru, entry->link);
+      g_queue_push_head_link (&cache->lru, entry->link);
+    }
+  else
+    {
+      entry = cache_entry_new (uri);
+
+      g_queue_push_head (&cache->lru, entry);
+      entry->link = cache->lru.head;
+
+      g_hash_table_insert (cache->entries, entry->uri, entry);
+    }
+
+  if (!entry->info.is_resolved && func != NULL)
+    {
+      Waiter *waiter = g_slice_new (Waiter);
+
+      waiter->func = func;
+      waiter->user_data = user_data;
+      entry->waiters = g_slist_prepend (entry->waiters, waiter);
+
+      if (entry->cancellable == NULL)
+        {
+          GFile *file = g_file_new_for_uri (uri);
+
+          entry->cancellable = g_cancellable_new ();
+          g_file_query_info_async (file,
+                                   QUERY_ATTRIBUTES,
+                                   G_FILE_QUERY_INFO_NONE,
+                                   G_PRIORITY_LOW,
+                                   entry->cancellable,
+                                   on_query_info_ready,
+                                   g_strdup (uri));
+
+          g_object_unref (file);
+        }
+    }
+
+  /* the new entry is at the head, so it is never the one evicted */
+  mnb_clipboard_file_cache_evict (cache, cache->max_entries);
+
+  return &entry->info;
+}
+
+/*
+ * mnb_clipboard_file_cache_cancel:
+ * @cache: a #MnbClipboardFileCache
+ * @uri: the URI passed to mnb_clipboard_file_cache_lookup()
+ * @func: the function passed to mnb_clipboard_file_cache_lookup()
+ * @user_data: the data passed to mnb_clipboard_file_cache_lookup()
+ *
+ * Removes a pending callback; the query is cancelled once nobody is
+ * waiting for it anymore.
+ */
+void
+mnb_clipboard_file_cache_cancel (MnbClipboardFileCache    *cache,
+                                 const gchar              *uri,
+                                 MnbClipboardFileInfoFunc  func,
+                                 gpointer                  user_data)
+{
+  CacheEntry *entry;
+  GSList *l;
+
+  g_return_if_fail (cache != NULL);
+  g_return_if_fail (uri != NULL);
+
+  entry = g_hash_table_lookup (cache->entries, uri);
+  if (entry == NULL)
+    return;
+
+  for (l = entry->waiters; l != NULL; l = l->next)
+    {
+      Waiter *waiter = l->data;
+
+      if (waiter->func == func && waiter->user_data == user_data)
+        {
+          entry->waiters = g_slist_delete_link (entry->waiters, l);
+          g_slice_free (Waiter, waiter);
+          break;
+        }
+    }
+
+  if (entry->waiters == NULL && entry->cancellable != NULL)
+    {
+      g_cancellable_cancel (entry->cancellable);
+      g_object_unref (entry->cancellable);
+      entry->cancellable = NULL;
+    }
+}
+
+/*
+ * mnb_clipboard_file_cache_trim:
+ * @cache: a #MnbClipboardFileCache
+ * @n_entries: the number of entries to keep
+ *
+ * Evicts the least recently used entries until at most @n_entries
+ * are left in the cache, not counting the ones being resolved.
+ */
+void
+mnb_clipboard_file_cache_trim (MnbClipboardFileCache *cache,
+                               guint                  n_entries)
+{
+  g_return_if_fail (cache != NULL);
+
+  mnb_clipboard_file_cache_evict (cache, n_entries);
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2008 - 2009 Intel Corporation.
+ *
+ * Author: Emmanuele Bassi <ebassi@linux.intel.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __MNB_CLIPBOARD_FILE_CACHE_H__
+#define __MNB_CLIPBOARD_FILE_CACHE_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef struct _MnbClipboardFileCache   MnbClipboardFileCache;
+typedef struct _MnbClipboardFileInfo    MnbClipboardFileInfo;
+
+struct _MnbClipboardFileInfo
+{
+  /* until the info is resolved, the name comes from the URI and
+   * there is no icon and no size
+   */
+  gchar *display_name;
+  gchar *icon_name;
+  goffset size;
+
+  guint is_directory : 1;
+  guint is_resolved  : 1;
+};
+
+typedef void (* MnbClipboardFileInfoFunc) (const gchar                *uri,
+                                           const MnbClipboardFileInfo *info,
+                                           gpointer                    user_data);
+
+MnbClipboardFileCache *mnb_clipboard_file_cache_get_default (void);
+
+const MnbClipboardFileInfo *mnb_clipboard_file_cache_lookup (MnbClipboardFileCache    *cache,
+                                                             const gchar              *uri,
+                                                             MnbClipboardFileInfoFunc  func,
+                                                             gpointer                  user_data);
+void                        mnb_clipboard_file_cache_cancel (MnbClipboardFileCache    *cache,
+                                                             const gchar              *uri,
+                                                             MnbClipboardFileInfoFunc  func,
+                                                             gpointer                  user_data);
+
+void mnb_clipboard_file_cache_trim (MnbClipboardFileCache *cache,
+                                    guint                  n_entries);
+
+G_END_DECLS
+
+#endif /* __MNB_CLIPBOARD_FILE_CACHE_H__ */
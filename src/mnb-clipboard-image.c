@@ -0,0 +1,558 @@
+/*
+ * Copyright (C) 2008 - 2009 Intel Corporation.
+ *
+ * Author: Emmanuele Bassi <ebassi@linux.intel.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * MnbClipboardImage: the out-of-line storage of the copied images
+ *
+ * A copied image is not kept as a GdkPixbuf: it is written as a PNG
+ * file in the cache directory, and the history only holds its URI.
+ * The files are named after the SHA-1 of their contents, plus a
+ * unique suffix, since every item owns its file:
+ *
+ *   images/<sha1>-XXXXXX.png
+ *
+ * The thumbnails are shared by the images with the same contents:
+ *
+ *   thumbnails/<sha1>.png
+ *
+ * Storing an image decodes and downscales it, so it happens on the
+ * store's worker thread; the rows find the thumbnail through a thread
+ * of their own, which only decodes the full image again if the
+ * thumbnail went missing. Once the thumbnail exists, showing a row
+ * does not decode anything but the thumbnail itself.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <glib/gstdio.h>
+
+#include "mnb-clipboard-image.h"
+
+typedef struct {
+  gchar *image_uri;
+  gchar *thumbnail_path;
+
+  GCancellable *cancellable;
+
+  MnbClipboardThumbnailFunc func;
+  gpointer user_data;
+} ThumbnailRequest;
+
+static GThreadPool *thumbnail_pool = NULL;
+
+const gchar *
+mnb_clipboard_image_get_dir (void)
+{
+  static gsize image_dir = 0;
+
+  /* the store calls us from its worker thread */
+  if (g_once_init_enter (&image_dir))
+    {
+      gchar *path = g_build_filename (g_get_user_cache_dir (),
+                                      "meego-panel-pasteboard",
+                                      NULL);
+
+      g_once_init_leave (&image_dir, (gsize) path);
+    }
+
+  return (const gchar *) image_dir;
+}
+
+static gchar *
+get_thumbnail_path (const gchar *hash)
+{
+  gchar *name, *path;
+
+  name = g_strconcat (hash, ".png", NULL);
+  path = g_build_filename (mnb_clipboard_image_get_dir (),
+                           "thumbnails",
+                           name,
+                           NULL);
+  g_free (name);
+
+  return path;
+}
+
+/* the hash is the part of the name before the suffix */
+static gchar *
+get_image_hash (const gchar *image_path)
+{
+  gchar *basename, *dash;
+
+  basename = g_path_get_basename (image_path);
+
+  dash = strrchr (basename, '-');
+  if (dash == NULL)
+    {
+      g_free (basename);
+      return NULL;
+    }
+
+  *dash = '\0';
+
+  return basename;
+}
+
+static void
+get_thumbnail_size (gint  width,
+                    gint  height,
+                    gint *thumb_width,
+                    gint *thumb_height)
+{
+  gdouble scale;
+
+  /* only scale down */
+  scale = MIN ((gdouble) MNB_CLIPBOARD_IMAGE_THUMBNAIL_SIZE / MAX (width, 1),
+               (gdouble) MNB_CLIPBOARD_IMAGE_THUMBNAIL_SIZE / MAX (height, 1));
+  scale = MIN (scale, 1.0);
+
+  *thumb_width = MAX (1, (gint) (width * scale));
+  *thumb_height = MAX (1, (gint) (height * scale));
+}
+
+static void
+on_size_prepared (GdkPixbufLoader *loader,
+                  gint             width,
+                  gint             height,
+                  gpointer         user_data)
+{
+  gint thumb_width, thumb_height;
+
+  get_thumbnail_size (width, height, &thumb_width, &thumb_height);
+
+  if (thumb_width != width || thumb_height != height)
+    gdk_pixbuf_loader_set_size (loader, thumb_width, thumb_height);
+}
+
+/* decodes @data straight at the size of the thumbnail */
+static GdkPixbuf *
+decode_thumbnail (const guchar  *data,
+                  gsize          len,
+                  GError       **error)
+{
+  GdkPixbufLoader *loader;
+  GdkPixbuf *pixbuf = NULL;
+
+  loader = gdk_pixbuf_loader_new ();
+  g_signal_connect (loader, "size-prepared",
+                    G_CALLBACK (on_size_prepared),
+                    NULL);
+
+  if (!gdk_pixbuf_loader_write (loader, data, len, error))
+    {
+      gdk_pixbuf_loader_close (loader, NULL);
+      goto out;
+    }
+
+  if (!gdk_pixbuf_loader_close (loader, error))
+    goto out;
+
+  pixbuf = gdk_pixbuf_loader_get_pixbuf (loader);
+  if (pixbuf != NULL)
+    g_object_ref (pixbuf);
+  else
+    g_set_error (error, GDK_PIXBUF_ERROR, GDK_PIXBUF_ERROR_CORRUPT_IMAGE,
+                 "The image could not be decoded");
+
+out:
+  g_object_unref (loader);
+
+  return pixbuf;
+}
+
+static gboolean
+save_thumbnail (const gchar  *path,
+                GdkPixbuf    *thumbnail,
+                GError      **error)
+{
+  gchar *buffer, *dir;
+  gsize len;
+  gboolean res;
+
+  if (!gdk_pixbuf_save_to_buffer (thumbnail, &buffer, &len, "png", error,
+                                  NULL))
+    return FALSE;
+
+  dir = g_path_get_dirname (path);
+  g_mkdir_with_parents (dir, 0700);
+  g_free (dir);
+
+  res = g_file_set_contents (path, buffer, len, error);
+
+  g_free (buffer);
+
+  return res;
+}
+
+/* writes the PNG data of a new item in a file of its own */
+static gchar *
+write_image (const gchar   *hash,
+             const guchar  *data,
+             gsize          len,
+             GError       **error)
+{
+  gchar *name, *path, *dir;
+  gint fd;
+
+  dir = g_build_filename (mnb_clipboard_image_get_dir (), "images", NULL);
+  g_mkdir_with_parents (dir, 0700);
+
+  name = g_strconcat (hash, "-XXXXXX.png", NULL);
+  path = g_build_filename (dir, name, NULL);
+  g_free (name);
+  g_free (dir);
+
+  fd = g_mkstemp_full (path, O_WRONLY, 0600);
+  if (fd == -1)
+    {
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                   "Unable to create '%s': %s",
+                   path,
+                   g_strerror (errno));
+      g_free (path);
+      return NULL;
+    }
+
+  close (fd);
+
+  if (!g_file_set_contents (path, (const gchar *) data, len, error))
+    {
+      g_unlink (path);
+      g_free (path);
+      return NULL;
+    }
+
+  return path;
+}
+
+static gchar *
+store_image (const guchar  *data,
+             gsize          len,
+             GdkPixbuf     *pixbuf,
+             GError       **error)
+{
+  gchar *hash, *thumbnail_path, *path, *uri = NULL;
+
+  hash = g_compute_checksum_for_data (G_CHECKSUM_SHA1, data, len);
+
+  /* an image copied before already has its thumbnail */
+  thumbnail_path = get_thumbnail_path (hash);
+  if (!g_file_test (thumbnail_path, G_FILE_TEST_EXISTS))
+    {
+      GdkPixbuf *thumbnail;
+
+      if (pixbuf != NULL)
+        {
+          gint width, height;
+
+          get_thumbnail_size (gdk_pixbuf_get_width (pixbuf),
+                              gdk_pixbuf_get_height (pixbuf),
+                              &width, &height);
+          thumbnail = gdk_pixbuf_scale_simple (pixbuf, width, height,
+                                               GDK_INTERP_BILINEAR);
+        }
+      else
+        thumbnail = decode_thumbnail (data, len, error);
+
+      /* data we cannot decode is not an image we can show */
+      if (thumbnail == NULL)
+        goto out;
+
+      if (!save_thumbnail (thumbnail_path, thumbnail, error))
+        {
+          g_object_unref (thumbnail);
+          goto out;
+        }
+
+      g_object_unref (thumbnail);
+    }
+
+  path = write_image (hash, data, len, error);
+  if (path == NULL)
+    goto out;
+
+  uri = g_filename_to_uri (path, NULL, error);
+
+  g_free (path);
+
+out:
+  g_free (thumbnail_path);
+  g_free (hash);
+
+  return uri;
+}
+
+/*
+ * mnb_clipboard_image_store_png:
+ * @data: the contents of a PNG file
+ * @len: the length of @data
+ * @error: return location for a #GError, or %NULL
+ *
+ * Stores a copied PNG image as it is, creating its thumbnail if
+ * needed. Blocks, so it should be called from a worker thread.
+ *
+ * Return value: the URI of the stored image, or %NULL
+ */
+gchar *
+mnb_clipboard_image_store_png (const guchar  *data,
+                               gsize          len,
+                               GError       **error)
+{
+  g_return_val_if_fail (data != NULL, NULL);
+
+  return store_image (data, len, NULL, error);
+}
+
+/*
+ * mnb_clipboard_image_store_pixbuf:
+ * @pixbuf: a #GdkPixbuf
+ * @error: return location for a #GError, or %NULL
+ *
+ * Stores a copied image, compressing it to PNG. Blocks, so it should
+ * be called from a worker thread.
+ *
+ * Return value: the URI of the stored image, or %NULL
+ */
+gchar *
+mnb_clipboard_image_store_pixbuf (GdkPixbuf  *pixbuf,
+                                  GError    **error)
+{
+  gchar *buffer, *uri;
+  gsize len;
+
+  g_return_val_if_fail (GDK_IS_PIXBUF (pixbuf), NULL);
+
+  if (!gdk_pixbuf_save_to_buffer (pixbuf, &buffer, &len, "png", error, NULL))
+    return NULL;
+
+  uri = store_image ((const guchar *) buffer, len, pixbuf, error);
+
+  g_free (buffer);
+
+  return uri;
+}
+
+static void
+thumbnail_request_free (ThumbnailRequest *request)
+{
+  g_free (request->image_uri);
+  g_free (request->thumbnail_path);
+
+  if (request->cancellable != NULL)
+    g_object_unref (request->cancellable);
+
+  g_slice_free (ThumbnailRequest, request);
+}
+
+static gboolean
+thumbnail_ready_idle (gpointer data)
+{
+  ThumbnailRequest *request = data;
+
+  if (request->cancellable == NULL ||
+      !g_cancellable_is_cancelled (request->cancellable))
+    request->func (request->thumbnail_path, request->user_data);
+
+  thumbnail_request_free (request);
+
+  return FALSE;
+}
+
+/* runs in the thumbnail thread */
+static void
+thumbnail_thread_func (gpointer data,
+                       gpointer user_data)
+{
+  ThumbnailRequest *request = data;
+  gchar *image_path, *hash = NULL;
+  GError *error = NULL;
+
+  if (request->cancellable != NULL &&
+      g_cancellable_is_cancelled (request->cancellable))
+    goto out;
+
+  image_path = g_filename_from_uri (request->image_uri, NULL, NULL);
+  if (image_path != NULL)
+    hash = get_image_hash (image_path);
+
+  if (hash == NULL)
+    {
+      g_free (image_path);
+      goto out;
+    }
+
+  request->thumbnail_path = get_thumbnail_path (hash);
+
+  /* the thumbnails are a cache, and might have been cleaned up */
+  if (!g_file_test (request->thumbnail_path, G_FILE_TEST_EXISTS))
+    {
+      GdkPixbuf *thumbnail = NULL;
+      gchar *contents;
+      gsize len;
+
+      if (g_file_get_contents (image_path, &contents, &len, &error))
+        {
+          thumbnail = decode_thumbnail ((const guchar *) contents, len, &error);
+          g_free (contents);
+        }
+
+      if (thumbnail == NULL ||
+          !save_thumbnail (request->thumbnail_path, thumbnail, &error))
+        {
+          g_warning ("Unable to create the thumbnail of '%s': %s",
+                     image_path,
+                     error->message);
+          g_error_free (error);
+
+          g_free (request->thumbnail_path);
+          request->thumbnail_path = NULL;
+        }
+
+      if (thumbnail != NULL)
+        g_object_unref (thumbnail);
+    }
+
+  g_free (image_path);
+  g_free (hash);
+
+out:
+  g_idle_add (thumbnail_ready_idle, request);
+}
+
+/*
+ * mnb_clipboard_image_get_thumbnail:
+ * @image_uri: the URI of a stored image
+ * @cancellable: (allow-none): a #GCancellable
+ * @func: the function called with the path of the thumbnail
+ * @user_data: data for @func
+ *
+ * Finds the thumbnail of an image in a thread, creating it again if
+ * it is missing. @func is called from the main loop, with a %NULL path
+ * if there is no thumbnail, unless @cancellable was cancelled.
+ */
+void
+mnb_clipboard_image_get_thumbnail (const gchar               *image_uri,
+                                   GCancellable              *cancellable,
+                                   MnbClipboardThumbnailFunc  func,
+                                   gpointer                   user_data)
+{
+  ThumbnailRequest *request;
+
+  g_return_if_fail (image_uri != NULL);
+  g_return_if_fail (func != NULL);
+
+  if (thumbnail_pool == NULL)
+    thumbnail_pool = g_thread_pool_new (thumbnail_thread_func, NULL,
+                                        1, FALSE,
+                                        NULL);
+
+  request = g_slice_new0 (ThumbnailRequest);
+  request->image_uri = g_strdup (image_uri);
+  request->cancellable = cancellable != NULL ? g_object_ref (cancellable)
+                                             : NULL;
+  request->func = func;
+  request->user_data = user_data;
+
+  g_thread_pool_push (thumbnail_pool, request, NULL);
+}
+
+/*
+ * mnb_clipboard_image_clean_dir:
+ * @keep_uris: the URIs of the images still in use
+ *
+ * Removes the images left over by a previous session, and the
+ * thumbnails that no image uses anymore.
+ */
+void
+mnb_clipboard_image_clean_dir (const gchar * const *keep_uris)
+{
+  GHashTable *keep, *hashes;
+  const gchar *name;
+  gchar *path;
+  GDir *dir;
+  gint i;
+
+  keep = g_hash_table_new (g_str_hash, g_str_equal);
+  hashes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  for (i = 0; keep_uris != NULL && keep_uris[i] != NULL; i++)
+    g_hash_table_insert (keep, (gpointer) keep_uris[i], (gpointer) keep_uris[i]);
+
+  path = g_build_filename (mnb_clipboard_image_get_dir (), "images", NULL);
+  dir = g_dir_open (path, 0, NULL);
+  if (dir != NULL)
+    {
+      while ((name = g_dir_read_name (dir)) != NULL)
+        {
+          gchar *file = g_build_filename (path, name, NULL);
+          gchar *uri = g_filename_to_uri (file, NULL, NULL);
+
+          if (uri != NULL && g_hash_table_lookup (keep, uri) != NULL)
+            {
+              gchar *hash = get_image_hash (file);
+
+              if (hash != NULL)
+                g_hash_table_insert (hashes, hash, hash);
+            }
+          else
+            g_unlink (file);
+
+          g_free (uri);
+          g_free (file);
+        }
+
+      g_dir_close (dir);
+    }
+
+  g_free (path);
+
+  path = g_build_filename (mnb_clipboard_image_get_dir (), "thumbnails", NULL);
+  dir = g_dir_open (path, 0, NULL);
+  if (dir != NULL)
+    {
+      while ((name = g_dir_read_name (dir)) != NULL)
+        {
+          gchar *hash = g_strndup (name, strcspn (name, "."));
+
+          if (g_hash_table_lookup (hashes, hash) == NULL)
+            {
+              gchar *file = g_build_filename (path, name, NULL);
+
+              g_unlink (file);
+              g_free (file);
+            }
+
+          g_free (hash);
+        }
+
+      g_dir_close (dir);
+    }
+
+  g_free (path);
+
+  g_hash_table_destroy (hashes);
+  g_hash_table_destroy (keep);
+}
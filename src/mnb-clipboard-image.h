@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2008 - 2009 Intel Corporation.
+ *
+ * Author: Emmanuele Bassi <ebassi@linux.intel.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __MNB_CLIPBOARD_IMAGE_H__
+#define __MNB_CLIPBOARD_IMAGE_H__
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* the thumbnails fit in a square of this size */
+#define MNB_CLIPBOARD_IMAGE_THUMBNAIL_SIZE      (128)
+
+typedef void (* MnbClipboardThumbnailFunc) (const gchar *thumbnail_path,
+                                            gpointer     user_data);
+
+/* these store the full image as a PNG file, along with its thumbnail;
+ * they block, so they are meant to be called from a worker thread.
+ * They return the URI of the stored image
+ */
+gchar *mnb_clipboard_image_store_png    (const guchar  *data,
+                                         gsize          len,
+                                         GError       **error);
+gchar *mnb_clipboard_image_store_pixbuf (GdkPixbuf     *pixbuf,
+                                         GError       **error);
+
+void mnb_clipboard_image_get_thumbnail (const gchar               *image_uri,
+                                        GCancellable              *cancellable,
+                                        MnbClipboardThumbnailFunc  func,
+                                        gpointer                   user_data);
+
+const gchar *mnb_clipboard_image_get_dir   (void);
+void         mnb_clipboard_image_clean_dir (const gchar * const *keep_uris);
+
+G_END_DECLS
+
+#endif /* __MNB_CLIPBOARD_IMAGE_H__ */
@@ -26,6 +26,9 @@
 #include <glib/gi18n.h>
 
 #include "mnb-clipboard-item.h"
+#include "mnb-clipboard-file-cache.h"
+#include "mnb-clipboard-image.h"
+#include "mnb-clipboard-text.h"
 #include "mnb-pasteboard-marshal.h"
 
 enum
@@ -41,37 +44,244 @@ enum
 {
   REMOVE_CLICKED,
   ACTION_CLICKED,
+  PIN_CLICKED,
 
   LAST_SIGNAL
 };
 
+/* the files shown for a list of URIs; the rest are only counted */
+#define MAX_FILE_ROWS           (5)
+
+#define FILE_ICON_SIZE          (16)
+#define FILE_PLACEHOLDER_ICON   "text-x-generic"
+
+typedef struct {
+  MnbClipboardItem *item;
+
+  gchar *uri;
+
+  ClutterActor *icon;
+  ClutterActor *name_label;
+  ClutterActor *size_label;
+} FileRow;
+
 G_DEFINE_TYPE (MnbClipboardItem, mnb_clipboard_item, MX_TYPE_TABLE);
 
 static guint item_signals[LAST_SIGNAL] = { 0, };
 
+/* the buttons are shared by all the rows: they are built the first
+ * time a row is hovered or gets the key focus, and then moved to
+ * whichever row is active. Every row keeps the room for them in its
+ * right padding, so it does not change size when they come and go;
+ * the pinned state and the paste target are shown by the style class
+ * of the row itself
+ */
+typedef struct {
+  ClutterActor *box;
+
+  ClutterActor *remove_button;
+  ClutterActor *action_button;
+  ClutterActor *pin_button;
+
+  /* the row holding the buttons, if any */
+  MnbClipboardItem *item;
+} ItemControls;
+
+static ItemControls controls = { NULL, };
+
+static void
+controls_emit (guint signal_id)
+{
+  MnbClipboardItem *item = controls.item;
+
+  if (item == NULL)
+    return;
+
+  /* the handler might destroy the row */
+  g_object_ref (item);
+  g_signal_emit (item, signal_id, 0);
+  g_object_unref (item);
+}
+
 static void
 on_remove_clicked (MxButton *button,
-                   MnbClipboardItem *self)
+                   gpointer  dummy G_GNUC_UNUSED)
 {
-  g_signal_emit (self, item_signals[REMOVE_CLICKED], 0);
+  controls_emit (item_signals[REMOVE_CLICKED]);
 }
 
 static void
 on_action_clicked (MxButton *button,
-                   MnbClipboardItem *self)
+                   gpointer  dummy G_GNUC_UNUSED)
+{
+  controls_emit (item_signals[ACTION_CLICKED]);
+}
+
+static void
+on_pin_clicked (MxButton *button,
+                gpointer  dummy G_GNUC_UNUSED)
 {
-  g_signal_emit (self, item_signals[ACTION_CLICKED], 0);
+  controls_emit (item_signals[PIN_CLICKED]);
+}
+
+static G_CONST_RETURN gchar *
+get_remove_icon_path (void)
+{
+  static gchar *remove_icon_path = NULL;
+
+  if (G_UNLIKELY (remove_icon_path == NULL))
+    remove_icon_path = g_build_filename (THEMEDIR,
+                                         "pasteboard-item-delete-hover.png",
+                                         NULL);
+
+  return remove_icon_path;
+}
+
+static void
+controls_ensure (void)
+{
+  ClutterTexture *texture;
+  MxTextureCache *texture_cache;
+
+  if (controls.box != NULL)
+    return;
+
+  /* the buttons outlive the rows they are moved between */
+  controls.box = mx_box_layout_new ();
+  g_object_ref_sink (controls.box);
+  mx_box_layout_set_spacing (MX_BOX_LAYOUT (controls.box), 6);
+  mx_stylable_set_style_class (MX_STYLABLE (controls.box),
+                               "MnbClipboardItemControls");
+
+  controls.remove_button = CLUTTER_ACTOR (mx_button_new ());
+  mx_stylable_set_style_class (MX_STYLABLE (controls.remove_button),
+                               "MnbClipboardItemDeleteButton");
+  clutter_actor_set_reactive (controls.remove_button, TRUE);
+  g_signal_connect (controls.remove_button, "clicked",
+                    G_CALLBACK (on_remove_clicked),
+                    NULL);
+  clutter_container_add_actor (CLUTTER_CONTAINER (controls.box),
+                               controls.remove_button);
+
+  texture_cache = mx_texture_cache_get_default ();
+  texture = mx_texture_cache_get_texture (texture_cache,
+                                          get_remove_icon_path ());
+  if (texture != NULL)
+    mx_bin_set_child (MX_BIN (controls.remove_button),
+                      CLUTTER_ACTOR (texture));
+
+  controls.action_button = CLUTTER_ACTOR (mx_button_new ());
+  mx_button_set_label (MX_BUTTON (controls.action_button),
+                       C_("Used to form '*Copy* from pasteboard'",
+                          "Copy"));
+  mx_stylable_set_style_class (MX_STYLABLE (controls.action_button),
+                               "MnbClipboardItemCopyButton");
+  clutter_actor_set_reactive (controls.action_button, TRUE);
+  g_signal_connect (controls.action_button, "clicked",
+                    G_CALLBACK (on_action_clicked),
+                    NULL);
+  clutter_container_add_actor (CLUTTER_CONTAINER (controls.box),
+                               controls.action_button);
+
+  controls.pin_button = CLUTTER_ACTOR (mx_button_new ());
+  mx_stylable_set_style_class (MX_STYLABLE (controls.pin_button),
+                               "MnbClipboardItemPinButton");
+  clutter_actor_set_reactive (controls.pin_button, TRUE);
+  g_signal_connect (controls.pin_button, "clicked",
+                    G_CALLBACK (on_pin_clicked),
+                    NULL);
+  clutter_container_add_actor (CLUTTER_CONTAINER (controls.box),
+                               controls.pin_button);
+}
+
+/* the buttons follow the state of the row holding them */
+static void
+controls_update (MnbClipboardItem *item)
+{
+  if (controls.item != item)
+    return;
+
+  if (item->show_action)
+    clutter_actor_show (controls.action_button);
+  else
+    clutter_actor_hide (controls.action_button);
+
+  if (item->is_pinned)
+    mx_button_set_label (MX_BUTTON (controls.pin_button), _("Unpin"));
+  else
+    mx_button_set_label (MX_BUTTON (controls.pin_button), _("Pin"));
+}
+
+static void
+controls_detach (MnbClipboardItem *item)
+{
+  if (controls.item != item)
+    return;
+
+  clutter_actor_unparent (controls.box);
+  controls.item = NULL;
+
+  clutter_actor_queue_redraw (CLUTTER_ACTOR (item));
+}
+
+static void
+controls_attach (MnbClipboardItem *item)
+{
+  controls_ensure ();
+
+  if (controls.item != item)
+    {
+      if (controls.item != NULL)
+        controls_detach (controls.item);
+
+      clutter_actor_set_parent (controls.box, CLUTTER_ACTOR (item));
+      controls.item = item;
+
+      /* only the buttons are allocated again, the row keeps its size */
+      clutter_actor_queue_relayout (CLUTTER_ACTOR (item));
+    }
+
+  controls_update (item);
+}
+
+static void
+mnb_clipboard_item_update_style_class (MnbClipboardItem *self)
+{
+  const gchar *style_class = NULL;
+
+  if (self->is_pinned && self->show_action)
+    style_class = "MnbClipboardItemPinnedTarget";
+  else if (self->is_pinned)
+    style_class = "MnbClipboardItemPinned";
+  else if (self->show_action)
+    style_class = "MnbClipboardItemTarget";
+
+  mx_stylable_set_style_class (MX_STYLABLE (self), style_class);
+}
+
+/* whether @actor is @item or one of its children */
+static gboolean
+is_inside_item (ClutterActor     *actor,
+                MnbClipboardItem *item)
+{
+  while (actor != NULL)
+    {
+      if (actor == CLUTTER_ACTOR (item))
+        return TRUE;
+
+      actor = clutter_actor_get_parent (actor);
+    }
+
+  return FALSE;
 }
 
 static gboolean
 mnb_clipboard_item_enter (ClutterActor *actor,
                           ClutterCrossingEvent *event)
 {
-  MnbClipboardItem *item = MNB_CLIPBOARD_ITEM (actor);
-
   mx_stylable_set_style_pseudo_class (MX_STYLABLE (actor), "hover");
 
-  clutter_actor_set_opacity (item->remove_button, 0xff);
+  controls_attach (MNB_CLIPBOARD_ITEM (actor));
 
   return TRUE;
 }
@@ -81,14 +291,204 @@ mnb_clipboard_item_leave (ClutterActor *actor,
                           ClutterCrossingEvent *event)
 {
   MnbClipboardItem *item = MNB_CLIPBOARD_ITEM (actor);
+  ClutterActor *stage;
 
-  mx_stylable_set_style_pseudo_class (MX_STYLABLE (actor), "hover");
+  /* moving onto the buttons does not leave the row */
+  if (is_inside_item (event->related, item))
+    return TRUE;
 
-  clutter_actor_set_opacity (item->remove_button, 0x00);
+  mx_stylable_set_style_pseudo_class (MX_STYLABLE (actor), NULL);
+
+  /* the row with the key focus keeps the buttons */
+  stage = clutter_actor_get_stage (actor);
+  if (stage == NULL ||
+      clutter_stage_get_key_focus (CLUTTER_STAGE (stage)) != actor)
+    controls_detach (item);
 
   return TRUE;
 }
 
+static void
+mnb_clipboard_item_key_focus_in (ClutterActor *actor)
+{
+  controls_attach (MNB_CLIPBOARD_ITEM (actor));
+}
+
+/* the buttons live in the right padding of the row */
+static void
+mnb_clipboard_item_allocate (ClutterActor           *actor,
+                             const ClutterActorBox  *box,
+                             ClutterAllocationFlags  flags)
+{
+  MnbClipboardItem *self = MNB_CLIPBOARD_ITEM (actor);
+  ClutterActorBox child_box;
+  MxPadding padding;
+  gfloat min_width, width, min_height, height;
+
+  CLUTTER_ACTOR_CLASS (mnb_clipboard_item_parent_class)->allocate (actor,
+                                                                   box,
+                                                                   flags);
+
+  if (controls.item != self)
+    return;
+
+  mx_widget_get_padding (MX_WIDGET (actor), &padding);
+
+  clutter_actor_get_preferred_width (controls.box, -1, &min_width, &width);
+  width = MIN (width, padding.right);
+
+  clutter_actor_get_preferred_height (controls.box, width,
+                                      &min_height, &height);
+  height = MIN (height, box->y2 - box->y1);
+
+  child_box.x1 = (gint) (box->x2 - box->x1 - padding.right);
+  child_box.x2 = child_box.x1 + (gint) width;
+  child_box.y1 = (gint) ((box->y2 - box->y1 - height) / 2);
+  child_box.y2 = child_box.y1 + (gint) height;
+
+  clutter_actor_allocate (controls.box, &child_box, flags);
+}
+
+static void
+mnb_clipboard_item_paint (ClutterActor *actor)
+{
+  CLUTTER_ACTOR_CLASS (mnb_clipboard_item_parent_class)->paint (actor);
+
+  if (controls.item == MNB_CLIPBOARD_ITEM (actor))
+    clutter_actor_paint (controls.box);
+}
+
+static void
+mnb_clipboard_item_pick (ClutterActor       *actor,
+                         const ClutterColor *color)
+{
+  CLUTTER_ACTOR_CLASS (mnb_clipboard_item_parent_class)->pick (actor, color);
+
+  if (controls.item == MNB_CLIPBOARD_ITEM (actor))
+    clutter_actor_paint (controls.box);
+}
+
+static void
+mnb_clipboard_item_map (ClutterActor *actor)
+{
+  CLUTTER_ACTOR_CLASS (mnb_clipboard_item_parent_class)->map (actor);
+
+  if (controls.item == MNB_CLIPBOARD_ITEM (actor))
+    clutter_actor_map (controls.box);
+}
+
+static void
+mnb_clipboard_item_unmap (ClutterActor *actor)
+{
+  if (controls.item == MNB_CLIPBOARD_ITEM (actor))
+    clutter_actor_unmap (controls.box);
+
+  CLUTTER_ACTOR_CLASS (mnb_clipboard_item_parent_class)->unmap (actor);
+}
+
+static void
+file_row_update (FileRow                    *row,
+                 const MnbClipboardFileInfo *info)
+{
+  mx_label_set_text (MX_LABEL (row->name_label), info->display_name);
+
+  mx_icon_set_icon_name (MX_ICON (row->icon),
+                         info->icon_name != NULL ? info->icon_name
+                                                 : FILE_PLACEHOLDER_ICON);
+
+  if (info->size >= 0 && !info->is_directory)
+    {
+      gchar *size = g_format_size (info->size);
+
+      mx_label_set_text (MX_LABEL (row->size_label), size);
+      g_free (size);
+    }
+  else
+    mx_label_set_text (MX_LABEL (row->size_label), "");
+}
+
+static void
+on_file_info_resolved (const gchar                *uri,
+                       const MnbClipboardFileInfo *info,
+                       gpointer                    user_data)
+{
+  file_row_update (user_data, info);
+}
+
+static FileRow *
+file_row_new (MnbClipboardItem *item,
+              const gchar      *uri)
+{
+  FileRow *row = g_slice_new0 (FileRow);
+  ClutterActor *box;
+
+  row->item = item;
+  row->uri = g_strdup (uri);
+
+  box = mx_box_layout_new ();
+  mx_box_layout_set_spacing (MX_BOX_LAYOUT (box), 6);
+
+  row->icon = mx_icon_new ();
+  mx_icon_set_icon_size (MX_ICON (row->icon), FILE_ICON_SIZE);
+  clutter_container_add_actor (CLUTTER_CONTAINER (box), row->icon);
+
+  row->name_label = mx_label_new ();
+  clutter_container_add_actor (CLUTTER_CONTAINER (box), row->name_label);
+
+  row->size_label = mx_label_new ();
+  mx_stylable_set_style_class (MX_STYLABLE (row->size_label),
+                               "MnbClipboardItemFileSize");
+  clutter_container_add_actor (CLUTTER_CONTAINER (box), row->size_label);
+
+  clutter_container_add_actor (CLUTTER_CONTAINER (item->files), box);
+
+  /* the placeholder is shown until the query completes; the files
+   * seen before are already resolved
+   */
+  file_row_update (row,
+                   mnb_clipboard_file_cache_lookup (mnb_clipboard_file_cache_get_default (),
+                                                    uri,
+                                                    on_file_info_resolved,
+                                                    row));
+
+  return row;
+}
+
+static void
+file_row_free (FileRow *row)
+{
+  mnb_clipboard_file_cache_cancel (mnb_clipboard_file_cache_get_default (),
+                                   row->uri,
+                                   on_file_info_resolved,
+                                   row);
+
+  g_free (row->uri);
+
+  g_slice_free (FileRow, row);
+}
+
+static void
+mnb_clipboard_item_dispose (GObject *gobject)
+{
+  MnbClipboardItem *self = MNB_CLIPBOARD_ITEM (gobject);
+
+  controls_detach (self);
+
+  /* no query may call back into a row that is gone */
+  g_slist_foreach (self->file_rows, (GFunc) file_row_free, NULL);
+  g_slist_free (self->file_rows);
+  self->file_rows = NULL;
+
+  if (self->image_cancellable != NULL)
+    {
+      g_cancellable_cancel (self->image_cancellable);
+      g_object_unref (self->image_cancellable);
+      self->image_cancellable = NULL;
+    }
+
+  G_OBJECT_CLASS (mnb_clipboard_item_parent_class)->dispose (gobject);
+}
+
 static void
 mnb_clipboard_item_set_property (GObject      *gobject,
                                  guint         prop_id,
@@ -100,8 +500,8 @@ mnb_clipboard_item_set_property (GObject      *gobject,
   switch (prop_id)
     {
     case PROP_CONTENTS:
-      mx_label_set_text (MX_LABEL (self->contents),
-                           g_value_get_string (value));
+      mnb_clipboard_text_set_text (MNB_CLIPBOARD_TEXT (self->contents),
+                                   g_value_get_string (value));
       break;
 
     case PROP_MTIME:
@@ -117,16 +517,6 @@ mnb_clipboard_item_set_property (GObject      *gobject,
     }
 }
 
-static void
-mnb_clipboard_item_finalize (GObject *gobject)
-{
-  MnbClipboardItem *item = MNB_CLIPBOARD_ITEM (gobject);
-
-  g_free (item->filter_contents);
-
-  G_OBJECT_CLASS (mnb_clipboard_item_parent_class)->finalize (gobject);
-}
-
 static void
 mnb_clipboard_item_class_init (MnbClipboardItemClass *klass)
 {
@@ -135,14 +525,20 @@ mnb_clipboard_item_class_init (MnbClipboardItemClass *klass)
   GParamSpec *pspec;
 
   gobject_class->set_property = mnb_clipboard_item_set_property;
-  gobject_class->finalize = mnb_clipboard_item_finalize;
+  gobject_class->dispose = mnb_clipboard_item_dispose;
 
   actor_class->enter_event = mnb_clipboard_item_enter;
   actor_class->leave_event = mnb_clipboard_item_leave;
+  actor_class->key_focus_in = mnb_clipboard_item_key_focus_in;
+  actor_class->allocate = mnb_clipboard_item_allocate;
+  actor_class->paint = mnb_clipboard_item_paint;
+  actor_class->pick = mnb_clipboard_item_pick;
+  actor_class->map = mnb_clipboard_item_map;
+  actor_class->unmap = mnb_clipboard_item_unmap;
 
   pspec = g_param_spec_string ("contents",
                                "Contents",
-                               "Contents of the item",
+                               "Preview of the contents of the item",
                                NULL,
                                G_PARAM_WRITABLE |
                                G_PARAM_CONSTRUCT_ONLY);
@@ -180,16 +576,21 @@ mnb_clipboard_item_class_init (MnbClipboardItemClass *klass)
                   NULL, NULL,
                   mnb_pasteboard_marshal_VOID__VOID,
                   G_TYPE_NONE, 0);
+
+  item_signals[PIN_CLICKED] =
+    g_signal_new (g_intern_static_string ("pin-clicked"),
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST,
+                  G_STRUCT_OFFSET (MnbClipboardItemClass, pin_clicked),
+                  NULL, NULL,
+                  mnb_pasteboard_marshal_VOID__VOID,
+                  G_TYPE_NONE, 0);
 }
 
 static void
 mnb_clipboard_item_init (MnbClipboardItem *self)
 {
   MxTable *table = MX_TABLE (self);
-  ClutterActor *text;
-  ClutterTexture *texture;
-  MxTextureCache *texture_cache;
-  gchar *remove_icon_path;
 
   clutter_actor_set_width (CLUTTER_ACTOR (self), 600);
   clutter_actor_set_reactive (CLUTTER_ACTOR (self), TRUE);
@@ -197,10 +598,10 @@ mnb_clipboard_item_init (MnbClipboardItem *self)
   mx_table_set_row_spacing (table, 2);
   mx_table_set_column_spacing (table, 6);
 
-  self->contents = CLUTTER_ACTOR (mx_label_new ());
-  text = mx_label_get_clutter_text (MX_LABEL (self->contents));
-  clutter_text_set_line_wrap (CLUTTER_TEXT (text), TRUE);
-  clutter_text_set_ellipsize (CLUTTER_TEXT (text), PANGO_ELLIPSIZE_NONE);
+  /* the layouts of the text are shared through the layout cache,
+   * so re-allocating the row does not shape the text again
+   */
+  self->contents = mnb_clipboard_text_new ();
   mx_table_add_actor_with_properties (table, self->contents,
                                         0, 0,
                                         "x-expand", TRUE,
@@ -211,57 +612,9 @@ mnb_clipboard_item_init (MnbClipboardItem *self)
                                         "y-align", MX_ALIGN_START,
                                         NULL);
 
-  self->remove_button = CLUTTER_ACTOR (mx_button_new ());
-  mx_stylable_set_style_class (MX_STYLABLE (self->remove_button),
-                                    "MnbClipboardItemDeleteButton");
-  clutter_actor_set_reactive (self->remove_button, TRUE);
-  clutter_actor_set_opacity (self->remove_button, 0x00);
-  g_signal_connect (self->remove_button, "clicked",
-                    G_CALLBACK (on_remove_clicked),
-                    self);
-  mx_table_add_actor_with_properties (table, self->remove_button,
-                                        0, 1,
-                                        "x-expand", FALSE,
-                                        "y-expand", FALSE,
-                                        "x-fill", FALSE,
-                                        "y-fill", FALSE,
-                                        "x-align", MX_ALIGN_START,
-                                        "y-align", MX_ALIGN_MIDDLE,
-                                        "row-span", 2,
-                                        NULL);
-
-  remove_icon_path = g_build_filename (THEMEDIR,
-                                       "pasteboard-item-delete-hover.png",
-                                       NULL);
-
-  texture_cache = mx_texture_cache_get_default ();
-  texture = mx_texture_cache_get_texture (texture_cache,
-                                            remove_icon_path);
-  if (texture != NULL)
-    mx_bin_set_child (MX_BIN (self->remove_button),
-                        CLUTTER_ACTOR (texture));
-
-  g_free (remove_icon_path);
-
-  self->action_button = CLUTTER_ACTOR (mx_button_new ());
-  mx_button_set_label (MX_BUTTON (self->action_button), 
-                       C_("Used to form '*Copy* from pasteboard'",
-                          "Copy"));
-  mx_stylable_set_style_class (MX_STYLABLE (self->action_button),
-                                    "MnbClipboardItemCopyButton");
-  clutter_actor_set_reactive (self->action_button, TRUE);
-  g_signal_connect (self->action_button, "clicked",
-                    G_CALLBACK (on_action_clicked),
-                    self);
-  mx_table_add_actor_with_properties (table, self->action_button,
-                                        1, 0,
-                                        "x-expand", FALSE,
-                                        "y-expand", FALSE,
-                                        "x-fill", FALSE,
-                                        "y-fill", FALSE,
-                                        "x-align", MX_ALIGN_START,
-                                        "y-align", MX_ALIGN_MIDDLE,
-                                        NULL);
+  /* the head row is the paste target until told otherwise */
+  self->show_action = TRUE;
+  mnb_clipboard_item_update_style_class (self);
 }
 
 G_CONST_RETURN gchar *
@@ -269,23 +622,10 @@ mnb_clipboard_item_get_contents (MnbClipboardItem *item)
 {
   g_return_val_if_fail (MNB_IS_CLIPBOARD_ITEM (item), NULL);
 
-  return mx_label_get_text (MX_LABEL (item->contents));
-}
-
-G_CONST_RETURN gchar *
-mnb_clipboard_item_get_filter_contents (MnbClipboardItem *item)
-{
-  g_return_val_if_fail (MNB_IS_CLIPBOARD_ITEM (item), NULL);
-
-  if (item->filter_contents == NULL)
-    {
-      const gchar *contents;
-
-      contents = mx_label_get_text (MX_LABEL (item->contents));
-      item->filter_contents = g_utf8_strdown (contents, -1);
-    }
+  if (item->contents == NULL)
+    return NULL;
 
-  return item->filter_contents;
+  return mnb_clipboard_text_get_text (MNB_CLIPBOARD_TEXT (item->contents));
 }
 
 gint64
@@ -301,7 +641,9 @@ mnb_clipboard_item_show_action (MnbClipboardItem *item)
 {
   g_return_if_fail (MNB_IS_CLIPBOARD_ITEM (item));
 
-  clutter_actor_show (item->action_button);
+  item->show_action = TRUE;
+  mnb_clipboard_item_update_style_class (item);
+  controls_update (item);
 }
 
 void
@@ -309,5 +651,194 @@ mnb_clipboard_item_hide_action (MnbClipboardItem *item)
 {
   g_return_if_fail (MNB_IS_CLIPBOARD_ITEM (item));
 
-  clutter_actor_hide (item->action_button);
+  item->show_action = FALSE;
+  mnb_clipboard_item_update_style_class (item);
+  controls_update (item);
+}
+
+/*
+ * mnb_clipboard_item_recycle:
+ * @item: a #MnbClipboardItem
+ * @serial: the serial of the item to show, or 0
+ * @contents: (allow-none): the preview of the item to show
+ *
+ * Makes @item, taken out of its view, show another text item as if it
+ * had just been created; with a %NULL @contents the item is emptied
+ * until it is used again. Only the items showing a text can be
+ * recycled.
+ *
+ * Return value: %TRUE if @item was recycled
+ */
+gboolean
+mnb_clipboard_item_recycle (MnbClipboardItem *item,
+                            gint64            serial,
+                            const gchar      *contents)
+{
+  g_return_val_if_fail (MNB_IS_CLIPBOARD_ITEM (item), FALSE);
+
+  if (item->contents == NULL)
+    return FALSE;
+
+  controls_detach (item);
+  mx_stylable_set_style_pseudo_class (MX_STYLABLE (item), NULL);
+
+  mnb_clipboard_text_set_text (MNB_CLIPBOARD_TEXT (item->contents),
+                               contents);
+  item->serial = serial;
+
+  item->show_action = TRUE;
+  item->is_pinned = FALSE;
+  mnb_clipboard_item_update_style_class (item);
+
+  clutter_actor_show (CLUTTER_ACTOR (item));
+
+  return TRUE;
+}
+
+/*
+ * mnb_clipboard_item_set_uris:
+ * @item: a #MnbClipboardItem
+ * @uris: the URIs held by the item
+ *
+ * Shows the files in @uris instead of the text contents: the name,
+ * icon and size of each file are filled in as they are resolved.
+ */
+void
+mnb_clipboard_item_set_uris (MnbClipboardItem    *item,
+                             const gchar * const *uris)
+{
+  guint i, n_uris;
+
+  g_return_if_fail (MNB_IS_CLIPBOARD_ITEM (item));
+  g_return_if_fail (uris != NULL);
+  g_return_if_fail (item->files == NULL);
+
+  if (item->contents != NULL)
+    {
+      clutter_actor_destroy (item->contents);
+      item->contents = NULL;
+    }
+
+  item->files = mx_box_layout_new ();
+  mx_box_layout_set_orientation (MX_BOX_LAYOUT (item->files),
+                                 MX_ORIENTATION_VERTICAL);
+  mx_table_add_actor_with_properties (MX_TABLE (item),
+                                        item->files,
+                                        0, 0,
+                                        "x-expand", TRUE,
+                                        "y-expand", TRUE,
+                                        "x-fill", TRUE,
+                                        "y-fill", TRUE,
+                                        "x-align", MX_ALIGN_START,
+                                        "y-align", MX_ALIGN_START,
+                                        NULL);
+
+  n_uris = g_strv_length ((gchar **) uris);
+
+  for (i = 0; i < n_uris && i < MAX_FILE_ROWS; i++)
+    item->file_rows = g_slist_prepend (item->file_rows,
+                                       file_row_new (item, uris[i]));
+
+  if (n_uris > MAX_FILE_ROWS)
+    {
+      guint n_more = n_uris - MAX_FILE_ROWS;
+      gchar *text;
+
+      text = g_strdup_printf (ngettext ("and %u more file",
+                                        "and %u more files",
+                                        n_more),
+                              n_more);
+      clutter_container_add_actor (CLUTTER_CONTAINER (item->files),
+                                   mx_label_new_with_text (text));
+      g_free (text);
+    }
+}
+
+void
+mnb_clipboard_item_set_pinned (MnbClipboardItem *item,
+                               gboolean          is_pinned)
+{
+  g_return_if_fail (MNB_IS_CLIPBOARD_ITEM (item));
+
+  is_pinned = !!is_pinned;
+
+  if (item->is_pinned == is_pinned)
+    return;
+
+  item->is_pinned = is_pinned;
+
+  mnb_clipboard_item_update_style_class (item);
+  controls_update (item);
+}
+
+gboolean
+mnb_clipboard_item_get_pinned (MnbClipboardItem *item)
+{
+  g_return_val_if_fail (MNB_IS_CLIPBOARD_ITEM (item), FALSE);
+
+  return item->is_pinned;
+}
+
+static void
+on_thumbnail_ready (const gchar *thumbnail_path,
+                    gpointer     user_data)
+{
+  MnbClipboardItem *item = user_data;
+  GError *error = NULL;
+
+  if (thumbnail_path == NULL)
+    return;
+
+  if (!clutter_texture_set_from_file (CLUTTER_TEXTURE (item->image),
+                                      thumbnail_path,
+                                      &error))
+    {
+      g_warning ("Unable to load the thumbnail '%s': %s",
+                 thumbnail_path,
+                 error->message);
+      g_error_free (error);
+    }
+}
+
+/*
+ * mnb_clipboard_item_set_image:
+ * @item: a #MnbClipboardItem
+ * @image_uri: the URI of the stored image
+ *
+ * Shows the thumbnail of an image instead of the text contents; the
+ * thumbnail is looked up, and decoded, outside of the main loop.
+ */
+void
+mnb_clipboard_item_set_image (MnbClipboardItem *item,
+                              const gchar      *image_uri)
+{
+  g_return_if_fail (MNB_IS_CLIPBOARD_ITEM (item));
+  g_return_if_fail (image_uri != NULL);
+  g_return_if_fail (item->image == NULL);
+
+  if (item->contents != NULL)
+    {
+      clutter_actor_destroy (item->contents);
+      item->contents = NULL;
+    }
+
+  item->image = clutter_texture_new ();
+  clutter_texture_set_load_async (CLUTTER_TEXTURE (item->image), TRUE);
+  clutter_texture_set_keep_aspect_ratio (CLUTTER_TEXTURE (item->image), TRUE);
+  mx_table_add_actor_with_properties (MX_TABLE (item),
+                                      item->image,
+                                      0, 0,
+                                      "x-expand", TRUE,
+                                      "y-expand", TRUE,
+                                      "x-fill", FALSE,
+                                      "y-fill", FALSE,
+                                      "x-align", MX_ALIGN_START,
+                                      "y-align", MX_ALIGN_START,
+                                      NULL);
+
+  item->image_cancellable = g_cancellable_new ();
+  mnb_clipboard_image_get_thumbnail (image_uri,
+                                     item->image_cancellable,
+                                     on_thumbnail_ready,
+                                     item);
 }
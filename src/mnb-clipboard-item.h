@@ -40,14 +40,20 @@ struct _MnbClipboardItem
 
   ClutterActor *contents;
 
-  ClutterActor *time_label;
+  /* the rows of a list of URIs, replacing the contents */
+  ClutterActor *files;
+  GSList *file_rows;
 
-  ClutterActor *remove_button;
-  ClutterActor *action_button;
+  /* the thumbnail of an image, replacing the contents */
+  ClutterActor *image;
+  GCancellable *image_cancellable;
 
-  gchar *filter_contents;
+  ClutterActor *time_label;
 
   gint64 serial;
+
+  guint show_action : 1;
+  guint is_pinned   : 1;
 };
 
 struct _MnbClipboardItemClass
@@ -56,17 +62,30 @@ struct _MnbClipboardItemClass
 
   void (* remove_clicked) (MnbClipboardItem *item);
   void (* action_clicked) (MnbClipboardItem *item);
+  void (* pin_clicked)    (MnbClipboardItem *item);
 };
 
 GType mnb_clipboard_item_get_type (void) G_GNUC_CONST;
 
 G_CONST_RETURN gchar *mnb_clipboard_item_get_contents (MnbClipboardItem *item);
-G_CONST_RETURN gchar *mnb_clipboard_item_get_filter_contents (MnbClipboardItem *item);
 gint64                mnb_clipboard_item_get_serial   (MnbClipboardItem *item);
 
 void                  mnb_clipboard_item_show_action  (MnbClipboardItem *item);
 void                  mnb_clipboard_item_hide_action  (MnbClipboardItem *item);
 
+gboolean              mnb_clipboard_item_recycle      (MnbClipboardItem *item,
+                                                       gint64            serial,
+                                                       const gchar      *contents);
+
+void                  mnb_clipboard_item_set_uris     (MnbClipboardItem   *item,
+                                                       const gchar * const *uris);
+void                  mnb_clipboard_item_set_image    (MnbClipboardItem *item,
+                                                       const gchar      *image_uri);
+
+void                  mnb_clipboard_item_set_pinned   (MnbClipboardItem *item,
+                                                       gboolean          is_pinned);
+gboolean              mnb_clipboard_item_get_pinned   (MnbClipboardItem *item);
+
 G_END_DECLS
 
 #endif /* __MNB_CLIPBOARD_ITEM_H__ */
@@ -0,0 +1,302 @@
+/*
+ * Copyright (C) 2008 - 2009 Intel Corporation.
+ *
+ * Author: Emmanuele Bassi <ebassi@linux.intel.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * MnbClipboardLayoutCache: a cache of shaped PangoLayouts
+ *
+ * The rows of the pasteboard are re-allocated every time the panel is
+ * resized, filtered or gets a new item; shaping the same text over and
+ * over again is the most expensive part of that. The cache keeps the
+ * layouts, and their height, keyed by the contents hash, the wrapping
+ * width, the font and the context, with its resolution and font
+ * options; the least recently used layouts are evicted when the cache
+ * grows past its maximum size.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <pango/pangocairo.h>
+
+#include "mnb-clipboard-layout-cache.h"
+
+#define DEFAULT_MAX_ENTRIES     (256)
+
+typedef struct _CacheEntry      CacheEntry;
+
+struct _CacheEntry
+{
+  /* key */
+  const gchar *text;
+  guint text_hash;
+  gint width;
+  PangoFontDescription *font_desc;
+
+  /* the context is changed in place when the settings change, so
+   * they are part of the key as well
+   */
+  PangoContext *context;
+  gdouble resolution;
+  cairo_font_options_t *font_options;
+
+  /* value */
+  PangoLayout *layout;
+  gint height;
+
+  /* link inside the LRU queue */
+  GList *link;
+};
+
+struct _MnbClipboardLayoutCache
+{
+  /* CacheEntry -> CacheEntry */
+  GHashTable *entries;
+
+  /* CacheEntry, most recently used first */
+  GQueue lru;
+
+  guint max_entries;
+};
+
+static guint
+cache_entry_hash (gconstpointer data)
+{
+  const CacheEntry *entry = data;
+
+  return entry->text_hash
+       ^ ((guint) entry->width * 31)
+       ^ pango_font_description_hash (entry->font_desc)
+       ^ g_direct_hash (entry->context)
+       ^ ((guint) entry->resolution * 17)
+       ^ (entry->font_options != NULL
+          ? cairo_font_options_hash (entry->font_options)
+          : 0);
+}
+
+static gboolean
+cache_entry_equal (gconstpointer a,
+                   gconstpointer b)
+{
+  const CacheEntry *entry_a = a;
+  const CacheEntry *entry_b = b;
+
+  if (entry_a->text_hash != entry_b->text_hash ||
+      entry_a->width != entry_b->width ||
+      entry_a->context != entry_b->context ||
+      entry_a->resolution != entry_b->resolution)
+    return FALSE;
+
+  if (entry_a->font_options == NULL || entry_b->font_options == NULL)
+    {
+      if (entry_a->font_options != entry_b->font_options)
+        return FALSE;
+    }
+  else if (!cairo_font_options_equal (entry_a->font_options,
+                                      entry_b->font_options))
+    return FALSE;
+
+  if (!pango_font_description_equal (entry_a->font_desc, entry_b->font_desc))
+    return FALSE;
+
+  return strcmp (entry_a->text, entry_b->text) == 0;
+}
+
+static void
+cache_entry_free (CacheEntry *entry)
+{
+  pango_font_description_free (entry->font_desc);
+  g_object_unref (entry->layout);
+
+  if (entry->font_options != NULL)
+    cairo_font_options_destroy (entry->font_options);
+
+  g_slice_free (CacheEntry, entry);
+}
+
+static void
+mnb_clipboard_layout_cache_evict (MnbClipboardLayoutCache *cache,
+                                  guint                    n_entries)
+{
+  while (cache->lru.length > n_entries)
+    {
+      CacheEntry *entry = g_queue_pop_tail (&cache->lru);
+
+      g_hash_table_remove (cache->entries, entry);
+      cache_entry_free (entry);
+    }
+}
+
+MnbClipboardLayoutCache *
+mnb_clipboard_layout_cache_get_default (void)
+{
+  static MnbClipboardLayoutCache *default_cache = NULL;
+
+  if (G_UNLIKELY (default_cache == NULL))
+    {
+      default_cache = g_slice_new0 (MnbClipboardLayoutCache);
+      default_cache->entries = g_hash_table_new (cache_entry_hash,
+                                                 cache_entry_equal);
+      g_queue_init (&default_cache->lru);
+      default_cache->max_entries = DEFAULT_MAX_ENTRIES;
+    }
+
+  return default_cache;
+}
+
+/*
+ * mnb_clipboard_layout_cache_get_layout:
+ * @cache: a #MnbClipboardLayoutCache
+ * @context: the #PangoContext used to create a new layout
+ * @text: the text of the layout
+ * @text_hash: the hash of @text, as returned by g_str_hash()
+ * @font_desc: the font of the layout
+ * @width: the wrapping width, in pixels, or -1 for no wrapping
+ * @height: return location for the height of the layout, in pixels
+ *
+ * Retrieves the layout for @text, shaping it only if it is not
+ * already in the cache.
+ *
+ * Return value: a #PangoLayout owned by the cache; it is only valid
+ *   until the next call to the cache
+ */
+PangoLayout *
+mnb_clipboard_layout_cache_get_layout (MnbClipboardLayoutCache    *cache,
+                                       PangoContext               *context,
+                                       const gchar                *text,
+                                       guint                       text_hash,
+                                       const PangoFontDescription *font_desc,
+                                       gint                        width,
+                                       gint                       *height)
+{
+  CacheEntry key, *entry;
+  PangoRectangle logical;
+  const cairo_font_options_t *font_options;
+
+  g_return_val_if_fail (cache != NULL, NULL);
+  g_return_val_if_fail (PANGO_IS_CONTEXT (context), NULL);
+  g_return_val_if_fail (text != NULL, NULL);
+  g_return_val_if_fail (font_desc != NULL, NULL);
+
+  key.text = text;
+  key.text_hash = text_hash;
+  key.width = width;
+  key.font_desc = (PangoFontDescription *) font_desc;
+  key.context = context;
+  key.resolution = pango_cairo_context_get_resolution (context);
+
+  font_options = pango_cairo_context_get_font_options (context);
+  key.font_options = (cairo_font_options_t *) font_options;
+
+  entry = g_hash_table_lookup (cache->entries, &key);
+  if (entry != NULL)
+    {
+      /* move to the front of the LRU queue */
+      g_queue_unlink (&cache->lru, entry->link);
+      g_queue_push_head_link (&cache->lru, entry->link);
+
+      if (height)
+        *height = entry->height;
+
+      return entry->layout;
+    }
+
+  entry = g_slice_new (CacheEntry);
+  entry->text_hash = text_hash;
+  entry->width = width;
+  entry->font_desc = pango_font_description_copy (font_desc);
+  entry->context = context;
+  entry->resolution = key.resolution;
+  entry->font_options = font_options != NULL
+                      ? cairo_font_options_copy (font_options)
+                      : NULL;
+
+  entry->layout = pango_layout_new (context);
+  pango_layout_set_font_description (entry->layout, font_desc);
+  pango_layout_set_wrap (entry->layout, PANGO_WRAP_WORD_CHAR);
+  pango_layout_set_ellipsize (entry->layout, PANGO_ELLIPSIZE_NONE);
+  pango_layout_set_width (entry->layout,
+                          width < 0 ? -1 : width * PANGO_SCALE);
+  pango_layout_set_text (entry->layout, text, -1);
+
+  /* the layout owns a copy of the text, use it as the key */
+  entry->text = pango_layout_get_text (entry->layout);
+
+  pango_layout_get_extents (entry->layout, NULL, &logical);
+  entry->height = PANGO_PIXELS_CEIL (logical.height);
+
+  g_queue_push_head (&cache->lru, entry);
+  entry->link = cache->lru.head;
+
+  g_hash_table_insert (cache->entries, entry, entry);
+
+  mnb_clipboard_layout_cache_evict (cache, cache->max_entries);
+
+  if (height)
+    *height = entry->height;
+
+  return entry->layout;
+}
+
+void
+mnb_clipboard_layout_cache_set_max_entries (MnbClipboardLayoutCache *cache,
+                                            guint                    max_entries)
+{
+  g_return_if_fail (cache != NULL);
+  g_return_if_fail (max_entries > 0);
+
+  cache->max_entries = max_entries;
+
+  mnb_clipboard_layout_cache_evict (cache, cache->max_entries);
+}
+
+guint
+mnb_clipboard_layout_cache_get_max_entries (MnbClipboardLayoutCache *cache)
+{
+  g_return_val_if_fail (cache != NULL, 0);
+
+  return cache->max_entries;
+}
+
+guint
+mnb_clipboard_layout_cache_get_n_entries (MnbClipboardLayoutCache *cache)
+{
+  g_return_val_if_fail (cache != NULL, 0);
+
+  return cache->lru.length;
+}
+
+/*
+ * mnb_clipboard_layout_cache_trim:
+ * @cache: a #MnbClipboardLayoutCache
+ * @n_entries: the number of entries to keep
+ *
+ * Evicts the least recently used layouts until at most @n_entries
+ * are left in the cache.
+ */
+void
+mnb_clipboard_layout_cache_trim (MnbClipboardLayoutCache *cache,
+                                 guint                    n_entries)
+{
+  g_return_if_fail (cache != NULL);
+
+  mnb_clipboard_layout_cache_evict (cache, n_entries);
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2008 - 2009 Intel Corporation.
+ *
+ * Author: Emmanuele Bassi <ebassi@linux.intel.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __MNB_CLIPBOARD_LAYOUT_CACHE_H__
+#define __MNB_CLIPBOARD_LAYOUT_CACHE_H__
+
+#include <pango/pango.h>
+
+G_BEGIN_DECLS
+
+typedef struct _MnbClipboardLayoutCache         MnbClipboardLayoutCache;
+
+MnbClipboardLayoutCache *mnb_clipboard_layout_cache_get_default (void);
+
+PangoLayout *mnb_clipboard_layout_cache_get_layout (MnbClipboardLayoutCache    *cache,
+                                                    PangoContext               *context,
+                                                    const gchar                *text,
+                                                    guint                       text_hash,
+                                                    const PangoFontDescription *font_desc,
+                                                    gint                        width,
+                                                    gint                       *height);
+
+void  mnb_clipboard_layout_cache_set_max_entries (MnbClipboardLayoutCache *cache,
+                                                  guint                    max_entries);
+guint mnb_clipboard_layout_cache_get_max_entries (MnbClipboardLayoutCache *cache);
+guint mnb_clipboard_layout_cache_get_n_entries   (MnbClipboardLayoutCache *cache);
+
+void mnb_clipboard_layout_cache_trim (MnbClipboardLayoutCache *cache,
+                                      guint                    n_entries);
+
+G_END_DECLS
+
+#endif /* __MNB_CLIPBOARD_LAYOUT_CACHE_H__ */
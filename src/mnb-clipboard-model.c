@@ -0,0 +1,1616 @@
+/*
+ * Copyright (C) 2008 - 2009 Intel Corporation.
+ *
+ * Author: Emmanuele Bassi <ebassi@linux.intel.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * MnbClipboardModel: the storage of the clipboard history
+ *
+ * The metadata of the items is kept in parallel arrays, one per
+ * field, and the strings in a separate set of arrays; scanning the
+ * serials or the timestamps touches only the memory of that field.
+ *
+ * The items are stored oldest first, so that adding an item is an
+ * append; the accessors take rows, with row 0 being the newest item.
+ *
+ * The strings are copied into a MnbClipboardArena; when the removals
+ * leave the arena mostly empty, the live strings are moved into a new
+ * one and the old blocks are given back.
+ *
+ * Under memory pressure the texts of the cold items are compressed
+ * and then written to the spill directory, leaving only the metadata
+ * and the preview in memory; the store undoes both once the pressure
+ * goes away.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "mnb-clipboard-model.h"
+#include "mnb-clipboard-arena.h"
+
+#define MIN_ALLOC       (32)
+
+/* above this many serials, removals use a hash set for the lookup */
+#define LINEAR_LOOKUP_MAX       (8)
+
+/* the texts written out are copied through a buffer of this size */
+#define WRITE_CHUNK_SIZE        (16 * 1024)
+
+#define NOT_RESIDENT    (MNB_CLIPBOARD_MODEL_COMPRESSED | MNB_CLIPBOARD_MODEL_SPILLED)
+
+typedef struct {
+  gchar **text;
+  gchar **preview;
+  gchar **filter;
+  gchar ***uris;
+} PayloadStore;
+
+struct _MnbClipboardModel
+{
+  guint n_items;
+  guint n_alloc;
+
+  /* metadata */
+  guint8 *types;
+  guint8 *flags;
+  gint64 *serials;
+  gint64 *mtimes;
+  guint32 *hashes;
+  guint32 *sizes;
+
+  /* the application each item was copied from, or 0 */
+  GQuark *sources;
+
+  /* the size of the compressed or spilled text */
+  guint32 *stored_sizes;
+
+  /* the sum of the text sizes */
+  gsize total_size;
+
+  PayloadStore payload;
+  MnbClipboardArena *arena;
+
+  /* scratch space for the bulk removals, one byte per item */
+  guint8 *doomed;
+
+  gchar *spill_dir;
+  gchar *image_dir;
+};
+
+#define ROW_TO_INDEX(model,row)         ((model)->n_items - 1 - (row))
+
+static gchar *mnb_clipboard_model_dup_text_index (MnbClipboardModel *model,
+                                                  guint              index_);
+
+MnbClipboardModel *
+mnb_clipboard_model_new (void)
+{
+  MnbClipboardModel *model = g_slice_new0 (MnbClipboardModel);
+
+  model->arena = mnb_clipboard_arena_new ();
+
+  return model;
+}
+
+static inline gsize
+safe_strlen (const gchar *str)
+{
+  return str != NULL ? strlen (str) : 0;
+}
+
+static gchar *
+spill_path (MnbClipboardModel *model,
+            guint              index_)
+{
+  gchar name[32];
+
+  g_snprintf (name, sizeof (name), "%" G_GINT64_FORMAT, model->serials[index_]);
+
+  return g_build_filename (model->spill_dir, name, NULL);
+}
+
+static void
+mnb_clipboard_model_release_index (MnbClipboardModel *model,
+                                   guint              index_)
+{
+  PayloadStore *payload = &model->payload;
+
+  if (model->flags[index_] & MNB_CLIPBOARD_MODEL_SPILLED)
+    {
+      gchar *path = spill_path (model, index_);
+
+      g_unlink (path);
+      g_free (path);
+    }
+  else if (model->flags[index_] & MNB_CLIPBOARD_MODEL_COMPRESSED)
+    g_free (payload->text[index_]);
+  else
+    mnb_clipboard_arena_release (model->arena,
+                                 payload->text[index_],
+                                 model->sizes[index_]);
+
+  mnb_clipboard_arena_release (model->arena,
+                               payload->preview[index_],
+                               safe_strlen (payload->preview[index_]));
+  mnb_clipboard_arena_release (model->arena,
+                               payload->filter[index_],
+                               safe_strlen (payload->filter[index_]));
+  g_strfreev (payload->uris[index_]);
+}
+
+/* the image files belong to their item, and go away with it; the
+ * rows only own the files in the image directory
+ */
+static void
+mnb_clipboard_model_unlink_image (MnbClipboardModel *model,
+                                  guint              index_)
+{
+  gchar **uris = model->payload.uris[index_];
+  gchar *path;
+
+  if (model->image_dir == NULL ||
+      model->types[index_] != MNB_CLIPBOARD_ITEM_IMAGE ||
+      uris == NULL || uris[0] == NULL)
+    return;
+
+  path = g_filename_from_uri (uris[0], NULL, NULL);
+  if (path == NULL)
+    return;
+
+  if (g_str_has_prefix (path, model->image_dir))
+    g_unlink (path);
+
+  g_free (path);
+}
+
+void
+mnb_clipboard_model_free (MnbClipboardModel *model)
+{
+  guint i;
+
+  if (model == NULL)
+    return;
+
+  /* this also frees the strings that live outside of the arena */
+  for (i = 0; i < model->n_items; i++)
+    mnb_clipboard_model_release_index (model, i);
+
+  mnb_clipboard_arena_free (model->arena);
+
+  g_free (model->types);
+  g_free (model->flags);
+  g_free (model->serials);
+  g_free (model->mtimes);
+  g_free (model->hashes);
+  g_free (model->sizes);
+  g_free (model->sources);
+  g_free (model->stored_sizes);
+
+  g_free (model->payload.text);
+  g_free (model->payload.preview);
+  g_free (model->payload.filter);
+  g_free (model->payload.uris);
+
+  g_free (model->doomed);
+  g_free (model->spill_dir);
+  g_free (model->image_dir);
+
+  g_slice_free (MnbClipboardModel, model);
+}
+
+static void
+mnb_clipboard_model_grow (MnbClipboardModel *model)
+{
+  guint n_alloc = MAX (MIN_ALLOC, model->n_alloc * 2);
+
+  model->types = g_renew (guint8, model->types, n_alloc);
+  model->flags = g_renew (guint8, model->flags, n_alloc);
+  model->serials = g_renew (gint64, model->serials, n_alloc);
+  model->mtimes = g_renew (gint64, model->mtimes, n_alloc);
+  model->hashes = g_renew (guint32, model->hashes, n_alloc);
+  model->sizes = g_renew (guint32, model->sizes, n_alloc);
+  model->sources = g_renew (GQuark, model->sources, n_alloc);
+  model->stored_sizes = g_renew (guint32, model->stored_sizes, n_alloc);
+
+  model->payload.text = g_renew (gchar *, model->payload.text, n_alloc);
+  model->payload.preview = g_renew (gchar *, model->payload.preview, n_alloc);
+  model->payload.filter = g_renew (gchar *, model->payload.filter, n_alloc);
+  model->payload.uris = g_renew (gchar **, model->payload.uris, n_alloc);
+
+  model->doomed = g_renew (guint8, model->doomed, n_alloc);
+
+  model->n_alloc = n_alloc;
+}
+
+guint
+mnb_clipboard_model_get_n_rows (MnbClipboardModel *model)
+{
+  return model->n_items;
+}
+
+/*
+ * mnb_clipboard_model_prepend:
+ *
+ * Adds a new item as row 0. The strings are copied, while the model
+ * takes ownership of @uris.
+ */
+void
+mnb_clipboard_model_prepend (MnbClipboardModel    *model,
+                             MnbClipboardItemType  item_type,
+                             gint64                serial,
+                             gint64                mtime,
+                             guint                 flags,
+                             guint32               text_hash,
+                             const gchar          *text,
+                             const gchar          *preview,
+                             const gchar          *filter,
+                             gchar               **uris)
+{
+  MnbClipboardArena *arena = model->arena;
+  gsize text_size = safe_strlen (text);
+  guint i;
+
+  if (model->n_items == model->n_alloc)
+    mnb_clipboard_model_grow (model);
+
+  i = model->n_items;
+
+  model->types[i] = item_type;
+  model->flags[i] = flags;
+  model->serials[i] = serial;
+  model->mtimes[i] = mtime;
+  model->hashes[i] = text_hash;
+  model->sizes[i] = text_size;
+  model->sources[i] = 0;
+  model->stored_sizes[i] = 0;
+
+  model->total_size += text_size;
+
+  model->payload.text[i] =
+    mnb_clipboard_arena_strndup (arena, text, text_size);
+
+  /* the preview of a short one-liner and the filter key of a case
+   * folded text are the same as the text, so they share it
+   */
+  if (preview != NULL && text != NULL && strcmp (preview, text) == 0)
+    model->payload.preview[i] = NULL;
+  else
+    model->payload.preview[i] =
+      mnb_clipboard_arena_strndup (arena, preview, safe_strlen (preview));
+
+  if (filter != NULL && text != NULL && strcmp (filter, text) == 0)
+    model->payload.filter[i] = NULL;
+  else
+    model->payload.filter[i] =
+      mnb_clipboard_arena_strndup (arena, filter, safe_strlen (filter));
+
+  model->payload.uris[i] = uris;
+
+  model->n_items += 1;
+}
+
+/*
+ * mnb_clipboard_model_prepend_spilled:
+ *
+ * Adds an item whose text was already written to @path, in the spill
+ * directory; the file is moved in place, and the text is never brought
+ * back in memory, other than by mnb_clipboard_model_dup_text().
+ */
+gboolean
+mnb_clipboard_model_prepend_spilled (MnbClipboardModel    *model,
+                                     MnbClipboardItemType  item_type,
+                                     gint64                serial,
+                                     gint64                mtime,
+                                     guint                 flags,
+                                     guint32               text_hash,
+                                     gsize                 text_size,
+                                     const gchar          *path,
+                                     const gchar          *preview,
+                                     const gchar          *filter)
+{
+  MnbClipboardArena *arena = model->arena;
+  gchar *dest;
+  guint i;
+
+  g_return_val_if_fail (model->spill_dir != NULL, FALSE);
+  g_return_val_if_fail (preview != NULL, FALSE);
+
+  if (model->n_items == model->n_alloc)
+    mnb_clipboard_model_grow (model);
+
+  i = model->n_items;
+
+  /* the name of the file comes from the serial */
+  model->serials[i] = serial;
+
+  dest = spill_path (model, i);
+  if (g_rename (path, dest) == -1)
+    {
+      g_warning ("Unable to move the clipboard item to '%s': %s",
+                 dest,
+                 g_strerror (errno));
+      g_free (dest);
+      return FALSE;
+    }
+
+  g_free (dest);
+
+  model->types[i] = item_type;
+  model->flags[i] = flags
+                  | MNB_CLIPBOARD_MODEL_SPILLED
+                  | MNB_CLIPBOARD_MODEL_STREAMED;
+  model->mtimes[i] = mtime;
+  model->hashes[i] = text_hash;
+  model->sizes[i] = text_size;
+  model->sources[i] = 0;
+  model->stored_sizes[i] = text_size;
+
+  model->total_size += text_size;
+
+  model->payload.text[i] = NULL;
+  model->payload.preview[i] =
+    mnb_clipboard_arena_strndup (arena, preview, strlen (preview));
+  model->payload.filter[i] =
+    mnb_clipboard_arena_strndup (arena, filter, safe_strlen (filter));
+  model->payload.uris[i] = NULL;
+
+  model->n_items += 1;
+
+  return TRUE;
+}
+
+/* returns the row of the item, or -1; recent items are the most
+ * likely to be looked up, so we scan from the newest
+ */
+gint
+mnb_clipboard_model_find (MnbClipboardModel *model,
+                          gint64             serial)
+{
+  const gint64 *serials = model->serials;
+  gint i;
+
+  for (i = (gint) model->n_items - 1; i >= 0; i--)
+    {
+      if (serials[i] == serial)
+        return ROW_TO_INDEX (model, i);
+    }
+
+  return -1;
+}
+
+/*
+ * mnb_clipboard_model_find_at_most:
+ *
+ * Returns the newest row whose serial is not above @serial, or the
+ * number of rows if there is none. The items get increasing serials
+ * as they are added, so the lookup is a binary search.
+ */
+guint
+mnb_clipboard_model_find_at_most (MnbClipboardModel *model,
+                                  gint64             serial)
+{
+  guint lo = 0, hi = model->n_items;
+
+  /* the number of items with a serial not above @serial */
+  while (lo < hi)
+    {
+      guint mid = lo + (hi - lo) / 2;
+
+      if (model->serials[mid] <= serial)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  if (lo == 0)
+    return model->n_items;
+
+  return ROW_TO_INDEX (model, lo - 1);
+}
+
+MnbClipboardItemType
+mnb_clipboard_model_get_item_type (MnbClipboardModel *model,
+                                   guint              row)
+{
+  g_return_val_if_fail (row < model->n_items, MNB_CLIPBOARD_ITEM_INVALID);
+
+  return model->types[ROW_TO_INDEX (model, row)];
+}
+
+gint64
+mnb_clipboard_model_get_serial (MnbClipboardModel *model,
+                                guint              row)
+{
+  g_return_val_if_fail (row < model->n_items, 0);
+
+  return model->serials[ROW_TO_INDEX (model, row)];
+}
+
+gint64
+mnb_clipboard_model_get_mtime (MnbClipboardModel *model,
+                               guint              row)
+{
+  g_return_val_if_fail (row < model->n_items, 0);
+
+  return model->mtimes[ROW_TO_INDEX (model, row)];
+}
+
+guint
+mnb_clipboard_model_get_flags (MnbClipboardModel *model,
+                               guint              row)
+{
+  g_return_val_if_fail (row < model->n_items, 0);
+
+  return model->flags[ROW_TO_INDEX (model, row)];
+}
+
+guint32
+mnb_clipboard_model_get_text_hash (MnbClipboardModel *model,
+                                   guint              row)
+{
+  g_return_val_if_fail (row < model->n_items, 0);
+
+  return model->hashes[ROW_TO_INDEX (model, row)];
+}
+
+GQuark
+mnb_clipboard_model_get_source (MnbClipboardModel *model,
+                                guint              row)
+{
+  g_return_val_if_fail (row < model->n_items, 0);
+
+  return model->sources[ROW_TO_INDEX (model, row)];
+}
+
+gsize
+mnb_clipboard_model_get_text_size (MnbClipboardModel *model,
+                                   guint              row)
+{
+  g_return_val_if_fail (row < model->n_items, 0);
+
+  return model->sizes[ROW_TO_INDEX (model, row)];
+}
+
+G_CONST_RETURN gchar *
+mnb_clipboard_model_get_text (MnbClipboardModel *model,
+                              guint              row)
+{
+  guint i;
+
+  g_return_val_if_fail (row < model->n_items, NULL);
+
+  i = ROW_TO_INDEX (model, row);
+
+  if (model->flags[i] & NOT_RESIDENT)
+    return NULL;
+
+  return model->payload.text[i];
+}
+
+G_CONST_RETURN gchar *
+mnb_clipboard_model_get_preview (MnbClipboardModel *model,
+                                 guint              row)
+{
+  guint i;
+
+  g_return_val_if_fail (row < model->n_items, NULL);
+
+  i = ROW_TO_INDEX (model, row);
+
+  if (model->payload.preview[i] != NULL)
+    return model->payload.preview[i];
+
+  return model->payload.text[i];
+}
+
+gchar **
+mnb_clipboard_model_get_uris (MnbClipboardModel *model,
+                              guint              row)
+{
+  g_return_val_if_fail (row < model->n_items, NULL);
+
+  return model->payload.uris[ROW_TO_INDEX (model, row)];
+}
+
+void
+mnb_clipboard_model_set_source (MnbClipboardModel *model,
+                                guint              row,
+                                GQuark             source)
+{
+  g_return_if_fail (row < model->n_items);
+
+  model->sources[ROW_TO_INDEX (model, row)] = source;
+}
+
+void
+mnb_clipboard_model_set_flags (MnbClipboardModel *model,
+                               guint              row,
+                               guint              flags)
+{
+  g_return_if_fail (row < model->n_items);
+
+  model->flags[ROW_TO_INDEX (model, row)] = flags;
+}
+
+static inline gchar *
+relocate_string (MnbClipboardArena *arena,
+                 gchar             *str,
+                 gsize              len)
+{
+  /* the big strings are not in the arena, so they can stay */
+  if (str == NULL || len + 1 > MNB_CLIPBOARD_ARENA_MAX_CHUNK)
+    return str;
+
+  return mnb_clipboard_arena_strndup (arena, str, len);
+}
+
+/* copies the live strings into a new arena, so that the blocks that
+ * were left mostly empty by the removals can be freed
+ */
+static void
+mnb_clipboard_model_compact_arena (MnbClipboardModel *model)
+{
+  PayloadStore *payload = &model->payload;
+  MnbClipboardArena *arena;
+  guint i;
+
+  if (!mnb_clipboard_arena_should_compact (model->arena))
+    return;
+
+  arena = mnb_clipboard_arena_new ();
+
+  for (i = 0; i < model->n_items; i++)
+    {
+      /* the compressed texts are not in the arena */
+      if ((model->flags[i] & NOT_RESIDENT) == 0)
+        payload->text[i] = relocate_string (arena, payload->text[i],
+                                            model->sizes[i]);
+
+      payload->preview[i] = relocate_string (arena, payload->preview[i],
+                                             safe_strlen (payload->preview[i]));
+      payload->filter[i] = relocate_string (arena, payload->filter[i],
+                                            safe_strlen (payload->filter[i]));
+    }
+
+  mnb_clipboard_arena_free (model->arena);
+  model->arena = arena;
+}
+
+/* drops the items marked in model->doomed, moving every column down
+ * in a single pass
+ */
+static void
+mnb_clipboard_model_compact (MnbClipboardModel *model,
+                             GArray            *removed)
+{
+  PayloadStore *payload = &model->payload;
+  guint r, w;
+
+  /* newest first, like the rows */
+  if (removed != NULL)
+    {
+      gint i;
+
+      for (i = (gint) model->n_items - 1; i >= 0; i--)
+        if (model->doomed[i])
+          g_array_append_val (removed, model->serials[i]);
+    }
+
+  for (r = 0, w = 0; r < model->n_items; r++)
+    {
+      if (model->doomed[r])
+        {
+          model->total_size -= model->sizes[r];
+          mnb_clipboard_model_unlink_image (model, r);
+          mnb_clipboard_model_release_index (model, r);
+          continue;
+        }
+
+      if (r != w)
+        {
+          model->types[w] = model->types[r];
+          model->flags[w] = model->flags[r];
+          model->serials[w] = model->serials[r];
+          model->mtimes[w] = model->mtimes[r];
+          model->hashes[w] = model->hashes[r];
+          model->sizes[w] = model->sizes[r];
+          model->sources[w] = model->sources[r];
+          model->stored_sizes[w] = model->stored_sizes[r];
+
+          payload->text[w] = payload->text[r];
+          payload->preview[w] = payload->preview[r];
+          payload->filter[w] = payload->filter[r];
+          payload->uris[w] = payload->uris[r];
+        }
+
+      w += 1;
+    }
+
+  model->n_items = w;
+
+  mnb_clipboard_model_compact_arena (model);
+}
+
+void
+mnb_clipboard_model_remove_serials (MnbClipboardModel *model,
+                                    const gint64      *serials,
+                                    guint              n_serials,
+                                    GArray            *removed)
+{
+  gboolean found = FALSE;
+  guint i, j;
+
+  if (model->n_items == 0 || n_serials == 0)
+    return;
+
+  memset (model->doomed, 0, model->n_items);
+
+  if (n_serials <= LINEAR_LOOKUP_MAX)
+    {
+      for (i = 0; i < model->n_items; i++)
+        for (j = 0; j < n_serials; j++)
+          {
+            if (model->serials[i] == serials[j])
+              {
+                model->doomed[i] = TRUE;
+                found = TRUE;
+                break;
+              }
+          }
+    }
+  else
+    {
+      GHashTable *set = g_hash_table_new (g_int64_hash, g_int64_equal);
+
+      for (j = 0; j < n_serials; j++)
+        g_hash_table_insert (set, (gpointer) &serials[j], (gpointer) &serials[j]);
+
+      for (i = 0; i < model->n_items; i++)
+        {
+          if (g_hash_table_lookup (set, &model->serials[i]) != NULL)
+            {
+              model->doomed[i] = TRUE;
+              found = TRUE;
+            }
+        }
+
+      g_hash_table_destroy (set);
+    }
+
+  if (found)
+    mnb_clipboard_model_compact (model, removed);
+}
+
+/* removes the items older than the @before entry for their type */
+void
+mnb_clipboard_model_remove_expired (MnbClipboardModel *model,
+                                    const gint64      *before,
+                                    GArray            *removed)
+{
+  gboolean found = FALSE;
+  guint i;
+
+  for (i = 0; i < model->n_items; i++)
+    {
+      model->doomed[i] = model->mtimes[i] < before[model->types[i]];
+      found |= model->doomed[i];
+    }
+
+  if (found)
+    mnb_clipboard_model_compact (model, removed);
+}
+
+/* removes the oldest items, until there are at most @max_items items
+ * and @max_bytes bytes of text; zero means no limit. The newest item
+ * is always kept
+ */
+void
+mnb_clipboard_model_trim (MnbClipboardModel *model,
+                          guint              max_items,
+                          gsize              max_bytes,
+                          GArray            *removed)
+{
+  guint i, n_items = model->n_items;
+  gsize total_size = model->total_size;
+  gboolean found = FALSE;
+
+  if ((max_items == 0 || n_items <= max_items) &&
+      (max_bytes == 0 || total_size <= max_bytes))
+    return;
+
+  memset (model->doomed, 0, model->n_items);
+
+  for (i = 0; i + 1 < model->n_items; i++)
+    {
+      if ((max_items == 0 || n_items <= max_items) &&
+          (max_bytes == 0 || total_size <= max_bytes))
+        break;
+
+      model->doomed[i] = TRUE;
+      found = TRUE;
+
+      n_items -= 1;
+      total_size -= model->sizes[i];
+    }
+
+  if (found)
+    mnb_clipboard_model_compact (model, removed);
+}
+
+/* removes the oldest items copied from @source, until it has at most
+ * @max_items items left; the newest item is always kept
+ */
+void
+mnb_clipboard_model_trim_source (MnbClipboardModel *model,
+                                 GQuark             source,
+                                 guint              max_items,
+                                 GArray            *removed)
+{
+  guint i, n_items = 0;
+  gboolean found = FALSE;
+
+  if (source == 0 || max_items == 0)
+    return;
+
+  for (i = 0; i < model->n_items; i++)
+    if (model->sources[i] == source)
+      n_items += 1;
+
+  if (n_items <= max_items)
+    return;
+
+  memset (model->doomed, 0, model->n_items);
+
+  for (i = 0; i + 1 < model->n_items && n_items > max_items; i++)
+    {
+      if (model->sources[i] != source)
+        continue;
+
+      model->doomed[i] = TRUE;
+      found = TRUE;
+
+      n_items -= 1;
+    }
+
+  if (found)
+    mnb_clipboard_model_compact (model, removed);
+}
+
+/*
+ * mnb_clipboard_model_move_row:
+ *
+ * Moves @row of @model to the top of @dest with new @serial, @flags
+ * and @mtime; the text is brought back into memory on the way. The
+ * serials of @dest must keep growing towards the top, so @serial is
+ * either the one of the row or a fresh one.
+ */
+void
+mnb_clipboard_model_move_row (MnbClipboardModel *model,
+                              guint              row,
+                              MnbClipboardModel *dest,
+                              gint64             serial,
+                              guint              flags,
+                              gint64             mtime)
+{
+  PayloadStore *payload = &model->payload;
+  gchar *text, **uris;
+  guint i;
+
+  g_return_if_fail (row < model->n_items);
+  g_return_if_fail (model != dest);
+
+  i = ROW_TO_INDEX (model, row);
+
+  text = mnb_clipboard_model_dup_text_index (model, i);
+
+  /* the uris change hands, so they must survive the removal */
+  uris = payload->uris[i];
+  payload->uris[i] = NULL;
+
+  mnb_clipboard_model_prepend (dest,
+                               model->types[i],
+                               serial,
+                               mtime,
+                               flags & ~(NOT_RESIDENT |
+                                         MNB_CLIPBOARD_MODEL_STREAMED),
+                               model->hashes[i],
+                               text,
+                               payload->preview[i],
+                               payload->filter[i],
+                               uris);
+
+  g_free (text);
+
+  dest->sources[dest->n_items - 1] = model->sources[i];
+
+  memset (model->doomed, 0, model->n_items);
+  model->doomed[i] = TRUE;
+
+  mnb_clipboard_model_compact (model, NULL);
+}
+
+void
+mnb_clipboard_model_clear (MnbClipboardModel *model,
+                           GArray            *removed)
+{
+  if (model->n_items == 0)
+    return;
+
+  memset (model->doomed, TRUE, model->n_items);
+
+  mnb_clipboard_model_compact (model, removed);
+}
+
+gint64
+mnb_clipboard_model_get_oldest_mtime (MnbClipboardModel    *model,
+                                      MnbClipboardItemType  item_type)
+{
+  guint i;
+
+  for (i = 0; i < model->n_items; i++)
+    {
+      if (model->types[i] == item_type)
+        return model->mtimes[i];
+    }
+
+  return -1;
+}
+
+gsize
+mnb_clipboard_model_get_total_size (MnbClipboardModel *model)
+{
+  return model->total_size;
+}
+
+/* appends the serials of the items whose filter key contains
+ * @needle, newest first
+ */
+void
+mnb_clipboard_model_match (MnbClipboardModel *model,
+                           const gchar       *needle,
+                           GArray            *matches)
+{
+  gchar * const *filters = model->payload.filter;
+  gchar * const *texts = model->payload.text;
+  gint i;
+
+  /* the items that are not in memory can only be found through
+   * their preview
+   */
+  for (i = (gint) model->n_items - 1; i >= 0; i--)
+    {
+      const gchar *haystack;
+
+      if (filters[i] != NULL)
+        haystack = filters[i];
+      else if (model->flags[i] & NOT_RESIDENT)
+        haystack = model->payload.preview[i];
+      else
+        haystack = texts[i];
+
+      if (haystack != NULL && strstr (haystack, needle) != NULL)
+        g_array_append_val (matches, model->serials[i]);
+    }
+}
+
+/*
+ * mnb_clipboard_model_set_image_dir:
+ *
+ * Sets the directory holding the images of the items; removing an
+ * image item also removes its file from there.
+ */
+void
+mnb_clipboard_model_set_image_dir (MnbClipboardModel *model,
+                                   const gchar       *path)
+{
+  g_return_if_fail (model->image_dir == NULL);
+
+  model->image_dir = g_strdup (path);
+}
+
+G_CONST_RETURN gchar *
+mnb_clipboard_model_get_spill_dir (MnbClipboardModel *model)
+{
+  return model->spill_dir;
+}
+
+/*
+ * mnb_clipboard_model_set_spill_dir:
+ *
+ * Sets the directory holding the spilled texts, creating it if
+ * needed. The files left over by a previous session are removed.
+ */
+void
+mnb_clipboard_model_set_spill_dir (MnbClipboardModel *model,
+                                   const gchar       *path)
+{
+  const gchar *name;
+  GDir *dir;
+
+  g_return_if_fail (model->spill_dir == NULL);
+
+  model->spill_dir = g_strdup (path);
+
+  if (g_mkdir_with_parents (path, 0700) == -1)
+    return;
+
+  dir = g_dir_open (path, 0, NULL);
+  if (dir == NULL)
+    return;
+
+  while ((name = g_dir_read_name (dir)) != NULL)
+    {
+      gchar *file = g_build_filename (path, name, NULL);
+
+      g_unlink (file);
+      g_free (file);
+    }
+
+  g_dir_close (dir);
+}
+
+static gchar *
+run_converter (GConverter  *converter,
+               const gchar *data,
+               gsize        len,
+               gsize        size_hint,
+               gsize       *out_len)
+{
+  GConverterResult res;
+  gsize in_pos = 0, out_pos = 0;
+  gsize out_size = MAX (size_hint, 64);
+  gchar *out = g_malloc (out_size);
+
+  do
+    {
+      GError *error = NULL;
+      gsize n_read = 0, n_written = 0;
+
+      res = g_converter_convert (converter,
+                                 data + in_pos, len - in_pos,
+                                 out + out_pos, out_size - out_pos,
+                                 G_CONVERTER_INPUT_AT_END,
+                                 &n_read,
+                                 &n_written,
+                                 &error);
+
+      if (res == G_CONVERTER_ERROR)
+        {
+          if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NO_SPACE))
+            {
+              g_error_free (error);
+
+              out_size *= 2;
+              out = g_realloc (out, out_size);
+
+              continue;
+            }
+
+          g_warning ("Unable to convert the clipboard item: %s",
+                     error->message);
+          g_error_free (error);
+          g_free (out);
+
+          return NULL;
+        }
+
+      in_pos += n_read;
+      out_pos += n_written;
+    }
+  while (res != G_CONVERTER_FINISHED);
+
+  *out_len = out_pos;
+
+  return out;
+}
+
+static gchar *
+compress_text (const gchar *text,
+               gsize        len,
+               gsize       *out_len)
+{
+  GZlibCompressor *compressor;
+  gchar *res;
+
+  compressor = g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW, -1);
+  res = run_converter (G_CONVERTER (compressor), text, len, len / 2, out_len);
+  g_object_unref (compressor);
+
+  return res;
+}
+
+static gchar *
+decompress_text (const gchar *data,
+                 gsize        len,
+                 gsize        text_size)
+{
+  GZlibDecompressor *decompressor;
+  gsize out_len = 0;
+  gchar *res;
+
+  decompressor = g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW);
+  res = run_converter (G_CONVERTER (decompressor), data, len,
+                       text_size + 1,
+                       &out_len);
+  g_object_unref (decompressor);
+
+  if (res == NULL)
+    return NULL;
+
+  if (out_len != text_size)
+    {
+      g_warning ("Corrupted clipboard item: expected %" G_GSIZE_FORMAT
+                 " bytes, got %" G_GSIZE_FORMAT,
+                 text_size,
+                 out_len);
+      g_free (res);
+
+      return NULL;
+    }
+
+  res = g_realloc (res, out_len + 1);
+  res[out_len] = '\0';
+
+  return res;
+}
+
+/* reads back the stored form of a spilled text */
+static gchar *
+load_spilled (MnbClipboardModel *model,
+              guint              index_)
+{
+  GError *error = NULL;
+  gchar *path, *data = NULL;
+  gsize len = 0;
+
+  path = spill_path (model, index_);
+
+  if (!g_file_get_contents (path, &data, &len, &error))
+    {
+      g_warning ("Unable to load the clipboard item from '%s': %s",
+                 path,
+                 error->message);
+      g_error_free (error);
+    }
+  else if (len != model->stored_sizes[index_])
+    {
+      g_warning ("Truncated clipboard item in '%s'", path);
+      g_free (data);
+      data = NULL;
+    }
+
+  g_free (path);
+
+  return data;
+}
+
+static gchar *
+mnb_clipboard_model_dup_text_index (MnbClipboardModel *model,
+                                    guint              index_)
+{
+  guint flags = model->flags[index_];
+  gchar *data, *res;
+
+  if ((flags & NOT_RESIDENT) == 0)
+    return g_strdup (model->payload.text[index_]);
+
+  if (flags & MNB_CLIPBOARD_MODEL_SPILLED)
+    {
+      data = load_spilled (model, index_);
+      if (data == NULL)
+        return NULL;
+
+      /* g_file_get_contents() terminates the data */
+      if ((flags & MNB_CLIPBOARD_MODEL_COMPRESSED) == 0)
+        return data;
+    }
+  else
+    data = model->payload.text[index_];
+
+  res = decompress_text (data, model->stored_sizes[index_],
+                         model->sizes[index_]);
+
+  if (data != model->payload.text[index_])
+    g_free (data);
+
+  return res;
+}
+
+/*
+ * mnb_clipboard_model_dup_text:
+ *
+ * Retrieves a copy of the text of @row, loading and decompressing it
+ * if needed.
+ *
+ * Return value: a newly allocated string, or %NULL
+ */
+gchar *
+mnb_clipboard_model_dup_text (MnbClipboardModel *model,
+                              guint              row)
+{
+  g_return_val_if_fail (row < model->n_items, NULL);
+
+  return mnb_clipboard_model_dup_text_index (model, ROW_TO_INDEX (model, row));
+}
+
+static gboolean
+write_all (gint          fd,
+           const gchar  *data,
+           gsize         len,
+           GError      **error)
+{
+  while (len > 0)
+    {
+      gssize res = write (fd, data, len);
+
+      if (res == -1)
+        {
+          if (errno == EINTR)
+            continue;
+
+          g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                       "Unable to write the clipboard item: %s",
+                       g_strerror (errno));
+          return FALSE;
+        }
+
+      data += res;
+      len -= res;
+    }
+
+  return TRUE;
+}
+
+/* decompresses into @fd a chunk at a time */
+static gboolean
+decompress_to_fd (const gchar  *data,
+                  gsize         len,
+                  gsize         text_size,
+                  gint          fd,
+                  GError      **error)
+{
+  GZlibDecompressor *decompressor;
+  GConverterResult res;
+  gchar buf[WRITE_CHUNK_SIZE];
+  gsize in_pos = 0, out_len = 0;
+  gboolean retval = FALSE;
+
+  decompressor = g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW);
+
+  do
+    {
+      gsize n_read = 0, n_written = 0;
+
+      res = g_converter_convert (G_CONVERTER (decompressor),
+                                 data + in_pos, len - in_pos,
+                                 buf, sizeof (buf),
+                                 G_CONVERTER_INPUT_AT_END,
+                                 &n_read,
+                                 &n_written,
+                                 error);
+      if (res == G_CONVERTER_ERROR)
+        goto out;
+
+      in_pos += n_read;
+      out_len += n_written;
+
+      if (!write_all (fd, buf, n_written, error))
+        goto out;
+    }
+  while (res != G_CONVERTER_FINISHED);
+
+  if (out_len != text_size)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                   "Corrupted clipboard item: expected %" G_GSIZE_FORMAT
+                   " bytes, got %" G_GSIZE_FORMAT,
+                   text_size,
+                   out_len);
+      goto out;
+    }
+
+  retval = TRUE;
+
+out:
+  g_object_unref (decompressor);
+
+  return retval;
+}
+
+/* copies a spilled text that is not compressed into @fd */
+static gboolean
+copy_spilled_to_fd (MnbClipboardModel  *model,
+                    guint               index_,
+                    gint                fd,
+                    GError            **error)
+{
+  gchar buf[WRITE_CHUNK_SIZE];
+  gchar *path;
+  gsize len = 0;
+  gint in_fd;
+  gboolean retval = FALSE;
+
+  path = spill_path (model, index_);
+
+  in_fd = g_open (path, O_RDONLY, 0);
+  if (in_fd == -1)
+    {
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                   "Unable to open '%s': %s",
+                   path,
+                   g_strerror (errno));
+      goto out;
+    }
+
+  for (;;)
+    {
+      gssize res = read (in_fd, buf, sizeof (buf));
+
+      if (res == -1)
+        {
+          if (errno == EINTR)
+            continue;
+
+          g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                       "Unable to read '%s': %s",
+                       path,
+                       g_strerror (errno));
+          goto out;
+        }
+
+      if (res == 0)
+        break;
+
+      if (!write_all (fd, buf, res, error))
+        goto out;
+
+      len += res;
+    }
+
+  if (len != model->stored_sizes[index_])
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                   "Truncated clipboard item in '%s'",
+                   path);
+      goto out;
+    }
+
+  retval = TRUE;
+
+out:
+  if (in_fd != -1)
+    close (in_fd);
+
+  g_free (path);
+
+  return retval;
+}
+
+/*
+ * mnb_clipboard_model_write_text:
+ *
+ * Writes the text of @row to @fd straight from where it is stored;
+ * unlike mnb_clipboard_model_dup_text(), the whole text is never
+ * copied in memory.
+ *
+ * Return value: %TRUE on success
+ */
+gboolean
+mnb_clipboard_model_write_text (MnbClipboardModel  *model,
+                                guint               row,
+                                gint                fd,
+                                GError            **error)
+{
+  guint index_, flags;
+  gchar *data;
+  gboolean retval;
+
+  g_return_val_if_fail (row < model->n_items, FALSE);
+  g_return_val_if_fail (fd != -1, FALSE);
+
+  index_ = ROW_TO_INDEX (model, row);
+  flags = model->flags[index_];
+
+  if ((flags & NOT_RESIDENT) == 0)
+    {
+      if (model->payload.text[index_] == NULL)
+        return TRUE;
+
+      return write_all (fd, model->payload.text[index_],
+                        model->sizes[index_],
+                        error);
+    }
+
+  if ((flags & MNB_CLIPBOARD_MODEL_COMPRESSED) == 0)
+    return copy_spilled_to_fd (model, index_, fd, error);
+
+  /* only the compressed form is loaded, and it is much smaller */
+  if (flags & MNB_CLIPBOARD_MODEL_SPILLED)
+    {
+      data = load_spilled (model, index_);
+      if (data == NULL)
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                       "Unable to load the clipboard item");
+          return FALSE;
+        }
+    }
+  else
+    data = model->payload.text[index_];
+
+  retval = decompress_to_fd (data, model->stored_sizes[index_],
+                             model->sizes[index_],
+                             fd,
+                             error);
+
+  if (data != model->payload.text[index_])
+    g_free (data);
+
+  return retval;
+}
+
+/* the preview of the short texts, and the filter key of the folded
+ * ones, are shared with the text, which is about to go away
+ */
+static void
+ensure_preview (MnbClipboardModel *model,
+                guint              index_)
+{
+  PayloadStore *payload = &model->payload;
+
+  if (payload->preview[index_] == NULL)
+    payload->preview[index_] =
+      mnb_clipboard_arena_strndup (model->arena,
+                                   payload->text[index_],
+                                   model->sizes[index_]);
+
+  /* otherwise the search would only see the preview */
+  if (payload->filter[index_] == NULL)
+    payload->filter[index_] =
+      mnb_clipboard_arena_strndup (model->arena,
+                                   payload->text[index_],
+                                   model->sizes[index_]);
+}
+
+guint
+mnb_clipboard_model_compress (MnbClipboardModel *model,
+                              gint64             before,
+                              gsize              min_size)
+{
+  PayloadStore *payload = &model->payload;
+  guint i, n_compressed = 0;
+
+  for (i = 0; i < model->n_items; i++)
+    {
+      gchar *data;
+      gsize len = 0;
+
+      if (model->mtimes[i] >= before ||
+          (model->flags[i] & NOT_RESIDENT) != 0 ||
+          payload->text[i] == NULL ||
+          model->sizes[i] < min_size)
+        continue;
+
+      data = compress_text (payload->text[i], model->sizes[i], &len);
+      if (data == NULL)
+        continue;
+
+      /* not worth the trouble of decompressing it later */
+      if (len > model->sizes[i] - model->sizes[i] / 8)
+        {
+          g_free (data);
+          continue;
+        }
+
+      ensure_preview (model, i);
+
+      mnb_clipboard_arena_release (model->arena,
+                                   payload->text[i],
+                                   model->sizes[i]);
+
+      payload->text[i] = data;
+      model->stored_sizes[i] = len;
+      model->flags[i] |= MNB_CLIPBOARD_MODEL_COMPRESSED;
+
+      n_compressed += 1;
+    }
+
+  if (n_compressed > 0)
+    mnb_clipboard_model_compact_arena (model);
+
+  return n_compressed;
+}
+
+guint
+mnb_clipboard_model_spill (MnbClipboardModel *model,
+                           gint64             before)
+{
+  PayloadStore *payload = &model->payload;
+  guint i, n_spilled = 0;
+
+  if (model->spill_dir == NULL)
+    return 0;
+
+  for (i = 0; i < model->n_items; i++)
+    {
+      GError *error = NULL;
+      gboolean is_compressed;
+      gchar *path;
+      gsize len;
+
+      if (model->mtimes[i] >= before ||
+          (model->flags[i] & MNB_CLIPBOARD_MODEL_SPILLED) != 0 ||
+          payload->text[i] == NULL)
+        continue;
+
+      is_compressed = (model->flags[i] & MNB_CLIPBOARD_MODEL_COMPRESSED) != 0;
+      len = is_compressed ? model->stored_sizes[i] : model->sizes[i];
+
+      path = spill_path (model, i);
+      if (!g_file_set_contents (path, payload->text[i], len, &error))
+        {
+          g_warning ("Unable to spill the clipboard item to '%s': %s",
+                     path,
+                     error->message);
+          g_error_free (error);
+          g_free (path);
+
+          /* the next ones are not going to fare any better */
+          break;
+        }
+
+      g_free (path);
+
+      /* a compressed text got them when it was compressed */
+      if (!is_compressed)
+        ensure_preview (model, i);
+
+      if (is_compressed)
+        g_free (payload->text[i]);
+      else
+        mnb_clipboard_arena_release (model->arena,
+                                     payload->text[i],
+                                     model->sizes[i]);
+
+      payload->text[i] = NULL;
+      model->stored_sizes[i] = len;
+      model->flags[i] |= MNB_CLIPBOARD_MODEL_SPILLED;
+
+      n_spilled += 1;
+    }
+
+  if (n_spilled > 0)
+    mnb_clipboard_model_compact_arena (model);
+
+  return n_spilled;
+}
+
+/* brings the spilled texts back in memory, in the form they had
+ * before being spilled
+ */
+guint
+mnb_clipboard_model_unspill (MnbClipboardModel *model)
+{
+  PayloadStore *payload = &model->payload;
+  guint i, n_loaded = 0;
+
+  for (i = 0; i < model->n_items; i++)
+    {
+      gchar *data, *path;
+
+      /* the streamed texts were never in memory */
+      if ((model->flags[i] & MNB_CLIPBOARD_MODEL_SPILLED) == 0 ||
+          (model->flags[i] & MNB_CLIPBOARD_MODEL_STREAMED) != 0)
+        continue;
+
+      data = load_spilled (model, i);
+      if (data == NULL)
+        continue;
+
+      if (model->flags[i] & MNB_CLIPBOARD_MODEL_COMPRESSED)
+        payload->text[i] = data;
+      else
+        {
+          payload->text[i] = mnb_clipboard_arena_strndup (model->arena,
+                                                          data,
+                                                          model->sizes[i]);
+          model->stored_sizes[i] = 0;
+          g_free (data);
+        }
+
+      path = spill_path (model, i);
+      g_unlink (path);
+      g_free (path);
+
+      model->flags[i] &= ~MNB_CLIPBOARD_MODEL_SPILLED;
+
+      n_loaded += 1;
+    }
+
+  return n_loaded;
+}
+
+guint
+mnb_clipboard_model_decompress (MnbClipboardModel *model)
+{
+  PayloadStore *payload = &model->payload;
+  guint i, n_decompressed = 0;
+
+  for (i = 0; i < model->n_items; i++)
+    {
+      gchar *text;
+
+      if ((model->flags[i] & NOT_RESIDENT) != MNB_CLIPBOARD_MODEL_COMPRESSED)
+        continue;
+
+      text = decompress_text (payload->text[i],
+                              model->stored_sizes[i],
+                              model->sizes[i]);
+      if (text == NULL)
+        continue;
+
+      g_free (payload->text[i]);
+
+      payload->text[i] = mnb_clipboard_arena_strndup (model->arena,
+                                                      text,
+                                                      model->sizes[i]);
+      model->stored_sizes[i] = 0;
+      model->flags[i] &= ~MNB_CLIPBOARD_MODEL_COMPRESSED;
+
+      g_free (text);
+
+      n_decompressed += 1;
+    }
+
+  return n_decompressed;
+}
+
+void
+mnb_clipboard_model_get_memory_stats (MnbClipboardModel *model,
+                                      gsize             *arena_live,
+                                      gsize             *arena_allocated,
+                                      guint             *n_compressed,
+                                      guint             *n_spilled)
+{
+  guint i, compressed = 0, spilled = 0;
+
+  mnb_clipboard_arena_get_stats (model->arena, arena_live, arena_allocated);
+
+  for (i = 0; i < model->n_items; i++)
+    {
+      if (model->flags[i] & MNB_CLIPBOARD_MODEL_SPILLED)
+        spilled += 1;
+      else if (model->flags[i] & MNB_CLIPBOARD_MODEL_COMPRESSED)
+        compressed += 1;
+    }
+
+  if (n_compressed)
+    *n_compressed = compressed;
+
+  if (n_spilled)
+    *n_spilled = spilled;
+}
@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2008 - 2009 Intel Corporation.
+ *
+ * Author: Emmanuele Bassi <ebassi@linux.intel.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __MNB_CLIPBOARD_MODEL_H__
+#define __MNB_CLIPBOARD_MODEL_H__
+
+#include "mnb-clipboard-store.h"
+
+G_BEGIN_DECLS
+
+typedef struct _MnbClipboardModel       MnbClipboardModel;
+
+#define MNB_CLIPBOARD_MODEL_N_TYPES     (MNB_CLIPBOARD_ITEM_IMAGE + 1)
+
+typedef enum {
+  MNB_CLIPBOARD_MODEL_PINNED     = 1 << 0,
+
+  /* where the text is, see mnb_clipboard_model_dup_text() */
+  MNB_CLIPBOARD_MODEL_COMPRESSED = 1 << 1,
+  MNB_CLIPBOARD_MODEL_SPILLED    = 1 << 2,
+
+  /* a long text streamed to the spill directory, which stays there;
+   * it might have been cut at the size cap of the fetch
+   */
+  MNB_CLIPBOARD_MODEL_STREAMED   = 1 << 3,
+  MNB_CLIPBOARD_MODEL_TRUNCATED  = 1 << 4
+} MnbClipboardModelFlags;
+
+MnbClipboardModel *mnb_clipboard_model_new  (void);
+void               mnb_clipboard_model_free (MnbClipboardModel *model);
+
+void mnb_clipboard_model_set_spill_dir (MnbClipboardModel *model,
+                                        const gchar       *path);
+G_CONST_RETURN gchar *mnb_clipboard_model_get_spill_dir (MnbClipboardModel *model);
+void mnb_clipboard_model_set_image_dir (MnbClipboardModel *model,
+                                        const gchar       *path);
+
+guint mnb_clipboard_model_get_n_rows (MnbClipboardModel *model);
+
+void mnb_clipboard_model_prepend (MnbClipboardModel    *model,
+                                  MnbClipboardItemType  item_type,
+                                  gint64                serial,
+                                  gint64                mtime,
+                                  guint                 flags,
+                                  guint32               text_hash,
+                                  const gchar          *text,
+                                  const gchar          *preview,
+                                  const gchar          *filter,
+                                  gchar               **uris);
+
+gboolean mnb_clipboard_model_prepend_spilled (MnbClipboardModel    *model,
+                                              MnbClipboardItemType  item_type,
+                                              gint64                serial,
+                                              gint64                mtime,
+                                              guint                 flags,
+                                              guint32               text_hash,
+                                              gsize                 text_size,
+                                              const gchar          *path,
+                                              const gchar          *preview,
+                                              const gchar          *filter);
+
+gint  mnb_clipboard_model_find         (MnbClipboardModel *model,
+                                        gint64             serial);
+guint mnb_clipboard_model_find_at_most (MnbClipboardModel *model,
+                                        gint64             serial);
+
+/* accessors by row, row 0 being the newest item; the strings are
+ * owned by the model. The text is %NULL while it is compressed or
+ * spilled to disk; mnb_clipboard_model_dup_text() works in any case
+ */
+MnbClipboardItemType mnb_clipboard_model_get_item_type (MnbClipboardModel *model,
+                                                        guint              row);
+gint64               mnb_clipboard_model_get_serial    (MnbClipboardModel *model,
+                                                        guint              row);
+gint64               mnb_clipboard_model_get_mtime     (MnbClipboardModel *model,
+                                                        guint              row);
+guint                mnb_clipboard_model_get_flags     (MnbClipboardModel *model,
+                                                        guint              row);
+guint32              mnb_clipboard_model_get_text_hash (MnbClipboardModel *model,
+                                                        guint              row);
+gsize                mnb_clipboard_model_get_text_size (MnbClipboardModel *model,
+                                                        guint              row);
+GQuark               mnb_clipboard_model_get_source    (MnbClipboardModel *model,
+                                                        guint              row);
+G_CONST_RETURN gchar *mnb_clipboard_model_get_text     (MnbClipboardModel *model,
+                                                        guint              row);
+G_CONST_RETURN gchar *mnb_clipboard_model_get_preview  (MnbClipboardModel *model,
+                                                        guint              row);
+gchar **             mnb_clipboard_model_get_uris      (MnbClipboardModel *model,
+                                                        guint              row);
+
+gchar *  mnb_clipboard_model_dup_text   (MnbClipboardModel  *model,
+                                         guint               row);
+gboolean mnb_clipboard_model_write_text (MnbClipboardModel  *model,
+                                         guint               row,
+                                         gint                fd,
+                                         GError            **error);
+
+void mnb_clipboard_model_set_flags  (MnbClipboardModel *model,
+                                     guint              row,
+                                     guint              flags);
+void mnb_clipboard_model_set_source (MnbClipboardModel *model,
+                                     guint              row,
+                                     GQuark             source);
+
+void mnb_clipboard_model_move_row (MnbClipboardModel *model,
+                                   guint              row,
+                                   MnbClipboardModel *dest,
+                                   gint64             serial,
+                                   guint              flags,
+                                   gint64             mtime);
+
+/* bulk operations; the serials of the removed items are appended to
+ * @removed, newest first
+ */
+void mnb_clipboard_model_remove_serials (MnbClipboardModel *model,
+                                         const gint64      *serials,
+                                         guint              n_serials,
+                                         GArray            *removed);
+void mnb_clipboard_model_remove_expired (MnbClipboardModel *model,
+                                         const gint64      *before,
+                                         GArray            *removed);
+void mnb_clipboard_model_trim           (MnbClipboardModel *model,
+                                         guint              max_items,
+                                         gsize              max_bytes,
+                                         GArray            *removed);
+void mnb_clipboard_model_trim_source    (MnbClipboardModel *model,
+                                         GQuark             source,
+                                         guint              max_items,
+                                         GArray            *removed);
+void mnb_clipboard_model_clear          (MnbClipboardModel *model,
+                                         GArray            *removed);
+
+/* the expiration only depends on the oldest item of each type;
+ * returns -1 if there is none
+ */
+gint64 mnb_clipboard_model_get_oldest_mtime (MnbClipboardModel    *model,
+                                             MnbClipboardItemType  item_type);
+gsize  mnb_clipboard_model_get_total_size   (MnbClipboardModel    *model);
+
+void mnb_clipboard_model_match (MnbClipboardModel *model,
+                                const gchar       *needle,
+                                GArray            *matches);
+
+/* memory pressure; the texts of the items older than @before are
+ * compressed or written to the spill directory, and brought back
+ * when the pressure goes away. All return the number of items
+ * affected.
+ */
+guint mnb_clipboard_model_compress   (MnbClipboardModel *model,
+                                      gint64             before,
+                                      gsize              min_size);
+guint mnb_clipboard_model_spill      (MnbClipboardModel *model,
+                                      gint64             before);
+guint mnb_clipboard_model_unspill    (MnbClipboardModel *model);
+guint mnb_clipboard_model_decompress (MnbClipboardModel *model);
+
+void mnb_clipboard_model_get_memory_stats (MnbClipboardModel *model,
+                                           gsize             *arena_live,
+                                           gsize             *arena_allocated,
+                                           guint             *n_compressed,
+                                           guint             *n_spilled);
+
+G_END_DECLS
+
+#endif /* __MNB_CLIPBOARD_MODEL_H__ */
@@ -0,0 +1,396 @@
+/*
+ * Copyright (C) 2008 - 2009 Intel Corporation.
+ *
+ * Author: Emmanuele Bassi <ebassi@linux.intel.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * MnbClipboardPressure: watches the memory pressure of the system
+ *
+ * The pressure is read from the PSI interface of the kernel, in
+ * /proc/pressure/memory; where it is not available the level stays
+ * at MNB_CLIPBOARD_PRESSURE_NONE and nothing is polled.
+ *
+ * We do not wake up while there is no pressure: the kernel notifies
+ * us through a PSI trigger once the stalls cross the lowest threshold,
+ * and the pressure is only polled while the level is above
+ * MNB_CLIPBOARD_PRESSURE_NONE, to see it going down again. Kernels
+ * that refuse the trigger get polled all the time.
+ *
+ * The level goes up as soon as the pressure crosses a threshold, but
+ * it only goes down one step at a time, after the pressure has stayed
+ * below the threshold for a while, so that we do not keep undoing and
+ * redoing the same work.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mnb-clipboard-pressure.h"
+
+#define PSI_MEMORY_PATH         "/proc/pressure/memory"
+
+/* 40ms of stalls within 2s, the threshold of the LOW level; the
+ * kernel only lets unprivileged processes use windows that are
+ * multiples of 2s
+ */
+#define PSI_TRIGGER             "some 40000 2000000"
+
+#define POLL_INTERVAL           (5)     /* seconds */
+
+/* polls below the current level before we step down */
+#define RELAX_POLLS             (6)
+
+struct _MnbClipboardPressurePrivate
+{
+  MnbClipboardPressureLevel level;
+
+  guint n_relaxed;
+
+  guint poll_id;
+
+  /* the PSI trigger, if the kernel accepted it */
+  GIOChannel *trigger;
+  guint trigger_id;
+};
+
+enum
+{
+  PROP_0,
+
+  PROP_LEVEL
+};
+
+G_DEFINE_TYPE (MnbClipboardPressure, mnb_clipboard_pressure, G_TYPE_OBJECT);
+
+#define MNB_CLIPBOARD_PRESSURE_GET_PRIVATE(obj)  (G_TYPE_INSTANCE_GET_PRIVATE ((obj), MNB_TYPE_CLIPBOARD_PRESSURE, MnbClipboardPressurePrivate))
+
+/* the share of time, in percent over the last ten seconds, in which
+ * some or all of the tasks were stalled waiting for memory
+ */
+static gboolean
+read_psi (gdouble *some_avg10,
+          gdouble *full_avg10)
+{
+  gchar *contents = NULL;
+  gchar **lines;
+  gint i;
+
+  if (!g_file_get_contents (PSI_MEMORY_PATH, &contents, NULL, NULL))
+    return FALSE;
+
+  *some_avg10 = *full_avg10 = 0.0;
+
+  lines = g_strsplit (contents, "\n", -1);
+  for (i = 0; lines[i] != NULL; i++)
+    {
+      const gchar *avg10 = strstr (lines[i], "avg10=");
+
+      if (avg10 == NULL)
+        continue;
+
+      avg10 += strlen ("avg10=");
+
+      if (g_str_has_prefix (lines[i], "some "))
+        *some_avg10 = g_ascii_strtod (avg10, NULL);
+      else if (g_str_has_prefix (lines[i], "full "))
+        *full_avg10 = g_ascii_strtod (avg10, NULL);
+    }
+
+  g_strfreev (lines);
+  g_free (contents);
+
+  return TRUE;
+}
+
+static MnbClipboardPressureLevel
+level_for_psi (gdouble some_avg10,
+               gdouble full_avg10)
+{
+  if (full_avg10 >= 10.0)
+    return MNB_CLIPBOARD_PRESSURE_CRITICAL;
+
+  if (full_avg10 >= 2.0 || some_avg10 >= 30.0)
+    return MNB_CLIPBOARD_PRESSURE_HIGH;
+
+  if (some_avg10 >= 10.0)
+    return MNB_CLIPBOARD_PRESSURE_MEDIUM;
+
+  if (some_avg10 >= 2.0)
+    return MNB_CLIPBOARD_PRESSURE_LOW;
+
+  return MNB_CLIPBOARD_PRESSURE_NONE;
+}
+
+static void
+mnb_clipboard_pressure_set_level (MnbClipboardPressure      *pressure,
+                                  MnbClipboardPressureLevel  level)
+{
+  MnbClipboardPressurePrivate *priv = pressure->priv;
+
+  if (priv->level == level)
+    return;
+
+  priv->level = level;
+
+  g_object_notify (G_OBJECT (pressure), "level");
+}
+
+/* reads the pressure and moves the level accordingly */
+static gboolean
+mnb_clipboard_pressure_update (MnbClipboardPressure *pressure)
+{
+  MnbClipboardPressurePrivate *priv = pressure->priv;
+  MnbClipboardPressureLevel level;
+  gdouble some_avg10, full_avg10;
+
+  if (!read_psi (&some_avg10, &full_avg10))
+    return FALSE;
+
+  level = level_for_psi (some_avg10, full_avg10);
+
+  if (level >= priv->level)
+    {
+      priv->n_relaxed = 0;
+      mnb_clipboard_pressure_set_level (pressure, level);
+    }
+  else if (++priv->n_relaxed >= RELAX_POLLS)
+    {
+      priv->n_relaxed = 0;
+      mnb_clipboard_pressure_set_level (pressure, priv->level - 1);
+    }
+
+  return TRUE;
+}
+
+static gboolean
+mnb_clipboard_pressure_poll (gpointer data)
+{
+  MnbClipboardPressure *pressure = data;
+  MnbClipboardPressurePrivate *priv = pressure->priv;
+
+  if (!mnb_clipboard_pressure_update (pressure))
+    {
+      priv->poll_id = 0;
+      mnb_clipboard_pressure_set_level (pressure, MNB_CLIPBOARD_PRESSURE_NONE);
+
+      return FALSE;
+    }
+
+  /* the trigger tells us when the pressure comes back */
+  if (priv->trigger != NULL && priv->level == MNB_CLIPBOARD_PRESSURE_NONE)
+    {
+      priv->poll_id = 0;
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+mnb_clipboard_pressure_start_polling (MnbClipboardPressure *pressure)
+{
+  MnbClipboardPressurePrivate *priv = pressure->priv;
+
+  if (priv->poll_id != 0)
+    return;
+
+  priv->poll_id = g_timeout_add_seconds (POLL_INTERVAL,
+                                         mnb_clipboard_pressure_poll,
+                                         pressure);
+}
+
+static gboolean
+on_trigger (GIOChannel   *channel,
+            GIOCondition  condition,
+            gpointer      data)
+{
+  MnbClipboardPressure *pressure = data;
+  MnbClipboardPressurePrivate *priv = pressure->priv;
+
+  /* the trigger is gone with the file it was set on */
+  if ((condition & G_IO_ERR) != 0)
+    {
+      g_warning ("The memory pressure trigger stopped working, "
+                 "polling the pressure instead");
+
+      priv->trigger_id = 0;
+      g_io_channel_unref (priv->trigger);
+      priv->trigger = NULL;
+
+      mnb_clipboard_pressure_start_polling (pressure);
+
+      return FALSE;
+    }
+
+  if (!mnb_clipboard_pressure_update (pressure))
+    return TRUE;
+
+  if (priv->level > MNB_CLIPBOARD_PRESSURE_NONE)
+    mnb_clipboard_pressure_start_polling (pressure);
+
+  return TRUE;
+}
+
+/* sets a PSI trigger on the memory stalls; the kernel signals it with
+ * POLLPRI on the file descriptor
+ */
+static gboolean
+mnb_clipboard_pressure_set_trigger (MnbClipboardPressure *pressure)
+{
+  MnbClipboardPressurePrivate *priv = pressure->priv;
+  gint fd;
+
+  fd = open (PSI_MEMORY_PATH, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+  if (fd == -1)
+    return FALSE;
+
+  if (write (fd, PSI_TRIGGER, strlen (PSI_TRIGGER) + 1) < 0)
+    {
+      g_debug (G_STRLOC ": Unable to set the memory pressure trigger: %s",
+               g_strerror (errno));
+
+      close (fd);
+      return FALSE;
+    }
+
+  priv->trigger = g_io_channel_unix_new (fd);
+  g_io_channel_set_close_on_unref (priv->trigger, TRUE);
+
+  priv->trigger_id = g_io_add_watch (priv->trigger,
+                                     G_IO_PRI | G_IO_ERR,
+                                     on_trigger,
+                                     pressure);
+
+  return TRUE;
+}
+
+static void
+mnb_clipboard_pressure_get_property (GObject    *gobject,
+                                     guint       prop_id,
+                                     GValue     *value,
+                                     GParamSpec *pspec)
+{
+  MnbClipboardPressurePrivate *priv = MNB_CLIPBOARD_PRESSURE (gobject)->priv;
+
+  switch (prop_id)
+    {
+    case PROP_LEVEL:
+      g_value_set_enum (value, priv->level);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (gobject, prop_id, pspec);
+      break;
+    }
+}
+
+static void
+mnb_clipboard_pressure_finalize (GObject *gobject)
+{
+  MnbClipboardPressurePrivate *priv = MNB_CLIPBOARD_PRESSURE (gobject)->priv;
+
+  if (priv->poll_id != 0)
+    g_source_remove (priv->poll_id);
+
+  if (priv->trigger_id != 0)
+    g_source_remove (priv->trigger_id);
+
+  if (priv->trigger != NULL)
+    g_io_channel_unref (priv->trigger);
+
+  G_OBJECT_CLASS (mnb_clipboard_pressure_parent_class)->finalize (gobject);
+}
+
+static void
+mnb_clipboard_pressure_class_init (MnbClipboardPressureClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GParamSpec *pspec;
+
+  g_type_class_add_private (klass, sizeof (MnbClipboardPressurePrivate));
+
+  gobject_class->get_property = mnb_clipboard_pressure_get_property;
+  gobject_class->finalize = mnb_clipboard_pressure_finalize;
+
+  pspec = g_param_spec_enum ("level",
+                             "Level",
+                             "The current memory pressure level",
+                             MNB_TYPE_CLIPBOARD_PRESSURE_LEVEL,
+                             MNB_CLIPBOARD_PRESSURE_NONE,
+                             G_PARAM_READABLE);
+  g_object_class_install_property (gobject_class, PROP_LEVEL, pspec);
+}
+
+static void
+mnb_clipboard_pressure_init (MnbClipboardPressure *self)
+{
+  MnbClipboardPressurePrivate *priv;
+
+  self->priv = priv = MNB_CLIPBOARD_PRESSURE_GET_PRIVATE (self);
+
+  priv->level = MNB_CLIPBOARD_PRESSURE_NONE;
+
+  if (!g_file_test (PSI_MEMORY_PATH, G_FILE_TEST_EXISTS))
+    return;
+
+  if (!mnb_clipboard_pressure_set_trigger (self))
+    mnb_clipboard_pressure_start_polling (self);
+}
+
+MnbClipboardPressure *
+mnb_clipboard_pressure_new (void)
+{
+  return g_object_new (MNB_TYPE_CLIPBOARD_PRESSURE, NULL);
+}
+
+MnbClipboardPressureLevel
+mnb_clipboard_pressure_get_level (MnbClipboardPressure *pressure)
+{
+  g_return_val_if_fail (MNB_IS_CLIPBOARD_PRESSURE (pressure),
+                        MNB_CLIPBOARD_PRESSURE_NONE);
+
+  return pressure->priv->level;
+}
+
+GType
+mnb_clipboard_pressure_level_get_type (void)
+{
+  static GType our_type = 0;
+
+  if (G_UNLIKELY (our_type == 0))
+    {
+      static const GEnumValue values[] = {
+        { MNB_CLIPBOARD_PRESSURE_NONE, "MNB_CLIPBOARD_PRESSURE_NONE", "none" },
+        { MNB_CLIPBOARD_PRESSURE_LOW, "MNB_CLIPBOARD_PRESSURE_LOW", "low" },
+        { MNB_CLIPBOARD_PRESSURE_MEDIUM, "MNB_CLIPBOARD_PRESSURE_MEDIUM", "medium" },
+        { MNB_CLIPBOARD_PRESSURE_HIGH, "MNB_CLIPBOARD_PRESSURE_HIGH", "high" },
+        { MNB_CLIPBOARD_PRESSURE_CRITICAL, "MNB_CLIPBOARD_PRESSURE_CRITICAL", "critical" },
+        { 0, NULL, NULL }
+      };
+
+      our_type = g_enum_register_static (g_intern_static_string ("MnbClipboardPressureLevel"),
+                                         values);
+    }
+
+  return our_type;
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2008 - 2009 Intel Corporation.
+ *
+ * Author: Emmanuele Bassi <ebassi@linux.intel.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __MNB_CLIPBOARD_PRESSURE_H__
+#define __MNB_CLIPBOARD_PRESSURE_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define MNB_TYPE_CLIPBOARD_PRESSURE_LEVEL       (mnb_clipboard_pressure_level_get_type ())
+
+#define MNB_TYPE_CLIPBOARD_PRESSURE             (mnb_clipboard_pressure_get_type ())
+#define MNB_CLIPBOARD_PRESSURE(obj)             (G_TYPE_CHECK_INSTANCE_CAST ((obj), MNB_TYPE_CLIPBOARD_PRESSURE, MnbClipboardPressure))
+#define MNB_IS_CLIPBOARD_PRESSURE(obj)          (G_TYPE_CHECK_INSTANCE_TYPE ((obj), MNB_TYPE_CLIPBOARD_PRESSURE))
+#define MNB_CLIPBOARD_PRESSURE_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST ((klass), MNB_TYPE_CLIPBOARD_PRESSURE, MnbClipboardPressureClass))
+#define MNB_IS_CLIPBOARD_PRESSURE_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE ((klass), MNB_TYPE_CLIPBOARD_PRESSURE))
+#define MNB_CLIPBOARD_PRESSURE_GET_CLASS(obj)   (G_TYPE_INSTANCE_GET_CLASS ((obj), MNB_TYPE_CLIPBOARD_PRESSURE, MnbClipboardPressureClass))
+
+typedef struct _MnbClipboardPressure            MnbClipboardPressure;
+typedef struct _MnbClipboardPressurePrivate     MnbClipboardPressurePrivate;
+typedef struct _MnbClipboardPressureClass       MnbClipboardPressureClass;
+
+/* every level includes the actions of the levels below it */
+typedef enum {
+  MNB_CLIPBOARD_PRESSURE_NONE = 0,
+  MNB_CLIPBOARD_PRESSURE_LOW,           /* drop the caches */
+  MNB_CLIPBOARD_PRESSURE_MEDIUM,        /* compress the cold items */
+  MNB_CLIPBOARD_PRESSURE_HIGH,          /* spill the cold items to disk */
+  MNB_CLIPBOARD_PRESSURE_CRITICAL       /* evict the cold items */
+} MnbClipboardPressureLevel;
+
+struct _MnbClipboardPressure
+{
+  GObject parent_instance;
+
+  MnbClipboardPressurePrivate *priv;
+};
+
+struct _MnbClipboardPressureClass
+{
+  GObjectClass parent_class;
+};
+
+GType mnb_clipboard_pressure_level_get_type (void) G_GNUC_CONST;
+GType mnb_clipboard_pressure_get_type (void) G_GNUC_CONST;
+
+MnbClipboardPressure *mnb_clipboard_pressure_new (void);
+
+MnbClipboardPressureLevel mnb_clipboard_pressure_get_level (MnbClipboardPressure *pressure);
+
+G_END_DECLS
+
+#endif /* __MNB_CLIPBOARD_PRESSURE_H__ */
@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2008 - 2009 Intel Corporation.
+ *
+ * Author: Emmanuele Bassi <ebassi@linux.intel.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "mnb-clipboard-preview.h"
+
+/* U+2026 HORIZONTAL ELLIPSIS */
+#define ELLIPSIS        "\342\200\246"
+
+/*
+ * mnb_clipboard_preview_new:
+ * @text: the contents of a clipboard item
+ * @len: the length of @text in bytes, or -1 if @text is nul-terminated
+ * @max_lines: the maximum number of lines of the preview
+ * @max_chars: the maximum number of characters of the preview
+ *
+ * Creates a preview of @text, collapsing runs of white space into a
+ * single space and runs of line breaks into a single line break. A
+ * combining mark is counted together with the character it follows,
+ * so the preview never splits a grapheme.
+ *
+ * Only the first part of @text is scanned, so the cost of the preview
+ * is bounded by @max_lines and @max_chars and not by the size of the
+ * contents.
+ *
+ * Return value: a newly allocated string
+ */
+gchar *
+mnb_clipboard_preview_new (const gchar *text,
+                           gssize       len,
+                           guint        max_lines,
+                           guint        max_chars)
+{
+  GString *preview;
+  const gchar *p, *end;
+  guint n_lines, n_chars;
+  gboolean pending_space, pending_newline, truncated;
+
+  g_return_val_if_fail (text != NULL, NULL);
+
+  if (len < 0)
+    len = strlen (text);
+
+  preview = g_string_sized_new (MIN ((gsize) len, max_chars) + 1);
+
+  p = text;
+  end = text + len;
+
+  n_lines = 1;
+  n_chars = 0;
+  pending_space = pending_newline = truncated = FALSE;
+
+  while (p < end && *p != '\0')
+    {
+      gunichar c = g_utf8_get_char_validated (p, end - p);
+      const gchar *next;
+
+      /* skip invalid bytes instead of giving up on the whole text */
+      if (c == (gunichar) -1 || c == (gunichar) -2)
+        {
+          p += 1;
+          continue;
+        }
+
+      next = g_utf8_next_char (p);
+
+      if (c == '\n' || c == '\r' || c == 0x2028 || c == 0x2029)
+        {
+          if (preview->len > 0)
+            pending_newline = TRUE;
+
+          pending_space = FALSE;
+        }
+      else if (g_unichar_isspace (c))
+        {
+          if (preview->len > 0 && !pending_newline)
+            pending_space = TRUE;
+        }
+      else
+        {
+          if (pending_newline)
+            {
+              if (n_lines == max_lines)
+                {
+                  truncated = TRUE;
+                  break;
+                }
+
+              g_string_append_c (preview, '\n');
+              n_lines += 1;
+
+              pending_newline = FALSE;
+            }
+          else if (pending_space)
+            {
+              if (n_chars == max_chars)
+                {
+                  truncated = TRUE;
+                  break;
+                }
+
+              g_string_append_c (preview, ' ');
+              n_chars += 1;
+
+              pending_space = FALSE;
+            }
+
+          /* combining marks belong to the previous character */
+          if (!g_unichar_ismark (c))
+            {
+              if (n_chars == max_chars)
+                {
+                  truncated = TRUE;
+                  break;
+                }
+
+              n_chars += 1;
+            }
+
+          g_string_append_len (preview, p, next - p);
+        }
+
+      p = next;
+    }
+
+  if (truncated)
+    g_string_append (preview, ELLIPSIS);
+
+  return g_string_free (preview, FALSE);
+}
+
+/*
+ * mnb_clipboard_preview_filter_key:
+ * @text: the contents of a clipboard item, or a search string
+ * @len: the length of @text in bytes, or -1 if @text is nul-terminated
+ *
+ * Creates the key an item is searched by: @text in compatibility
+ * composed form, case folded. Unlike g_utf8_strdown(), this matches
+ * "STRASSE" with "straße", and the ligatures and full width forms with
+ * the plain letters. The search string goes through the same, so that
+ * a plain strstr() does the matching.
+ *
+ * The whole of @text is converted, so the items are given their key
+ * in the preview thread. Invalid UTF-8 gives an empty key.
+ *
+ * Return value: a newly allocated string
+ */
+gchar *
+mnb_clipboard_preview_filter_key (const gchar *text,
+                                  gssize       len)
+{
+  gchar *normalized, *folded, *res;
+
+  g_return_val_if_fail (text != NULL, NULL);
+
+  /* nothing can be safely made of invalid UTF-8 */
+  if (!g_utf8_validate (text, len, NULL))
+    return g_strdup ("");
+
+  normalized = g_utf8_normalize (text, len, G_NORMALIZE_NFKC);
+  if (normalized == NULL)
+    return g_strdup ("");
+
+  /* folding can undo the composition, as with U+0130 */
+  folded = g_utf8_casefold (normalized, -1);
+  res = g_utf8_normalize (folded, -1, G_NORMALIZE_NFKC);
+
+  g_free (normalized);
+
+  if (res == NULL)
+    return folded;
+
+  g_free (folded);
+
+  return res;
+}
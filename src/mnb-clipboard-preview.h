@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2008 - 2009 Intel Corporation.
+ *
+ * Author: Emmanuele Bassi <ebassi@linux.intel.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __MNB_CLIPBOARD_PREVIEW_H__
+#define __MNB_CLIPBOARD_PREVIEW_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* the bounds of the text shown for each item; the full contents
+ * are only used when copying an item back into the clipboard
+ */
+#define MNB_CLIPBOARD_PREVIEW_MAX_LINES         (8)
+#define MNB_CLIPBOARD_PREVIEW_MAX_CHARS         (400)
+
+gchar *mnb_clipboard_preview_new (const gchar *text,
+                                  gssize       len,
+                                  guint        max_lines,
+                                  guint        max_chars);
+
+gchar *mnb_clipboard_preview_filter_key (const gchar *text,
+                                         gssize       len);
+
+G_END_DECLS
+
+#endif /* __MNB_CLIPBOARD_PREVIEW_H__ */
@@ -0,0 +1,1103 @@
+/*
+ * Copyright (C) 2008 - 2009 Intel Corporation.
+ *
+ * Author: Emmanuele Bassi <ebassi@linux.intel.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * MnbClipboardProxy: a MnbClipboardStore mirroring the history owned
+ * by the pasteboard daemon
+ *
+ * The proxy does not watch the clipboard; it pulls the previews from
+ * the daemon when the panel is shown and follows the changes only
+ * while it is live, so a hidden panel does not wake up for every copy.
+ * The searches go to the daemon, which has the full texts.
+ *
+ * When the daemon goes away the proxy takes its bus name, and keeps
+ * the history in-process until a daemon replaces it.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "mnb-clipboard-proxy.h"
+#include "mnb-pasteboard-service.h"
+
+#define MNB_CLIPBOARD_PROXY_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), MNB_TYPE_CLIPBOARD_PROXY, MnbClipboardProxyPrivate))
+
+/* number of items requested with each ListItems call */
+#define SYNC_PAGE_SIZE          128
+
+/* the results of a slower search would come too late to be useful */
+#define SEARCH_TIMEOUT          (1000)
+
+typedef struct {
+  MnbClipboardItemType type;
+  gint64 serial;
+  gint64 mtime;
+  gchar *preview;
+  gboolean is_pinned;
+} ProxyItem;
+
+struct _MnbClipboardProxyPrivate
+{
+  GDBusConnection *connection;
+
+  guint changed_id;
+  guint selection_id;
+
+  guint watch_id;
+  guint owner_id;
+
+  /* serves the history while we keep it in-process */
+  MnbPasteboardService *service;
+
+  /* the items received by the sync in progress, newest first; the
+   * pinned items come after the history
+   */
+  GArray *sync_items;
+
+  guint is_live      : 1;
+  guint is_syncing   : 1;
+  guint needs_resync : 1;
+  guint is_local     : 1;
+};
+
+enum
+{
+  PROP_0,
+
+  PROP_CONNECTION
+};
+
+G_DEFINE_TYPE (MnbClipboardProxy, mnb_clipboard_proxy, MNB_TYPE_CLIPBOARD_STORE);
+
+static void mnb_clipboard_proxy_fetch_page   (MnbClipboardProxy *proxy,
+                                              gint64             last_serial);
+static void mnb_clipboard_proxy_fetch_pinned (MnbClipboardProxy *proxy);
+
+static void
+mnb_clipboard_proxy_call (MnbClipboardProxy *proxy,
+                          const gchar       *method_name,
+                          GVariant          *parameters)
+{
+  g_dbus_connection_call (proxy->priv->connection,
+                          MNB_PASTEBOARD_DBUS_NAME,
+                          MNB_PASTEBOARD_DBUS_PATH,
+                          MNB_PASTEBOARD_DBUS_INTERFACE,
+                          method_name,
+                          parameters,
+                          NULL,
+                          G_DBUS_CALL_FLAGS_NONE,
+                          -1,
+                          NULL,
+                          NULL,
+                          NULL);
+}
+
+static void
+mnb_clipboard_proxy_clear_sync_items (MnbClipboardProxy *proxy)
+{
+  MnbClipboardProxyPrivate *priv = proxy->priv;
+  guint i;
+
+  if (priv->sync_items == NULL)
+    return;
+
+  for (i = 0; i < priv->sync_items->len; i++)
+    g_free (g_array_index (priv->sync_items, ProxyItem, i).preview);
+
+  g_array_free (priv->sync_items, TRUE);
+  priv->sync_items = NULL;
+}
+
+static void
+mnb_clipboard_proxy_remove_local (MnbClipboardProxy *proxy,
+                                  const gint64      *serials,
+                                  guint              n_serials)
+{
+  MnbClipboardStoreClass *parent_class;
+
+  parent_class = MNB_CLIPBOARD_STORE_CLASS (mnb_clipboard_proxy_parent_class);
+  parent_class->remove_items (MNB_CLIPBOARD_STORE (proxy), serials, n_serials);
+}
+
+/* removes every row, mirrored or captured */
+static void
+mnb_clipboard_proxy_drop_local (MnbClipboardProxy *proxy)
+{
+  MnbClipboardStore *store = MNB_CLIPBOARD_STORE (proxy);
+  GArray *serials;
+  guint i, n_items, n_pinned;
+
+  n_items = mnb_clipboard_store_get_n_items (store);
+  n_pinned = mnb_clipboard_store_get_n_pinned (store);
+  serials = g_array_sized_new (FALSE, FALSE, sizeof (gint64),
+                               n_items + n_pinned);
+
+  for (i = 0; i < n_items; i++)
+    {
+      gint64 serial = 0;
+
+      if (mnb_clipboard_store_get_row (store, i,
+                                       NULL, &serial, NULL, NULL, NULL))
+        g_array_append_val (serials, serial);
+    }
+
+  for (i = 0; i < n_pinned; i++)
+    {
+      gint64 serial = 0;
+
+      if (mnb_clipboard_store_get_pinned_row (store, i,
+                                              NULL, &serial, NULL, NULL))
+        g_array_append_val (serials, serial);
+    }
+
+  mnb_clipboard_proxy_remove_local (proxy,
+                                    (const gint64 *) serials->data,
+                                    serials->len);
+
+  g_array_free (serials, TRUE);
+}
+
+static void
+mnb_clipboard_proxy_update_local (MnbClipboardProxy *proxy,
+                                  ProxyItem         *item)
+{
+  MnbClipboardStore *store = MNB_CLIPBOARD_STORE (proxy);
+
+  if (!mnb_clipboard_store_get_item (store, item->serial,
+                                     NULL, NULL, NULL, NULL))
+    mnb_clipboard_store_add_item (store,
+                                  item->type,
+                                  item->serial,
+                                  item->mtime,
+                                  NULL,
+                                  item->preview);
+
+  /* the daemon owns the pinned file: only follow it */
+  mnb_clipboard_store_mirror_pinned (store, item->serial, item->is_pinned);
+}
+
+static void
+proxy_item_from_variant (ProxyItem *item,
+                         GVariant  *variant)
+{
+  gint item_type = 0;
+
+  g_variant_get (variant, "(ixxsb)",
+                 &item_type,
+                 &item->serial,
+                 &item->mtime,
+                 &item->preview,
+                 &item->is_pinned);
+
+  item->type = item_type;
+}
+
+/* only the rows the daemon dropped are removed, and only the items
+ * we do not have yet are added; since the new items are prepended,
+ * the history is rebuilt whole in the unlikely case that one of them
+ * is older than a row we keep
+ */
+static void
+mnb_clipboard_proxy_apply_sync (MnbClipboardProxy *proxy)
+{
+  MnbClipboardStore *store = MNB_CLIPBOARD_STORE (proxy);
+  MnbClipboardProxyPrivate *priv = proxy->priv;
+  GHashTable *synced;
+  GArray *local, *stale;
+  guint n_items, n_pinned;
+  gint64 newest_kept = 0;
+  gboolean in_order = TRUE;
+  gint i;
+
+  n_items = mnb_clipboard_store_get_n_items (store);
+  n_pinned = mnb_clipboard_store_get_n_pinned (store);
+  local = g_array_sized_new (FALSE, FALSE, sizeof (gint64),
+                             n_items + n_pinned);
+  stale = g_array_new (FALSE, FALSE, sizeof (gint64));
+
+  synced = g_hash_table_new (g_int64_hash, g_int64_equal);
+  for (i = 0; i < (gint) priv->sync_items->len; i++)
+    {
+      ProxyItem *item = &g_array_index (priv->sync_items, ProxyItem, i);
+
+      g_hash_table_insert (synced, &item->serial, item);
+    }
+
+  for (i = 0; i < (gint) n_items; i++)
+    {
+      gint64 serial = 0;
+
+      if (!mnb_clipboard_store_get_row (store, i,
+                                        NULL, &serial, NULL, NULL, NULL))
+        continue;
+
+      g_array_append_val (local, serial);
+
+      if (g_hash_table_lookup (synced, &serial) == NULL)
+        g_array_append_val (stale, serial);
+      else if (serial > newest_kept)
+        newest_kept = serial;
+    }
+
+  for (i = 0; i < (gint) n_pinned; i++)
+    {
+      gint64 serial = 0;
+
+      if (!mnb_clipboard_store_get_pinned_row (store, i,
+                                               NULL, &serial, NULL, NULL))
+        continue;
+
+      g_array_append_val (local, serial);
+
+      if (g_hash_table_lookup (synced, &serial) == NULL)
+        g_array_append_val (stale, serial);
+    }
+
+  for (i = 0; i < (gint) priv->sync_items->len && in_order; i++)
+    {
+      ProxyItem *item = &g_array_index (priv->sync_items, ProxyItem, i);
+
+      if (!item->is_pinned && item->serial < newest_kept &&
+          !mnb_clipboard_store_get_item (store, item->serial,
+                                         NULL, NULL, NULL, NULL))
+        in_order = FALSE;
+    }
+
+  g_hash_table_destroy (synced);
+
+  mnb_clipboard_store_begin_update (store);
+
+  if (in_order)
+    mnb_clipboard_proxy_remove_local (proxy,
+                                      (const gint64 *) stale->data,
+                                      stale->len);
+  else
+    mnb_clipboard_proxy_remove_local (proxy,
+                                      (const gint64 *) local->data,
+                                      local->len);
+
+  g_array_free (stale, TRUE);
+  g_array_free (local, TRUE);
+
+  /* the daemon sends the newest first, and we prepend; the items we
+   * already have only get their pinned state updated
+   */
+  for (i = priv->sync_items->len - 1; i >= 0; i--)
+    mnb_clipboard_proxy_update_local (proxy,
+                                      &g_array_index (priv->sync_items,
+                                                      ProxyItem,
+                                                      i));
+
+  mnb_clipboard_store_end_update (store);
+}
+
+/* appends the items of a ListItems or ListPinned reply to the sync */
+static guint
+mnb_clipboard_proxy_append_sync_items (MnbClipboardProxy *proxy,
+                                       GVariant          *reply,
+                                       gint64            *last_serial)
+{
+  MnbClipboardProxyPrivate *priv = proxy->priv;
+  GVariant *items, *child;
+  GVariantIter iter;
+  guint n_items = 0;
+
+  items = g_variant_get_child_value (reply, 0);
+  g_variant_iter_init (&iter, items);
+  while ((child = g_variant_iter_next_value (&iter)) != NULL)
+    {
+      ProxyItem item;
+
+      proxy_item_from_variant (&item, child);
+      *last_serial = item.serial;
+
+      g_array_append_val (priv->sync_items, item);
+      g_variant_unref (child);
+
+      n_items += 1;
+    }
+
+  g_variant_unref (items);
+
+  return n_items;
+}
+
+/* the history changed under us; start over */
+static void
+mnb_clipboard_proxy_restart_sync (MnbClipboardProxy *proxy)
+{
+  MnbClipboardProxyPrivate *priv = proxy->priv;
+
+  priv->needs_resync = FALSE;
+  mnb_clipboard_proxy_clear_sync_items (proxy);
+  priv->sync_items = g_array_new (FALSE, FALSE, sizeof (ProxyItem));
+  mnb_clipboard_proxy_fetch_page (proxy, 0);
+}
+
+static void
+on_get_items_reply (GObject      *source,
+                    GAsyncResult *result,
+                    gpointer      user_data)
+{
+  MnbClipboardProxy *proxy = user_data;
+  MnbClipboardProxyPrivate *priv = proxy->priv;
+  GVariant *reply;
+  GError *error = NULL;
+  gint64 last_serial = 0;
+  guint n_items;
+
+  reply = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source),
+                                         result,
+                                         &error);
+  if (reply == NULL)
+    {
+      g_warning ("Unable to retrieve the pasteboard history: %s",
+                 error->message);
+      g_error_free (error);
+
+      mnb_clipboard_proxy_clear_sync_items (proxy);
+      priv->is_syncing = FALSE;
+      priv->needs_resync = FALSE;
+
+      g_object_unref (proxy);
+      return;
+    }
+
+  n_items = mnb_clipboard_proxy_append_sync_items (proxy, reply, &last_serial);
+  g_variant_unref (reply);
+
+  if (priv->is_local)
+    {
+      mnb_clipboard_proxy_clear_sync_items (proxy);
+      priv->is_syncing = FALSE;
+      priv->needs_resync = FALSE;
+    }
+  else if (priv->needs_resync)
+    mnb_clipboard_proxy_restart_sync (proxy);
+  else if (n_items == SYNC_PAGE_SIZE && last_serial > 1)
+    mnb_clipboard_proxy_fetch_page (proxy, last_serial - 1);
+  else
+    mnb_clipboard_proxy_fetch_pinned (proxy);
+
+  g_object_unref (proxy);
+}
+
+static void
+on_list_pinned_reply (GObject      *source,
+                      GAsyncResult *result,
+                      gpointer      user_data)
+{
+  MnbClipboardProxy *proxy = user_data;
+  MnbClipboardProxyPrivate *priv = proxy->priv;
+  GVariant *reply;
+  GError *error = NULL;
+  gint64 last_serial = 0;
+
+  reply = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source),
+                                         result,
+                                         &error);
+  if (reply == NULL)
+    {
+      g_warning ("Unable to retrieve the pinned items: %s",
+                 error->message);
+      g_error_free (error);
+
+      mnb_clipboard_proxy_clear_sync_items (proxy);
+      priv->is_syncing = FALSE;
+      priv->needs_resync = FALSE;
+
+      g_object_unref (proxy);
+      return;
+    }
+
+  mnb_clipboard_proxy_append_sync_items (proxy, reply, &last_serial);
+  g_variant_unref (reply);
+
+  if (priv->needs_resync && !priv->is_local)
+    mnb_clipboard_proxy_restart_sync (proxy);
+  else
+    {
+      if (!priv->is_local)
+        mnb_clipboard_proxy_apply_sync (proxy);
+
+      mnb_clipboard_proxy_clear_sync_items (proxy);
+      priv->is_syncing = FALSE;
+    }
+
+  g_object_unref (proxy);
+}
+
+/* pages go from the newest item to the oldest; a @last_serial of 0
+ * starts from the newest
+ */
+static void
+mnb_clipboard_proxy_fetch_page (MnbClipboardProxy *proxy,
+                                gint64             last_serial)
+{
+  g_dbus_connection_call (proxy->priv->connection,
+                          MNB_PASTEBOARD_DBUS_NAME,
+                          MNB_PASTEBOARD_DBUS_PATH,
+                          MNB_PASTEBOARD_DBUS_INTERFACE,
+                          "ListItems",
+                          g_variant_new ("(xxu)",
+                                         (gint64) 0,
+                                         last_serial,
+                                         SYNC_PAGE_SIZE),
+                          G_VARIANT_TYPE ("(a(ixxsb))"),
+                          G_DBUS_CALL_FLAGS_NONE,
+                          -1,
+                          NULL,
+                          on_get_items_reply,
+                          g_object_ref (proxy));
+}
+
+/* the pinned items come last, once the whole history is in */
+static void
+mnb_clipboard_proxy_fetch_pinned (MnbClipboardProxy *proxy)
+{
+  g_dbus_connection_call (proxy->priv->connection,
+                          MNB_PASTEBOARD_DBUS_NAME,
+                          MNB_PASTEBOARD_DBUS_PATH,
+                          MNB_PASTEBOARD_DBUS_INTERFACE,
+                          "ListPinned",
+                          NULL,
+                          G_VARIANT_TYPE ("(a(ixxsb))"),
+                          G_DBUS_CALL_FLAGS_NONE,
+                          -1,
+                          NULL,
+                          on_list_pinned_reply,
+                          g_object_ref (proxy));
+}
+
+static void
+on_get_selection_reply (GObject      *source,
+                        GAsyncResult *result,
+                        gpointer      user_data)
+{
+  MnbClipboardStore *store = user_data;
+  GVariant *reply;
+  GError *error = NULL;
+
+  reply = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source),
+                                         result,
+                                         &error);
+  if (reply == NULL)
+    {
+      g_warning ("Unable to retrieve the selection: %s", error->message);
+      g_error_free (error);
+    }
+  else if (!MNB_CLIPBOARD_PROXY (store)->priv->is_local)
+    {
+      const gchar *preview = NULL;
+
+      g_variant_get (reply, "(&s)", &preview);
+      mnb_clipboard_store_set_selection (store,
+                                         *preview != '\0' ? preview : NULL);
+
+      g_variant_unref (reply);
+    }
+
+  g_object_unref (store);
+}
+
+static void
+on_items_changed (GDBusConnection *connection,
+                  const gchar     *sender_name,
+                  const gchar     *object_path,
+                  const gchar     *interface_name,
+                  const gchar     *signal_name,
+                  GVariant        *parameters,
+                  gpointer         user_data)
+{
+  MnbClipboardProxy *proxy = user_data;
+  MnbClipboardProxyPrivate *priv = proxy->priv;
+  GVariant *items, *removed;
+  const gint64 *serials;
+  gsize n_serials = 0;
+  gint i;
+
+  /* while we own the history, the signals are our own */
+  if (!priv->is_live || priv->is_local)
+    return;
+
+  if (priv->is_syncing)
+    {
+      priv->needs_resync = TRUE;
+      return;
+    }
+
+  items = g_variant_get_child_value (parameters, 0);
+  removed = g_variant_get_child_value (parameters, 1);
+
+  mnb_clipboard_store_begin_update (MNB_CLIPBOARD_STORE (proxy));
+
+  serials = g_variant_get_fixed_array (removed, &n_serials, sizeof (gint64));
+  if (n_serials > 0)
+    mnb_clipboard_proxy_remove_local (proxy, serials, n_serials);
+
+  /* newest first, and we prepend */
+  for (i = (gint) g_variant_n_children (items) - 1; i >= 0; i--)
+    {
+      GVariant *child = g_variant_get_child_value (items, i);
+      ProxyItem item;
+
+      proxy_item_from_variant (&item, child);
+      mnb_clipboard_proxy_update_local (proxy, &item);
+
+      g_free (item.preview);
+      g_variant_unref (child);
+    }
+
+  mnb_clipboard_store_end_update (MNB_CLIPBOARD_STORE (proxy));
+
+  g_variant_unref (items);
+  g_variant_unref (removed);
+}
+
+static void
+on_selection_changed (GDBusConnection *connection,
+                      const gchar     *sender_name,
+                      const gchar     *object_path,
+                      const gchar     *interface_name,
+                      const gchar     *signal_name,
+                      GVariant        *parameters,
+                      gpointer         user_data)
+{
+  MnbClipboardStore *store = user_data;
+  const gchar *preview = NULL;
+
+  if (MNB_CLIPBOARD_PROXY (store)->priv->is_local)
+    return;
+
+  g_variant_get (parameters, "(&s)", &preview);
+
+  mnb_clipboard_store_set_selection (store,
+                                     *preview != '\0' ? preview : NULL);
+}
+
+static guint
+mnb_clipboard_proxy_subscribe (MnbClipboardProxy   *proxy,
+                               const gchar         *signal_name,
+                               GDBusSignalCallback  callback)
+{
+  return g_dbus_connection_signal_subscribe (proxy->priv->connection,
+                                             MNB_PASTEBOARD_DBUS_NAME,
+                                             MNB_PASTEBOARD_DBUS_INTERFACE,
+                                             signal_name,
+                                             MNB_PASTEBOARD_DBUS_PATH,
+                                             NULL,
+                                             G_DBUS_SIGNAL_FLAGS_NONE,
+                                             callback,
+                                             proxy,
+                                             NULL);
+}
+
+static void
+mnb_clipboard_proxy_remove_items (MnbClipboardStore *store,
+                                  const gint64      *serials,
+                                  guint              n_serials)
+{
+  GVariantBuilder builder;
+  guint i;
+
+  if (MNB_CLIPBOARD_PROXY (store)->priv->is_local)
+    {
+      mnb_clipboard_proxy_remove_local (MNB_CLIPBOARD_PROXY (store),
+                                        serials,
+                                        n_serials);
+      return;
+    }
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("ax"));
+  for (i = 0; i < n_serials; i++)
+    g_variant_builder_add (&builder, "x", serials[i]);
+
+  /* the rows go away when the daemon emits ItemsChanged */
+  mnb_clipboard_proxy_call (MNB_CLIPBOARD_PROXY (store), "RemoveItems",
+                            g_variant_new ("(ax)", &builder));
+}
+
+static void
+mnb_clipboard_proxy_clear (MnbClipboardStore *store)
+{
+  if (MNB_CLIPBOARD_PROXY (store)->priv->is_local)
+    MNB_CLIPBOARD_STORE_CLASS (mnb_clipboard_proxy_parent_class)->clear (store);
+  else
+    mnb_clipboard_proxy_call (MNB_CLIPBOARD_PROXY (store), "Clear", NULL);
+}
+
+static void
+mnb_clipboard_proxy_copy_back (MnbClipboardStore *store,
+                               gint64             serial)
+{
+  if (MNB_CLIPBOARD_PROXY (store)->priv->is_local)
+    MNB_CLIPBOARD_STORE_CLASS (mnb_clipboard_proxy_parent_class)->copy_back (store,
+                                                                             serial);
+  else
+    mnb_clipboard_proxy_call (MNB_CLIPBOARD_PROXY (store), "CopyBack",
+                              g_variant_new ("(x)", serial));
+}
+
+static void
+mnb_clipboard_proxy_save_selection (MnbClipboardStore *store)
+{
+  if (MNB_CLIPBOARD_PROXY (store)->priv->is_local)
+    MNB_CLIPBOARD_STORE_CLASS (mnb_clipboard_proxy_parent_class)->save_selection (store);
+  else
+    mnb_clipboard_proxy_call (MNB_CLIPBOARD_PROXY (store), "SaveSelection",
+                              NULL);
+}
+
+static void
+mnb_clipboard_proxy_set_pinned (MnbClipboardStore *store,
+                                gint64             serial,
+                                gboolean           is_pinned)
+{
+  if (MNB_CLIPBOARD_PROXY (store)->priv->is_local)
+    MNB_CLIPBOARD_STORE_CLASS (mnb_clipboard_proxy_parent_class)->set_pinned (store,
+                                                                              serial,
+                                                                              is_pinned);
+  else
+    mnb_clipboard_proxy_call (MNB_CLIPBOARD_PROXY (store), "Pin",
+                              g_variant_new ("(xb)", serial, is_pinned));
+}
+
+typedef struct {
+  MnbClipboardProxy *proxy;
+  gchar *filter;
+
+  GCancellable *cancellable;
+  MnbClipboardMatchFunc func;
+  gpointer user_data;
+} MatchClosure;
+
+static void
+match_closure_free (MatchClosure *closure)
+{
+  g_object_unref (closure->proxy);
+  g_free (closure->filter);
+
+  if (closure->cancellable != NULL)
+    g_object_unref (closure->cancellable);
+
+  g_slice_free (MatchClosure, closure);
+}
+
+static void
+on_search_reply (GObject      *source,
+                 GAsyncResult *result,
+                 gpointer      user_data)
+{
+  MatchClosure *closure = user_data;
+  MnbClipboardStore *store = MNB_CLIPBOARD_STORE (closure->proxy);
+  GVariant *reply, *serials;
+  GError *error = NULL;
+  const gint64 *data;
+  gsize n_serials = 0;
+  GArray *res;
+
+  reply = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source),
+                                         result,
+                                         &error);
+
+  /* a newer search took over */
+  if (g_cancellable_is_cancelled (closure->cancellable))
+    {
+      if (reply != NULL)
+        g_variant_unref (reply);
+
+      g_clear_error (&error);
+      match_closure_free (closure);
+      return;
+    }
+
+  if (reply == NULL)
+    {
+      /* the previews are better than nothing */
+      g_warning ("Unable to search the pasteboard: %s", error->message);
+      g_error_free (error);
+
+      res = MNB_CLIPBOARD_STORE_CLASS (mnb_clipboard_proxy_parent_class)->match (store,
+                                                                                   closure->filter);
+    }
+  else
+    {
+      serials = g_variant_get_child_value (reply, 0);
+      data = g_variant_get_fixed_array (serials, &n_serials, sizeof (gint64));
+
+      res = g_array_sized_new (FALSE, FALSE, sizeof (gint64), n_serials);
+      g_array_append_vals (res, data, n_serials);
+
+      g_variant_unref (serials);
+      g_variant_unref (reply);
+    }
+
+  closure->func (store, res, closure->user_data);
+
+  g_array_free (res, TRUE);
+  match_closure_free (closure);
+}
+
+/* the rows only hold the previews, so the daemon searches the texts;
+ * the panel keeps running meanwhile
+ */
+static void
+mnb_clipboard_proxy_match_async (MnbClipboardStore     *store,
+                                 const gchar           *filter,
+                                 GCancellable          *cancellable,
+                                 MnbClipboardMatchFunc  func,
+                                 gpointer               user_data)
+{
+  MnbClipboardProxy *proxy = MNB_CLIPBOARD_PROXY (store);
+  MatchClosure *closure;
+
+  if (proxy->priv->is_local)
+    {
+      MNB_CLIPBOARD_STORE_CLASS (mnb_clipboard_proxy_parent_class)->match_async (store,
+                                                                                   filter,
+                                                                                   cancellable,
+                                                                                   func,
+                                                                                   user_data);
+      return;
+    }
+
+  closure = g_slice_new (MatchClosure);
+  closure->proxy = g_object_ref (proxy);
+  closure->filter = g_strdup (filter);
+  closure->cancellable = cancellable != NULL ? g_object_ref (cancellable)
+                                             : NULL;
+  closure->func = func;
+  closure->user_data = user_data;
+
+  g_dbus_connection_call (proxy->priv->connection,
+                          MNB_PASTEBOARD_DBUS_NAME,
+                          MNB_PASTEBOARD_DBUS_PATH,
+                          MNB_PASTEBOARD_DBUS_INTERFACE,
+                          "Search",
+                          g_variant_new ("(su)",
+                                         filter,
+                                         mnb_clipboard_store_get_n_items (store) +
+                                         mnb_clipboard_store_get_n_pinned (store)),
+                          G_VARIANT_TYPE ("(ax)"),
+                          G_DBUS_CALL_FLAGS_NONE,
+                          SEARCH_TIMEOUT,
+                          cancellable,
+                          on_search_reply,
+                          closure);
+}
+
+/* we own the history until a daemon replaces us */
+static void
+on_name_acquired (GDBusConnection *connection,
+                  const gchar     *name,
+                  gpointer         user_data)
+{
+  MnbClipboardProxy *proxy = user_data;
+  MnbClipboardProxyPrivate *priv = proxy->priv;
+  GError *error = NULL;
+
+  g_debug (G_STRLOC ": Keeping the pasteboard history in-process");
+
+  priv->is_local = TRUE;
+
+  mnb_clipboard_store_begin_update (MNB_CLIPBOARD_STORE (proxy));
+  mnb_clipboard_proxy_drop_local (proxy);
+  mnb_clipboard_store_start_capture (MNB_CLIPBOARD_STORE (proxy));
+  mnb_clipboard_store_end_update (MNB_CLIPBOARD_STORE (proxy));
+
+  priv->service = mnb_pasteboard_service_new (MNB_CLIPBOARD_STORE (proxy));
+  if (!mnb_pasteboard_service_register (priv->service, connection, &error))
+    {
+      g_warning ("Unable to export the pasteboard: %s", error->message);
+      g_clear_error (&error);
+    }
+}
+
+static void
+on_name_lost (GDBusConnection *connection,
+              const gchar     *name,
+              gpointer         user_data)
+{
+  MnbClipboardProxy *proxy = user_data;
+  MnbClipboardProxyPrivate *priv = proxy->priv;
+
+  g_bus_unown_name (priv->owner_id);
+  priv->owner_id = 0;
+
+  if (!priv->is_local)
+    return;
+
+  g_debug (G_STRLOC ": Using the history of the pasteboard daemon");
+
+  mnb_pasteboard_service_unregister (priv->service);
+  g_object_unref (priv->service);
+  priv->service = NULL;
+
+  mnb_clipboard_store_stop_capture (MNB_CLIPBOARD_STORE (proxy));
+
+  priv->is_local = FALSE;
+
+  mnb_clipboard_store_begin_update (MNB_CLIPBOARD_STORE (proxy));
+  mnb_clipboard_proxy_drop_local (proxy);
+  mnb_clipboard_store_end_update (MNB_CLIPBOARD_STORE (proxy));
+
+  if (priv->is_live)
+    mnb_clipboard_proxy_sync (proxy);
+}
+
+/* the daemon is gone: we try to take over its name, and with it the
+ * history; a daemon started later replaces us
+ */
+static void
+on_name_vanished (GDBusConnection *connection,
+                  const gchar     *name,
+                  gpointer         user_data)
+{
+  MnbClipboardProxy *proxy = user_data;
+  MnbClipboardProxyPrivate *priv = proxy->priv;
+
+  if (priv->owner_id != 0)
+    return;
+
+  priv->owner_id =
+    g_bus_own_name_on_connection (connection,
+                                  MNB_PASTEBOARD_DBUS_NAME,
+                                  G_BUS_NAME_OWNER_FLAGS_ALLOW_REPLACEMENT,
+                                  on_name_acquired,
+                                  on_name_lost,
+                                  proxy,
+                                  NULL);
+}
+
+static void
+mnb_clipboard_proxy_set_property (GObject      *gobject,
+                                  guint         prop_id,
+                                  const GValue *value,
+                                  GParamSpec   *pspec)
+{
+  MnbClipboardProxyPrivate *priv = MNB_CLIPBOARD_PROXY (gobject)->priv;
+
+  switch (prop_id)
+    {
+    case PROP_CONNECTION:
+      priv->connection = g_value_dup_object (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (gobject, prop_id, pspec);
+      break;
+    }
+}
+
+static void
+mnb_clipboard_proxy_get_property (GObject    *gobject,
+                                  guint       prop_id,
+                                  GValue     *value,
+                                  GParamSpec *pspec)
+{
+  MnbClipboardProxyPrivate *priv = MNB_CLIPBOARD_PROXY (gobject)->priv;
+
+  switch (prop_id)
+    {
+    case PROP_CONNECTION:
+      g_value_set_object (value, priv->connection);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (gobject, prop_id, pspec);
+      break;
+    }
+}
+
+static void
+mnb_clipboard_proxy_constructed (GObject *gobject)
+{
+  MnbClipboardProxy *proxy = MNB_CLIPBOARD_PROXY (gobject);
+  MnbClipboardProxyPrivate *priv = proxy->priv;
+
+  if (G_OBJECT_CLASS (mnb_clipboard_proxy_parent_class)->constructed)
+    G_OBJECT_CLASS (mnb_clipboard_proxy_parent_class)->constructed (gobject);
+
+  g_assert (priv->connection != NULL);
+
+  priv->changed_id =
+    mnb_clipboard_proxy_subscribe (proxy, "ItemsChanged", on_items_changed);
+  priv->selection_id =
+    mnb_clipboard_proxy_subscribe (proxy, "SelectionChanged",
+                                   on_selection_changed);
+
+  priv->watch_id =
+    g_bus_watch_name_on_connection (priv->connection,
+                                    MNB_PASTEBOARD_DBUS_NAME,
+                                    G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                    NULL,
+                                    on_name_vanished,
+                                    proxy,
+                                    NULL);
+}
+
+static void
+mnb_clipboard_proxy_dispose (GObject *gobject)
+{
+  MnbClipboardProxy *proxy = MNB_CLIPBOARD_PROXY (gobject);
+  MnbClipboardProxyPrivate *priv = proxy->priv;
+
+  if (priv->watch_id != 0)
+    {
+      g_bus_unwatch_name (priv->watch_id);
+      priv->watch_id = 0;
+    }
+
+  if (priv->owner_id != 0)
+    {
+      g_bus_unown_name (priv->owner_id);
+      priv->owner_id = 0;
+    }
+
+  if (priv->service != NULL)
+    {
+      mnb_pasteboard_service_unregister (priv->service);
+      g_object_unref (priv->service);
+      priv->service = NULL;
+    }
+
+  if (priv->connection != NULL)
+    {
+      g_dbus_connection_signal_unsubscribe (priv->connection, priv->changed_id);
+      g_dbus_connection_signal_unsubscribe (priv->connection, priv->selection_id);
+
+      g_object_unref (priv->connection);
+      priv->connection = NULL;
+    }
+
+  mnb_clipboard_proxy_clear_sync_items (proxy);
+
+  G_OBJECT_CLASS (mnb_clipboard_proxy_parent_class)->dispose (gobject);
+}
+
+static void
+mnb_clipboard_proxy_class_init (MnbClipboardProxyClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  MnbClipboardStoreClass *store_class = MNB_CLIPBOARD_STORE_CLASS (klass);
+  GParamSpec *pspec;
+
+  g_type_class_add_private (klass, sizeof (MnbClipboardProxyPrivate));
+
+  gobject_class->set_property = mnb_clipboard_proxy_set_property;
+  gobject_class->get_property = mnb_clipboard_proxy_get_property;
+  gobject_class->constructed = mnb_clipboard_proxy_constructed;
+  gobject_class->dispose = mnb_clipboard_proxy_dispose;
+
+  store_class->remove_items = mnb_clipboard_proxy_remove_items;
+  store_class->clear = mnb_clipboard_proxy_clear;
+  store_class->copy_back = mnb_clipboard_proxy_copy_back;
+  store_class->save_selection = mnb_clipboard_proxy_save_selection;
+  store_class->set_pinned = mnb_clipboard_proxy_set_pinned;
+  store_class->match_async = mnb_clipboard_proxy_match_async;
+
+  pspec = g_param_spec_object ("connection",
+                               "Connection",
+                               "The connection to the pasteboard daemon",
+                               G_TYPE_DBUS_CONNECTION,
+                               G_PARAM_READWRITE |
+                               G_PARAM_CONSTRUCT_ONLY);
+  g_object_class_install_property (gobject_class, PROP_CONNECTION, pspec);
+}
+
+static void
+mnb_clipboard_proxy_init (MnbClipboardProxy *self)
+{
+  self->priv = MNB_CLIPBOARD_PROXY_GET_PRIVATE (self);
+}
+
+MnbClipboardStore *
+mnb_clipboard_proxy_new (GDBusConnection *connection)
+{
+  g_return_val_if_fail (G_IS_DBUS_CONNECTION (connection), NULL);
+
+  return g_object_new (MNB_TYPE_CLIPBOARD_PROXY,
+                       "capture", FALSE,
+                       "connection", connection,
+                       NULL);
+}
+
+/*
+ * mnb_clipboard_proxy_sync:
+ * @proxy: a #MnbClipboardProxy
+ *
+ * Replaces the contents of @proxy with the history of the daemon, and
+ * follows its changes until mnb_clipboard_proxy_release() is called.
+ */
+void
+mnb_clipboard_proxy_sync (MnbClipboardProxy *proxy)
+{
+  MnbClipboardProxyPrivate *priv;
+
+  g_return_if_fail (MNB_IS_CLIPBOARD_PROXY (proxy));
+
+  priv = proxy->priv;
+
+  priv->is_live = TRUE;
+
+  /* the history is ours, there is nothing to pull */
+  if (priv->is_local)
+    return;
+
+  if (priv->is_syncing)
+    {
+      priv->needs_resync = TRUE;
+      return;
+    }
+
+  priv->is_syncing = TRUE;
+  priv->needs_resync = FALSE;
+  priv->sync_items = g_array_new (FALSE, FALSE, sizeof (ProxyItem));
+
+  mnb_clipboard_proxy_fetch_page (proxy, 0);
+
+  g_dbus_connection_call (priv->connection,
+                          MNB_PASTEBOARD_DBUS_NAME,
+                          MNB_PASTEBOARD_DBUS_PATH,
+                          MNB_PASTEBOARD_DBUS_INTERFACE,
+                          "GetSelection",
+                          NULL,
+                          G_VARIANT_TYPE ("(s)"),
+                          G_DBUS_CALL_FLAGS_NONE,
+                          -1,
+                          NULL,
+                          on_get_selection_reply,
+                          g_object_ref (proxy));
+}
+
+/*
+ * mnb_clipboard_proxy_release:
+ * @proxy: a #MnbClipboardProxy
+ *
+ * Stops following the changes of the history; the contents of @proxy
+ * are refreshed by the next call to mnb_clipboard_proxy_sync().
+ */
+void
+mnb_clipboard_proxy_release (MnbClipboardProxy *proxy)
+{
+  g_return_if_fail (MNB_IS_CLIPBOARD_PROXY (proxy));
+
+  proxy->priv->is_live = FALSE;
+}
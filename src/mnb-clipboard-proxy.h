@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2008 - 2009 Intel Corporation.
+ *
+ * Author: Emmanuele Bassi <ebassi@linux.intel.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __MNB_CLIPBOARD_PROXY_H__
+#define __MNB_CLIPBOARD_PROXY_H__
+
+#include <gio/gio.h>
+#include "mnb-clipboard-store.h"
+
+G_BEGIN_DECLS
+
+#define MNB_TYPE_CLIPBOARD_PROXY                (mnb_clipboard_proxy_get_type ())
+#define MNB_CLIPBOARD_PROXY(obj)                (G_TYPE_CHECK_INSTANCE_CAST ((obj), MNB_TYPE_CLIPBOARD_PROXY, MnbClipboardProxy))
+#define MNB_IS_CLIPBOARD_PROXY(obj)             (G_TYPE_CHECK_INSTANCE_TYPE ((obj), MNB_TYPE_CLIPBOARD_PROXY))
+#define MNB_CLIPBOARD_PROXY_CLASS(klass)        (G_TYPE_CHECK_CLASS_CAST ((klass), MNB_TYPE_CLIPBOARD_PROXY, MnbClipboardProxyClass))
+#define MNB_IS_CLIPBOARD_PROXY_CLASS(klass)     (G_TYPE_CHECK_CLASS_TYPE ((klass), MNB_TYPE_CLIPBOARD_PROXY))
+#define MNB_CLIPBOARD_PROXY_GET_CLASS(obj)      (G_TYPE_INSTANCE_GET_CLASS ((obj), MNB_TYPE_CLIPBOARD_PROXY, MnbClipboardProxyClass))
+
+typedef struct _MnbClipboardProxy               MnbClipboardProxy;
+typedef struct _MnbClipboardProxyPrivate        MnbClipboardProxyPrivate;
+typedef struct _MnbClipboardProxyClass          MnbClipboardProxyClass;
+
+struct _MnbClipboardProxy
+{
+  MnbClipboardStore parent_instance;
+
+  MnbClipboardProxyPrivate *priv;
+};
+
+struct _MnbClipboardProxyClass
+{
+  MnbClipboardStoreClass parent_class;
+};
+
+GType mnb_clipboard_proxy_get_type (void) G_GNUC_CONST;
+
+MnbClipboardStore *mnb_clipboard_proxy_new (GDBusConnection *connection);
+
+void mnb_clipboard_proxy_sync    (MnbClipboardProxy *proxy);
+void mnb_clipboard_proxy_release (MnbClipboardProxy *proxy);
+
+G_END_DECLS
+
+#endif /* __MNB_CLIPBOARD_PROXY_H__ */
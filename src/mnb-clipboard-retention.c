@@ -0,0 +1,371 @@
+/*
+ * Copyright (C) 2008 - 2009 Intel Corporation.
+ *
+ * Author: Emmanuele Bassi <ebassi@linux.intel.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * MnbClipboardRetention: how long, and how much, history we keep
+ *
+ * The policy is read from a key file like:
+ *
+ *   [Retention]
+ *   MaxItems=200
+ *   MaxBytes=4194304
+ *
+ *   [Text]
+ *   MaxAge=7200
+ *   MaxFetchSize=16777216
+ *
+ *   [URIs]
+ *   MaxAge=7200
+ *
+ *   [Images]
+ *   MaxAge=1800
+ *
+ *   [Sources]
+ *   MaxRate=30
+ *   MaxItems=50
+ *
+ * where the ages are in seconds, and zero or a missing key means no
+ * limit. A copied text longer than MaxFetchSize bytes is cut, and
+ * kept as truncated. An application may copy at most MaxRate times a
+ * minute, and keep at most MaxItems items in the history; the oldest
+ * of its items make room for the new ones. Pinned items are kept apart from the history: they never
+ * expire and do not count against the caps. The file is watched, and
+ * ::changed is emitted when the policy it holds changes.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <gio/gio.h>
+
+#include "mnb-clipboard-retention.h"
+#include "mnb-clipboard-store.h"
+#include "mnb-pasteboard-marshal.h"
+
+#define N_ITEM_TYPES    (MNB_CLIPBOARD_ITEM_IMAGE + 1)
+
+/* the history used to be kept for two hours, with no other limit */
+#define DEFAULT_MAX_AGE (60 * 60 * 2)
+
+/* a bigger copy is most likely a mistake */
+#define DEFAULT_MAX_FETCH_SIZE  (16 * 1024 * 1024)
+
+typedef struct {
+  gint64 max_age[N_ITEM_TYPES];
+  guint max_items;
+  gsize max_bytes;
+  gsize max_fetch_size;
+  guint max_source_rate;
+  guint max_source_items;
+} Policy;
+
+struct _MnbClipboardRetentionPrivate
+{
+  GFile *file;
+  GFileMonitor *monitor;
+
+  Policy policy;
+};
+
+enum
+{
+  CHANGED,
+
+  LAST_SIGNAL
+};
+
+G_DEFINE_TYPE (MnbClipboardRetention, mnb_clipboard_retention, G_TYPE_OBJECT);
+
+#define MNB_CLIPBOARD_RETENTION_GET_PRIVATE(obj)        (G_TYPE_INSTANCE_GET_PRIVATE ((obj), MNB_TYPE_CLIPBOARD_RETENTION, MnbClipboardRetentionPrivate))
+
+static guint retention_signals[LAST_SIGNAL] = { 0, };
+
+static const gchar *type_groups[N_ITEM_TYPES] = {
+  NULL,         /* MNB_CLIPBOARD_ITEM_INVALID */
+  "Text",       /* MNB_CLIPBOARD_ITEM_TEXT */
+  "URIs",       /* MNB_CLIPBOARD_ITEM_URIS */
+  "Images"      /* MNB_CLIPBOARD_ITEM_IMAGE */
+};
+
+static void
+policy_init_defaults (Policy *policy)
+{
+  gint i;
+
+  /* the policies are compared with memcmp(), padding included */
+  memset (policy, 0, sizeof (Policy));
+
+  for (i = MNB_CLIPBOARD_ITEM_TEXT; i < N_ITEM_TYPES; i++)
+    policy->max_age[i] = DEFAULT_MAX_AGE;
+
+  policy->max_items = 0;
+  policy->max_bytes = 0;
+  policy->max_fetch_size = DEFAULT_MAX_FETCH_SIZE;
+  policy->max_source_rate = 0;
+  policy->max_source_items = 0;
+}
+
+static gint64
+key_file_get_size (GKeyFile    *key_file,
+                   const gchar *group,
+                   const gchar *key,
+                   gint64       default_value)
+{
+  GError *error = NULL;
+  gint64 res;
+
+  if (!g_key_file_has_key (key_file, group, key, NULL))
+    return default_value;
+
+  res = g_key_file_get_int64 (key_file, group, key, &error);
+  if (error != NULL)
+    {
+      g_warning ("Invalid value for %s/%s in the retention policy: %s",
+                 group, key,
+                 error->message);
+      g_error_free (error);
+
+      return default_value;
+    }
+
+  return MAX (res, 0);
+}
+
+/* a missing or broken file gives the default policy */
+static void
+mnb_clipboard_retention_load (MnbClipboardRetention *retention,
+                              Policy                *policy)
+{
+  MnbClipboardRetentionPrivate *priv = retention->priv;
+  GError *error = NULL;
+  GKeyFile *key_file;
+  gchar *path;
+  gint i;
+
+  policy_init_defaults (policy);
+
+  path = g_file_get_path (priv->file);
+  key_file = g_key_file_new ();
+
+  if (!g_key_file_load_from_file (key_file, path, G_KEY_FILE_NONE, &error))
+    {
+      if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        g_warning ("Unable to load the retention policy from '%s': %s",
+                   path,
+                   error->message);
+
+      g_error_free (error);
+      goto out;
+    }
+
+  for (i = MNB_CLIPBOARD_ITEM_TEXT; i < N_ITEM_TYPES; i++)
+    policy->max_age[i] = key_file_get_size (key_file, type_groups[i],
+                                            "MaxAge",
+                                            policy->max_age[i]);
+
+  policy->max_items = MIN (key_file_get_size (key_file, "Retention",
+                                              "MaxItems",
+                                              0),
+                           G_MAXUINT);
+  policy->max_bytes = MIN (key_file_get_size (key_file, "Retention",
+                                              "MaxBytes",
+                                              0),
+                           G_MAXSIZE);
+  policy->max_fetch_size = MIN (key_file_get_size (key_file, "Text",
+                                                   "MaxFetchSize",
+                                                   policy->max_fetch_size),
+                                G_MAXSIZE);
+  policy->max_source_rate = MIN (key_file_get_size (key_file, "Sources",
+                                                    "MaxRate",
+                                                    0),
+                                 G_MAXUINT);
+  policy->max_source_items = MIN (key_file_get_size (key_file, "Sources",
+                                                     "MaxItems",
+                                                     0),
+                                  G_MAXUINT);
+
+out:
+  g_key_file_free (key_file);
+  g_free (path);
+}
+
+static void
+on_file_changed (GFileMonitor          *monitor,
+                 GFile                 *file,
+                 GFile                 *other_file,
+                 GFileMonitorEvent      event_type,
+                 MnbClipboardRetention *retention)
+{
+  MnbClipboardRetentionPrivate *priv = retention->priv;
+  Policy policy;
+
+  if (event_type != G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT &&
+      event_type != G_FILE_MONITOR_EVENT_CREATED &&
+      event_type != G_FILE_MONITOR_EVENT_DELETED)
+    return;
+
+  mnb_clipboard_retention_load (retention, &policy);
+
+  if (memcmp (&policy, &priv->policy, sizeof (Policy)) == 0)
+    return;
+
+  priv->policy = policy;
+
+  g_signal_emit (retention, retention_signals[CHANGED], 0);
+}
+
+static void
+mnb_clipboard_retention_finalize (GObject *gobject)
+{
+  MnbClipboardRetentionPrivate *priv = MNB_CLIPBOARD_RETENTION (gobject)->priv;
+
+  if (priv->monitor != NULL)
+    {
+      g_file_monitor_cancel (priv->monitor);
+      g_object_unref (priv->monitor);
+    }
+
+  g_object_unref (priv->file);
+
+  G_OBJECT_CLASS (mnb_clipboard_retention_parent_class)->finalize (gobject);
+}
+
+static void
+mnb_clipboard_retention_class_init (MnbClipboardRetentionClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  g_type_class_add_private (klass, sizeof (MnbClipboardRetentionPrivate));
+
+  gobject_class->finalize = mnb_clipboard_retention_finalize;
+
+  retention_signals[CHANGED] =
+    g_signal_new (g_intern_static_string ("changed"),
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST,
+                  G_STRUCT_OFFSET (MnbClipboardRetentionClass, changed),
+                  NULL, NULL,
+                  mnb_pasteboard_marshal_VOID__VOID,
+                  G_TYPE_NONE, 0);
+}
+
+static void
+mnb_clipboard_retention_init (MnbClipboardRetention *self)
+{
+  self->priv = MNB_CLIPBOARD_RETENTION_GET_PRIVATE (self);
+
+  policy_init_defaults (&self->priv->policy);
+}
+
+/*
+ * mnb_clipboard_retention_new:
+ * @path: the key file holding the policy
+ *
+ * Loads the policy from @path and watches it; the file does not need
+ * to exist.
+ */
+MnbClipboardRetention *
+mnb_clipboard_retention_new (const gchar *path)
+{
+  MnbClipboardRetention *retention;
+  MnbClipboardRetentionPrivate *priv;
+  GError *error = NULL;
+
+  g_return_val_if_fail (path != NULL, NULL);
+
+  retention = g_object_new (MNB_TYPE_CLIPBOARD_RETENTION, NULL);
+  priv = retention->priv;
+
+  priv->file = g_file_new_for_path (path);
+
+  mnb_clipboard_retention_load (retention, &priv->policy);
+
+  priv->monitor = g_file_monitor_file (priv->file,
+                                       G_FILE_MONITOR_NONE,
+                                       NULL,
+                                       &error);
+  if (priv->monitor != NULL)
+    g_signal_connect (priv->monitor, "changed",
+                      G_CALLBACK (on_file_changed),
+                      retention);
+  else
+    {
+      g_warning ("Unable to watch the retention policy in '%s': %s",
+                 path,
+                 error->message);
+      g_error_free (error);
+    }
+
+  return retention;
+}
+
+gint64
+mnb_clipboard_retention_get_max_age (MnbClipboardRetention *retention,
+                                     gint                   item_type)
+{
+  g_return_val_if_fail (MNB_IS_CLIPBOARD_RETENTION (retention), 0);
+
+  if (item_type <= MNB_CLIPBOARD_ITEM_INVALID || item_type >= N_ITEM_TYPES)
+    return 0;
+
+  return retention->priv->policy.max_age[item_type];
+}
+
+guint
+mnb_clipboard_retention_get_max_items (MnbClipboardRetention *retention)
+{
+  g_return_val_if_fail (MNB_IS_CLIPBOARD_RETENTION (retention), 0);
+
+  return retention->priv->policy.max_items;
+}
+
+gsize
+mnb_clipboard_retention_get_max_bytes (MnbClipboardRetention *retention)
+{
+  g_return_val_if_fail (MNB_IS_CLIPBOARD_RETENTION (retention), 0);
+
+  return retention->priv->policy.max_bytes;
+}
+
+gsize
+mnb_clipboard_retention_get_max_fetch_size (MnbClipboardRetention *retention)
+{
+  g_return_val_if_fail (MNB_IS_CLIPBOARD_RETENTION (retention), 0);
+
+  return retention->priv->policy.max_fetch_size;
+}
+
+guint
+mnb_clipboard_retention_get_max_source_rate (MnbClipboardRetention *retention)
+{
+  g_return_val_if_fail (MNB_IS_CLIPBOARD_RETENTION (retention), 0);
+
+  return retention->priv->policy.max_source_rate;
+}
+
+guint
+mnb_clipboard_retention_get_max_source_items (MnbClipboardRetention *retention)
+{
+  g_return_val_if_fail (MNB_IS_CLIPBOARD_RETENTION (retention), 0);
+
+  return retention->priv->policy.max_source_items;
+}
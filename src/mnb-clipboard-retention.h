@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2008 - 2009 Intel Corporation.
+ *
+ * Author: Emmanuele Bassi <ebassi@linux.intel.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __MNB_CLIPBOARD_RETENTION_H__
+#define __MNB_CLIPBOARD_RETENTION_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define MNB_TYPE_CLIPBOARD_RETENTION            (mnb_clipboard_retention_get_type ())
+#define MNB_CLIPBOARD_RETENTION(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), MNB_TYPE_CLIPBOARD_RETENTION, MnbClipboardRetention))
+#define MNB_IS_CLIPBOARD_RETENTION(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), MNB_TYPE_CLIPBOARD_RETENTION))
+#define MNB_CLIPBOARD_RETENTION_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), MNB_TYPE_CLIPBOARD_RETENTION, MnbClipboardRetentionClass))
+#define MNB_IS_CLIPBOARD_RETENTION_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), MNB_TYPE_CLIPBOARD_RETENTION))
+#define MNB_CLIPBOARD_RETENTION_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), MNB_TYPE_CLIPBOARD_RETENTION, MnbClipboardRetentionClass))
+
+typedef struct _MnbClipboardRetention           MnbClipboardRetention;
+typedef struct _MnbClipboardRetentionPrivate    MnbClipboardRetentionPrivate;
+typedef struct _MnbClipboardRetentionClass      MnbClipboardRetentionClass;
+
+struct _MnbClipboardRetention
+{
+  GObject parent_instance;
+
+  MnbClipboardRetentionPrivate *priv;
+};
+
+struct _MnbClipboardRetentionClass
+{
+  GObjectClass parent_class;
+
+  void (* changed) (MnbClipboardRetention *retention);
+};
+
+GType mnb_clipboard_retention_get_type (void) G_GNUC_CONST;
+
+MnbClipboardRetention *mnb_clipboard_retention_new (const gchar *path);
+
+/* the item type is a MnbClipboardItemType; zero means no limit */
+gint64 mnb_clipboard_retention_get_max_age   (MnbClipboardRetention *retention,
+                                              gint                   item_type);
+guint  mnb_clipboard_retention_get_max_items (MnbClipboardRetention *retention);
+gsize  mnb_clipboard_retention_get_max_bytes (MnbClipboardRetention *retention);
+
+/* the size cap of a copied text; zero means no limit */
+gsize  mnb_clipboard_retention_get_max_fetch_size (MnbClipboardRetention *retention);
+
+/* the copies a minute, and the items, allowed to each application;
+ * zero means no limit
+ */
+guint  mnb_clipboard_retention_get_max_source_rate  (MnbClipboardRetention *retention);
+guint  mnb_clipboard_retention_get_max_source_items (MnbClipboardRetention *retention);
+
+G_END_DECLS
+
+#endif /* __MNB_CLIPBOARD_RETENTION_H__ */
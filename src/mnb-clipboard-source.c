@@ -0,0 +1,336 @@
+/*
+ * Copyright (C) 2008 - 2009 Intel Corporation.
+ *
+ * Author: Emmanuele Bassi <ebassi@linux.intel.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * MnbClipboardSources: the applications the copies come from
+ *
+ * The owner of a selection is a window; the application behind it is
+ * found from its WM_CLASS or, failing that, from the command of the
+ * process in its _NET_WM_PID. Toolkits often own the selections with
+ * a hidden or a child window, so the client leader and the ancestors
+ * of the owner are tried as well.
+ *
+ * Finding the application costs a few round trips to the X server,
+ * so the result is kept for each owner window: an application that
+ * copies over and over costs a hash table lookup.
+ *
+ * Each application also has a token bucket, refilled at the allowed
+ * rate, which decides whether a new copy may be captured.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gdk/gdkx.h>
+#include <X11/Xatom.h>
+
+#include "mnb-clipboard-source.h"
+
+/* past this many owners, the cache starts over; owners are usually
+ * long lived, and their windows might get reused by someone else
+ */
+#define MAX_CACHED_OWNERS       (64)
+
+/* how far we go up from the owner to find its toplevel */
+#define MAX_ANCESTORS           (8)
+
+typedef struct {
+  gdouble tokens;
+  gint64 last_time;
+} Bucket;
+
+struct _MnbClipboardSources
+{
+  /* owner window -> application */
+  GHashTable *owners;
+
+  /* application -> Bucket */
+  GHashTable *buckets;
+};
+
+static void
+bucket_free (gpointer data)
+{
+  g_slice_free (Bucket, data);
+}
+
+MnbClipboardSources *
+mnb_clipboard_sources_new (void)
+{
+  MnbClipboardSources *sources = g_slice_new (MnbClipboardSources);
+
+  sources->owners = g_hash_table_new (NULL, NULL);
+  sources->buckets = g_hash_table_new_full (NULL, NULL,
+                                            NULL,
+                                            bucket_free);
+
+  return sources;
+}
+
+void
+mnb_clipboard_sources_free (MnbClipboardSources *sources)
+{
+  if (sources == NULL)
+    return;
+
+  g_hash_table_destroy (sources->owners);
+  g_hash_table_destroy (sources->buckets);
+
+  g_slice_free (MnbClipboardSources, sources);
+}
+
+static gulong
+window_get_cardinal (Display     *xdisplay,
+                     Window       xwindow,
+                     const gchar *name,
+                     Atom         type)
+{
+  Atom actual_type;
+  gint actual_format;
+  gulong n_items, bytes_after;
+  guchar *data = NULL;
+  gulong res = 0;
+
+  if (XGetWindowProperty (xdisplay, xwindow,
+                          gdk_x11_get_xatom_by_name (name),
+                          0, 1,
+                          False,
+                          type,
+                          &actual_type, &actual_format,
+                          &n_items, &bytes_after,
+                          &data) == Success &&
+      actual_type == type &&
+      actual_format == 32 &&
+      n_items == 1)
+    res = *((gulong *) data);
+
+  if (data != NULL)
+    XFree (data);
+
+  return res;
+}
+
+static gchar *
+pid_get_command (gulong pid)
+{
+  gchar *path, *contents = NULL;
+
+  path = g_strdup_printf ("/proc/%lu/comm", pid);
+
+  if (g_file_get_contents (path, &contents, NULL, NULL))
+    {
+      g_strchomp (contents);
+
+      if (*contents == '\0')
+        {
+          g_free (contents);
+          contents = NULL;
+        }
+    }
+
+  g_free (path);
+
+  return contents;
+}
+
+static gchar *
+window_get_application (Display *xdisplay,
+                        Window   xwindow)
+{
+  XClassHint hint = { NULL, NULL };
+  gchar *res = NULL;
+  gulong pid;
+
+  if (XGetClassHint (xdisplay, xwindow, &hint))
+    {
+      if (hint.res_class != NULL && *hint.res_class != '\0')
+        res = g_strdup (hint.res_class);
+      else if (hint.res_name != NULL && *hint.res_name != '\0')
+        res = g_strdup (hint.res_name);
+
+      if (hint.res_name != NULL)
+        XFree (hint.res_name);
+
+      if (hint.res_class != NULL)
+        XFree (hint.res_class);
+    }
+
+  if (res != NULL)
+    return res;
+
+  pid = window_get_cardinal (xdisplay, xwindow, "_NET_WM_PID", XA_CARDINAL);
+  if (pid != 0)
+    res = pid_get_command (pid);
+
+  return res;
+}
+
+static GQuark
+resolve_owner (Window owner)
+{
+  Display *xdisplay;
+  Window xwindow, leader, root, parent, *children;
+  guint n_children;
+  gchar *name;
+  GQuark res = 0;
+  gint i;
+
+  xdisplay = GDK_DISPLAY_XDISPLAY (gdk_display_get_default ());
+
+  /* the owner might be gone already */
+  gdk_error_trap_push ();
+
+  name = window_get_application (xdisplay, owner);
+
+  if (name == NULL)
+    {
+      leader = window_get_cardinal (xdisplay, owner,
+                                    "WM_CLIENT_LEADER",
+                                    XA_WINDOW);
+      if (leader != None && leader != owner)
+        name = window_get_application (xdisplay, leader);
+    }
+
+  xwindow = owner;
+  for (i = 0; name == NULL && i < MAX_ANCESTORS; i++)
+    {
+      children = NULL;
+
+      if (!XQueryTree (xdisplay, xwindow,
+                       &root, &parent,
+                       &children, &n_children))
+        break;
+
+      if (children != NULL)
+        XFree (children);
+
+      if (parent == None || parent == root)
+        break;
+
+      xwindow = parent;
+      name = window_get_application (xdisplay, xwindow);
+    }
+
+  gdk_error_trap_pop ();
+
+  if (name != NULL)
+    {
+      res = g_quark_from_string (name);
+      g_free (name);
+    }
+
+  return res;
+}
+
+/*
+ * mnb_clipboard_sources_lookup:
+ * @sources: the sources
+ * @owner: the XID of the window owning a selection
+ *
+ * Finds the application that owns the selection; only the first
+ * lookup of an owner asks the X server.
+ *
+ * Return value: the name of the application as a quark, or 0
+ */
+GQuark
+mnb_clipboard_sources_lookup (MnbClipboardSources *sources,
+                              guint32              owner)
+{
+  gpointer key = GUINT_TO_POINTER (owner);
+  gpointer value;
+  GQuark res;
+
+  g_return_val_if_fail (sources != NULL, 0);
+
+  if (owner == None)
+    return 0;
+
+  if (g_hash_table_lookup_extended (sources->owners, key, NULL, &value))
+    return GPOINTER_TO_UINT (value);
+
+  res = resolve_owner (owner);
+
+  if (g_hash_table_size (sources->owners) >= MAX_CACHED_OWNERS)
+    g_hash_table_remove_all (sources->owners);
+
+  g_hash_table_insert (sources->owners, key, GUINT_TO_POINTER (res));
+
+  return res;
+}
+
+/*
+ * mnb_clipboard_sources_admit:
+ * @sources: the sources
+ * @source: the application, or 0 for the ones we do not know
+ * @max_rate: the copies allowed in a minute, or 0 for no limit
+ * @retry_after: return location for the delay until the next copy
+ *   is allowed, in milliseconds
+ *
+ * Takes a copy out of the allowance of @source. A source may copy
+ * @max_rate times in a row, and then as fast as its allowance is
+ * refilled. The applications we do not know share one allowance.
+ *
+ * Return value: %TRUE if the copy can be captured
+ */
+gboolean
+mnb_clipboard_sources_admit (MnbClipboardSources *sources,
+                             GQuark               source,
+                             guint                max_rate,
+                             guint               *retry_after)
+{
+  gpointer key = GUINT_TO_POINTER (source);
+  Bucket *bucket;
+  gint64 now;
+
+  g_return_val_if_fail (sources != NULL, TRUE);
+
+  if (max_rate == 0)
+    return TRUE;
+
+  now = g_get_monotonic_time ();
+
+  bucket = g_hash_table_lookup (sources->buckets, key);
+  if (bucket == NULL)
+    {
+      bucket = g_slice_new (Bucket);
+      bucket->tokens = max_rate;
+
+      g_hash_table_insert (sources->buckets, key, bucket);
+    }
+  else
+    {
+      bucket->tokens += (gdouble) (now - bucket->last_time) * max_rate
+                      / (60.0 * G_USEC_PER_SEC);
+      bucket->tokens = MIN (bucket->tokens, max_rate);
+    }
+
+  bucket->last_time = now;
+
+  if (bucket->tokens >= 1.0)
+    {
+      bucket->tokens -= 1.0;
+      return TRUE;
+    }
+
+  if (retry_after != NULL)
+    *retry_after = (guint) ((1.0 - bucket->tokens) * 60000.0 / max_rate) + 1;
+
+  return FALSE;
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2008 - 2009 Intel Corporation.
+ *
+ * Author: Emmanuele Bassi <ebassi@linux.intel.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __MNB_CLIPBOARD_SOURCE_H__
+#define __MNB_CLIPBOARD_SOURCE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _MnbClipboardSources     MnbClipboardSources;
+
+MnbClipboardSources *mnb_clipboard_sources_new  (void);
+void                 mnb_clipboard_sources_free (MnbClipboardSources *sources);
+
+/* the application owning the window @owner, or 0 if unknown */
+GQuark   mnb_clipboard_sources_lookup (MnbClipboardSources *sources,
+                                       guint32              owner);
+
+/* whether @source may copy once more, with at most @max_rate copies
+ * a minute; if not, @retry_after is set to the milliseconds until it
+ * may
+ */
+gboolean mnb_clipboard_sources_admit  (MnbClipboardSources *sources,
+                                       GQuark               source,
+                                       guint                max_rate,
+                                       guint               *retry_after);
+
+G_END_DECLS
+
+#endif /* __MNB_CLIPBOARD_SOURCE_H__ */
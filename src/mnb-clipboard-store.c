@@ -22,55 +22,187 @@
 #endif
 
 #include "mnb-clipboard-store.h"
+#include "mnb-clipboard-fetch.h"
+#include "mnb-clipboard-image.h"
+#include "mnb-clipboard-model.h"
+#include "mnb-clipboard-preview.h"
+#include "mnb-clipboard-pressure.h"
+#include "mnb-clipboard-retention.h"
+#include "mnb-clipboard-source.h"
+#include "mnb-clipboard-targets.h"
+#include "mnb-clipboard-xfixes.h"
 #include "mnb-pasteboard-marshal.h"
 
 #include <gtk/gtk.h>
+#include <glib/gstdio.h>
+#include <sys/types.h>
+#include <errno.h>
+#include <signal.h>
 #include <string.h>
+#include <unistd.h>
 
 #define MNB_CLIPBOARD_STORE_GET_PRIVATE(obj)    (G_TYPE_INSTANCE_GET_PRIVATE ((obj), MNB_TYPE_CLIPBOARD_STORE, MnbClipboardStorePrivate))
 
+/* under memory pressure, the items older than this are compressed,
+ * then spilled to disk and finally evicted
+ */
+#define COLD_ITEM_AGE                   (10 * 60)
+
+/* smaller texts do not compress well enough */
+#define COMPRESS_MIN_SIZE               (512)
+
+/* while under pressure, how often we look for cold items */
+#define PRESSURE_INTERVAL               (60)
+
+/* how long the changes to the pinned items wait before being saved */
+#define SAVE_PINNED_TIMEOUT             (2)
+
+/* the pinned items are kept in memory, and saved and loaded in one
+ * go; a longer text, like a streamed one, stays in the history
+ */
+#define PINNED_MAX_TEXT_SIZE            (256 * 1024)
+
+/* how long the clipboard has to stay the same before we fetch its
+ * secondary targets, so that a burst of copies costs nothing more
+ */
+#define LAZY_FETCH_DELAY                (1)
+
+/* a selection that grows or shrinks within this many milliseconds of
+ * the previous one, from the same owner, is a drag in progress; it is
+ * announced once it stays the same for SELECTION_SETTLE_DELAY
+ */
+#define SELECTION_COLLAPSE_TIME         (1000)
+#define SELECTION_SETTLE_DELAY          (150)
+
+/* the info of the primary targets when copying back; the fetched
+ * targets come after it
+ */
+#define PRIMARY_TARGET_INFO             (0)
+#define FIRST_FETCHED_TARGET_INFO       (1)
+
 typedef struct _ClipboardItem  ClipboardItem;
+typedef struct _CopyBack       CopyBack;
+typedef struct _Deferred       Deferred;
+
+/* a capture put off because its application copies too often */
+struct _Deferred
+{
+  MnbClipboardStore *store;
+  GtkClipboard *clipboard;
+
+  guint32 owner;
+  guint32 time_;
+
+  guint id;
+};
 
 struct _MnbClipboardStorePrivate
 {
+  MnbClipboardModel *model;
+
+  /* the pinned items live apart from the history, so that neither
+   * the expiration nor the eviction ever go through them
+   */
+  MnbClipboardModel *pinned;
+  gchar *pinned_path;
+  guint save_id;
+
   /* XXX owned by GTK+ - DO NOT UNREF */
   GtkClipboard *clipboard;
   GtkClipboard *primary;
 
-  /* expiration delta */
-  gint64 max_time;
+  /* only the store owning the history applies the policy */
+  MnbClipboardRetention *retention;
+  gulong retention_id;
 
   /* serial */
   gint64 last_serial;
 
-  gulong expire_id;
+  /* the next expiration, planned from the oldest item of each type */
+  guint expire_id;
+  gint64 expire_time;
 
+  /* the current selection, where it comes from, and the preview
+   * last computed for it; a drag in progress is announced only once
+   * it settles
+   */
   gchar *selection;
+  gsize selection_len;
+  guint32 selection_owner;
+  gint64 selection_time;
+  gchar *selection_preview;
+  guint settle_id;
+
+  /* the secondary targets of the items, by serial, and the lazy
+   * fetch of the ones of the current clipboard owner
+   */
+  GHashTable *targets;
+  gint64 clipboard_serial;
+  guint fetch_id;
+
+  /* the item we serve after its owner went away, or 0 */
+  gint64 serving_serial;
+
+  /* the captured items get their preview and filter key here, one
+   * at a time, so they come out in order
+   */
+  GThreadPool *preview_pool;
+
+  /* the rows added and removed since the last notification; they
+   * are emitted when the outermost update ends
+   */
+  GArray *added_serials;
+  GArray *removed_serials;
+  guint update_depth;
+
+  MnbClipboardPressure *pressure;
+  MnbClipboardPressureLevel pressure_level;
+
+  /* the actions taken under memory pressure */
+  guint n_cache_drops;
+  guint n_compressed;
+  guint n_spilled;
+  guint n_evicted;
+  guint n_restored;
+
+  /* the owner changes straight from XFixes, if asked for */
+  MnbClipboardXFixes *xfixes;
+
+  /* the applications the items come from, and the last capture of
+   * CLIPBOARD and PRIMARY put off by their rate limit
+   */
+  MnbClipboardSources *sources;
+  Deferred deferred[2];
+  guint n_throttled;
+
+  /* whether we watch the selections; a store mirroring another
+   * process does not
+   */
+  guint capture        : 1;
+  guint native_capture : 1;
 };
 
 enum
 {
-  COLUMN_ITEM_TYPE = 0,
-  COLUMN_ITEM_TEXT,
-  COLUMN_ITEM_URIS,
-  COLUMN_ITEM_IMAGE,
-  COLUMN_ITEM_MTIME,
-  COLUMN_ITEM_IS_SELECTION,
-  COLUMN_ITEM_SERIAL,
+  PROP_0,
 
-  N_COLUMNS
+  PROP_CAPTURE,
+  PROP_NATIVE_CAPTURE,
+  PROP_PRESSURE_LEVEL
 };
 
 enum
 {
-  ITEM_ADDED,
-  ITEM_REMOVED,
+  ITEMS_ADDED,
+  ITEMS_REMOVED,
+  ITEM_CHANGED,
   SELECTION_CHANGED,
+  FETCH_PROGRESS,
 
   LAST_SIGNAL
 };
 
-G_DEFINE_TYPE (MnbClipboardStore, mnb_clipboard_store, CLUTTER_TYPE_LIST_MODEL);
+G_DEFINE_TYPE (MnbClipboardStore, mnb_clipboard_store, G_TYPE_OBJECT);
 
 struct _ClipboardItem
 {
@@ -81,434 +213,3085 @@ struct _ClipboardItem
   gint64 mtime;
   gint64 serial;
 
+  /* the window owning the selection, and the time it took it */
+  guint32 owner;
+  guint32 time_;
+
+  /* the application it was copied from, or 0 */
+  GQuark source;
+
+  gchar *text;
+  gchar *preview;
+  gchar *filter;
+  gchar **uris;
+
+  /* a copied image, until it is stored by the preview thread */
+  GdkPixbuf *pixbuf;
+  guchar *image_data;
+  gsize image_len;
+
+  MnbClipboardTargets *targets;
+
+  /* a long text streamed to a file; only its start is in memory */
+  gchar *spill_path;
+  gchar *head;
+  gsize text_size;
+  guint32 text_hash;
+
   guint is_selection : 1;
+  guint is_truncated : 1;
+};
+
+/* the contents we own while an item is copied back */
+struct _CopyBack
+{
+  MnbClipboardItemType type;
+
+  gchar *text;
+  gchar **uris;
+  GdkPixbuf *pixbuf;
+
+  MnbClipboardTargets *targets;
 };
 
 static gulong store_signals[LAST_SIGNAL] = { 0, };
 
+static void mnb_clipboard_store_emit_changes    (MnbClipboardStore *store);
+static void mnb_clipboard_store_apply_pressure (MnbClipboardStore *store);
+static void mnb_clipboard_store_plan_expiry    (MnbClipboardStore *store);
+static void mnb_clipboard_store_take_over      (MnbClipboardStore *store);
+
 static gboolean
 expire_clipboard_items (gpointer data)
 {
   MnbClipboardStore *store = data;
-  ClutterModelIter *iter;
-  GArray *expire_list = g_array_new (FALSE, FALSE, sizeof (guint));
+  MnbClipboardStorePrivate *priv = store->priv;
+  gint64 before[MNB_CLIPBOARD_MODEL_N_TYPES];
   GTimeVal now;
   gint i;
 
+  priv->expire_id = 0;
+
   g_get_current_time (&now);
 
-  iter = clutter_model_get_last_iter (CLUTTER_MODEL (store));
-  do
+  for (i = 0; i < MNB_CLIPBOARD_MODEL_N_TYPES; i++)
     {
-      guint row = clutter_model_iter_get_row (iter);
-      gint64 item_mtime = 0;
-
-      clutter_model_iter_get (iter, COLUMN_ITEM_MTIME, &item_mtime, -1);
+      gint64 max_age = mnb_clipboard_retention_get_max_age (priv->retention, i);
 
-      /* we should not remove while iterating */
-      if ((now.tv_sec - item_mtime) > store->priv->max_time)
-        g_array_append_val (expire_list, row);
-
-      iter = clutter_model_iter_prev (iter);
+      before[i] = max_age > 0 ? now.tv_sec - max_age : G_MININT64;
     }
-  while (!clutter_model_iter_is_first (iter));
 
-  g_object_unref (iter);
+  /* the expired items go away with a single notification */
+  mnb_clipboard_model_remove_expired (priv->model,
+                                      before,
+                                      priv->removed_serials);
 
-  for (i = 0; i < expire_list->len; i++)
-    {
-      clutter_model_remove (CLUTTER_MODEL (store),
-                            g_array_index (expire_list, guint, i));
-    }
+  if (priv->update_depth == 0)
+    mnb_clipboard_store_emit_changes (store);
 
-  g_array_free (expire_list, TRUE);
+  /* more items might have gone cold since the last pass */
+  if (priv->pressure_level > MNB_CLIPBOARD_PRESSURE_LOW)
+    mnb_clipboard_store_apply_pressure (store);
 
-  store->priv->expire_id = 0;
+  mnb_clipboard_store_plan_expiry (store);
 
   return FALSE;
 }
 
+/* the items are kept in order of capture, so the next expiration is
+ * the one of the oldest item of each type; that is usually found at
+ * the start of the model, instead of going through all of it
+ */
 static void
-on_clipboard_request_text (GtkClipboard *clipboard,
-                           const gchar  *text,
-                           gpointer      data)
+mnb_clipboard_store_arm_expiry (MnbClipboardStore *store,
+                                gint64             expire_time,
+                                gint64             now)
 {
-  MnbClipboardStorePrivate *priv;
-  ClipboardItem *item = data;
+  MnbClipboardStorePrivate *priv = store->priv;
+
+  priv->expire_time = expire_time;
+  priv->expire_id =
+    g_timeout_add_seconds_full (G_PRIORITY_LOW,
+                                (guint) CLAMP (expire_time - now + 1,
+                                               1, G_MAXUINT / 2),
+                                expire_clipboard_items,
+                                store,
+                                NULL);
+}
 
-  if (text == NULL || *text == '\0')
-    return;
+static void
+mnb_clipboard_store_plan_expiry (MnbClipboardStore *store)
+{
+  MnbClipboardStorePrivate *priv = store->priv;
+  gint64 expire_time = G_MAXINT64;
+  GTimeVal now;
+  gint i;
 
-  priv = item->store->priv;
+  if (priv->retention == NULL)
+    return;
 
-  if (item->is_selection)
+  for (i = MNB_CLIPBOARD_ITEM_TEXT; i < MNB_CLIPBOARD_MODEL_N_TYPES; i++)
     {
-      g_free (priv->selection);
-      priv->selection = g_strdup (text);
+      gint64 max_age, oldest;
 
-      g_signal_emit (item->store, store_signals[SELECTION_CHANGED], 0, text);
+      max_age = mnb_clipboard_retention_get_max_age (priv->retention, i);
+      if (max_age == 0)
+        continue;
 
-      g_object_unref (item->store);
-      g_slice_free (ClipboardItem, item);
+      oldest = mnb_clipboard_model_get_oldest_mtime (priv->model, i);
+      if (oldest < 0)
+        continue;
 
-      return;
+      expire_time = MIN (expire_time, oldest + max_age);
     }
 
-  clutter_model_prepend (CLUTTER_MODEL (item->store),
-                         COLUMN_ITEM_TYPE, item->type,
-                         COLUMN_ITEM_SERIAL, item->serial,
-                         COLUMN_ITEM_MTIME, item->mtime,
-                         COLUMN_ITEM_TEXT, text,
-                         COLUMN_ITEM_IS_SELECTION, item->is_selection,
-                         -1);
+  g_get_current_time (&now);
 
-  /* if an expiration has already been schedule, coalesce it */
-  if (priv->expire_id == 0)
-    priv->expire_id = g_idle_add_full (G_PRIORITY_LOW,
-                                       expire_clipboard_items,
-                                       g_object_ref (item->store),
-                                       (GDestroyNotify) g_object_unref);
+  if (priv->pressure_level > MNB_CLIPBOARD_PRESSURE_LOW)
+    expire_time = MIN (expire_time, now.tv_sec + PRESSURE_INTERVAL);
 
-  g_object_unref (item->store);
-  g_slice_free (ClipboardItem, item);
-}
+  /* nothing changed */
+  if (priv->expire_id != 0 && priv->expire_time == expire_time)
+    return;
 
-#if GTK_CHECK_VERSION(2, 14, 0)
-static void
-on_clipboard_request_uris (GtkClipboard  *clipboard,
-                           gchar        **uris,
-                           gpointer       data)
-{
-  ClipboardItem *item = data;
+  if (priv->expire_id != 0)
+    {
+      g_source_remove (priv->expire_id);
+      priv->expire_id = 0;
+    }
 
-  clutter_model_prepend (CLUTTER_MODEL (item->store),
-                         COLUMN_ITEM_TYPE, item->type,
-                         COLUMN_ITEM_SERIAL, item->serial,
-                         COLUMN_ITEM_MTIME, item->mtime,
-                         COLUMN_ITEM_URIS, uris,
-                         COLUMN_ITEM_IS_SELECTION, item->is_selection,
-                         -1);
+  if (expire_time == G_MAXINT64)
+    return;
 
-  g_object_unref (item->store);
-  g_slice_free (ClipboardItem, item);
+  mnb_clipboard_store_arm_expiry (store, expire_time, now.tv_sec);
 }
-#endif /* GTK_CHECK_VERSION */
 
+/* a new item might expire before the others when the types have
+ * different ages, but it never delays the planned expiration
+ */
 static void
-on_clipboard_request_targets (GtkClipboard *clipboard,
-                              GdkAtom      *atoms,
-                              gint          n_atoms,
-                              gpointer      data)
+mnb_clipboard_store_plan_newest_expiry (MnbClipboardStore *store)
 {
-  ClipboardItem *tmp = data;
-  gboolean free_item = TRUE;
-  gint i;
+  MnbClipboardStorePrivate *priv = store->priv;
+  gint64 max_age, expire_time;
+  GTimeVal now;
 
-  if (atoms == NULL)
-    goto out;
+  if (priv->retention == NULL ||
+      mnb_clipboard_model_get_n_rows (priv->model) == 0)
+    return;
 
-  /* step 2: we get a copy of what the clipboard is holding */
-  for (i = 0; i < n_atoms; i++)
+  max_age =
+    mnb_clipboard_retention_get_max_age (priv->retention,
+                                         mnb_clipboard_model_get_item_type (priv->model, 0));
+  if (max_age == 0)
+    return;
+
+  expire_time = mnb_clipboard_model_get_mtime (priv->model, 0) + max_age;
+
+  if (priv->expire_id != 0)
     {
-      if (atoms[i] == gdk_atom_intern_static_string ("UTF8_STRING"))
-        {
-          tmp->type = MNB_CLIPBOARD_ITEM_TEXT;
-          break;
-        }
-      else if (atoms[i] == gdk_atom_intern_static_string ("text/uri-list"))
-        {
-          tmp->type = MNB_CLIPBOARD_ITEM_URIS;
-          break;
-        }
-      else
-        continue;
+      if (priv->expire_time <= expire_time)
+        return;
+
+      g_source_remove (priv->expire_id);
+      priv->expire_id = 0;
     }
 
-  if (tmp->type == MNB_CLIPBOARD_ITEM_INVALID)
-    goto out;
+  g_get_current_time (&now);
 
-  switch (tmp->type)
-    {
-    case MNB_CLIPBOARD_ITEM_TEXT:
-      gtk_clipboard_request_text (clipboard,
-                                  on_clipboard_request_text,
-                                  tmp);
-      free_item = FALSE;
-      break;
+  mnb_clipboard_store_arm_expiry (store, expire_time, now.tv_sec);
+}
 
-    case MNB_CLIPBOARD_ITEM_URIS:
-#if GTK_CHECK_VERSION(2, 14, 0)
-      gtk_clipboard_request_uris (clipboard,
-                                  on_clipboard_request_uris,
-                                  tmp);
-      free_item = FALSE;
-#endif
-      break;
+/* applies the caps on the number of items and on their size */
+static void
+mnb_clipboard_store_apply_caps (MnbClipboardStore *store)
+{
+  MnbClipboardStorePrivate *priv = store->priv;
 
-    case MNB_CLIPBOARD_ITEM_IMAGE:
-      break;
+  if (priv->retention == NULL)
+    return;
 
-    case MNB_CLIPBOARD_ITEM_INVALID:
-      g_assert_not_reached ();
-      break;
-    }
+  mnb_clipboard_model_trim (priv->model,
+                            mnb_clipboard_retention_get_max_items (priv->retention),
+                            mnb_clipboard_retention_get_max_bytes (priv->retention),
+                            priv->removed_serials);
 
-out:
+  if (priv->update_depth == 0)
+    mnb_clipboard_store_emit_changes (store);
+}
 
-  if (free_item)
+static void
+on_retention_changed (MnbClipboardRetention *retention,
+                      MnbClipboardStore     *store)
+{
+  mnb_clipboard_store_apply_caps (store);
+
+  /* the ages might be shorter, or longer, than the planned ones */
+  if (store->priv->expire_id != 0)
     {
-      g_object_unref (tmp->store);
-      g_slice_free (ClipboardItem, tmp);
+      g_source_remove (store->priv->expire_id);
+      store->priv->expire_id = 0;
     }
+
+  expire_clipboard_items (store);
 }
 
 static void
-on_clipboard_owner_change (GtkClipboard      *clipboard,
-                           GdkEvent          *event,
-                           MnbClipboardStore *store)
+clipboard_item_free (ClipboardItem *item)
 {
-  ClipboardItem *tmp;
-  GTimeVal now;
+  g_free (item->text);
+  g_free (item->preview);
+  g_free (item->filter);
+  g_strfreev (item->uris);
 
-  g_get_current_time (&now);
+  if (item->pixbuf != NULL)
+    g_object_unref (item->pixbuf);
 
-  tmp = g_slice_new (ClipboardItem);
+  g_free (item->image_data);
 
-  tmp->type = MNB_CLIPBOARD_ITEM_INVALID;
-  tmp->serial = store->priv->last_serial;
-  tmp->store = g_object_ref (store);
-  tmp->mtime = now.tv_sec;
-  tmp->is_selection = (clipboard == store->priv->primary) ? TRUE : FALSE;
+  mnb_clipboard_targets_free (item->targets);
 
-  store->priv->last_serial += 1;
+  /* the text of an item that never made it to the model */
+  if (item->spill_path != NULL)
+    g_unlink (item->spill_path);
 
-  /* step 1: we ask what the clipboard is holding */
-  gtk_clipboard_request_targets (clipboard,
-                                 on_clipboard_request_targets,
-                                 tmp);
+  g_free (item->spill_path);
+  g_free (item->head);
+
+  g_object_unref (item->store);
+
+  g_slice_free (ClipboardItem, item);
 }
 
+/* a streamed text is only known by its start */
 static void
-mnb_clipboard_store_row_added (ClutterModel     *model,
-                               ClutterModelIter *iter)
+clipboard_item_generate_preview (ClipboardItem *item)
 {
-  MnbClipboardStore *store = MNB_CLIPBOARD_STORE (model);
-  MnbClipboardItemType type = MNB_CLIPBOARD_ITEM_INVALID;
-  gint64 serial = 0, mtime = 0;
-
-  clutter_model_iter_get (iter,
-                          COLUMN_ITEM_TYPE, &type,
-                          COLUMN_ITEM_SERIAL, &serial,
-                          COLUMN_ITEM_MTIME, &mtime,
-                          -1);
-
-#if 0
-  {
-    g_debug ("%s: Added new row (mtime: %lld, serial: %lld)",
-             G_STRLOC,
-             mtime,
-             serial);
-  }
-#endif
+  const gchar *text = item->text != NULL ? item->text : item->head;
 
-  g_signal_emit (store, store_signals[ITEM_ADDED], 0, type);
+  item->preview = mnb_clipboard_preview_new (text, -1,
+                                             MNB_CLIPBOARD_PREVIEW_MAX_LINES,
+                                             MNB_CLIPBOARD_PREVIEW_MAX_CHARS);
+  item->filter = mnb_clipboard_preview_filter_key (text, -1);
 }
 
+/* the text of a list of URIs is the list itself, one URI per line,
+ * which is also its preview; the filter key is unescaped, so that the
+ * files can be found by name
+ */
 static void
-mnb_clipboard_store_row_removed (ClutterModel     *model,
-                                 ClutterModelIter *iter)
+clipboard_item_set_uris (ClipboardItem *item,
+                         gchar        **uris)
 {
-  gint64 serial = 0;
+  gchar *unescaped;
+
+  item->uris = uris;
+  item->text = g_strjoinv ("\n", uris);
+  item->preview = g_strdup (item->text);
+
+  unescaped = g_uri_unescape_string (item->text, NULL);
+  item->filter =
+    mnb_clipboard_preview_filter_key (unescaped != NULL ? unescaped
+                                                        : item->text,
+                                      -1);
+  g_free (unescaped);
+}
 
-  clutter_model_iter_get (iter, COLUMN_ITEM_SERIAL, &serial, -1);
+/* an image is stored as a PNG file, and the item only holds its URI,
+ * which is also its preview; there is no text to match
+ */
+static void
+clipboard_item_store_image (ClipboardItem *item)
+{
+  GError *error = NULL;
+  gchar *uri;
 
-  CLUTTER_MODEL_CLASS (mnb_clipboard_store_parent_class)->row_removed (model, iter);
+  if (item->image_data != NULL)
+    uri = mnb_clipboard_image_store_png (item->image_data, item->image_len,
+                                         &error);
+  else
+    uri = mnb_clipboard_image_store_pixbuf (item->pixbuf, &error);
 
-  /* now the row does not exist anymore and we can emit the signal */
+  if (uri == NULL)
+    {
+      g_warning ("Unable to store the copied image: %s", error->message);
+      g_error_free (error);
+      return;
+    }
 
-  g_signal_emit (model, store_signals[ITEM_REMOVED], 0, serial);
+  item->uris = g_new0 (gchar *, 2);
+  item->uris[0] = uri;
+  item->preview = g_strdup (uri);
 }
 
+typedef struct {
+  MnbClipboardStore *store;
+  gint64 serial;
+} TargetFetch;
+
+static void     mnb_clipboard_store_plan_fetch (MnbClipboardStore *store);
+static gboolean fetch_next_target              (gpointer           data);
+
 static void
-mnb_clipboard_store_class_init (MnbClipboardStoreClass *klass)
+on_target_received (GtkClipboard     *clipboard,
+                    GtkSelectionData *selection_data,
+                    gpointer          data)
 {
-  ClutterModelClass *model_class = CLUTTER_MODEL_CLASS (klass);
+  TargetFetch *fetch = data;
+  MnbClipboardStorePrivate *priv = fetch->store->priv;
+  MnbClipboardTargets *targets;
 
-  g_type_class_add_private (klass, sizeof (MnbClipboardStorePrivate));
+  /* if the owner changed in the meantime, this might not even be
+   * the contents of the item
+   */
+  if (fetch->serial != priv->clipboard_serial)
+    goto out;
 
-  model_class->row_added = mnb_clipboard_store_row_added;
-  model_class->row_removed = mnb_clipboard_store_row_removed;
+  targets = g_hash_table_lookup (priv->targets, &fetch->serial);
+  if (targets == NULL)
+    goto out;
 
-  store_signals[ITEM_ADDED] =
-    g_signal_new (g_intern_static_string ("item-added"),
-                  G_TYPE_FROM_CLASS (klass),
-                  G_SIGNAL_RUN_LAST,
-                  G_STRUCT_OFFSET (MnbClipboardStoreClass, item_added),
-                  NULL, NULL,
-                  mnb_pasteboard_marshal_VOID__ENUM,
-                  G_TYPE_NONE, 1,
-                  MNB_TYPE_CLIPBOARD_ITEM_TYPE);
+  mnb_clipboard_targets_set_data (targets, selection_data);
 
-  store_signals[ITEM_REMOVED] =
-    g_signal_new (g_intern_static_string ("item-removed"),
-                  G_TYPE_FROM_CLASS (klass),
-                  G_SIGNAL_RUN_LAST,
-                  G_STRUCT_OFFSET (MnbClipboardStoreClass, item_removed),
-                  NULL, NULL,
-                  mnb_pasteboard_marshal_VOID__INT64,
-                  G_TYPE_NONE, 1,
-                  G_TYPE_INT64);
+  /* one target at a time, whenever the main loop is idle */
+  if (priv->fetch_id == 0)
+    priv->fetch_id = g_idle_add_full (G_PRIORITY_LOW,
+                                      fetch_next_target,
+                                      fetch->store,
+                                      NULL);
 
-  store_signals[SELECTION_CHANGED] =
-    g_signal_new (g_intern_static_string ("selection-changed"),
-                  G_TYPE_FROM_CLASS (klass),
-                  G_SIGNAL_RUN_LAST,
-                  G_STRUCT_OFFSET (MnbClipboardStoreClass, selection_changed),
-                  NULL, NULL,
-                  mnb_pasteboard_marshal_VOID__STRING,
-                  G_TYPE_NONE, 1,
-                  G_TYPE_STRING);
+out:
+  g_object_unref (fetch->store);
+  g_slice_free (TargetFetch, fetch);
 }
 
-static void
-mnb_clipboard_store_init (MnbClipboardStore *self)
+static gboolean
+fetch_next_target (gpointer data)
 {
-  MnbClipboardStorePrivate *priv;
-  ClutterModel *model = CLUTTER_MODEL (self);
-  GType column_types[] = {
-    G_TYPE_INT,         /* COLUMN_ITEM_TYPE */
-    G_TYPE_STRING,      /* COLUMN_ITEM_TEXT */
-    G_TYPE_STRV,        /* COLUMN_ITEM_URIS */
-    G_TYPE_POINTER,     /* COLUMN_ITEM_IMAGE */
-    G_TYPE_INT64,       /* COLUMN_ITEM_MTIME */
-    G_TYPE_BOOLEAN,     /* COLUMN_ITEM_IS_SELECTION */
-    G_TYPE_INT64,       /* COLUMN_ITEM_SERIAL */
-  };
+  MnbClipboardStore *store = data;
+  MnbClipboardStorePrivate *priv = store->priv;
+  MnbClipboardTargets *targets;
+  TargetFetch *fetch;
+  GdkAtom target;
 
-  self->priv = priv = MNB_CLIPBOARD_STORE_GET_PRIVATE (self);
+  priv->fetch_id = 0;
 
-  clutter_model_set_types (model, N_COLUMNS, column_types);
+  targets = g_hash_table_lookup (priv->targets, &priv->clipboard_serial);
+  if (targets == NULL)
+    return FALSE;
 
-  priv->clipboard = gtk_clipboard_get (GDK_SELECTION_CLIPBOARD);
-  g_signal_connect (self->priv->clipboard,
-                    "owner-change", G_CALLBACK (on_clipboard_owner_change),
-                    self);
+  target = mnb_clipboard_targets_next_missing (targets);
+  if (target == GDK_NONE)
+    return FALSE;
 
-  priv->primary = gtk_clipboard_get (GDK_SELECTION_PRIMARY);
-  g_signal_connect (self->priv->primary,
-                    "owner-change", G_CALLBACK (on_clipboard_owner_change),
-                    self);
+  fetch = g_slice_new (TargetFetch);
+  fetch->store = g_object_ref (store);
+  fetch->serial = priv->clipboard_serial;
 
-  /* XXX - keep an item around for two hours; this should be
-   * hooked into GConf
-   */
-  priv->max_time = (60 * 60 * 2);
+  gtk_clipboard_request_contents (priv->clipboard, target,
+                                  on_target_received,
+                                  fetch);
 
-  priv->last_serial = 1;
+  return FALSE;
 }
 
-MnbClipboardStore *
-mnb_clipboard_store_new (void)
+static void
+mnb_clipboard_store_plan_fetch (MnbClipboardStore *store)
 {
-  return g_object_new (MNB_TYPE_CLIPBOARD_STORE, NULL);
+  MnbClipboardStorePrivate *priv = store->priv;
+
+  if (priv->fetch_id != 0)
+    g_source_remove (priv->fetch_id);
+
+  priv->fetch_id = g_timeout_add_seconds (LAZY_FETCH_DELAY,
+                                          fetch_next_target,
+                                          store);
 }
 
-gchar *
-mnb_clipboard_store_get_last_text (MnbClipboardStore *store,
-                                   gint64            *mtime,
-                                   gint64            *serial)
+/* the targets that the primary representation of an item serves */
+static GtkTargetList *
+get_primary_targets (MnbClipboardItemType item_type)
 {
-  ClutterModelIter *iter;
-  MnbClipboardItemType item_type = MNB_CLIPBOARD_ITEM_INVALID;
-  gchar *text = NULL;
-  gint64 timestamp = 0;
-  gint64 id = 0;
+  GtkTargetList *list = gtk_target_list_new (NULL, 0);
 
-  g_return_val_if_fail (MNB_IS_CLIPBOARD_STORE (store), NULL);
+  switch (item_type)
+    {
+    case MNB_CLIPBOARD_ITEM_URIS:
+      gtk_target_list_add_uri_targets (list, PRIMARY_TARGET_INFO);
+      /* fall through */
 
-  iter = clutter_model_get_first_iter (CLUTTER_MODEL (store));
-  clutter_model_iter_get (iter,
-                          COLUMN_ITEM_TYPE, &item_type,
-                          COLUMN_ITEM_TEXT, &text,
-                          COLUMN_ITEM_MTIME, &timestamp,
-                          COLUMN_ITEM_SERIAL, &id,
-                          -1);
+    case MNB_CLIPBOARD_ITEM_TEXT:
+      gtk_target_list_add_text_targets (list, PRIMARY_TARGET_INFO);
+      break;
 
-  g_object_unref (iter);
+    case MNB_CLIPBOARD_ITEM_IMAGE:
+      gtk_target_list_add_image_targets (list, PRIMARY_TARGET_INFO, FALSE);
+      break;
 
-  if (item_type != MNB_CLIPBOARD_ITEM_TEXT)
-    {
-      GEnumClass *enum_class;
-      GEnumValue *enum_value;
+    case MNB_CLIPBOARD_ITEM_INVALID:
+      break;
+    }
 
-      enum_class = g_type_class_peek (MNB_TYPE_CLIPBOARD_ITEM_TYPE);
-      if (G_LIKELY (enum_class != NULL))
-        {
+  return list;
+}
+
+static void
+mnb_clipboard_store_insert_item (MnbClipboardStore *store,
+                                 ClipboardItem     *item)
+{
+  MnbClipboardStorePrivate *priv = store->priv;
+  guint32 text_hash;
+  guint flags;
+
+  flags = item->is_truncated ? MNB_CLIPBOARD_MODEL_TRUNCATED : 0;
+
+  if (item->spill_path != NULL)
+    {
+      /* the file of a streamed text is moved into the model as it is */
+      if (!mnb_clipboard_model_prepend_spilled (priv->model,
+                                                item->type,
+                                                item->serial,
+                                                item->mtime,
+                                                flags,
+                                                item->text_hash,
+                                                item->text_size,
+                                                item->spill_path,
+                                                item->preview,
+                                                item->filter))
+        return;
+
+      g_free (item->spill_path);
+      item->spill_path = NULL;
+
+      mnb_clipboard_model_set_source (priv->model, 0, item->source);
+    }
+  else
+    {
+      text_hash = item->text != NULL ? g_str_hash (item->text) : 0;
+
+      /* the strings are copied into the arena of the model, while the
+       * URIs are handed over
+       */
+      mnb_clipboard_model_prepend (priv->model,
+                                   item->type,
+                                   item->serial,
+                                   item->mtime,
+                                   flags,
+                                   text_hash,
+                                   item->text,
+                                   item->preview,
+                                   item->filter,
+                                   item->uris);
+
+      mnb_clipboard_model_set_source (priv->model, 0, item->source);
+
+      item->uris = NULL;
+    }
+
+  if (item->targets != NULL)
+    {
+      g_hash_table_insert (priv->targets,
+                           g_memdup (&item->serial, sizeof (gint64)),
+                           item->targets);
+      item->targets = NULL;
+
+      /* the owner is still around only if nothing was copied since */
+      if (item->serial == priv->clipboard_serial)
+        mnb_clipboard_store_plan_fetch (store);
+    }
+
+  g_array_append_val (priv->added_serials, item->serial);
+
+  /* the new item goes in the same notification as the ones it
+   * pushes out, be it the oldest items of its application or the
+   * oldest of all
+   */
+  if (priv->retention != NULL)
+    mnb_clipboard_model_trim_source (priv->model,
+                                     item->source,
+                                     mnb_clipboard_retention_get_max_source_items (priv->retention),
+                                     priv->removed_serials);
+
+  mnb_clipboard_store_apply_caps (store);
+
+  if (priv->update_depth == 0)
+    mnb_clipboard_store_emit_changes (store);
+
+  mnb_clipboard_store_plan_newest_expiry (store);
+}
+
+static gboolean
+insert_item_idle (gpointer data)
+{
+  ClipboardItem *item = data;
+
+  /* an image that could not be stored is dropped */
+  if (item->type != MNB_CLIPBOARD_ITEM_IMAGE || item->uris != NULL)
+    mnb_clipboard_store_insert_item (item->store, item);
+
+  clipboard_item_free (item);
+
+  return FALSE;
+}
+
+/* runs in the preview thread */
+static void
+preview_thread_func (gpointer data,
+                     gpointer user_data)
+{
+  ClipboardItem *item = data;
+
+  switch (item->type)
+    {
+    case MNB_CLIPBOARD_ITEM_IMAGE:
+      clipboard_item_store_image (item);
+      break;
+
+    case MNB_CLIPBOARD_ITEM_URIS:
+      clipboard_item_set_uris (item, item->uris);
+      break;
+
+    default:
+      clipboard_item_generate_preview (item);
+      break;
+    }
+
+  g_idle_add (insert_item_idle, item);
+}
+
+/* every captured item goes through the thread, which keeps their
+ * order; normalizing and folding a text for its filter key costs as
+ * much as the text is long, so the main loop never does it
+ */
+static void
+mnb_clipboard_store_push_item (MnbClipboardStore *store,
+                               ClipboardItem     *item)
+{
+  MnbClipboardStorePrivate *priv = store->priv;
+
+  if (priv->preview_pool == NULL)
+    priv->preview_pool = g_thread_pool_new (preview_thread_func, NULL,
+                                            1, FALSE,
+                                            NULL);
+
+  g_thread_pool_push (priv->preview_pool, item, NULL);
+}
+
+/* takes @text over */
+static void
+mnb_clipboard_store_capture_text (ClipboardItem *item,
+                                  gchar         *text)
+{
+  item->text = text;
+
+  mnb_clipboard_store_push_item (item->store, item);
+}
+
+static void
+mnb_clipboard_store_announce_selection (MnbClipboardStore *store)
+{
+  MnbClipboardStorePrivate *priv = store->priv;
+
+  if (priv->settle_id != 0)
+    {
+      g_source_remove (priv->settle_id);
+      priv->settle_id = 0;
+    }
+
+  g_signal_emit (store, store_signals[SELECTION_CHANGED], 0,
+                 priv->selection_preview);
+}
+
+static gboolean
+settle_selection (gpointer data)
+{
+  MnbClipboardStore *store = data;
+
+  store->priv->settle_id = 0;
+
+  mnb_clipboard_store_announce_selection (store);
+
+  return FALSE;
+}
+
+/* whether @text is @old grown or shrunk at either end, like a drag
+ * selection going forward or backward; only the length of the
+ * shorter one is compared, and nothing is copied
+ */
+static gboolean
+selection_is_related (const gchar *old,
+                      gsize        old_len,
+                      const gchar *text,
+                      gsize        len)
+{
+  const gchar *longer, *shorter;
+  gsize n_longer, n_shorter;
+
+  if (len >= old_len)
+    {
+      longer = text;
+      n_longer = len;
+      shorter = old;
+      n_shorter = old_len;
+    }
+  else
+    {
+      longer = old;
+      n_longer = old_len;
+      shorter = text;
+      n_shorter = len;
+    }
+
+  return memcmp (longer, shorter, n_shorter) == 0 ||
+         memcmp (longer + n_longer - n_shorter, shorter, n_shorter) == 0;
+}
+
+/* takes @text over; the selection is not part of the history */
+static void
+mnb_clipboard_store_capture_selection (ClipboardItem *item,
+                                       gchar         *text,
+                                       gsize          len)
+{
+  MnbClipboardStore *store = item->store;
+  MnbClipboardStorePrivate *priv = store->priv;
+  gboolean is_related, was_settling;
+  gchar *preview;
+  gint64 now;
+
+  now = g_get_monotonic_time ();
+
+  is_related = priv->selection != NULL &&
+               item->owner == priv->selection_owner &&
+               now - priv->selection_time < SELECTION_COLLAPSE_TIME * 1000 &&
+               selection_is_related (priv->selection, priv->selection_len,
+                                     text, len);
+
+  g_free (priv->selection);
+  priv->selection = text;
+  priv->selection_len = len;
+  priv->selection_owner = item->owner;
+  priv->selection_time = now;
+
+  clipboard_item_free (item);
+
+  /* the preview is bounded, so we can create it right away; past its
+   * bounds, a growing selection does not change it
+   */
+  preview = mnb_clipboard_preview_new (text, len,
+                                      MNB_CLIPBOARD_PREVIEW_MAX_LINES,
+                                      MNB_CLIPBOARD_PREVIEW_MAX_CHARS);
+
+  /* a new selection ends the drag that was settling; what it left
+   * unannounced goes out now, with the new preview
+   */
+  was_settling = priv->settle_id != 0;
+  if (was_settling && !is_related)
+    {
+      g_source_remove (priv->settle_id);
+      priv->settle_id = 0;
+    }
+
+  if (g_strcmp0 (preview, priv->selection_preview) == 0)
+    {
+      g_free (preview);
+
+      if (was_settling && !is_related)
+        mnb_clipboard_store_announce_selection (store);
+
+      return;
+    }
+
+  g_free (priv->selection_preview);
+  priv->selection_preview = preview;
+
+  /* only the final state of a drag is announced */
+  if (is_related)
+    {
+      if (priv->settle_id != 0)
+        g_source_remove (priv->settle_id);
+
+      priv->settle_id = g_timeout_add (SELECTION_SETTLE_DELAY,
+                                       settle_selection,
+                                       store);
+    }
+  else
+    mnb_clipboard_store_announce_selection (store);
+}
+
+static void
+on_clipboard_request_text (GtkClipboard *clipboard,
+                           const gchar  *text,
+                           gpointer      data)
+{
+  ClipboardItem *item = data;
+  gsize len;
+
+  if (text == NULL || *text == '\0')
+    {
+      clipboard_item_free (item);
+      return;
+    }
+
+  len = strlen (text);
+
+  if (item->is_selection)
+    {
+      mnb_clipboard_store_capture_selection (item,
+                                             g_memdup (text, len + 1),
+                                             len);
+      return;
+    }
+
+  mnb_clipboard_store_capture_text (item, g_memdup (text, len + 1));
+}
+
+static void
+on_fetch_progress (gsize    n_bytes,
+                   gpointer data)
+{
+  ClipboardItem *item = data;
+
+  g_signal_emit (item->store, store_signals[FETCH_PROGRESS], 0,
+                 item->serial,
+                 (guint64) n_bytes);
+}
+
+static void
+on_fetch_done (MnbClipboardFetchResult *result,
+               gpointer                 data)
+{
+  ClipboardItem *item = data;
+
+  if (result == NULL)
+    {
+      clipboard_item_free (item);
+      return;
+    }
+
+  item->is_truncated = result->is_truncated;
+
+  if (item->is_selection)
+    {
+      if (result->text != NULL)
+        {
+          mnb_clipboard_store_capture_selection (item,
+                                                 result->text,
+                                                 result->size);
+          result->text = NULL;
+        }
+      else
+        clipboard_item_free (item);
+    }
+  else if (result->text != NULL)
+    {
+      mnb_clipboard_store_capture_text (item, result->text);
+      result->text = NULL;
+    }
+  else
+    {
+      item->spill_path = result->path;
+      item->head = result->head;
+      item->text_size = result->size;
+      item->text_hash = result->text_hash;
+
+      result->path = result->head = NULL;
+
+      /* only the start of the text needs a preview */
+      mnb_clipboard_store_push_item (item->store, item);
+    }
+
+  mnb_clipboard_fetch_result_free (result);
+}
+
+#if GTK_CHECK_VERSION(2, 14, 0)
+static void
+on_clipboard_request_uris (GtkClipboard  *clipboard,
+                           gchar        **uris,
+                           gpointer       data)
+{
+  ClipboardItem *item = data;
+
+  if (uris == NULL || uris[0] == NULL)
+    {
+      clipboard_item_free (item);
+      return;
+    }
+
+  /* the text and the filter key are made in the preview thread */
+  item->uris = g_strdupv (uris);
+
+  mnb_clipboard_store_push_item (item->store, item);
+}
+#endif /* GTK_CHECK_VERSION */
+
+/* PNG data is kept as it is, without decoding it on the main loop */
+static void
+on_clipboard_request_png (GtkClipboard     *clipboard,
+                          GtkSelectionData *selection_data,
+                          gpointer          data)
+{
+  ClipboardItem *item = data;
+  const guchar *image_data;
+  gint len;
+
+  image_data = gtk_selection_data_get_data (selection_data);
+  len = gtk_selection_data_get_length (selection_data);
+
+  if (image_data == NULL || len <= 0)
+    {
+      clipboard_item_free (item);
+      return;
+    }
+
+  item->image_data = g_memdup (image_data, len);
+  item->image_len = len;
+
+  mnb_clipboard_store_push_item (item->store, item);
+}
+
+static void
+on_clipboard_request_image (GtkClipboard *clipboard,
+                            GdkPixbuf    *pixbuf,
+                            gpointer      data)
+{
+  ClipboardItem *item = data;
+
+  if (pixbuf == NULL)
+    {
+      clipboard_item_free (item);
+      return;
+    }
+
+  item->pixbuf = g_object_ref (pixbuf);
+
+  mnb_clipboard_store_push_item (item->store, item);
+}
+
+static void
+on_clipboard_request_targets (GtkClipboard *clipboard,
+                              GdkAtom      *atoms,
+                              gint          n_atoms,
+                              gpointer      data)
+{
+  ClipboardItem *tmp = data;
+  MnbClipboardStorePrivate *priv = tmp->store->priv;
+  GdkAtom png_atom = GDK_NONE;
+  const gchar *spill_dir;
+  gsize max_size = 0;
+  gboolean free_item = TRUE;
+  gint i;
+
+  if (atoms == NULL)
+    goto out;
+
+  /* step 2: we get a copy of what the clipboard is holding */
+  for (i = 0; i < n_atoms; i++)
+    {
+      if (atoms[i] == gdk_atom_intern_static_string ("UTF8_STRING"))
+        {
+          tmp->type = MNB_CLIPBOARD_ITEM_TEXT;
+          break;
+        }
+      else if (atoms[i] == gdk_atom_intern_static_string ("text/uri-list"))
+        {
+          tmp->type = MNB_CLIPBOARD_ITEM_URIS;
+          break;
+        }
+      else if (atoms[i] == gdk_atom_intern_static_string ("image/png"))
+        png_atom = atoms[i];
+      else
+        continue;
+    }
+
+  /* the selection is only ever text */
+  if (tmp->type == MNB_CLIPBOARD_ITEM_INVALID && !tmp->is_selection &&
+      (png_atom != GDK_NONE ||
+       gtk_targets_include_image (atoms, n_atoms, FALSE)))
+    tmp->type = MNB_CLIPBOARD_ITEM_IMAGE;
+
+  if (tmp->type == MNB_CLIPBOARD_ITEM_INVALID)
+    goto out;
+
+  /* only the primary representation is fetched right away; the
+   * other targets are recorded, and fetched later if the owner is
+   * still around
+   */
+  if (!tmp->is_selection)
+    {
+      GtkTargetList *primary = get_primary_targets (tmp->type);
+
+      tmp->targets = mnb_clipboard_targets_new (atoms, n_atoms, primary);
+
+      gtk_target_list_unref (primary);
+    }
+
+  switch (tmp->type)
+    {
+    case MNB_CLIPBOARD_ITEM_TEXT:
+      /* the clipboard is streamed, so that a huge copy is never
+       * buffered whole; with XFixes, the selection is fetched by
+       * ourselves as well, and kept in memory
+       */
+      spill_dir = mnb_clipboard_model_get_spill_dir (priv->model);
+      if (priv->retention != NULL)
+        max_size = mnb_clipboard_retention_get_max_fetch_size (priv->retention);
+
+      if (!tmp->is_selection && spill_dir != NULL)
+        mnb_clipboard_fetch_text (GDK_SELECTION_CLIPBOARD,
+                                  tmp->time_,
+                                  spill_dir,
+                                  max_size,
+                                  on_fetch_progress,
+                                  on_fetch_done,
+                                  tmp);
+      else if (tmp->is_selection && priv->xfixes != NULL)
+        mnb_clipboard_fetch_text (GDK_SELECTION_PRIMARY,
+                                  tmp->time_,
+                                  NULL,
+                                  max_size,
+                                  NULL,
+                                  on_fetch_done,
+                                  tmp);
+      else
+        gtk_clipboard_request_text (clipboard,
+                                    on_clipboard_request_text,
+                                    tmp);
+      free_item = FALSE;
+      break;
+
+    case MNB_CLIPBOARD_ITEM_URIS:
+#if GTK_CHECK_VERSION(2, 14, 0)
+      gtk_clipboard_request_uris (clipboard,
+                                  on_clipboard_request_uris,
+                                  tmp);
+      free_item = FALSE;
+#endif
+      break;
+
+    case MNB_CLIPBOARD_ITEM_IMAGE:
+      /* other formats have to be decoded by GTK+ first */
+      if (png_atom != GDK_NONE)
+        gtk_clipboard_request_contents (clipboard, png_atom,
+                                        on_clipboard_request_png,
+                                        tmp);
+      else
+        gtk_clipboard_request_image (clipboard,
+                                     on_clipboard_request_image,
+                                     tmp);
+      free_item = FALSE;
+      break;
+
+    case MNB_CLIPBOARD_ITEM_INVALID:
+      g_assert_not_reached ();
+      break;
+    }
+
+out:
+
+  if (free_item)
+    clipboard_item_free (tmp);
+}
+
+/* runs with the targets fetched by ourselves */
+static void
+on_targets_fetched (GdkAtom  *atoms,
+                    gint      n_atoms,
+                    gpointer  data)
+{
+  ClipboardItem *tmp = data;
+  MnbClipboardStorePrivate *priv = tmp->store->priv;
+
+  on_clipboard_request_targets (tmp->is_selection ? priv->primary
+                                                  : priv->clipboard,
+                                atoms, n_atoms,
+                                tmp);
+}
+
+static void mnb_clipboard_store_owner_changed (MnbClipboardStore *store,
+                                               GtkClipboard      *clipboard,
+                                               guint32            owner,
+                                               guint32            time_,
+                                               gboolean           is_gone);
+
+static gboolean
+capture_deferred (gpointer data)
+{
+  Deferred *deferred = data;
+
+  deferred->id = 0;
+
+  mnb_clipboard_store_owner_changed (deferred->store,
+                                     deferred->clipboard,
+                                     deferred->owner,
+                                     deferred->time_,
+                                     FALSE);
+
+  return FALSE;
+}
+
+/* checks the rate limit of @source before anything is fetched; a
+ * capture over the limit is put off until the application is allowed
+ * to copy again, and dropped if the selection changes hands before
+ * that, so that a burst of copies ends with its last one captured
+ */
+static gboolean
+mnb_clipboard_store_admit (MnbClipboardStore *store,
+                           GtkClipboard      *clipboard,
+                           guint32            owner,
+                           guint32            time_,
+                           GQuark             source)
+{
+  MnbClipboardStorePrivate *priv = store->priv;
+  Deferred *deferred;
+  guint retry_after = 0;
+
+  if (priv->retention == NULL || priv->sources == NULL)
+    return TRUE;
+
+  if (mnb_clipboard_sources_admit (priv->sources, source,
+                                   mnb_clipboard_retention_get_max_source_rate (priv->retention),
+                                   &retry_after))
+    return TRUE;
+
+  priv->n_throttled += 1;
+
+  deferred = &priv->deferred[clipboard == priv->primary ? 1 : 0];
+  deferred->store = store;
+  deferred->clipboard = clipboard;
+  deferred->owner = owner;
+  deferred->time_ = time_;
+  deferred->id = g_timeout_add (retry_after, capture_deferred, deferred);
+
+  return FALSE;
+}
+
+static void
+mnb_clipboard_store_owner_changed (MnbClipboardStore *store,
+                                   GtkClipboard      *clipboard,
+                                   guint32            owner,
+                                   guint32            time_,
+                                   gboolean           is_gone)
+{
+  MnbClipboardStorePrivate *priv = store->priv;
+  Deferred *deferred;
+  ClipboardItem *tmp;
+  GQuark source = 0;
+  GTimeVal now;
+
+  /* a capture put off is for an owner that is not there anymore */
+  deferred = &priv->deferred[clipboard == priv->primary ? 1 : 0];
+  if (deferred->id != 0)
+    {
+      g_source_remove (deferred->id);
+      deferred->id = 0;
+    }
+
+  if (clipboard == store->priv->clipboard)
+    {
+      /* what we serve is already in the history */
+      if (gtk_clipboard_get_owner (clipboard) == G_OBJECT (store))
+        return;
+
+      /* the owner went away, and took its contents with it */
+      if (is_gone)
+        {
+          mnb_clipboard_store_take_over (store);
+          return;
+        }
+    }
+  else if (is_gone)
+    return;
+
+  /* a flooding application costs us no more than this */
+  if (priv->sources != NULL)
+    {
+      source = mnb_clipboard_sources_lookup (priv->sources, owner);
+
+      if (!mnb_clipboard_store_admit (store, clipboard, owner, time_, source))
+        return;
+    }
+
+  g_get_current_time (&now);
+
+  tmp = g_slice_new0 (ClipboardItem);
+
+  tmp->type = MNB_CLIPBOARD_ITEM_INVALID;
+  tmp->serial = store->priv->last_serial;
+  tmp->store = g_object_ref (store);
+  tmp->mtime = now.tv_sec;
+  tmp->owner = owner;
+  tmp->time_ = time_;
+  tmp->source = source;
+  tmp->is_selection = (clipboard == store->priv->primary) ? TRUE : FALSE;
+
+  store->priv->last_serial += 1;
+
+  /* whatever was being fetched belongs to the previous owner */
+  if (!tmp->is_selection)
+    {
+      store->priv->clipboard_serial = tmp->serial;
+
+      if (store->priv->fetch_id != 0)
+        {
+          g_source_remove (store->priv->fetch_id);
+          store->priv->fetch_id = 0;
+        }
+    }
+
+  /* step 1: we ask what the clipboard is holding */
+  if (store->priv->xfixes != NULL)
+    mnb_clipboard_fetch_targets (tmp->is_selection ? GDK_SELECTION_PRIMARY
+                                                   : GDK_SELECTION_CLIPBOARD,
+                                 time_,
+                                 on_targets_fetched,
+                                 tmp);
+  else
+    gtk_clipboard_request_targets (clipboard,
+                                   on_clipboard_request_targets,
+                                   tmp);
+}
+
+static void
+on_clipboard_owner_change (GtkClipboard      *clipboard,
+                           GdkEvent          *event,
+                           MnbClipboardStore *store)
+{
+  gboolean is_gone;
+
+  is_gone = event->owner_change.reason == GDK_OWNER_CHANGE_DESTROY ||
+            event->owner_change.reason == GDK_OWNER_CHANGE_CLOSE;
+
+  mnb_clipboard_store_owner_changed (store, clipboard,
+                                     event->owner_change.owner,
+                                     event->owner_change.selection_time,
+                                     is_gone);
+}
+
+static void
+on_xfixes_owner_change (GdkAtom   selection,
+                        guint32   owner,
+                        guint32   time_,
+                        gboolean  is_gone,
+                        gpointer  data)
+{
+  MnbClipboardStore *store = data;
+
+  mnb_clipboard_store_owner_changed (store,
+                                     selection == GDK_SELECTION_CLIPBOARD
+                                       ? store->priv->clipboard
+                                       : store->priv->primary,
+                                     owner,
+                                     time_,
+                                     is_gone);
+}
+
+/* the pinned items are saved oldest first, one group each:
+ *
+ *   [Item 0]
+ *   Type=text
+ *   Time=1259064000
+ *   Text=...
+ *
+ * with a URIs list instead of the text for the uris items
+ */
+static gboolean
+save_pinned_items (gpointer data)
+{
+  MnbClipboardStore *store = data;
+  MnbClipboardStorePrivate *priv = store->priv;
+  MnbClipboardModel *model = priv->pinned;
+  GEnumClass *enum_class;
+  GKeyFile *key_file;
+  GError *error = NULL;
+  gchar *contents, *dir;
+  gsize len;
+  gint row, i;
+
+  priv->save_id = 0;
+
+  enum_class = g_type_class_ref (MNB_TYPE_CLIPBOARD_ITEM_TYPE);
+  key_file = g_key_file_new ();
+
+  for (row = (gint) mnb_clipboard_model_get_n_rows (model) - 1, i = 0;
+       row >= 0;
+       row--, i++)
+    {
+      MnbClipboardItemType item_type;
+      GEnumValue *enum_value;
+      gchar group[32];
+      gchar **uris;
+      gchar *text;
+      GQuark source;
+
+      g_snprintf (group, sizeof (group), "Item %d", i);
+
+      item_type = mnb_clipboard_model_get_item_type (model, row);
+      enum_value = g_enum_get_value (enum_class, item_type);
+
+      g_key_file_set_string (key_file, group, "Type",
+                             enum_value != NULL ? enum_value->value_nick
+                                                : "invalid");
+      g_key_file_set_int64 (key_file, group, "Time",
+                            mnb_clipboard_model_get_mtime (model, row));
+
+      source = mnb_clipboard_model_get_source (model, row);
+      if (source != 0)
+        g_key_file_set_string (key_file, group, "Source",
+                               g_quark_to_string (source));
+
+      uris = mnb_clipboard_model_get_uris (model, row);
+      if (uris != NULL)
+        g_key_file_set_string_list (key_file, group, "URIs",
+                                    (const gchar * const *) uris,
+                                    g_strv_length (uris));
+      else
+        {
+          text = mnb_clipboard_model_dup_text (model, row);
+          if (text != NULL)
+            g_key_file_set_string (key_file, group, "Text", text);
+
+          g_free (text);
+        }
+    }
+
+  g_type_class_unref (enum_class);
+
+  contents = g_key_file_to_data (key_file, &len, NULL);
+
+  dir = g_path_get_dirname (priv->pinned_path);
+  g_mkdir_with_parents (dir, 0700);
+  g_free (dir);
+
+  if (!g_file_set_contents (priv->pinned_path, contents, len, &error))
+    {
+      g_warning ("Unable to save the pinned items: %s", error->message);
+      g_error_free (error);
+    }
+
+  g_free (contents);
+  g_key_file_free (key_file);
+
+  return FALSE;
+}
+
+static void
+mnb_clipboard_store_queue_save (MnbClipboardStore *store)
+{
+  MnbClipboardStorePrivate *priv = store->priv;
+
+  /* only the store owning the history has a file */
+  if (priv->pinned_path == NULL || priv->save_id != 0)
+    return;
+
+  priv->save_id = g_timeout_add_seconds (SAVE_PINNED_TIMEOUT,
+                                         save_pinned_items,
+                                         store);
+}
+
+/* removes the files left over by the images of a previous session,
+ * keeping the ones of the pinned items
+ */
+static void
+mnb_clipboard_store_clean_images (MnbClipboardStore *store)
+{
+  MnbClipboardModel *pinned = store->priv->pinned;
+  GPtrArray *keep;
+  guint i, n_rows;
+
+  keep = g_ptr_array_new ();
+
+  n_rows = mnb_clipboard_model_get_n_rows (pinned);
+  for (i = 0; i < n_rows; i++)
+    {
+      gchar **uris;
+
+      if (mnb_clipboard_model_get_item_type (pinned, i) != MNB_CLIPBOARD_ITEM_IMAGE)
+        continue;
+
+      uris = mnb_clipboard_model_get_uris (pinned, i);
+      if (uris != NULL && uris[0] != NULL)
+        g_ptr_array_add (keep, uris[0]);
+    }
+
+  g_ptr_array_add (keep, NULL);
+
+  mnb_clipboard_image_clean_dir ((const gchar * const *) keep->pdata);
+
+  g_ptr_array_free (keep, TRUE);
+}
+
+static gboolean
+remove_dir (const gchar *path)
+{
+  const gchar *name;
+  GDir *dir;
+
+  dir = g_dir_open (path, 0, NULL);
+  if (dir == NULL)
+    return FALSE;
+
+  while ((name = g_dir_read_name (dir)) != NULL)
+    {
+      gchar *file = g_build_filename (path, name, NULL);
+
+      g_unlink (file);
+      g_free (file);
+    }
+
+  g_dir_close (dir);
+
+  return g_rmdir (path) == 0;
+}
+
+/* every capturing store spills into a directory named after its
+ * process, so that two of them never share a file; the directories
+ * of the processes that are gone are removed, and so are the files
+ * spilled before the directories existed
+ */
+static gchar *
+mnb_clipboard_store_get_spill_dir (void)
+{
+  gchar *parent, *retval, *pid;
+  const gchar *name;
+  GDir *dir;
+
+  parent = g_build_filename (g_get_user_cache_dir (),
+                             "meego-panel-pasteboard",
+                             "spill",
+                             NULL);
+
+  dir = g_dir_open (parent, 0, NULL);
+  if (dir != NULL)
+    {
+      while ((name = g_dir_read_name (dir)) != NULL)
+        {
+          gchar *path = g_build_filename (parent, name, NULL);
+
+          if (!g_file_test (path, G_FILE_TEST_IS_DIR))
+            g_unlink (path);
+          else
+            {
+              gchar *end = NULL;
+              guint64 owner = g_ascii_strtoull (name, &end, 10);
+
+              if (end != NULL && *end == '\0' && owner > 0 &&
+                  owner != (guint64) getpid () &&
+                  kill ((pid_t) owner, 0) == -1 && errno == ESRCH)
+                remove_dir (path);
+            }
+
+          g_free (path);
+        }
+
+      g_dir_close (dir);
+    }
+
+  pid = g_strdup_printf ("%lu", (gulong) getpid ());
+  retval = g_build_filename (parent, pid, NULL);
+  g_free (pid);
+  g_free (parent);
+
+  return retval;
+}
+
+/* the pinned items are few and short, so they are loaded in one go
+ * before anything gets captured
+ */
+static void
+load_pinned_items (MnbClipboardStore *store)
+{
+  MnbClipboardStorePrivate *priv = store->priv;
+  GEnumClass *enum_class;
+  GKeyFile *key_file;
+  GError *error = NULL;
+  gchar **groups;
+  gint i;
+
+  key_file = g_key_file_new ();
+  if (!g_key_file_load_from_file (key_file, priv->pinned_path, 0, &error))
+    {
+      if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        g_warning ("Unable to load the pinned items: %s", error->message);
+
+      g_error_free (error);
+      g_key_file_free (key_file);
+      return;
+    }
+
+  enum_class = g_type_class_ref (MNB_TYPE_CLIPBOARD_ITEM_TYPE);
+
+  groups = g_key_file_get_groups (key_file, NULL);
+  for (i = 0; groups[i] != NULL; i++)
+    {
+      GEnumValue *enum_value;
+      gchar *type_nick, *text, *preview, *filter, *source;
+      gchar **uris;
+      gint64 mtime;
+
+      type_nick = g_key_file_get_string (key_file, groups[i], "Type", NULL);
+      enum_value = type_nick != NULL
+                 ? g_enum_get_value_by_nick (enum_class, type_nick)
+                 : NULL;
+      g_free (type_nick);
+
+      if (enum_value == NULL || enum_value->value == MNB_CLIPBOARD_ITEM_INVALID)
+        continue;
+
+      mtime = g_key_file_get_int64 (key_file, groups[i], "Time", NULL);
+      text = g_key_file_get_string (key_file, groups[i], "Text", NULL);
+      uris = g_key_file_get_string_list (key_file, groups[i], "URIs",
+                                         NULL, NULL);
+
+      if (text == NULL && uris == NULL)
+        continue;
+
+      if (enum_value->value == MNB_CLIPBOARD_ITEM_URIS && uris != NULL)
+        {
+          ClipboardItem tmp = { 0, };
+
+          /* the URIs are handed over to the model */
+          g_free (text);
+          clipboard_item_set_uris (&tmp, uris);
+
+          text = tmp.text;
+          preview = tmp.preview;
+          filter = tmp.filter;
+        }
+      else if (enum_value->value == MNB_CLIPBOARD_ITEM_IMAGE && uris != NULL)
+        {
+          g_free (text);
+          text = filter = NULL;
+          preview = g_strdup (uris[0]);
+        }
+      else if (text != NULL)
+        {
+          preview = mnb_clipboard_preview_new (text, -1,
+                                              MNB_CLIPBOARD_PREVIEW_MAX_LINES,
+                                              MNB_CLIPBOARD_PREVIEW_MAX_CHARS);
+          filter = mnb_clipboard_preview_filter_key (text, -1);
+        }
+      else
+        preview = filter = NULL;
+
+      mnb_clipboard_model_prepend (priv->pinned,
+                                   enum_value->value,
+                                   priv->last_serial,
+                                   mtime,
+                                   MNB_CLIPBOARD_MODEL_PINNED,
+                                   text != NULL ? g_str_hash (text) : 0,
+                                   text,
+                                   preview,
+                                   filter,
+                                   uris);
+
+      source = g_key_file_get_string (key_file, groups[i], "Source", NULL);
+      if (source != NULL)
+        mnb_clipboard_model_set_source (priv->pinned, 0,
+                                        g_quark_from_string (source));
+
+      priv->last_serial += 1;
+
+      g_free (source);
+      g_free (text);
+      g_free (preview);
+      g_free (filter);
+    }
+
+  g_strfreev (groups);
+  g_type_class_unref (enum_class);
+  g_key_file_free (key_file);
+}
+
+/* pinned items first: there are only a few of them */
+static MnbClipboardModel *
+mnb_clipboard_store_lookup (MnbClipboardStore *store,
+                            gint64             serial,
+                            gint              *row)
+{
+  MnbClipboardStorePrivate *priv = store->priv;
+
+  *row = mnb_clipboard_model_find (priv->pinned, serial);
+  if (*row >= 0)
+    return priv->pinned;
+
+  *row = mnb_clipboard_model_find (priv->model, serial);
+  if (*row >= 0)
+    return priv->model;
+
+  return NULL;
+}
+
+static void
+mnb_clipboard_store_emit_changes (MnbClipboardStore *store)
+{
+  MnbClipboardStorePrivate *priv = store->priv;
+  GArray *serials;
+
+  /* the handlers might change the store again, so we swap the
+   * pending arrays out before emitting
+   */
+  if (priv->removed_serials->len > 0)
+    {
+      guint i;
+
+      serials = priv->removed_serials;
+      priv->removed_serials = g_array_new (FALSE, FALSE, sizeof (gint64));
+
+      for (i = 0; i < serials->len; i++)
+        {
+          gint64 serial = g_array_index (serials, gint64, i);
+
+          g_hash_table_remove (priv->targets, &serial);
+
+          /* we do not serve what is not in the history anymore */
+          if (serial == priv->serving_serial &&
+              gtk_clipboard_get_owner (priv->clipboard) == G_OBJECT (store))
+            gtk_clipboard_clear (priv->clipboard);
+        }
+
+      g_signal_emit (store, store_signals[ITEMS_REMOVED], 0, serials);
+
+      g_array_free (serials, TRUE);
+    }
+
+  if (priv->added_serials->len > 0)
+    {
+      serials = priv->added_serials;
+      priv->added_serials = g_array_new (FALSE, FALSE, sizeof (gint64));
+
+      g_signal_emit (store, store_signals[ITEMS_ADDED], 0, serials);
+
+      g_array_free (serials, TRUE);
+    }
+}
+
+/* the model removes all the items in a single pass, and the
+ * listeners are notified once
+ */
+static void
+mnb_clipboard_store_real_remove_items (MnbClipboardStore *store,
+                                       const gint64      *serials,
+                                       guint              n_serials)
+{
+  MnbClipboardStorePrivate *priv = store->priv;
+  guint n_pinned;
+
+  mnb_clipboard_model_remove_serials (priv->model,
+                                      serials, n_serials,
+                                      priv->removed_serials);
+
+  /* the pinned items only go away when asked explicitly */
+  n_pinned = mnb_clipboard_model_get_n_rows (priv->pinned);
+  mnb_clipboard_model_remove_serials (priv->pinned,
+                                      serials, n_serials,
+                                      priv->removed_serials);
+
+  if (mnb_clipboard_model_get_n_rows (priv->pinned) != n_pinned)
+    mnb_clipboard_store_queue_save (store);
+
+  if (priv->update_depth == 0)
+    mnb_clipboard_store_emit_changes (store);
+}
+
+/* clears the history; the pinned items stay */
+static void
+mnb_clipboard_store_real_clear (MnbClipboardStore *store)
+{
+  MnbClipboardStorePrivate *priv = store->priv;
+
+  mnb_clipboard_model_clear (priv->model, priv->removed_serials);
+
+  if (priv->update_depth == 0)
+    mnb_clipboard_store_emit_changes (store);
+
+  gtk_clipboard_set_text (priv->clipboard, "", -1);
+}
+
+static void
+copy_back_free (CopyBack *copy_back)
+{
+  g_free (copy_back->text);
+  g_strfreev (copy_back->uris);
+
+  if (copy_back->pixbuf != NULL)
+    g_object_unref (copy_back->pixbuf);
+
+  mnb_clipboard_targets_free (copy_back->targets);
+
+  g_slice_free (CopyBack, copy_back);
+}
+
+/* everything is read before the item goes away; the image, in
+ * particular, is decoded again from its file, which is removed
+ * together with the item
+ */
+static CopyBack *
+copy_back_new (MnbClipboardModel *model,
+               gint               row)
+{
+  CopyBack *copy_back;
+  gchar **uris, *path;
+  GError *error = NULL;
+
+  copy_back = g_slice_new0 (CopyBack);
+  copy_back->type = mnb_clipboard_model_get_item_type (model, row);
+
+  if (copy_back->type != MNB_CLIPBOARD_ITEM_IMAGE)
+    {
+      copy_back->text = mnb_clipboard_model_dup_text (model, row);
+      if (copy_back->text == NULL || *copy_back->text == '\0')
+        goto fail;
+
+      copy_back->uris = g_strdupv (mnb_clipboard_model_get_uris (model, row));
+
+      return copy_back;
+    }
+
+  uris = mnb_clipboard_model_get_uris (model, row);
+  if (uris == NULL || uris[0] == NULL)
+    goto fail;
+
+  path = g_filename_from_uri (uris[0], NULL, NULL);
+  if (path == NULL)
+    goto fail;
+
+  copy_back->pixbuf = gdk_pixbuf_new_from_file (path, &error);
+  g_free (path);
+
+  if (copy_back->pixbuf == NULL)
+    {
+      g_warning ("Unable to load the copied image: %s", error->message);
+      g_error_free (error);
+      goto fail;
+    }
+
+  return copy_back;
+
+fail:
+  copy_back_free (copy_back);
+
+  return NULL;
+}
+
+static void
+copy_back_get_func (GtkClipboard     *clipboard,
+                    GtkSelectionData *selection_data,
+                    guint             info,
+                    gpointer          data)
+{
+  CopyBack *copy_back = data;
+
+  if (info != PRIMARY_TARGET_INFO)
+    {
+      mnb_clipboard_targets_serve (copy_back->targets, selection_data,
+                                   info,
+                                   FIRST_FETCHED_TARGET_INFO);
+      return;
+    }
+
+  if (copy_back->pixbuf != NULL)
+    gtk_selection_data_set_pixbuf (selection_data, copy_back->pixbuf);
+  else if (copy_back->uris == NULL ||
+           !gtk_selection_data_set_uris (selection_data, copy_back->uris))
+    gtk_selection_data_set_text (selection_data, copy_back->text, -1);
+}
+
+static void
+copy_back_clear_func (GtkClipboard *clipboard,
+                      gpointer      data)
+{
+  copy_back_free (data);
+}
+
+/* with the secondary targets, we own the clipboard and serve each
+ * target when asked; otherwise GTK+ serves the primary one for us
+ */
+static void
+copy_back_set (GtkClipboard *clipboard,
+               CopyBack     *copy_back)
+{
+  GtkTargetList *list;
+  GtkTargetEntry *entries;
+  gint n_entries;
+
+  if (copy_back->targets == NULL)
+    {
+      if (copy_back->pixbuf != NULL)
+        gtk_clipboard_set_image (clipboard, copy_back->pixbuf);
+      else
+        gtk_clipboard_set_text (clipboard, copy_back->text, -1);
+
+      copy_back_free (copy_back);
+
+      return;
+    }
+
+  list = get_primary_targets (copy_back->type);
+  mnb_clipboard_targets_add_to_list (copy_back->targets, list,
+                                     FIRST_FETCHED_TARGET_INFO);
+
+  entries = gtk_target_table_new_from_list (list, &n_entries);
+
+  if (!gtk_clipboard_set_with_data (clipboard,
+                                    entries, n_entries,
+                                    copy_back_get_func,
+                                    copy_back_clear_func,
+                                    copy_back))
+    copy_back_free (copy_back);
+
+  gtk_target_table_free (entries, n_entries);
+  gtk_target_list_unref (list);
+}
+
+static void
+serve_text (GtkSelectionData  *selection_data,
+            MnbClipboardModel *model,
+            gint               row)
+{
+  const gchar *text;
+  gchar *copy;
+
+  text = mnb_clipboard_model_get_text (model, row);
+  if (text != NULL)
+    {
+      gtk_selection_data_set_text (selection_data, text, -1);
+      return;
+    }
+
+  /* compressed or spilled to disk */
+  copy = mnb_clipboard_model_dup_text (model, row);
+  if (copy != NULL)
+    gtk_selection_data_set_text (selection_data, copy, -1);
+
+  g_free (copy);
+}
+
+/* a PNG is served straight from its file; the other formats need
+ * the image decoded
+ */
+static void
+serve_image (GtkSelectionData *selection_data,
+             const gchar      *image_uri)
+{
+  GdkAtom target = gtk_selection_data_get_target (selection_data);
+  gchar *path;
+
+  path = g_filename_from_uri (image_uri, NULL, NULL);
+  if (path == NULL)
+    return;
+
+  if (target == gdk_atom_intern_static_string ("image/png"))
+    {
+      GMappedFile *file = g_mapped_file_new (path, FALSE, NULL);
+
+      if (file != NULL)
+        {
+          const gchar *contents = g_mapped_file_get_contents (file);
+
+          gtk_selection_data_set (selection_data, target, 8,
+                                  (const guchar *) contents,
+                                  g_mapped_file_get_length (file));
+          g_mapped_file_unref (file);
+        }
+    }
+  else
+    {
+      GdkPixbuf *pixbuf = gdk_pixbuf_new_from_file (path, NULL);
+
+      if (pixbuf != NULL)
+        {
+          gtk_selection_data_set_pixbuf (selection_data, pixbuf);
+          g_object_unref (pixbuf);
+        }
+    }
+
+  g_free (path);
+}
+
+/* the item stays in the history, and every target is read from there
+ * when asked, so nothing is copied up front
+ */
+static void
+take_over_get_func (GtkClipboard     *clipboard,
+                    GtkSelectionData *selection_data,
+                    guint             info,
+                    gpointer          owner)
+{
+  MnbClipboardStore *store = owner;
+  MnbClipboardModel *model;
+  gchar **uris;
+  gint row;
+
+  model = mnb_clipboard_store_lookup (store, store->priv->serving_serial,
+                                      &row);
+  if (model == NULL)
+    return;
+
+  if (info != PRIMARY_TARGET_INFO)
+    {
+      MnbClipboardTargets *targets;
+
+      targets = g_hash_table_lookup (store->priv->targets,
+                                     &store->priv->serving_serial);
+      if (targets != NULL)
+        mnb_clipboard_targets_serve (targets, selection_data,
+                                     info,
+                                     FIRST_FETCHED_TARGET_INFO);
+
+      return;
+    }
+
+  uris = mnb_clipboard_model_get_uris (model, row);
+
+  switch (mnb_clipboard_model_get_item_type (model, row))
+    {
+    case MNB_CLIPBOARD_ITEM_TEXT:
+      serve_text (selection_data, model, row);
+      break;
+
+    case MNB_CLIPBOARD_ITEM_URIS:
+      if (uris == NULL || !gtk_selection_data_set_uris (selection_data, uris))
+        serve_text (selection_data, model, row);
+      break;
+
+    case MNB_CLIPBOARD_ITEM_IMAGE:
+      if (uris != NULL && uris[0] != NULL)
+        serve_image (selection_data, uris[0]);
+      break;
+
+    case MNB_CLIPBOARD_ITEM_INVALID:
+      break;
+    }
+}
+
+static void
+take_over_clear_func (GtkClipboard *clipboard,
+                      gpointer      owner)
+{
+  MNB_CLIPBOARD_STORE (owner)->priv->serving_serial = 0;
+}
+
+/* acts as a clipboard manager: when the owner of the clipboard goes
+ * away, we serve the newest item of the history in its place
+ */
+static void
+mnb_clipboard_store_take_over (MnbClipboardStore *store)
+{
+  MnbClipboardStorePrivate *priv = store->priv;
+  MnbClipboardTargets *targets;
+  GtkTargetList *list;
+  GtkTargetEntry *entries;
+  gint64 serial;
+  gint n_entries;
+
+  if (mnb_clipboard_model_get_n_rows (priv->model) == 0)
+    return;
+
+  serial = mnb_clipboard_model_get_serial (priv->model, 0);
+
+  list = get_primary_targets (mnb_clipboard_model_get_item_type (priv->model,
+                                                                 0));
+
+  targets = g_hash_table_lookup (priv->targets, &serial);
+  if (targets != NULL)
+    mnb_clipboard_targets_add_to_list (targets, list,
+                                       FIRST_FETCHED_TARGET_INFO);
+
+  entries = gtk_target_table_new_from_list (list, &n_entries);
+
+  if (gtk_clipboard_set_with_owner (priv->clipboard,
+                                    entries, n_entries,
+                                    take_over_get_func,
+                                    take_over_clear_func,
+                                    G_OBJECT (store)))
+    {
+      priv->serving_serial = serial;
+
+      /* and if we go away as well, someone else can keep it */
+      gtk_clipboard_set_can_store (priv->clipboard, NULL, 0);
+    }
+
+  gtk_target_table_free (entries, n_entries);
+  gtk_target_list_unref (list);
+}
+
+static void
+mnb_clipboard_store_real_copy_back (MnbClipboardStore *store,
+                                    gint64             serial)
+{
+  MnbClipboardModel *model;
+  MnbClipboardTargets *targets;
+  CopyBack *copy_back;
+  gint row;
+
+  model = mnb_clipboard_store_lookup (store, serial, &row);
+  if (model == NULL)
+    return;
+
+  copy_back = copy_back_new (model, row);
+  if (copy_back == NULL)
+    return;
+
+  /* only the targets that were fetched can be served again */
+  targets = g_hash_table_lookup (store->priv->targets, &serial);
+  if (targets != NULL && mnb_clipboard_targets_get_size (targets) > 0)
+    copy_back->targets = mnb_clipboard_targets_copy (targets);
+
+  /* remove the item from the history; a pinned item stays where it
+   * is, and the copy lands in the history
+   */
+  if (model != store->priv->pinned)
+    mnb_clipboard_store_remove (store, serial);
+
+  /* this will add another item at the beginning of the history */
+  copy_back_set (store->priv->clipboard, copy_back);
+}
+
+static void
+mnb_clipboard_store_real_save_selection (MnbClipboardStore *store)
+{
+  MnbClipboardStorePrivate *priv = store->priv;
+
+  gtk_clipboard_set_text (priv->clipboard, priv->selection, -1);
+
+  g_free (priv->selection);
+  priv->selection = NULL;
+  priv->selection_len = 0;
+
+  g_free (priv->selection_preview);
+  priv->selection_preview = NULL;
+
+  mnb_clipboard_store_announce_selection (store);
+}
+
+/* pinning moves the item out of the history, and unpinning puts it
+ * back as the newest item, so that it gets a full lifetime
+ */
+/* moves @row between the history and the pinned items; an item
+ * going back to the history becomes its newest one, with @serial
+ */
+static void
+mnb_clipboard_store_move_item (MnbClipboardStore *store,
+                               gint               row,
+                               gboolean           is_pinned,
+                               gint64             serial)
+{
+  MnbClipboardStorePrivate *priv = store->priv;
+
+  if (is_pinned)
+    mnb_clipboard_model_move_row (priv->model, row, priv->pinned,
+                                  serial,
+                                  MNB_CLIPBOARD_MODEL_PINNED,
+                                  mnb_clipboard_model_get_mtime (priv->model,
+                                                                 row));
+  else
+    {
+      GTimeVal now;
+
+      g_get_current_time (&now);
+
+      mnb_clipboard_model_move_row (priv->pinned, row, priv->model,
+                                    serial,
+                                    0,
+                                    now.tv_sec);
+    }
+}
+
+static void
+mnb_clipboard_store_real_set_pinned (MnbClipboardStore *store,
+                                     gint64             serial,
+                                     gboolean           is_pinned)
+{
+  MnbClipboardStorePrivate *priv = store->priv;
+  MnbClipboardModel *model;
+  gpointer key, targets;
+  gint64 new_serial;
+  gint row;
+
+  model = mnb_clipboard_store_lookup (store, serial, &row);
+  if (model == NULL || (model == priv->pinned) == is_pinned)
+    return;
+
+  if (is_pinned &&
+      ((mnb_clipboard_model_get_flags (model, row)
+        & MNB_CLIPBOARD_MODEL_STREAMED) != 0 ||
+       mnb_clipboard_model_get_text_size (model, row) > PINNED_MAX_TEXT_SIZE))
+    {
+      g_warning ("The clipboard item %" G_GINT64_FORMAT " is too long "
+                 "to be pinned",
+                 serial);
+      return;
+    }
+
+  if (is_pinned)
+    {
+      mnb_clipboard_store_move_item (store, row, TRUE, serial);
+      mnb_clipboard_store_queue_save (store);
+
+      g_signal_emit (store, store_signals[ITEM_CHANGED], 0, serial);
+      return;
+    }
+
+  /* the item comes back as the newest of the history, where the
+   * serials grow with the age; with its old serial it would break
+   * the lookups and the paging, so it takes a new one and is seen as
+   * removed and added again
+   */
+  new_serial = priv->last_serial;
+  priv->last_serial += 1;
+
+  mnb_clipboard_store_move_item (store, row, FALSE, new_serial);
+  mnb_clipboard_store_queue_save (store);
+
+  if (g_hash_table_lookup_extended (priv->targets, &serial, &key, &targets))
+    {
+      g_hash_table_steal (priv->targets, &serial);
+      *((gint64 *) key) = new_serial;
+      g_hash_table_insert (priv->targets, key, targets);
+    }
+
+  if (priv->clipboard_serial == serial)
+    priv->clipboard_serial = new_serial;
+
+  if (priv->serving_serial == serial)
+    priv->serving_serial = new_serial;
+
+  g_array_append_val (priv->removed_serials, serial);
+  g_array_append_val (priv->added_serials, new_serial);
+
+  /* the item might push other items out of the history */
+  mnb_clipboard_store_apply_caps (store);
+
+  if (priv->update_depth == 0)
+    mnb_clipboard_store_emit_changes (store);
+
+  mnb_clipboard_store_plan_newest_expiry (store);
+}
+
+/* degrades the history in steps as the pressure goes up, and
+ * undoes the steps as it goes down; evicted items are gone for good,
+ * but the eviction stops
+ */
+static void
+mnb_clipboard_store_apply_pressure (MnbClipboardStore *store)
+{
+  MnbClipboardStorePrivate *priv = store->priv;
+  MnbClipboardPressureLevel level = priv->pressure_level;
+  gint64 cold_time;
+  GTimeVal now;
+
+  g_get_current_time (&now);
+  cold_time = now.tv_sec - COLD_ITEM_AGE;
+
+  if (level < MNB_CLIPBOARD_PRESSURE_HIGH)
+    priv->n_restored += mnb_clipboard_model_unspill (priv->model);
+
+  if (level < MNB_CLIPBOARD_PRESSURE_MEDIUM)
+    priv->n_restored += mnb_clipboard_model_decompress (priv->model);
+
+  if (level >= MNB_CLIPBOARD_PRESSURE_MEDIUM)
+    priv->n_compressed += mnb_clipboard_model_compress (priv->model,
+                                                        cold_time,
+                                                        COMPRESS_MIN_SIZE);
+
+  if (level >= MNB_CLIPBOARD_PRESSURE_HIGH)
+    priv->n_spilled += mnb_clipboard_model_spill (priv->model, cold_time);
+
+  if (level >= MNB_CLIPBOARD_PRESSURE_CRITICAL)
+    {
+      guint n_removed = priv->removed_serials->len;
+      gint64 before[MNB_CLIPBOARD_MODEL_N_TYPES];
+      gint i;
+
+      for (i = 0; i < MNB_CLIPBOARD_MODEL_N_TYPES; i++)
+        before[i] = cold_time;
+
+      mnb_clipboard_model_remove_expired (priv->model,
+                                          before,
+                                          priv->removed_serials);
+
+      priv->n_evicted += priv->removed_serials->len - n_removed;
+
+      if (priv->update_depth == 0)
+        mnb_clipboard_store_emit_changes (store);
+    }
+}
+
+static void
+on_pressure_level_changed (MnbClipboardPressure *pressure,
+                           GParamSpec           *pspec,
+                           MnbClipboardStore    *store)
+{
+  MnbClipboardStorePrivate *priv = store->priv;
+  MnbClipboardPressureLevel level;
+
+  level = mnb_clipboard_pressure_get_level (pressure);
+  if (level == priv->pressure_level)
+    return;
+
+  /* the caches belong to the views; they drop them when notified */
+  if (priv->pressure_level == MNB_CLIPBOARD_PRESSURE_NONE)
+    priv->n_cache_drops += 1;
+
+  priv->pressure_level = level;
+
+  mnb_clipboard_store_apply_pressure (store);
+
+  /* under pressure, the cold items are looked for periodically */
+  mnb_clipboard_store_plan_expiry (store);
+
+  g_object_notify (G_OBJECT (store), "pressure-level");
+}
+
+static GArray *
+mnb_clipboard_store_real_match (MnbClipboardStore *store,
+                                const gchar       *filter)
+{
+  GArray *res;
+  gchar *needle;
+
+  res = g_array_new (FALSE, FALSE, sizeof (gint64));
+  needle = mnb_clipboard_preview_filter_key (filter, -1);
+
+  mnb_clipboard_model_match (store->priv->pinned, needle, res);
+  mnb_clipboard_model_match (store->priv->model, needle, res);
+
+  g_free (needle);
+
+  return res;
+}
+
+/* the texts are at hand, so there is nothing to wait for */
+static void
+mnb_clipboard_store_real_match_async (MnbClipboardStore     *store,
+                                      const gchar           *filter,
+                                      GCancellable          *cancellable,
+                                      MnbClipboardMatchFunc  func,
+                                      gpointer               user_data)
+{
+  GArray *serials;
+
+  if (g_cancellable_is_cancelled (cancellable))
+    return;
+
+  serials = MNB_CLIPBOARD_STORE_GET_CLASS (store)->match (store, filter);
+  func (store, serials, user_data);
+  g_array_free (serials, TRUE);
+}
+
+static void
+mnb_clipboard_store_set_property (GObject      *gobject,
+                                  guint         prop_id,
+                                  const GValue *value,
+                                  GParamSpec   *pspec)
+{
+  MnbClipboardStorePrivate *priv = MNB_CLIPBOARD_STORE (gobject)->priv;
+
+  switch (prop_id)
+    {
+    case PROP_CAPTURE:
+      priv->capture = g_value_get_boolean (value);
+      break;
+
+    case PROP_NATIVE_CAPTURE:
+      priv->native_capture = g_value_get_boolean (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (gobject, prop_id, pspec);
+      break;
+    }
+}
+
+static void
+mnb_clipboard_store_get_property (GObject    *gobject,
+                                  guint       prop_id,
+                                  GValue     *value,
+                                  GParamSpec *pspec)
+{
+  MnbClipboardStorePrivate *priv = MNB_CLIPBOARD_STORE (gobject)->priv;
+
+  switch (prop_id)
+    {
+    case PROP_CAPTURE:
+      g_value_set_boolean (value, priv->capture);
+      break;
+
+    case PROP_NATIVE_CAPTURE:
+      g_value_set_boolean (value, priv->native_capture);
+      break;
+
+    case PROP_PRESSURE_LEVEL:
+      g_value_set_enum (value, priv->pressure_level);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (gobject, prop_id, pspec);
+      break;
+    }
+}
+
+/* makes the store own the history: called once the store is
+ * constructed with :capture set, or by mnb_clipboard_store_start_capture()
+ */
+static void
+mnb_clipboard_store_setup_capture (MnbClipboardStore *self)
+{
+  MnbClipboardStorePrivate *priv = self->priv;
+  gchar *config_path, *spill_dir;
+
+  /* the pinned items come first, so they get the lowest serials */
+  g_free (priv->pinned_path);
+  priv->pinned_path = g_build_filename (g_get_user_data_dir (),
+                                        "meego-panel-pasteboard",
+                                        "pinned",
+                                        NULL);
+  load_pinned_items (self);
+
+  priv->sources = mnb_clipboard_sources_new ();
+
+  if (priv->native_capture)
+    {
+      priv->xfixes = mnb_clipboard_xfixes_new (on_xfixes_owner_change,
+                                               self);
+      if (priv->xfixes == NULL)
+        g_warning ("XFixes is not available, the selections are "
+                   "watched through GTK+");
+    }
+
+  if (priv->xfixes == NULL)
+    {
+      g_signal_connect (priv->clipboard,
+                        "owner-change",
+                        G_CALLBACK (on_clipboard_owner_change),
+                        self);
+      g_signal_connect (priv->primary,
+                        "owner-change",
+                        G_CALLBACK (on_clipboard_owner_change),
+                        self);
+    }
+
+  config_path = g_build_filename (g_get_user_config_dir (),
+                                  "meego-panel-pasteboard",
+                                  "retention.conf",
+                                  NULL);
+  priv->retention = mnb_clipboard_retention_new (config_path);
+  priv->retention_id =
+    g_signal_connect (priv->retention, "changed",
+                      G_CALLBACK (on_retention_changed),
+                      self);
+  g_free (config_path);
+
+  /* the directories are only set up, and cleaned, the first time */
+  if (mnb_clipboard_model_get_spill_dir (priv->model) != NULL)
+    return;
+
+  /* the images of the history do not outlive the session */
+  mnb_clipboard_model_set_image_dir (priv->model,
+                                     mnb_clipboard_image_get_dir ());
+  mnb_clipboard_model_set_image_dir (priv->pinned,
+                                     mnb_clipboard_image_get_dir ());
+  mnb_clipboard_store_clean_images (self);
+
+  /* only the store holding the history spills it to disk */
+  spill_dir = mnb_clipboard_store_get_spill_dir ();
+  mnb_clipboard_model_set_spill_dir (priv->model, spill_dir);
+  g_free (spill_dir);
+}
+
+/* stops watching the selections; the rows are left alone */
+static void
+mnb_clipboard_store_teardown_capture (MnbClipboardStore *self)
+{
+  MnbClipboardStorePrivate *priv = self->priv;
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (priv->deferred); i++)
+    if (priv->deferred[i].id != 0)
+      {
+        g_source_remove (priv->deferred[i].id);
+        priv->deferred[i].id = 0;
+      }
+
+  /* the last change made while we owned the history is kept; after
+   * that the pinned items are not ours to save anymore
+   */
+  if (priv->save_id != 0)
+    {
+      g_source_remove (priv->save_id);
+      save_pinned_items (self);
+    }
+
+  g_free (priv->pinned_path);
+  priv->pinned_path = NULL;
+
+  if (priv->xfixes != NULL)
+    {
+      mnb_clipboard_xfixes_free (priv->xfixes);
+      priv->xfixes = NULL;
+    }
+  else
+    {
+      g_signal_handlers_disconnect_by_func (priv->clipboard,
+                                            on_clipboard_owner_change,
+                                            self);
+      g_signal_handlers_disconnect_by_func (priv->primary,
+                                            on_clipboard_owner_change,
+                                            self);
+    }
+
+  if (priv->retention != NULL)
+    {
+      g_signal_handler_disconnect (priv->retention, priv->retention_id);
+      g_object_unref (priv->retention);
+      priv->retention = NULL;
+      priv->retention_id = 0;
+    }
+
+  mnb_clipboard_sources_free (priv->sources);
+  priv->sources = NULL;
+}
+
+static void
+mnb_clipboard_store_constructed (GObject *gobject)
+{
+  MnbClipboardStore *self = MNB_CLIPBOARD_STORE (gobject);
+  MnbClipboardStorePrivate *priv = self->priv;
+
+  if (priv->capture)
+    mnb_clipboard_store_setup_capture (self);
+
+  priv->pressure = mnb_clipboard_pressure_new ();
+  g_signal_connect (priv->pressure,
+                    "notify::level", G_CALLBACK (on_pressure_level_changed),
+                    self);
+
+  if (G_OBJECT_CLASS (mnb_clipboard_store_parent_class)->constructed)
+    G_OBJECT_CLASS (mnb_clipboard_store_parent_class)->constructed (gobject);
+}
+
+static void
+mnb_clipboard_store_finalize (GObject *gobject)
+{
+  MnbClipboardStorePrivate *priv = MNB_CLIPBOARD_STORE (gobject)->priv;
+
+  /* every pending item holds a reference on the store, so the
+   * thread pool has nothing left to do at this point
+   */
+  if (priv->preview_pool != NULL)
+    g_thread_pool_free (priv->preview_pool, TRUE, FALSE);
+
+  if (priv->expire_id != 0)
+    g_source_remove (priv->expire_id);
+
+  if (priv->fetch_id != 0)
+    g_source_remove (priv->fetch_id);
+
+  /* do not lose the last change */
+  if (priv->save_id != 0)
+    {
+      g_source_remove (priv->save_id);
+      save_pinned_items (gobject);
+    }
+
+  g_signal_handlers_disconnect_by_func (priv->pressure,
+                                        on_pressure_level_changed,
+                                        gobject);
+  g_object_unref (priv->pressure);
+
+  if (priv->capture)
+    {
+      /* the clipboard must not call back into us anymore */
+      if (gtk_clipboard_get_owner (priv->clipboard) == gobject)
+        gtk_clipboard_clear (priv->clipboard);
+
+      mnb_clipboard_store_teardown_capture (MNB_CLIPBOARD_STORE (gobject));
+    }
+
+  if (priv->settle_id != 0)
+    g_source_remove (priv->settle_id);
+
+  g_free (priv->selection);
+  g_free (priv->selection_preview);
+
+  g_array_free (priv->added_serials, TRUE);
+  g_array_free (priv->removed_serials, TRUE);
+
+  g_hash_table_destroy (priv->targets);
+
+  mnb_clipboard_model_free (priv->model);
+  mnb_clipboard_model_free (priv->pinned);
+  g_free (priv->pinned_path);
+
+  G_OBJECT_CLASS (mnb_clipboard_store_parent_class)->finalize (gobject);
+}
+
+static void
+mnb_clipboard_store_class_init (MnbClipboardStoreClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GParamSpec *pspec;
+
+  g_type_class_add_private (klass, sizeof (MnbClipboardStorePrivate));
+
+  gobject_class->set_property = mnb_clipboard_store_set_property;
+  gobject_class->get_property = mnb_clipboard_store_get_property;
+  gobject_class->constructed = mnb_clipboard_store_constructed;
+  gobject_class->finalize = mnb_clipboard_store_finalize;
+
+  klass->remove_items = mnb_clipboard_store_real_remove_items;
+  klass->clear = mnb_clipboard_store_real_clear;
+  klass->copy_back = mnb_clipboard_store_real_copy_back;
+  klass->save_selection = mnb_clipboard_store_real_save_selection;
+  klass->set_pinned = mnb_clipboard_store_real_set_pinned;
+  klass->match = mnb_clipboard_store_real_match;
+  klass->match_async = mnb_clipboard_store_real_match_async;
+
+  pspec = g_param_spec_boolean ("capture",
+                                "Capture",
+                                "Whether the store watches the selections",
+                                TRUE,
+                                G_PARAM_READWRITE |
+                                G_PARAM_CONSTRUCT_ONLY);
+  g_object_class_install_property (gobject_class, PROP_CAPTURE, pspec);
+
+  pspec = g_param_spec_boolean ("native-capture",
+                                "Native Capture",
+                                "Whether the selections are watched "
+                                "through XFixes instead of GTK+",
+                                FALSE,
+                                G_PARAM_READWRITE |
+                                G_PARAM_CONSTRUCT_ONLY);
+  g_object_class_install_property (gobject_class, PROP_NATIVE_CAPTURE, pspec);
+
+  pspec = g_param_spec_enum ("pressure-level",
+                             "Pressure Level",
+                             "The memory pressure the store is reacting to",
+                             MNB_TYPE_CLIPBOARD_PRESSURE_LEVEL,
+                             MNB_CLIPBOARD_PRESSURE_NONE,
+                             G_PARAM_READABLE);
+  g_object_class_install_property (gobject_class, PROP_PRESSURE_LEVEL, pspec);
+
+  /* the serials of the new items, in order of insertion; the
+   * newest item is the last one
+   */
+  store_signals[ITEMS_ADDED] =
+    g_signal_new (g_intern_static_string ("items-added"),
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST,
+                  G_STRUCT_OFFSET (MnbClipboardStoreClass, items_added),
+                  NULL, NULL,
+                  mnb_pasteboard_marshal_VOID__BOXED,
+                  G_TYPE_NONE, 1,
+                  G_TYPE_ARRAY);
+
+  store_signals[ITEMS_REMOVED] =
+    g_signal_new (g_intern_static_string ("items-removed"),
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST,
+                  G_STRUCT_OFFSET (MnbClipboardStoreClass, items_removed),
+                  NULL, NULL,
+                  mnb_pasteboard_marshal_VOID__BOXED,
+                  G_TYPE_NONE, 1,
+                  G_TYPE_ARRAY);
+
+  store_signals[ITEM_CHANGED] =
+    g_signal_new (g_intern_static_string ("item-changed"),
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST,
+                  G_STRUCT_OFFSET (MnbClipboardStoreClass, item_changed),
+                  NULL, NULL,
+                  mnb_pasteboard_marshal_VOID__INT64,
+                  G_TYPE_NONE, 1,
+                  G_TYPE_INT64);
+
+  store_signals[SELECTION_CHANGED] =
+    g_signal_new (g_intern_static_string ("selection-changed"),
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST,
+                  G_STRUCT_OFFSET (MnbClipboardStoreClass, selection_changed),
+                  NULL, NULL,
+                  mnb_pasteboard_marshal_VOID__STRING,
+                  G_TYPE_NONE, 1,
+                  G_TYPE_STRING);
+
+  /* emitted for every chunk of a long text, with the bytes so far */
+  store_signals[FETCH_PROGRESS] =
+    g_signal_new (g_intern_static_string ("fetch-progress"),
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST,
+                  G_STRUCT_OFFSET (MnbClipboardStoreClass, fetch_progress),
+                  NULL, NULL,
+                  mnb_pasteboard_marshal_VOID__INT64_UINT64,
+                  G_TYPE_NONE, 2,
+                  G_TYPE_INT64,
+                  G_TYPE_UINT64);
+}
+
+static void
+mnb_clipboard_store_init (MnbClipboardStore *self)
+{
+  MnbClipboardStorePrivate *priv;
+
+  self->priv = priv = MNB_CLIPBOARD_STORE_GET_PRIVATE (self);
+
+  priv->model = mnb_clipboard_model_new ();
+  priv->pinned = mnb_clipboard_model_new ();
+
+  priv->clipboard = gtk_clipboard_get (GDK_SELECTION_CLIPBOARD);
+  priv->primary = gtk_clipboard_get (GDK_SELECTION_PRIMARY);
+
+  priv->capture = TRUE;
+
+  priv->added_serials = g_array_new (FALSE, FALSE, sizeof (gint64));
+  priv->removed_serials = g_array_new (FALSE, FALSE, sizeof (gint64));
+
+  priv->targets = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+                                         g_free,
+                                         (GDestroyNotify) mnb_clipboard_targets_free);
+
+  priv->last_serial = 1;
+}
+
+MnbClipboardStore *
+mnb_clipboard_store_new (void)
+{
+  return g_object_new (MNB_TYPE_CLIPBOARD_STORE, NULL);
+}
+
+static gchar *
+mnb_clipboard_store_get_last_string (MnbClipboardStore *store,
+                                     gboolean           want_preview,
+                                     gint64            *mtime,
+                                     gint64            *serial)
+{
+  MnbClipboardModel *model = store->priv->model;
+  MnbClipboardItemType item_type;
+  gchar *text = NULL;
+  gint64 timestamp = 0;
+  gint64 id = 0;
+
+  if (mnb_clipboard_model_get_n_rows (model) == 0)
+    goto out;
+
+  item_type = mnb_clipboard_model_get_item_type (model, 0);
+  if (item_type != MNB_CLIPBOARD_ITEM_TEXT)
+    {
+      GEnumClass *enum_class;
+      GEnumValue *enum_value;
+
+      enum_class = g_type_class_peek (MNB_TYPE_CLIPBOARD_ITEM_TYPE);
+      if (G_LIKELY (enum_class != NULL))
+        {
           const gchar *nick;
 
-          enum_value = g_enum_get_value (enum_class, item_type);
-          if (G_LIKELY (enum_value != NULL))
-            nick = enum_value->value_nick;
-          else
-            nick = "<unknown>";
+          enum_value = g_enum_get_value (enum_class, item_type);
+          if (G_LIKELY (enum_value != NULL))
+            nick = enum_value->value_nick;
+          else
+            nick = "<unknown>";
+
+          g_warning ("Requested text, but the last column has type '%s'",
+                     nick);
+        }
+      else
+        g_warning ("Requested text, but the last column has type <unknown>");
+
+      goto out;
+    }
+
+  if (want_preview)
+    text = g_strdup (mnb_clipboard_model_get_preview (model, 0));
+  else
+    text = mnb_clipboard_model_dup_text (model, 0);
+
+  timestamp = mnb_clipboard_model_get_mtime (model, 0);
+  id = mnb_clipboard_model_get_serial (model, 0);
+
+out:
+  if (mtime)
+    *mtime = timestamp;
+
+  if (serial)
+    *serial = id;
+
+  return text;
+}
+
+gchar *
+mnb_clipboard_store_get_last_text (MnbClipboardStore *store,
+                                   gint64            *mtime,
+                                   gint64            *serial)
+{
+  g_return_val_if_fail (MNB_IS_CLIPBOARD_STORE (store), NULL);
+
+  return mnb_clipboard_store_get_last_string (store, FALSE,
+                                              mtime,
+                                              serial);
+}
+
+gchar *
+mnb_clipboard_store_get_last_preview (MnbClipboardStore *store,
+                                      gint64            *mtime,
+                                      gint64            *serial)
+{
+  g_return_val_if_fail (MNB_IS_CLIPBOARD_STORE (store), NULL);
+
+  return mnb_clipboard_store_get_last_string (store, TRUE,
+                                              mtime,
+                                              serial);
+}
 
-          g_warning ("Requested text, but the last column has type '%s'",
-                     nick);
-        }
-      else
-        g_warning ("Requested text, but the last column has type <unknown>");
+guint
+mnb_clipboard_store_get_n_items (MnbClipboardStore *store)
+{
+  g_return_val_if_fail (MNB_IS_CLIPBOARD_STORE (store), 0);
 
-      g_free (text);
-      text = NULL;
+  return mnb_clipboard_model_get_n_rows (store->priv->model);
+}
 
-      timestamp = 0;
-      id = 0;
-    }
+static gboolean
+get_model_row (MnbClipboardModel     *model,
+               guint                  row,
+               MnbClipboardItemType  *item_type,
+               gint64                *serial,
+               gint64                *mtime,
+               gchar                **preview,
+               gboolean              *is_pinned)
+{
+  if (row >= mnb_clipboard_model_get_n_rows (model))
+    return FALSE;
 
-  if (mtime)
-    *mtime = timestamp;
+  if (item_type)
+    *item_type = mnb_clipboard_model_get_item_type (model, row);
+
+  if (is_pinned)
+    *is_pinned = (mnb_clipboard_model_get_flags (model, row)
+                  & MNB_CLIPBOARD_MODEL_PINNED) != 0;
 
   if (serial)
-    *serial = id;
+    *serial = mnb_clipboard_model_get_serial (model, row);
 
-  return text;
+  if (mtime)
+    *mtime = mnb_clipboard_model_get_mtime (model, row);
+
+  if (preview)
+    *preview = g_strdup (mnb_clipboard_model_get_preview (model, row));
+
+  return TRUE;
+}
+
+/*
+ * mnb_clipboard_store_get_row:
+ *
+ * Retrieves the data of the item at @row of the history, row 0 being
+ * the newest item. The pinned items are not part of the history; see
+ * mnb_clipboard_store_get_pinned_row().
+ */
+gboolean
+mnb_clipboard_store_get_row (MnbClipboardStore     *store,
+                             guint                  row,
+                             MnbClipboardItemType  *item_type,
+                             gint64                *serial,
+                             gint64                *mtime,
+                             gchar                **preview,
+                             gboolean              *is_pinned)
+{
+  g_return_val_if_fail (MNB_IS_CLIPBOARD_STORE (store), FALSE);
+
+  return get_model_row (store->priv->model, row,
+                        item_type,
+                        serial,
+                        mtime,
+                        preview,
+                        is_pinned);
+}
+
+/*
+ * mnb_clipboard_store_find_row:
+ * @store: a #MnbClipboardStore
+ * @serial: a serial
+ *
+ * Finds the newest row of the history whose serial is not above
+ * @serial, without scanning the rows before it.
+ *
+ * Return value: the row, or the number of items if there is none
+ */
+guint
+mnb_clipboard_store_find_row (MnbClipboardStore *store,
+                              gint64             serial)
+{
+  g_return_val_if_fail (MNB_IS_CLIPBOARD_STORE (store), 0);
+
+  return mnb_clipboard_model_find_at_most (store->priv->model, serial);
+}
+
+guint
+mnb_clipboard_store_get_n_pinned (MnbClipboardStore *store)
+{
+  g_return_val_if_fail (MNB_IS_CLIPBOARD_STORE (store), 0);
+
+  return mnb_clipboard_model_get_n_rows (store->priv->pinned);
+}
+
+/* the pinned items, most recently pinned first */
+gboolean
+mnb_clipboard_store_get_pinned_row (MnbClipboardStore     *store,
+                                    guint                  row,
+                                    MnbClipboardItemType  *item_type,
+                                    gint64                *serial,
+                                    gint64                *mtime,
+                                    gchar                **preview)
+{
+  g_return_val_if_fail (MNB_IS_CLIPBOARD_STORE (store), FALSE);
+
+  return get_model_row (store->priv->pinned, row,
+                        item_type,
+                        serial,
+                        mtime,
+                        preview,
+                        NULL);
+}
+
+gchar *
+mnb_clipboard_store_get_text (MnbClipboardStore *store,
+                              gint64             serial)
+{
+  MnbClipboardModel *model;
+  gint row;
+
+  g_return_val_if_fail (MNB_IS_CLIPBOARD_STORE (store), NULL);
+  g_return_val_if_fail (serial > 0, NULL);
+
+  model = mnb_clipboard_store_lookup (store, serial, &row);
+  if (model == NULL)
+    return NULL;
+
+  return mnb_clipboard_model_dup_text (model, row);
+}
+
+gsize
+mnb_clipboard_store_get_text_size (MnbClipboardStore *store,
+                                   gint64             serial)
+{
+  MnbClipboardModel *model;
+  gint row;
+
+  g_return_val_if_fail (MNB_IS_CLIPBOARD_STORE (store), 0);
+
+  model = mnb_clipboard_store_lookup (store, serial, &row);
+  if (model == NULL)
+    return 0;
+
+  return mnb_clipboard_model_get_text_size (model, row);
+}
+
+/*
+ * mnb_clipboard_store_write_text:
+ * @store: a #MnbClipboardStore
+ * @serial: the serial of the item
+ * @fd: the file descriptor to write to
+ * @error: return location for a #GError, or %NULL
+ *
+ * Writes the text of the item with the given @serial to @fd, without
+ * making a copy of it in memory.
+ *
+ * Return value: %TRUE on success
+ */
+gboolean
+mnb_clipboard_store_write_text (MnbClipboardStore  *store,
+                                gint64              serial,
+                                gint                fd,
+                                GError            **error)
+{
+  MnbClipboardModel *model;
+  gint row;
+
+  g_return_val_if_fail (MNB_IS_CLIPBOARD_STORE (store), FALSE);
+  g_return_val_if_fail (fd != -1, FALSE);
+
+  model = mnb_clipboard_store_lookup (store, serial, &row);
+  if (model == NULL)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                   "No item with serial %" G_GINT64_FORMAT,
+                   serial);
+      return FALSE;
+    }
+
+  return mnb_clipboard_model_write_text (model, row, fd, error);
+}
+
+/*
+ * mnb_clipboard_store_get_item:
+ * @store: a #MnbClipboardStore
+ * @serial: the serial of the item
+ * @item_type: (out): return location for the type, or %NULL
+ * @mtime: (out): return location for the timestamp, or %NULL
+ * @preview: (out): return location for the preview, or %NULL
+ * @is_pinned: (out): return location for the pinned state, or %NULL
+ *
+ * Retrieves the data of the item with the given @serial.
+ *
+ * Return value: %TRUE if the item was found
+ */
+gboolean
+mnb_clipboard_store_get_item (MnbClipboardStore     *store,
+                              gint64                 serial,
+                              MnbClipboardItemType  *item_type,
+                              gint64                *mtime,
+                              gchar                **preview,
+                              gboolean              *is_pinned)
+{
+  MnbClipboardModel *model;
+  gint row;
+
+  g_return_val_if_fail (MNB_IS_CLIPBOARD_STORE (store), FALSE);
+
+  model = mnb_clipboard_store_lookup (store, serial, &row);
+  if (model == NULL)
+    return FALSE;
+
+  return get_model_row (model, row,
+                        item_type,
+                        NULL,
+                        mtime,
+                        preview,
+                        is_pinned);
+}
+
+/*
+ * mnb_clipboard_store_get_uris:
+ * @store: a #MnbClipboardStore
+ * @serial: the serial of a %MNB_CLIPBOARD_ITEM_URIS item
+ *
+ * Retrieves the URIs held by the item.
+ *
+ * Return value: a newly allocated %NULL-terminated array, or %NULL
+ */
+gchar **
+mnb_clipboard_store_get_uris (MnbClipboardStore *store,
+                              gint64             serial)
+{
+  MnbClipboardModel *model;
+  gint row;
+
+  g_return_val_if_fail (MNB_IS_CLIPBOARD_STORE (store), NULL);
+  g_return_val_if_fail (serial > 0, NULL);
+
+  model = mnb_clipboard_store_lookup (store, serial, &row);
+  if (model == NULL)
+    return NULL;
+
+  return g_strdupv (mnb_clipboard_model_get_uris (model, row));
+}
+
+/*
+ * mnb_clipboard_store_get_source:
+ *
+ * Retrieves the name of the application the item was copied from.
+ *
+ * Return value: the name, or %NULL if it is not known
+ */
+G_CONST_RETURN gchar *
+mnb_clipboard_store_get_source (MnbClipboardStore *store,
+                                gint64             serial)
+{
+  MnbClipboardModel *model;
+  gint row;
+
+  g_return_val_if_fail (MNB_IS_CLIPBOARD_STORE (store), NULL);
+
+  model = mnb_clipboard_store_lookup (store, serial, &row);
+  if (model == NULL)
+    return NULL;
+
+  return g_quark_to_string (mnb_clipboard_model_get_source (model, row));
+}
+
+GArray *
+mnb_clipboard_store_match (MnbClipboardStore *store,
+                           const gchar       *filter)
+{
+  g_return_val_if_fail (MNB_IS_CLIPBOARD_STORE (store), NULL);
+  g_return_val_if_fail (filter != NULL, NULL);
+
+  return MNB_CLIPBOARD_STORE_GET_CLASS (store)->match (store, filter);
+}
+
+/*
+ * mnb_clipboard_store_match_async:
+ * @store: a #MnbClipboardStore
+ * @filter: the text to look for
+ * @cancellable: (allow-none): a #GCancellable
+ * @func: the function called with the serials of the matching items
+ * @user_data: data for @func
+ *
+ * Looks for @filter in the items of @store, calling @func from the
+ * main loop unless @cancellable was cancelled. A store holding the
+ * texts calls @func before returning; a store searching through
+ * another process does not block while waiting for it.
+ */
+void
+mnb_clipboard_store_match_async (MnbClipboardStore     *store,
+                                 const gchar           *filter,
+                                 GCancellable          *cancellable,
+                                 MnbClipboardMatchFunc  func,
+                                 gpointer               user_data)
+{
+  g_return_if_fail (MNB_IS_CLIPBOARD_STORE (store));
+  g_return_if_fail (filter != NULL);
+  g_return_if_fail (func != NULL);
+
+  MNB_CLIPBOARD_STORE_GET_CLASS (store)->match_async (store, filter,
+                                                      cancellable,
+                                                      func, user_data);
 }
 
 void
 mnb_clipboard_store_remove (MnbClipboardStore *store,
                             gint64             serial)
 {
-  ClutterModelIter *iter;
-  gint row_id = -1;
+  g_return_if_fail (MNB_IS_CLIPBOARD_STORE (store));
+  g_return_if_fail (serial > 0);
+
+  MNB_CLIPBOARD_STORE_GET_CLASS (store)->remove_items (store, &serial, 1);
+}
+
+/*
+ * mnb_clipboard_store_remove_items:
+ * @store: a #MnbClipboardStore
+ * @serials: (array length=n_serials): the serials of the items
+ * @n_serials: the number of serials
+ *
+ * Removes all the given items with a single ::items-removed
+ * emission. Unknown serials are ignored.
+ */
+void
+mnb_clipboard_store_remove_items (MnbClipboardStore *store,
+                                  const gint64      *serials,
+                                  guint              n_serials)
+{
+  g_return_if_fail (MNB_IS_CLIPBOARD_STORE (store));
+  g_return_if_fail (serials != NULL || n_serials == 0);
+
+  if (n_serials == 0)
+    return;
+
+  MNB_CLIPBOARD_STORE_GET_CLASS (store)->remove_items (store,
+                                                       serials,
+                                                       n_serials);
+}
 
+void
+mnb_clipboard_store_copy_back (MnbClipboardStore *store,
+                               gint64             serial)
+{
   g_return_if_fail (MNB_IS_CLIPBOARD_STORE (store));
   g_return_if_fail (serial > 0);
 
-  iter = clutter_model_get_first_iter (CLUTTER_MODEL (store));
-  while (!clutter_model_iter_is_last (iter))
-    {
-      gint64 serial_iter = 0;
+  MNB_CLIPBOARD_STORE_GET_CLASS (store)->copy_back (store, serial);
+}
 
-      clutter_model_iter_get (iter, COLUMN_ITEM_SERIAL, &serial_iter, -1);
-      if (serial_iter == serial)
-        {
-          row_id = clutter_model_iter_get_row (iter);
-          break;
-        }
+void
+mnb_clipboard_store_set_pinned (MnbClipboardStore *store,
+                                gint64             serial,
+                                gboolean           is_pinned)
+{
+  g_return_if_fail (MNB_IS_CLIPBOARD_STORE (store));
+  g_return_if_fail (serial > 0);
 
-      iter = clutter_model_iter_next (iter);
-    }
+  MNB_CLIPBOARD_STORE_GET_CLASS (store)->set_pinned (store, serial,
+                                                     is_pinned != FALSE);
+}
+
+/*
+ * mnb_clipboard_store_mirror_pinned:
+ * @store: a #MnbClipboardStore
+ * @serial: the serial of the item
+ * @is_pinned: whether the item is pinned
+ *
+ * Moves an item between the history and the pinned items, for stores
+ * mirroring another process: unlike mnb_clipboard_store_set_pinned(),
+ * the item is neither checked nor saved, since the process owning the
+ * history already did both.
+ */
+void
+mnb_clipboard_store_mirror_pinned (MnbClipboardStore *store,
+                                   gint64             serial,
+                                   gboolean           is_pinned)
+{
+  MnbClipboardModel *model;
+  gint row;
 
-  g_object_unref (iter);
+  g_return_if_fail (MNB_IS_CLIPBOARD_STORE (store));
 
-  if (row_id == -1)
+  model = mnb_clipboard_store_lookup (store, serial, &row);
+  if (model == NULL || (model == store->priv->pinned) == !!is_pinned)
     return;
 
-  clutter_model_remove (CLUTTER_MODEL (store), row_id);
+  mnb_clipboard_store_move_item (store, row, is_pinned, serial);
+
+  g_signal_emit (store, store_signals[ITEM_CHANGED], 0, serial);
 }
 
+/*
+ * mnb_clipboard_store_start_capture:
+ * @store: a #MnbClipboardStore
+ *
+ * Makes @store own the history, for a store created without the
+ * :capture property: the pinned items are loaded, and the selections
+ * are captured until mnb_clipboard_store_stop_capture() is called.
+ */
 void
-mnb_clipboard_store_save_selection (MnbClipboardStore *store)
+mnb_clipboard_store_start_capture (MnbClipboardStore *store)
+{
+  g_return_if_fail (MNB_IS_CLIPBOARD_STORE (store));
+
+  if (store->priv->capture)
+    return;
+
+  store->priv->capture = TRUE;
+  mnb_clipboard_store_setup_capture (store);
+}
+
+/*
+ * mnb_clipboard_store_stop_capture:
+ * @store: a #MnbClipboardStore
+ *
+ * Stops capturing the selections; the pending change to the pinned
+ * items is saved, and the rows of @store are left alone.
+ */
+void
+mnb_clipboard_store_stop_capture (MnbClipboardStore *store)
+{
+  g_return_if_fail (MNB_IS_CLIPBOARD_STORE (store));
+
+  if (!store->priv->capture)
+    return;
+
+  mnb_clipboard_store_teardown_capture (store);
+  store->priv->capture = FALSE;
+}
+
+/*
+ * mnb_clipboard_store_begin_update:
+ * @store: a #MnbClipboardStore
+ *
+ * Starts a batch of changes; the ::items-added and ::items-removed
+ * signals are emitted once, when the matching call to
+ * mnb_clipboard_store_end_update() is made. Updates can be nested.
+ */
+void
+mnb_clipboard_store_begin_update (MnbClipboardStore *store)
+{
+  g_return_if_fail (MNB_IS_CLIPBOARD_STORE (store));
+
+  store->priv->update_depth += 1;
+}
+
+void
+mnb_clipboard_store_end_update (MnbClipboardStore *store)
 {
   MnbClipboardStorePrivate *priv;
 
@@ -516,21 +3299,176 @@ mnb_clipboard_store_save_selection (MnbClipboardStore *store)
 
   priv = store->priv;
 
-  gtk_clipboard_set_text (priv->clipboard, priv->selection, -1);
+  g_return_if_fail (priv->update_depth > 0);
+
+  priv->update_depth -= 1;
+
+  if (priv->update_depth == 0)
+    mnb_clipboard_store_emit_changes (store);
+}
+
+/*
+ * mnb_clipboard_store_add_item:
+ * @store: a #MnbClipboardStore
+ * @item_type: the type of the item
+ * @serial: the serial of the item
+ * @mtime: the timestamp of the item
+ * @text: (allow-none): the full text, or %NULL
+ * @preview: the preview of the text
+ *
+ * Prepends an item that was not captured by @store itself, for
+ * instance when mirroring the history of another process.
+ */
+void
+mnb_clipboard_store_add_item (MnbClipboardStore    *store,
+                              MnbClipboardItemType  item_type,
+                              gint64                serial,
+                              gint64                mtime,
+                              const gchar          *text,
+                              const gchar          *preview)
+{
+  ClipboardItem *item;
+
+  g_return_if_fail (MNB_IS_CLIPBOARD_STORE (store));
+  g_return_if_fail (preview != NULL);
+
+  item = g_slice_new0 (ClipboardItem);
+  item->type = item_type;
+  item->store = g_object_ref (store);
+  item->serial = serial;
+  item->mtime = mtime;
+  /* the preview of a list of URIs is the list */
+  if (item_type == MNB_CLIPBOARD_ITEM_URIS)
+    clipboard_item_set_uris (item, g_strsplit (preview, "\n", -1));
+  else if (item_type == MNB_CLIPBOARD_ITEM_IMAGE)
+    {
+      /* and the preview of an image is its URI */
+      item->uris = g_new0 (gchar *, 2);
+      item->uris[0] = g_strdup (preview);
+      item->preview = g_strdup (preview);
+    }
+  else
+    {
+      item->text = g_strdup (text);
+      item->preview = g_strdup (preview);
+      item->filter =
+        mnb_clipboard_preview_filter_key (text != NULL ? text : preview, -1);
+    }
+
+  if (serial >= store->priv->last_serial)
+    store->priv->last_serial = serial + 1;
+
+  mnb_clipboard_store_insert_item (store, item);
+  clipboard_item_free (item);
+}
+
+gchar *
+mnb_clipboard_store_get_selection_preview (MnbClipboardStore *store)
+{
+  MnbClipboardStorePrivate *priv;
+
+  g_return_val_if_fail (MNB_IS_CLIPBOARD_STORE (store), NULL);
+
+  priv = store->priv;
+
+  /* a drag that did not settle yet is included */
+  return g_strdup (priv->selection_preview);
+}
+
+/*
+ * mnb_clipboard_store_set_selection:
+ * @store: a #MnbClipboardStore
+ * @text: (allow-none): the contents of the selection
+ *
+ * Sets the current selection, for stores that do not capture it.
+ */
+void
+mnb_clipboard_store_set_selection (MnbClipboardStore *store,
+                                   const gchar       *text)
+{
+  MnbClipboardStorePrivate *priv;
+
+  g_return_if_fail (MNB_IS_CLIPBOARD_STORE (store));
+
+  priv = store->priv;
 
   g_free (priv->selection);
-  priv->selection = NULL;
+  priv->selection = g_strdup (text);
+  priv->selection_len = text != NULL ? strlen (text) : 0;
+
+  g_free (priv->selection_preview);
+  priv->selection_preview = NULL;
+
+  if (text != NULL && *text != '\0')
+    priv->selection_preview =
+      mnb_clipboard_preview_new (text, priv->selection_len,
+                                 MNB_CLIPBOARD_PREVIEW_MAX_LINES,
+                                 MNB_CLIPBOARD_PREVIEW_MAX_CHARS);
+
+  mnb_clipboard_store_announce_selection (store);
+}
+
+void
+mnb_clipboard_store_save_selection (MnbClipboardStore *store)
+{
+  g_return_if_fail (MNB_IS_CLIPBOARD_STORE (store));
 
-  g_signal_emit (store, store_signals[SELECTION_CHANGED], 0, NULL);
+  MNB_CLIPBOARD_STORE_GET_CLASS (store)->save_selection (store);
 }
 
 void
 mnb_clipboard_store_clear (MnbClipboardStore *store)
 {
-  while (clutter_model_get_n_rows (CLUTTER_MODEL (store)))
-    clutter_model_remove (CLUTTER_MODEL (store), 0);
+  g_return_if_fail (MNB_IS_CLIPBOARD_STORE (store));
+
+  MNB_CLIPBOARD_STORE_GET_CLASS (store)->clear (store);
+}
+
+MnbClipboardPressureLevel
+mnb_clipboard_store_get_pressure_level (MnbClipboardStore *store)
+{
+  g_return_val_if_fail (MNB_IS_CLIPBOARD_STORE (store),
+                        MNB_CLIPBOARD_PRESSURE_NONE);
+
+  return store->priv->pressure_level;
+}
+
+/*
+ * mnb_clipboard_store_get_stats:
+ * @store: a #MnbClipboardStore
+ * @stats: (out): return location for the statistics
+ *
+ * Retrieves the memory used by the history, and the actions taken
+ * under memory pressure since the store was created.
+ */
+void
+mnb_clipboard_store_get_stats (MnbClipboardStore      *store,
+                               MnbClipboardStoreStats *stats)
+{
+  MnbClipboardStorePrivate *priv;
+
+  g_return_if_fail (MNB_IS_CLIPBOARD_STORE (store));
+  g_return_if_fail (stats != NULL);
+
+  priv = store->priv;
 
-  gtk_clipboard_set_text (store->priv->clipboard, "", -1);
+  memset (stats, 0, sizeof (MnbClipboardStoreStats));
+
+  stats->n_items = mnb_clipboard_model_get_n_rows (priv->model);
+  stats->n_pinned_items = mnb_clipboard_model_get_n_rows (priv->pinned);
+  mnb_clipboard_model_get_memory_stats (priv->model,
+                                        &stats->arena_live_bytes,
+                                        &stats->arena_allocated_bytes,
+                                        &stats->n_compressed_items,
+                                        &stats->n_spilled_items);
+
+  stats->pressure_level = priv->pressure_level;
+  stats->n_cache_drops = priv->n_cache_drops;
+  stats->n_compressed = priv->n_compressed;
+  stats->n_spilled = priv->n_spilled;
+  stats->n_evicted = priv->n_evicted;
+  stats->n_restored = priv->n_restored;
+  stats->n_throttled = priv->n_throttled;
 }
 
 GType
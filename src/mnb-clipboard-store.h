@@ -20,7 +20,9 @@
 #ifndef __MNB_CLIPBOARD_STORE_H__
 #define __MNB_CLIPBOARD_STORE_H__
 
-#include <clutter/clutter.h>
+#include <gio/gio.h>
+
+#include "mnb-clipboard-pressure.h"
 
 G_BEGIN_DECLS
 
@@ -36,6 +38,7 @@ G_BEGIN_DECLS
 typedef struct _MnbClipboardStore               MnbClipboardStore;
 typedef struct _MnbClipboardStorePrivate        MnbClipboardStorePrivate;
 typedef struct _MnbClipboardStoreClass          MnbClipboardStoreClass;
+typedef struct _MnbClipboardStoreStats          MnbClipboardStoreStats;
 
 typedef enum {
   MNB_CLIPBOARD_ITEM_INVALID = 0,
@@ -44,24 +47,79 @@ typedef enum {
   MNB_CLIPBOARD_ITEM_IMAGE
 } MnbClipboardItemType;
 
+/* @serials belong to the caller of the function */
+typedef void (* MnbClipboardMatchFunc) (MnbClipboardStore *store,
+                                        GArray            *serials,
+                                        gpointer           user_data);
+
+struct _MnbClipboardStoreStats
+{
+  guint n_items;
+  guint n_pinned_items;
+
+  gsize arena_live_bytes;
+  gsize arena_allocated_bytes;
+
+  /* the items currently compressed, or spilled to disk */
+  guint n_compressed_items;
+  guint n_spilled_items;
+
+  MnbClipboardPressureLevel pressure_level;
+
+  /* the actions taken since the store was created */
+  guint n_cache_drops;
+  guint n_compressed;
+  guint n_spilled;
+  guint n_evicted;
+  guint n_restored;
+
+  /* the captures put off by the rate limit of their application */
+  guint n_throttled;
+};
+
 struct _MnbClipboardStore
 {
-  ClutterListModel parent_instance;
+  GObject parent_instance;
 
   MnbClipboardStorePrivate *priv;
 };
 
 struct _MnbClipboardStoreClass
 {
-  ClutterListModelClass parent_class;
+  GObjectClass parent_class;
 
   void (* selection_changed) (MnbClipboardStore *store,
                               const gchar       *selection);
 
-  void (* item_added)   (MnbClipboardStore    *store,
-                         MnbClipboardItemType  item_type);
-  void (* item_removed) (MnbClipboardStore    *store,
-                         gint64                serial);
+  void (* items_added)   (MnbClipboardStore *store,
+                          GArray            *serials);
+  void (* items_removed) (MnbClipboardStore *store,
+                          GArray            *serials);
+  void (* item_changed)  (MnbClipboardStore *store,
+                          gint64             serial);
+
+  void (* fetch_progress) (MnbClipboardStore *store,
+                           gint64             serial,
+                           guint64            n_bytes);
+
+  /* operations; overridden by stores that do not own the history */
+  void (* remove_items)   (MnbClipboardStore *store,
+                           const gint64      *serials,
+                           guint              n_serials);
+  void (* clear)          (MnbClipboardStore *store);
+  void (* copy_back)      (MnbClipboardStore *store,
+                           gint64             serial);
+  void (* save_selection) (MnbClipboardStore *store);
+  void (* set_pinned)     (MnbClipboardStore *store,
+                           gint64             serial,
+                           gboolean           is_pinned);
+  GArray *(* match)       (MnbClipboardStore *store,
+                           const gchar       *filter);
+  void (* match_async)    (MnbClipboardStore     *store,
+                           const gchar           *filter,
+                           GCancellable          *cancellable,
+                           MnbClipboardMatchFunc  func,
+                           gpointer               user_data);
 };
 
 GType mnb_clipboard_item_type_get_type (void) G_GNUC_CONST;
@@ -75,13 +133,96 @@ gchar * mnb_clipboard_store_get_last_text (MnbClipboardStore *store,
 gchar **mnb_clipboard_store_get_last_uris (MnbClipboardStore *store,
                                            gint64            *mtime,
                                            gint64            *serial);
+gchar * mnb_clipboard_store_get_last_preview (MnbClipboardStore *store,
+                                              gint64            *mtime,
+                                              gint64            *serial);
+
+gchar * mnb_clipboard_store_get_text (MnbClipboardStore *store,
+                                      gint64             serial);
+gchar **mnb_clipboard_store_get_uris (MnbClipboardStore *store,
+                                      gint64             serial);
+
+gsize    mnb_clipboard_store_get_text_size (MnbClipboardStore  *store,
+                                            gint64              serial);
+gboolean mnb_clipboard_store_write_text    (MnbClipboardStore  *store,
+                                            gint64              serial,
+                                            gint                fd,
+                                            GError            **error);
+
+G_CONST_RETURN gchar *mnb_clipboard_store_get_source (MnbClipboardStore *store,
+                                                      gint64             serial);
+
+guint    mnb_clipboard_store_get_n_items (MnbClipboardStore     *store);
+guint    mnb_clipboard_store_find_row    (MnbClipboardStore     *store,
+                                          gint64                 serial);
+gboolean mnb_clipboard_store_get_row     (MnbClipboardStore     *store,
+                                          guint                  row,
+                                          MnbClipboardItemType  *item_type,
+                                          gint64                *serial,
+                                          gint64                *mtime,
+                                          gchar                **preview,
+                                          gboolean              *is_pinned);
+
+guint    mnb_clipboard_store_get_n_pinned   (MnbClipboardStore     *store);
+gboolean mnb_clipboard_store_get_pinned_row (MnbClipboardStore     *store,
+                                             guint                  row,
+                                             MnbClipboardItemType  *item_type,
+                                             gint64                *serial,
+                                             gint64                *mtime,
+                                             gchar                **preview);
+
+gboolean mnb_clipboard_store_get_item (MnbClipboardStore     *store,
+                                       gint64                 serial,
+                                       MnbClipboardItemType  *item_type,
+                                       gint64                *mtime,
+                                       gchar                **preview,
+                                       gboolean              *is_pinned);
+
+void mnb_clipboard_store_add_item (MnbClipboardStore    *store,
+                                   MnbClipboardItemType  item_type,
+                                   gint64                serial,
+                                   gint64                mtime,
+                                   const gchar          *text,
+                                   const gchar          *preview);
+
+GArray *mnb_clipboard_store_match       (MnbClipboardStore     *store,
+                                         const gchar           *filter);
+void    mnb_clipboard_store_match_async (MnbClipboardStore     *store,
+                                         const gchar           *filter,
+                                         GCancellable          *cancellable,
+                                         MnbClipboardMatchFunc  func,
+                                         gpointer               user_data);
+
+void mnb_clipboard_store_remove       (MnbClipboardStore *store,
+                                       gint64             serial);
+void mnb_clipboard_store_remove_items (MnbClipboardStore *store,
+                                       const gint64      *serials,
+                                       guint              n_serials);
+void mnb_clipboard_store_copy_back (MnbClipboardStore *store,
+                                    gint64             serial);
+void mnb_clipboard_store_set_pinned (MnbClipboardStore *store,
+                                     gint64             serial,
+                                     gboolean           is_pinned);
+void mnb_clipboard_store_mirror_pinned (MnbClipboardStore *store,
+                                        gint64             serial,
+                                        gboolean           is_pinned);
+
+gchar *mnb_clipboard_store_get_selection_preview (MnbClipboardStore *store);
+void   mnb_clipboard_store_set_selection         (MnbClipboardStore *store,
+                                                  const gchar       *text);
+void   mnb_clipboard_store_save_selection        (MnbClipboardStore *store);
 
-void mnb_clipboard_store_remove (MnbClipboardStore *store,
-                                 gint64             serial);
+void mnb_clipboard_store_clear (MnbClipboardStore *store);
 
-void mnb_clipboard_store_save_selection (MnbClipboardStore *store);
+void mnb_clipboard_store_start_capture (MnbClipboardStore *store);
+void mnb_clipboard_store_stop_capture  (MnbClipboardStore *store);
 
-void mnb_clipboard_store_clear (MnbClipboardStore *store);
+void mnb_clipboard_store_begin_update (MnbClipboardStore *store);
+void mnb_clipboard_store_end_update   (MnbClipboardStore *store);
+
+MnbClipboardPressureLevel mnb_clipboard_store_get_pressure_level (MnbClipboardStore      *store);
+void                      mnb_clipboard_store_get_stats          (MnbClipboardStore      *store,
+                                                                  MnbClipboardStoreStats *stats);
 
 G_END_DECLS
 
@@ -0,0 +1,338 @@
+/*
+ * Copyright (C) 2008 - 2009 Intel Corporation.
+ *
+ * Author: Emmanuele Bassi <ebassi@linux.intel.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * MnbClipboardTargets: the secondary representations of an item
+ *
+ * The owner of the clipboard usually offers the same contents in many
+ * formats: rich text, HTML, images, application-specific data. Only
+ * the plain representation is fetched when the item is captured; the
+ * other targets are recorded, and their data is fetched later, one at
+ * a time, while the owner is still around. When the item is copied
+ * back, every fetched target is served again on demand.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "mnb-clipboard-targets.h"
+
+typedef enum {
+  TARGET_MISSING,
+  TARGET_REQUESTED,
+  TARGET_FETCHED
+} TargetState;
+
+typedef struct {
+  GdkAtom target;
+
+  /* as received from the owner */
+  GdkAtom type;
+  gint format;
+  guchar *data;
+  gint length;
+
+  TargetState state;
+} Target;
+
+struct _MnbClipboardTargets
+{
+  Target *targets;
+  guint n_targets;
+
+  /* the sum of the fetched data */
+  gsize size;
+};
+
+/* the targets of the selection protocol itself */
+static gboolean
+is_meta_target (GdkAtom atom)
+{
+  static const gchar *meta_targets[] = {
+    "TARGETS",
+    "TIMESTAMP",
+    "MULTIPLE",
+    "SAVE_TARGETS",
+    "DELETE",
+    "INSERT_SELECTION",
+    "INSERT_PROPERTY"
+  };
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (meta_targets); i++)
+    if (atom == gdk_atom_intern_static_string (meta_targets[i]))
+      return TRUE;
+
+  return FALSE;
+}
+
+/*
+ * mnb_clipboard_targets_new:
+ * @atoms: the targets offered by the owner
+ * @n_atoms: the number of targets
+ * @primary: the targets served from the primary representation
+ *
+ * Records the targets offered for an item, leaving out the ones that
+ * the primary representation already covers.
+ *
+ * Return value: the new targets, or %NULL if there is nothing to keep
+ */
+MnbClipboardTargets *
+mnb_clipboard_targets_new (const GdkAtom *atoms,
+                           gint           n_atoms,
+                           GtkTargetList *primary)
+{
+  MnbClipboardTargets *targets;
+  gint i;
+
+  g_return_val_if_fail (atoms != NULL || n_atoms == 0, NULL);
+
+  targets = g_slice_new0 (MnbClipboardTargets);
+  targets->targets = g_new0 (Target, MAX (n_atoms, 1));
+
+  for (i = 0; i < n_atoms; i++)
+    {
+      guint j;
+
+      if (is_meta_target (atoms[i]))
+        continue;
+
+      if (primary != NULL && gtk_target_list_find (primary, atoms[i], NULL))
+        continue;
+
+      for (j = 0; j < targets->n_targets; j++)
+        if (targets->targets[j].target == atoms[i])
+          break;
+
+      if (j < targets->n_targets)
+        continue;
+
+      targets->targets[targets->n_targets].target = atoms[i];
+      targets->n_targets += 1;
+    }
+
+  if (targets->n_targets == 0)
+    {
+      mnb_clipboard_targets_free (targets);
+      return NULL;
+    }
+
+  return targets;
+}
+
+MnbClipboardTargets *
+mnb_clipboard_targets_copy (MnbClipboardTargets *targets)
+{
+  MnbClipboardTargets *copy;
+  guint i;
+
+  g_return_val_if_fail (targets != NULL, NULL);
+
+  copy = g_slice_new0 (MnbClipboardTargets);
+  copy->targets = g_memdup (targets->targets,
+                            targets->n_targets * sizeof (Target));
+  copy->n_targets = targets->n_targets;
+  copy->size = targets->size;
+
+  for (i = 0; i < copy->n_targets; i++)
+    {
+      Target *target = &copy->targets[i];
+
+      if (target->state == TARGET_FETCHED)
+        target->data = g_memdup (target->data, target->length + 1);
+      else
+        target->data = NULL;
+    }
+
+  return copy;
+}
+
+void
+mnb_clipboard_targets_free (MnbClipboardTargets *targets)
+{
+  guint i;
+
+  if (targets == NULL)
+    return;
+
+  for (i = 0; i < targets->n_targets; i++)
+    g_free (targets->targets[i].data);
+
+  g_free (targets->targets);
+
+  g_slice_free (MnbClipboardTargets, targets);
+}
+
+guint
+mnb_clipboard_targets_get_n_targets (MnbClipboardTargets *targets)
+{
+  g_return_val_if_fail (targets != NULL, 0);
+
+  return targets->n_targets;
+}
+
+gsize
+mnb_clipboard_targets_get_size (MnbClipboardTargets *targets)
+{
+  g_return_val_if_fail (targets != NULL, 0);
+
+  return targets->size;
+}
+
+/*
+ * mnb_clipboard_targets_next_missing:
+ * @targets: a #MnbClipboardTargets
+ *
+ * Picks the next target to fetch. A target is only picked once: if
+ * the owner fails to convert it, it is not asked again.
+ *
+ * Return value: the target, or %GDK_NONE when all were asked for
+ */
+GdkAtom
+mnb_clipboard_targets_next_missing (MnbClipboardTargets *targets)
+{
+  guint i;
+
+  g_return_val_if_fail (targets != NULL, GDK_NONE);
+
+  for (i = 0; i < targets->n_targets; i++)
+    {
+      if (targets->targets[i].state == TARGET_MISSING)
+        {
+          targets->targets[i].state = TARGET_REQUESTED;
+          return targets->targets[i].target;
+        }
+    }
+
+  return GDK_NONE;
+}
+
+/*
+ * mnb_clipboard_targets_set_data:
+ * @targets: a #MnbClipboardTargets
+ * @selection_data: the contents of one of the targets
+ *
+ * Keeps a copy of the contents of a requested target.
+ *
+ * Return value: %TRUE if the contents were kept
+ */
+gboolean
+mnb_clipboard_targets_set_data (MnbClipboardTargets *targets,
+                                GtkSelectionData    *selection_data)
+{
+  const guchar *data;
+  GdkAtom target_atom;
+  Target *target = NULL;
+  gint length;
+  guint i;
+
+  g_return_val_if_fail (targets != NULL, FALSE);
+  g_return_val_if_fail (selection_data != NULL, FALSE);
+
+  target_atom = gtk_selection_data_get_target (selection_data);
+
+  for (i = 0; i < targets->n_targets; i++)
+    {
+      if (targets->targets[i].target == target_atom)
+        {
+          target = &targets->targets[i];
+          break;
+        }
+    }
+
+  if (target == NULL || target->state != TARGET_REQUESTED)
+    return FALSE;
+
+  data = gtk_selection_data_get_data (selection_data);
+  length = gtk_selection_data_get_length (selection_data);
+
+  if (data == NULL || length < 0 ||
+      length > MNB_CLIPBOARD_TARGETS_MAX_DATA_SIZE)
+    return FALSE;
+
+  /* GTK+ terminates the data, and so do we */
+  target->data = g_malloc (length + 1);
+  memcpy (target->data, data, length);
+  target->data[length] = '\0';
+
+  target->length = length;
+  target->type = gtk_selection_data_get_data_type (selection_data);
+  target->format = gtk_selection_data_get_format (selection_data);
+  target->state = TARGET_FETCHED;
+
+  targets->size += length;
+
+  return TRUE;
+}
+
+void
+mnb_clipboard_targets_add_to_list (MnbClipboardTargets *targets,
+                                   GtkTargetList       *list,
+                                   guint                first_info)
+{
+  guint i;
+
+  g_return_if_fail (targets != NULL);
+  g_return_if_fail (list != NULL);
+
+  for (i = 0; i < targets->n_targets; i++)
+    if (targets->targets[i].state == TARGET_FETCHED)
+      gtk_target_list_add (list, targets->targets[i].target, 0,
+                           first_info + i);
+}
+
+/*
+ * mnb_clipboard_targets_serve:
+ * @targets: a #MnbClipboardTargets
+ * @selection_data: the #GtkSelectionData to fill
+ * @info: the info of the requested target
+ * @first_info: the info passed to mnb_clipboard_targets_add_to_list()
+ *
+ * Serves a fetched target, as it was received from its owner.
+ *
+ * Return value: %TRUE if @info is one of the fetched targets
+ */
+gboolean
+mnb_clipboard_targets_serve (MnbClipboardTargets *targets,
+                             GtkSelectionData    *selection_data,
+                             guint                info,
+                             guint                first_info)
+{
+  Target *target;
+
+  g_return_val_if_fail (targets != NULL, FALSE);
+
+  if (info < first_info || info - first_info >= targets->n_targets)
+    return FALSE;
+
+  target = &targets->targets[info - first_info];
+  if (target->state != TARGET_FETCHED)
+    return FALSE;
+
+  gtk_selection_data_set (selection_data,
+                          target->type,
+                          target->format,
+                          target->data,
+                          target->length);
+
+  return TRUE;
+}
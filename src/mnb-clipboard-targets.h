@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2008 - 2009 Intel Corporation.
+ *
+ * Author: Emmanuele Bassi <ebassi@linux.intel.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __MNB_CLIPBOARD_TARGETS_H__
+#define __MNB_CLIPBOARD_TARGETS_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+typedef struct _MnbClipboardTargets     MnbClipboardTargets;
+
+/* the targets bigger than this are not kept */
+#define MNB_CLIPBOARD_TARGETS_MAX_DATA_SIZE     (4 * 1024 * 1024)
+
+MnbClipboardTargets *mnb_clipboard_targets_new  (const GdkAtom       *atoms,
+                                                 gint                 n_atoms,
+                                                 GtkTargetList       *primary);
+MnbClipboardTargets *mnb_clipboard_targets_copy (MnbClipboardTargets *targets);
+void                 mnb_clipboard_targets_free (MnbClipboardTargets *targets);
+
+guint mnb_clipboard_targets_get_n_targets (MnbClipboardTargets *targets);
+gsize mnb_clipboard_targets_get_size      (MnbClipboardTargets *targets);
+
+/* the lazy fetch; every target is only asked for once */
+GdkAtom  mnb_clipboard_targets_next_missing (MnbClipboardTargets *targets);
+gboolean mnb_clipboard_targets_set_data     (MnbClipboardTargets *targets,
+                                             GtkSelectionData    *selection_data);
+
+/* the copy back; the info of the fetched targets starts at @first_info */
+void     mnb_clipboard_targets_add_to_list (MnbClipboardTargets *targets,
+                                            GtkTargetList       *list,
+                                            guint                first_info);
+gboolean mnb_clipboard_targets_serve       (MnbClipboardTargets *targets,
+                                            GtkSelectionData    *selection_data,
+                                            guint                info,
+                                            guint                first_info);
+
+G_END_DECLS
+
+#endif /* __MNB_CLIPBOARD_TARGETS_H__ */
@@ -0,0 +1,294 @@
+/*
+ * Copyright (C) 2008 - 2009 Intel Corporation.
+ *
+ * Author: Emmanuele Bassi <ebassi@linux.intel.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <cogl/cogl-pango.h>
+
+#include "mnb-clipboard-text.h"
+#include "mnb-clipboard-layout-cache.h"
+
+enum
+{
+  PROP_0,
+
+  PROP_TEXT
+};
+
+G_DEFINE_TYPE (MnbClipboardText, mnb_clipboard_text, MX_TYPE_WIDGET);
+
+static PangoLayout *
+mnb_clipboard_text_get_layout (MnbClipboardText *self,
+                               gfloat            for_width,
+                               gint             *height)
+{
+  ClutterActor *actor = CLUTTER_ACTOR (self);
+  MnbClipboardLayoutCache *cache;
+
+  if (self->text == NULL || self->font_desc == NULL)
+    {
+      if (height)
+        *height = 0;
+
+      return NULL;
+    }
+
+  cache = mnb_clipboard_layout_cache_get_default ();
+
+  return mnb_clipboard_layout_cache_get_layout (cache,
+                                                clutter_actor_get_pango_context (actor),
+                                                self->text,
+                                                self->text_hash,
+                                                self->font_desc,
+                                                for_width < 0 ? -1 : (gint) for_width,
+                                                height);
+}
+
+static void
+on_style_changed (MnbClipboardText *self)
+{
+  ClutterColor *color = NULL;
+  gchar *font_family = NULL;
+  gint font_size = 0;
+
+  mx_stylable_get (MX_STYLABLE (self),
+                   "color", &color,
+                   "font-family", &font_family,
+                   "font-size", &font_size,
+                   NULL);
+
+  if (color != NULL)
+    {
+      self->color = *color;
+      clutter_color_free (color);
+    }
+
+  if (self->font_desc != NULL)
+    pango_font_description_free (self->font_desc);
+
+  if (font_family != NULL)
+    self->font_desc = pango_font_description_from_string (font_family);
+  else
+    {
+      ClutterBackend *backend = clutter_get_default_backend ();
+
+      self->font_desc =
+        pango_font_description_from_string (clutter_backend_get_font_name (backend));
+    }
+
+  if (font_size > 0)
+    pango_font_description_set_absolute_size (self->font_desc,
+                                              font_size * PANGO_SCALE);
+
+  g_free (font_family);
+
+  clutter_actor_queue_relayout (CLUTTER_ACTOR (self));
+}
+
+static void
+mnb_clipboard_text_get_preferred_width (ClutterActor *actor,
+                                        gfloat        for_height,
+                                        gfloat       *min_width_p,
+                                        gfloat       *natural_width_p)
+{
+  MnbClipboardText *self = MNB_CLIPBOARD_TEXT (actor);
+  PangoLayout *layout = NULL;
+  PangoRectangle logical = { 0, };
+
+  /* shaping the text unwrapped as well would double the layouts in
+   * the cache; the rows are stretched to the view anyway, so the
+   * natural width is the one of the layout we were last given
+   */
+  if (self->layout_width > 0)
+    layout = mnb_clipboard_text_get_layout (self, self->layout_width, NULL);
+
+  if (layout != NULL)
+    pango_layout_get_extents (layout, NULL, &logical);
+
+  /* we wrap, so we can be as small as we are told */
+  if (min_width_p)
+    *min_width_p = 1;
+
+  if (natural_width_p)
+    *natural_width_p = PANGO_PIXELS_CEIL (logical.width);
+}
+
+static void
+mnb_clipboard_text_get_preferred_height (ClutterActor *actor,
+                                         gfloat        for_width,
+                                         gfloat       *min_height_p,
+                                         gfloat       *natural_height_p)
+{
+  MnbClipboardText *self = MNB_CLIPBOARD_TEXT (actor);
+  gint height = 0;
+
+  if (for_width >= 0)
+    self->layout_width = (gint) for_width;
+
+  /* this is a lookup unless the text was never shaped at this width */
+  mnb_clipboard_text_get_layout (self, for_width, &height);
+
+  if (min_height_p)
+    *min_height_p = height;
+
+  if (natural_height_p)
+    *natural_height_p = height;
+}
+
+static void
+mnb_clipboard_text_paint (ClutterActor *actor)
+{
+  MnbClipboardText *self = MNB_CLIPBOARD_TEXT (actor);
+  ClutterActorBox box;
+  PangoLayout *layout;
+  CoglColor color;
+
+  clutter_actor_get_allocation_box (actor, &box);
+
+  layout = mnb_clipboard_text_get_layout (self, box.x2 - box.x1, NULL);
+  if (layout == NULL)
+    return;
+
+  cogl_color_set_from_4ub (&color,
+                           self->color.red,
+                           self->color.green,
+                           self->color.blue,
+                           clutter_actor_get_paint_opacity (actor)
+                           * self->color.alpha / 255);
+
+  cogl_pango_render_layout (layout, 0, 0, &color, 0);
+}
+
+static void
+mnb_clipboard_text_set_property (GObject      *gobject,
+                                 guint         prop_id,
+                                 const GValue *value,
+                                 GParamSpec   *pspec)
+{
+  MnbClipboardText *self = MNB_CLIPBOARD_TEXT (gobject);
+
+  switch (prop_id)
+    {
+    case PROP_TEXT:
+      mnb_clipboard_text_set_text (self, g_value_get_string (value));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (gobject, prop_id, pspec);
+      break;
+    }
+}
+
+static void
+mnb_clipboard_text_get_property (GObject    *gobject,
+                                 guint       prop_id,
+                                 GValue     *value,
+                                 GParamSpec *pspec)
+{
+  MnbClipboardText *self = MNB_CLIPBOARD_TEXT (gobject);
+
+  switch (prop_id)
+    {
+    case PROP_TEXT:
+      g_value_set_string (value, self->text);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (gobject, prop_id, pspec);
+      break;
+    }
+}
+
+static void
+mnb_clipboard_text_finalize (GObject *gobject)
+{
+  MnbClipboardText *self = MNB_CLIPBOARD_TEXT (gobject);
+
+  g_free (self->text);
+
+  if (self->font_desc != NULL)
+    pango_font_description_free (self->font_desc);
+
+  G_OBJECT_CLASS (mnb_clipboard_text_parent_class)->finalize (gobject);
+}
+
+static void
+mnb_clipboard_text_class_init (MnbClipboardTextClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  ClutterActorClass *actor_class = CLUTTER_ACTOR_CLASS (klass);
+  GParamSpec *pspec;
+
+  gobject_class->set_property = mnb_clipboard_text_set_property;
+  gobject_class->get_property = mnb_clipboard_text_get_property;
+  gobject_class->finalize = mnb_clipboard_text_finalize;
+
+  actor_class->get_preferred_width = mnb_clipboard_text_get_preferred_width;
+  actor_class->get_preferred_height = mnb_clipboard_text_get_preferred_height;
+  actor_class->paint = mnb_clipboard_text_paint;
+
+  pspec = g_param_spec_string ("text",
+                               "Text",
+                               "The text to display",
+                               NULL,
+                               G_PARAM_READWRITE);
+  g_object_class_install_property (gobject_class, PROP_TEXT, pspec);
+}
+
+static void
+mnb_clipboard_text_init (MnbClipboardText *self)
+{
+  self->color.red = self->color.green = self->color.blue = 0x00;
+  self->color.alpha = 0xff;
+
+  g_signal_connect (self, "style-changed",
+                    G_CALLBACK (on_style_changed),
+                    NULL);
+}
+
+ClutterActor *
+mnb_clipboard_text_new (void)
+{
+  return g_object_new (MNB_TYPE_CLIPBOARD_TEXT, NULL);
+}
+
+void
+mnb_clipboard_text_set_text (MnbClipboardText *text,
+                             const gchar      *str)
+{
+  g_return_if_fail (MNB_IS_CLIPBOARD_TEXT (text));
+
+  g_free (text->text);
+  text->text = g_strdup (str);
+  text->text_hash = (str != NULL) ? g_str_hash (str) : 0;
+
+  clutter_actor_queue_relayout (CLUTTER_ACTOR (text));
+
+  g_object_notify (G_OBJECT (text), "text");
+}
+
+G_CONST_RETURN gchar *
+mnb_clipboard_text_get_text (MnbClipboardText *text)
+{
+  g_return_val_if_fail (MNB_IS_CLIPBOARD_TEXT (text), NULL);
+
+  return text->text;
+}
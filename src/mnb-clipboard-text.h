@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2008 - 2009 Intel Corporation.
+ *
+ * Author: Emmanuele Bassi <ebassi@linux.intel.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __MNB_CLIPBOARD_TEXT_H__
+#define __MNB_CLIPBOARD_TEXT_H__
+
+#include <mx/mx.h>
+
+G_BEGIN_DECLS
+
+#define MNB_TYPE_CLIPBOARD_TEXT                 (mnb_clipboard_text_get_type ())
+#define MNB_CLIPBOARD_TEXT(obj)                 (G_TYPE_CHECK_INSTANCE_CAST ((obj), MNB_TYPE_CLIPBOARD_TEXT, MnbClipboardText))
+#define MNB_IS_CLIPBOARD_TEXT(obj)              (G_TYPE_CHECK_INSTANCE_TYPE ((obj), MNB_TYPE_CLIPBOARD_TEXT))
+#define MNB_CLIPBOARD_TEXT_CLASS(klass)         (G_TYPE_CHECK_CLASS_CAST ((klass), MNB_TYPE_CLIPBOARD_TEXT, MnbClipboardTextClass))
+#define MNB_IS_CLIPBOARD_TEXT_CLASS(klass)      (G_TYPE_CHECK_CLASS_TYPE ((klass), MNB_TYPE_CLIPBOARD_TEXT))
+#define MNB_CLIPBOARD_TEXT_GET_CLASS(obj)       (G_TYPE_INSTANCE_GET_CLASS ((obj), MNB_TYPE_CLIPBOARD_TEXT, MnbClipboardTextClass))
+
+typedef struct _MnbClipboardText                MnbClipboardText;
+typedef struct _MnbClipboardTextClass           MnbClipboardTextClass;
+
+/* a read-only, wrapping text whose layouts are kept in the shared
+ * MnbClipboardLayoutCache instead of being shaped by each actor
+ */
+struct _MnbClipboardText
+{
+  MxWidget parent_instance;
+
+  gchar *text;
+  guint text_hash;
+
+  /* the wrapping width last asked for */
+  gint layout_width;
+
+  PangoFontDescription *font_desc;
+  ClutterColor color;
+};
+
+struct _MnbClipboardTextClass
+{
+  MxWidgetClass parent_class;
+};
+
+GType mnb_clipboard_text_get_type (void) G_GNUC_CONST;
+
+ClutterActor *        mnb_clipboard_text_new      (void);
+
+void                  mnb_clipboard_text_set_text (MnbClipboardText *text,
+                                                   const gchar      *str);
+G_CONST_RETURN gchar *mnb_clipboard_text_get_text (MnbClipboardText *text);
+
+G_END_DECLS
+
+#endif /* __MNB_CLIPBOARD_TEXT_H__ */
@@ -32,6 +32,8 @@
 #include "mnb-clipboard-view.h"
 #include "mnb-clipboard-store.h"
 #include "mnb-clipboard-item.h"
+#include "mnb-clipboard-file-cache.h"
+#include "mnb-clipboard-layout-cache.h"
 
 #define MNB_CLIPBOARD_VIEW_GET_PRIVATE(obj)     (G_TYPE_INSTANCE_GET_PRIVATE ((obj), MNB_TYPE_CLIPBOARD_VIEW, MnbClipboardViewPrivate))
 
@@ -39,14 +41,103 @@
 
 #define EMPTY_TEXT      _("You need to copy some text to use Pasteboard")
 
+/* rows created synchronously on resume, enough to fill the view;
+ * the rest are created in batches when idle
+ */
+#define RESUME_ROWS             (16)
+#define REBUILD_BATCH_SIZE      (32)
+
+/* text rows kept aside when the rows are torn down, and reused by
+ * the next rows to be created: enough for a resume and its first
+ * batch
+ */
+#define ROW_POOL_SIZE           (RESUME_ROWS + REBUILD_BATCH_SIZE)
+
+/* number of shaped layouts kept while the view is suspended */
+#define SUSPENDED_LAYOUT_CACHE_SIZE     (32)
+
+/* size of the layout cache while the memory is tight */
+#define PRESSURE_LAYOUT_CACHE_SIZE      (8)
+
+typedef struct _ViewRow         ViewRow;
+
+struct _ViewRow
+{
+  MnbClipboardView *view;
+
+  MnbClipboardItem *item;
+
+  gint64 serial;
+
+  /* the cached preferred height, valid for for_width; a negative
+   * height means that the row has to be measured again
+   */
+  gfloat for_width;
+  gfloat height;
+
+  gulong relayout_id;
+
+  guint is_dirty  : 1;
+  guint is_pinned : 1;
+};
+
 struct _MnbClipboardViewPrivate
 {
   MnbClipboardStore *store;
 
-  GSList *rows;
+  /* ViewRow, most recent first */
+  GQueue *rows;
+
+  /* the pinned rows, laid out above the history; they change
+   * rarely, so their heights are summed up apart from the history
+   * and the new rows do not cause them to be measured again
+   */
+  GQueue *pinned;
+  gfloat pinned_height;
+  guint n_pinned_visible;
+
+  /* serial -> GList link inside rows or pinned */
+  GHashTable *rows_by_serial;
+
+  /* the row holding the current clipboard contents, if any; the
+   * serial is kept while the rows are torn down
+   */
+  ViewRow *head;
+  gint64 head_serial;
+
+  /* the next store row to rebuild after a resume */
+  guint rebuild_row;
+  guint rebuild_id;
+
+  /* rows that have been added or that changed since the last
+   * layout; only these rows need to be measured again
+   */
+  GSList *dirty_rows;
+
+  /* sum of the cached heights of the visible, non-dirty rows,
+   * computed for layout_width
+   */
+  gfloat layout_width;
+  gfloat layout_height;
+  guint n_visible;
 
   guint add_id;
   guint remove_id;
+  guint changed_id;
+  guint pressure_id;
+
+  /* the size of the layout cache before the memory got tight */
+  guint saved_cache_size;
+
+  /* the search in progress, if any */
+  GCancellable *match_cancellable;
+
+  /* MnbClipboardItem, emptied and out of the view */
+  GQueue *row_pool;
+
+  guint layout_valid : 1;
+  guint pinned_valid : 1;
+  guint is_suspended : 1;
 };
 
 enum
@@ -58,26 +149,259 @@ enum
 
 G_DEFINE_TYPE (MnbClipboardView, mnb_clipboard_view, MX_TYPE_BOX_LAYOUT);
 
+static gfloat
+view_row_get_height (ViewRow *row,
+                     gfloat   for_width)
+{
+  if (row->height < 0 || row->for_width != for_width)
+    {
+      clutter_actor_get_preferred_height (CLUTTER_ACTOR (row->item),
+                                          for_width,
+                                          NULL,
+                                          &row->height);
+      row->for_width = for_width;
+    }
+
+  return row->height;
+}
+
+static void
+view_row_mark_dirty (ViewRow *row)
+{
+  MnbClipboardViewPrivate *priv = row->view->priv;
+
+  if (row->is_dirty)
+    return;
+
+  /* the pinned section is measured again as a whole */
+  if (row->is_pinned)
+    {
+      row->height = -1;
+      priv->pinned_valid = FALSE;
+      return;
+    }
+
+  /* the height of a dirty row is not part of the layout height */
+  if (priv->layout_valid &&
+      row->height >= 0 &&
+      CLUTTER_ACTOR_IS_VISIBLE (row->item))
+    priv->layout_height -= row->height;
+
+  row->height = -1;
+  row->is_dirty = TRUE;
+
+  priv->dirty_rows = g_slist_prepend (priv->dirty_rows, row);
+}
+
+static void
+on_row_queue_relayout (ClutterActor *actor,
+                       ViewRow      *row)
+{
+  view_row_mark_dirty (row);
+}
+
+static ViewRow *
+view_row_new (MnbClipboardView *view,
+              MnbClipboardItem *item)
+{
+  ViewRow *row = g_slice_new0 (ViewRow);
+
+  row->view = view;
+  row->item = item;
+  row->serial = mnb_clipboard_item_get_serial (item);
+  row->for_width = -1;
+  row->height = -1;
+
+  row->relayout_id = g_signal_connect (item, "queue-relayout",
+                                       G_CALLBACK (on_row_queue_relayout),
+                                       row);
+
+  return row;
+}
+
+/* frees the row without touching the layout or the actor */
+static void
+view_row_release (ViewRow *row)
+{
+  g_signal_handler_disconnect (row->item, row->relayout_id);
+
+  g_slice_free (ViewRow, row);
+}
+
+/* keeps the actor of a text row aside, unless the memory is tight;
+ * called before the actor leaves the view
+ */
+static void
+mnb_clipboard_view_pool_item (MnbClipboardView *view,
+                              MnbClipboardItem *item)
+{
+  MnbClipboardViewPrivate *priv = view->priv;
+
+  if (g_queue_get_length (priv->row_pool) >= ROW_POOL_SIZE ||
+      mnb_clipboard_store_get_pressure_level (priv->store) >= MNB_CLIPBOARD_PRESSURE_LOW)
+    return;
+
+  if (mnb_clipboard_item_recycle (item, 0, NULL))
+    g_queue_push_head (priv->row_pool, g_object_ref (item));
+}
+
+static MnbClipboardItem *
+mnb_clipboard_view_take_pooled_item (MnbClipboardView *view,
+                                     gint64            serial,
+                                     const gchar      *preview)
+{
+  MnbClipboardItem *item;
+
+  item = g_queue_pop_head (view->priv->row_pool);
+  if (item == NULL)
+    return NULL;
+
+  mnb_clipboard_item_recycle (item, serial, preview);
+
+  /* the reference of the pool goes to the view with the actor */
+  g_object_force_floating (G_OBJECT (item));
+
+  return item;
+}
+
+static void
+mnb_clipboard_view_drain_pool (MnbClipboardView *view)
+{
+  MnbClipboardItem *item;
+
+  while ((item = g_queue_pop_head (view->priv->row_pool)) != NULL)
+    g_object_unref (item);
+}
+
+static void
+view_row_free (ViewRow *row)
+{
+  MnbClipboardViewPrivate *priv = row->view->priv;
+
+  if (row->is_pinned)
+    priv->pinned_valid = FALSE;
+  else if (CLUTTER_ACTOR_IS_VISIBLE (row->item))
+    {
+      if (priv->n_visible > 0)
+        priv->n_visible -= 1;
+
+      if (priv->layout_valid && !row->is_dirty && row->height >= 0)
+        priv->layout_height -= row->height;
+    }
+
+  if (row->is_dirty)
+    priv->dirty_rows = g_slist_remove (priv->dirty_rows, row);
+
+  mnb_clipboard_view_pool_item (row->view, row->item);
+  clutter_container_remove_actor (CLUTTER_CONTAINER (row->view),
+                                  CLUTTER_ACTOR (row->item));
+
+  view_row_release (row);
+}
+
+/* brings the layout height up to date for the given width; only the
+ * rows without a cached height for the width are measured
+ */
+static void
+mnb_clipboard_view_validate_layout (MnbClipboardView *view,
+                                    gfloat            for_width)
+{
+  MnbClipboardViewPrivate *priv = view->priv;
+  GSList *l;
+
+  if (!priv->pinned_valid || priv->layout_width != for_width)
+    {
+      GList *r;
+
+      priv->pinned_height = 0;
+      priv->n_pinned_visible = 0;
+
+      for (r = priv->pinned->head; r != NULL; r = r->next)
+        {
+          ViewRow *row = r->data;
+
+          if (!CLUTTER_ACTOR_IS_VISIBLE (row->item))
+            continue;
+
+          priv->pinned_height += view_row_get_height (row, for_width);
+          priv->n_pinned_visible += 1;
+        }
+
+      priv->pinned_valid = TRUE;
+    }
+
+  if (!priv->layout_valid || priv->layout_width != for_width)
+    {
+      GList *r;
+
+      priv->layout_height = 0;
+      priv->n_visible = 0;
+
+      for (r = priv->rows->head; r != NULL; r = r->next)
+        {
+          ViewRow *row = r->data;
+
+          row->is_dirty = FALSE;
+
+          if (!CLUTTER_ACTOR_IS_VISIBLE (row->item))
+            continue;
+
+          priv->layout_height += view_row_get_height (row, for_width);
+          priv->n_visible += 1;
+        }
+
+      g_slist_free (priv->dirty_rows);
+      priv->dirty_rows = NULL;
+
+      priv->layout_width = for_width;
+      priv->layout_valid = TRUE;
+
+      return;
+    }
+
+  for (l = priv->dirty_rows; l != NULL; l = l->next)
+    {
+      ViewRow *row = l->data;
+
+      row->is_dirty = FALSE;
+
+      if (CLUTTER_ACTOR_IS_VISIBLE (row->item))
+        priv->layout_height += view_row_get_height (row, for_width);
+    }
+
+  g_slist_free (priv->dirty_rows);
+  priv->dirty_rows = NULL;
+}
+
+static void
+mnb_clipboard_view_invalidate_layout (MnbClipboardView *view)
+{
+  view->priv->layout_valid = FALSE;
+
+  clutter_actor_queue_relayout (CLUTTER_ACTOR (view));
+}
+
 static void
 on_action_clicked (MnbClipboardItem *item,
                    MnbClipboardView *view)
 {
   MnbClipboardViewPrivate *priv = view->priv;
-  GtkClipboard *clipboard;
-  const gchar *text;
-  gint64 serial;
+  gint64 serial = mnb_clipboard_item_get_serial (item);
 
-  text = mnb_clipboard_item_get_contents (item);
-  if (text == NULL || *text == '\0')
-    return;
+  /* this will move the item at the beginning of the view */
+  mnb_clipboard_store_copy_back (priv->store, serial);
+}
 
-  /* remove the item from the view */
-  serial = mnb_clipboard_item_get_serial (item);
-  mnb_clipboard_store_remove (priv->store, serial);
+static void
+on_pin_clicked (MnbClipboardItem *item,
+                MnbClipboardView *view)
+{
+  MnbClipboardViewPrivate *priv = view->priv;
+  gint64 serial = mnb_clipboard_item_get_serial (item);
 
-  /* this will add another item at the beginning of the view */
-  clipboard = gtk_clipboard_get (GDK_SELECTION_CLIPBOARD);
-  gtk_clipboard_set_text (clipboard, text, -1);
+  /* the row moves when the store says so */
+  mnb_clipboard_store_set_pinned (priv->store, serial,
+                                  !mnb_clipboard_item_get_pinned (item));
 }
 
 static void
@@ -91,87 +415,117 @@ on_remove_clicked (MnbClipboardItem *item,
 }
 
 static void
-on_store_item_removed (MnbClipboardStore *store,
-                       gint64             serial,
-                       MnbClipboardView  *view)
+mnb_clipboard_view_remove_row (MnbClipboardView *view,
+                               gint64            serial)
 {
   MnbClipboardViewPrivate *priv = view->priv;
-  MnbClipboardItem *row = NULL;
-  gboolean item_found = FALSE;
-  gboolean reset_action = FALSE;
-  GSList *l;
+  ViewRow *row;
+  GList *l;
 
-  for (l = priv->rows; l != NULL; l = l->next)
+  /* if we removed the current clipboard contents there is no paste
+   * target anymore; every other row is already showing its action
+   */
+  if (priv->head_serial == serial)
     {
-      row = l->data;
-
-      if (mnb_clipboard_item_get_serial (row) == serial)
-        {
-          item_found = TRUE;
-          break;
-        }
+      priv->head = NULL;
+      priv->head_serial = 0;
     }
 
-  if (!item_found)
+  l = g_hash_table_lookup (priv->rows_by_serial, &serial);
+  if (l == NULL)
     return;
 
-  /* if we removed the first item we need to show the action
-   * button for every row since the current clipboard contents
-   * will not be the first item anymore
-   */
-  if (priv->rows->data == row)
-    reset_action = TRUE;
-
-  priv->rows = g_slist_remove (priv->rows, row);
-  clutter_container_remove_actor (CLUTTER_CONTAINER (view), CLUTTER_ACTOR (row));
+  row = l->data;
 
-  if (reset_action)
+  if (row->is_pinned)
     {
-      for (l = priv->rows; l != NULL; l = l->next)
-        mnb_clipboard_item_show_action (l->data);
+      g_hash_table_remove (priv->rows_by_serial, &row->serial);
+      g_queue_delete_link (priv->pinned, l);
+      view_row_free (row);
+
+      clutter_actor_queue_relayout (CLUTTER_ACTOR (view));
+      return;
     }
+
+  /* the rows before the rebuild position mirror the store rows */
+  if (priv->rebuild_id != 0 && priv->rebuild_row > 0)
+    priv->rebuild_row -= 1;
+
+  g_hash_table_remove (priv->rows_by_serial, &row->serial);
+  g_queue_delete_link (priv->rows, l);
+  view_row_free (row);
 }
 
-static void
-on_store_item_added (MnbClipboardStore    *store,
-                     MnbClipboardItemType  item_type,
-                     MnbClipboardView     *view)
+static ViewRow *
+mnb_clipboard_view_insert_row (MnbClipboardView     *view,
+                               MnbClipboardItemType  item_type,
+                               gint64                serial,
+                               const gchar          *preview,
+                               gboolean              is_pinned,
+                               gboolean              prepend)
 {
   MnbClipboardViewPrivate *priv = view->priv;
   ClutterActor *row = NULL;
-  GSList *l;
+  ViewRow *view_row;
 
   switch (item_type)
     {
     case MNB_CLIPBOARD_ITEM_TEXT:
+      if (preview == NULL)
+        break;
+
+      /* a pooled row is already set up for this view */
+      row = (ClutterActor *) mnb_clipboard_view_take_pooled_item (view,
+                                                                  serial,
+                                                                  preview);
+      if (row != NULL)
+        goto add_row;
+
+      row = g_object_new (MNB_TYPE_CLIPBOARD_ITEM,
+                          "contents", preview,
+                          "serial", serial,
+                          NULL);
+      break;
+
+    case MNB_CLIPBOARD_ITEM_URIS:
       {
-        gchar *text = NULL;
-        gint64 mtime = 0, serial = 0;
+        gchar **uris;
 
-        text = mnb_clipboard_store_get_last_text (store, &mtime, &serial);
-        if (text != NULL)
+        /* the files are shown with a placeholder, and filled in as
+         * their info comes in
+         */
+        uris = mnb_clipboard_store_get_uris (priv->store, serial);
+        if (uris != NULL && uris[0] != NULL)
           {
             row = g_object_new (MNB_TYPE_CLIPBOARD_ITEM,
-                                "contents", text,
                                 "serial", serial,
                                 NULL);
 
-            g_signal_connect (row, "remove-clicked",
-                              G_CALLBACK (on_remove_clicked),
-                              view);
-            g_signal_connect (row, "action-clicked",
-                              G_CALLBACK (on_action_clicked),
-                              view);
-
-            g_free (text);
+            mnb_clipboard_item_set_uris (MNB_CLIPBOARD_ITEM (row),
+                                         (const gchar * const *) uris);
           }
-      }
-      break;
 
-    case MNB_CLIPBOARD_ITEM_URIS:
+        g_strfreev (uris);
+      }
       break;
 
     case MNB_CLIPBOARD_ITEM_IMAGE:
+      {
+        gchar **uris;
+
+        /* only the thumbnail is loaded, and not on the main loop */
+        uris = mnb_clipboard_store_get_uris (priv->store, serial);
+        if (uris != NULL && uris[0] != NULL)
+          {
+            row = g_object_new (MNB_TYPE_CLIPBOARD_ITEM,
+                                "serial", serial,
+                                NULL);
+
+            mnb_clipboard_item_set_image (MNB_CLIPBOARD_ITEM (row), uris[0]);
+          }
+
+        g_strfreev (uris);
+      }
       break;
 
     case MNB_CLIPBOARD_ITEM_INVALID:
@@ -180,19 +534,517 @@ on_store_item_added (MnbClipboardStore    *store,
     }
 
   if (row == NULL)
+    return NULL;
+
+  g_signal_connect (row, "remove-clicked",
+                    G_CALLBACK (on_remove_clicked),
+                    view);
+  g_signal_connect (row, "action-clicked",
+                    G_CALLBACK (on_action_clicked),
+                    view);
+  g_signal_connect (row, "pin-clicked",
+                    G_CALLBACK (on_pin_clicked),
+                    view);
+
+add_row:
+  mnb_clipboard_item_set_pinned (MNB_CLIPBOARD_ITEM (row), is_pinned);
+
+  /* we do not use the BoxLayout positioning: the rows are laid out
+   * by us, and only the new row is going to be measured
+   */
+  clutter_container_add_actor (CLUTTER_CONTAINER (view), row);
+
+  view_row = view_row_new (view, MNB_CLIPBOARD_ITEM (row));
+
+  if (is_pinned)
+    {
+      view_row->is_pinned = TRUE;
+
+      if (prepend)
+        {
+          g_queue_push_head (priv->pinned, view_row);
+          g_hash_table_insert (priv->rows_by_serial,
+                               &view_row->serial,
+                               priv->pinned->head);
+        }
+      else
+        {
+          g_queue_push_tail (priv->pinned, view_row);
+          g_hash_table_insert (priv->rows_by_serial,
+                               &view_row->serial,
+                               priv->pinned->tail);
+        }
+
+      priv->pinned_valid = FALSE;
+      clutter_actor_queue_relayout (CLUTTER_ACTOR (view));
+
+      return view_row;
+    }
+
+  if (prepend)
+    {
+      g_queue_push_head (priv->rows, view_row);
+      g_hash_table_insert (priv->rows_by_serial,
+                           &view_row->serial,
+                           priv->rows->head);
+    }
+  else
+    {
+      g_queue_push_tail (priv->rows, view_row);
+      g_hash_table_insert (priv->rows_by_serial,
+                           &view_row->serial,
+                           priv->rows->tail);
+    }
+
+  if (priv->layout_valid)
+    priv->n_visible += 1;
+
+  view_row_mark_dirty (view_row);
+
+  if (serial == priv->head_serial)
+    {
+      mnb_clipboard_item_hide_action (view_row->item);
+      priv->head = view_row;
+    }
+
+  return view_row;
+}
+
+/* drops every row in one pass; the actors are removed in the order
+ * of the container, and the layout is computed again only once
+ */
+static void
+mnb_clipboard_view_drop_rows (MnbClipboardView *view)
+{
+  MnbClipboardViewPrivate *priv = view->priv;
+  GList *children, *l;
+  ViewRow *row;
+
+  g_hash_table_remove_all (priv->rows_by_serial);
+  priv->head = NULL;
+
+  g_slist_free (priv->dirty_rows);
+  priv->dirty_rows = NULL;
+
+  while ((row = g_queue_pop_head (priv->rows)) != NULL)
+    view_row_release (row);
+
+  while ((row = g_queue_pop_head (priv->pinned)) != NULL)
+    view_row_release (row);
+
+  children = clutter_container_get_children (CLUTTER_CONTAINER (view));
+  for (l = children; l != NULL; l = l->next)
+    {
+      mnb_clipboard_view_pool_item (view, l->data);
+      clutter_container_remove_actor (CLUTTER_CONTAINER (view), l->data);
+    }
+
+  g_list_free (children);
+
+  priv->layout_height = 0;
+  priv->n_visible = 0;
+  priv->pinned_valid = FALSE;
+
+  mnb_clipboard_view_invalidate_layout (view);
+}
+
+static void
+on_store_items_removed (MnbClipboardStore *store,
+                        GArray            *serials,
+                        MnbClipboardView  *view)
+{
+  MnbClipboardViewPrivate *priv = view->priv;
+  guint i, n_found, n_pinned;
+
+  if (serials->len == 1)
+    {
+      mnb_clipboard_view_remove_row (view, g_array_index (serials, gint64, 0));
+      return;
+    }
+
+  for (i = 0, n_found = 0, n_pinned = 0; i < serials->len; i++)
+    {
+      gint64 serial = g_array_index (serials, gint64, i);
+      GList *l;
+
+      if (priv->head_serial == serial)
+        {
+          priv->head = NULL;
+          priv->head_serial = 0;
+        }
+
+      l = g_hash_table_lookup (priv->rows_by_serial, &serial);
+      if (l == NULL)
+        continue;
+
+      if (((ViewRow *) l->data)->is_pinned)
+        n_pinned += 1;
+      else
+        n_found += 1;
+    }
+
+  if (n_found == 0 && n_pinned == 0)
     return;
 
-  priv->rows = g_slist_prepend (priv->rows, row);
-  mx_box_layout_add_actor (MX_BOX_LAYOUT (view),
-                           CLUTTER_ACTOR (row),
-                           0);
+  /* the rows before the rebuild position mirror the store rows */
+  if (priv->rebuild_id != 0)
+    priv->rebuild_row -= MIN (n_found, priv->rebuild_row);
 
-  for (l = priv->rows; l != NULL; l = l->next)
+  if (n_found == g_queue_get_length (priv->rows) &&
+      n_pinned == g_queue_get_length (priv->pinned))
     {
-      if (l == priv->rows)
-        mnb_clipboard_item_hide_action (l->data);
+      mnb_clipboard_view_drop_rows (view);
+      return;
+    }
+
+  /* the dirty list might point to the rows going away; the layout
+   * is going to be summed up again from the cached heights anyway
+   */
+  g_slist_free (priv->dirty_rows);
+  priv->dirty_rows = NULL;
+
+  for (i = 0; i < serials->len; i++)
+    {
+      gint64 serial = g_array_index (serials, gint64, i);
+      ViewRow *row;
+      GList *l;
+
+      l = g_hash_table_lookup (priv->rows_by_serial, &serial);
+      if (l == NULL)
+        continue;
+
+      row = l->data;
+
+      g_hash_table_remove (priv->rows_by_serial, &row->serial);
+
+      if (row->is_pinned)
+        {
+          g_queue_delete_link (priv->pinned, l);
+          priv->pinned_valid = FALSE;
+        }
       else
-        mnb_clipboard_item_show_action (l->data);
+        g_queue_delete_link (priv->rows, l);
+
+      clutter_container_remove_actor (CLUTTER_CONTAINER (view),
+                                      CLUTTER_ACTOR (row->item));
+      view_row_release (row);
+    }
+
+  mnb_clipboard_view_invalidate_layout (view);
+}
+
+static void
+mnb_clipboard_view_add_row (MnbClipboardView *view,
+                            gint64            serial)
+{
+  MnbClipboardViewPrivate *priv = view->priv;
+  MnbClipboardItemType item_type = MNB_CLIPBOARD_ITEM_INVALID;
+  gboolean is_pinned = FALSE;
+  gchar *preview = NULL;
+
+  if (!mnb_clipboard_store_get_item (priv->store, serial,
+                                     &item_type,
+                                     NULL,
+                                     &preview,
+                                     &is_pinned))
+    return;
+
+  if (item_type == MNB_CLIPBOARD_ITEM_INVALID || preview == NULL)
+    {
+      g_free (preview);
+      return;
+    }
+
+  /* an item pinned before we got to see it; it is not the paste
+   * target, and it does not move the history
+   */
+  if (is_pinned)
+    {
+      if (!priv->is_suspended &&
+          g_hash_table_lookup (priv->rows_by_serial, &serial) == NULL)
+        mnb_clipboard_view_insert_row (view, item_type, serial, preview,
+                                       TRUE, TRUE);
+
+      g_free (preview);
+      return;
+    }
+
+  /* the new row is the current paste target; only the previous
+   * target needs to get its action back
+   */
+  if (priv->head != NULL)
+    mnb_clipboard_item_show_action (priv->head->item);
+
+  priv->head = NULL;
+  priv->head_serial = serial;
+
+  /* while suspended the rows are rebuilt from the store on resume */
+  if (!priv->is_suspended)
+    {
+      mnb_clipboard_view_insert_row (view, item_type, serial, preview,
+                                     FALSE, TRUE);
+
+      if (priv->rebuild_id != 0)
+        priv->rebuild_row += 1;
+    }
+
+  g_free (preview);
+}
+
+/* the serials come oldest first, and every new row goes on top */
+static void
+on_store_items_added (MnbClipboardStore *store,
+                      GArray            *serials,
+                      MnbClipboardView  *view)
+{
+  guint i;
+
+  for (i = 0; i < serials->len; i++)
+    mnb_clipboard_view_add_row (view, g_array_index (serials, gint64, i));
+}
+
+/* pinning and unpinning move the existing row between the sections,
+ * keeping the actor and its shaped layout
+ */
+static void
+on_store_item_changed (MnbClipboardStore *store,
+                       gint64             serial,
+                       MnbClipboardView  *view)
+{
+  MnbClipboardViewPrivate *priv = view->priv;
+  gboolean is_pinned = FALSE;
+  ViewRow *row;
+  GList *l;
+
+  /* rows that do not exist yet get the right section when added */
+  l = g_hash_table_lookup (priv->rows_by_serial, &serial);
+  if (l == NULL)
+    return;
+
+  row = l->data;
+
+  if (!mnb_clipboard_store_get_item (store, serial,
+                                     NULL, NULL, NULL,
+                                     &is_pinned))
+    return;
+
+  if (row->is_pinned == is_pinned)
+    return;
+
+  mnb_clipboard_item_set_pinned (row->item, is_pinned);
+
+  if (is_pinned)
+    {
+      /* take the row out of the history sums */
+      if (CLUTTER_ACTOR_IS_VISIBLE (row->item))
+        {
+          if (priv->n_visible > 0)
+            priv->n_visible -= 1;
+
+          if (priv->layout_valid && !row->is_dirty && row->height >= 0)
+            priv->layout_height -= row->height;
+        }
+
+      if (row->is_dirty)
+        {
+          priv->dirty_rows = g_slist_remove (priv->dirty_rows, row);
+          row->is_dirty = FALSE;
+        }
+
+      if (priv->rebuild_id != 0 && priv->rebuild_row > 0)
+        priv->rebuild_row -= 1;
+
+      g_queue_unlink (priv->rows, l);
+      g_queue_push_head_link (priv->pinned, l);
+
+      row->is_pinned = TRUE;
+      priv->pinned_valid = FALSE;
+    }
+  else
+    {
+      /* a store unpinning an item gives it a new serial, so only
+       * mirrored items come back here, as the newest ones
+       */
+      g_queue_unlink (priv->pinned, l);
+      g_queue_push_head_link (priv->rows, l);
+
+      row->is_pinned = FALSE;
+      row->height = -1;
+      priv->pinned_valid = FALSE;
+
+      if (priv->layout_valid && CLUTTER_ACTOR_IS_VISIBLE (row->item))
+        priv->n_visible += 1;
+
+      view_row_mark_dirty (row);
+
+      if (priv->rebuild_id != 0)
+        priv->rebuild_row += 1;
+    }
+
+  clutter_actor_queue_relayout (CLUTTER_ACTOR (view));
+}
+
+/* appends up to n_rows rows from the store; returns TRUE if there
+ * are more rows left to rebuild
+ */
+static gboolean
+mnb_clipboard_view_rebuild_rows (MnbClipboardView *view,
+                                 guint             n_rows)
+{
+  MnbClipboardViewPrivate *priv = view->priv;
+  guint n_items;
+
+  n_items = mnb_clipboard_store_get_n_items (priv->store);
+
+  while (n_rows > 0 && priv->rebuild_row < n_items)
+    {
+      MnbClipboardItemType item_type = MNB_CLIPBOARD_ITEM_INVALID;
+      gchar *preview = NULL;
+      gint64 serial = 0;
+
+      if (mnb_clipboard_store_get_row (priv->store, priv->rebuild_row,
+                                       &item_type,
+                                       &serial,
+                                       NULL,
+                                       &preview,
+                                       NULL) &&
+          g_hash_table_lookup (priv->rows_by_serial, &serial) == NULL)
+        {
+          mnb_clipboard_view_insert_row (view, item_type, serial, preview,
+                                         FALSE, FALSE);
+        }
+
+      g_free (preview);
+
+      priv->rebuild_row += 1;
+      n_rows -= 1;
+    }
+
+  return priv->rebuild_row < n_items;
+}
+
+static gboolean
+rebuild_rows_idle (gpointer data)
+{
+  MnbClipboardView *view = data;
+
+  if (mnb_clipboard_view_rebuild_rows (view, REBUILD_BATCH_SIZE))
+    return TRUE;
+
+  view->priv->rebuild_id = 0;
+
+  return FALSE;
+}
+
+/* we override the BoxLayout size negotiation because the BoxLayout
+ * measures every child on every relayout; we keep the height of each
+ * row cached, and only measure the rows that were added or changed
+ */
+static void
+mnb_clipboard_view_get_preferred_height (ClutterActor *actor,
+                                         gfloat        for_width,
+                                         gfloat       *min_height_p,
+                                         gfloat       *natural_height_p)
+{
+  MnbClipboardView *view = MNB_CLIPBOARD_VIEW (actor);
+  MnbClipboardViewPrivate *priv = view->priv;
+  MxPadding padding;
+  guint n_visible;
+  gfloat height;
+
+  mx_widget_get_padding (MX_WIDGET (actor), &padding);
+
+  if (for_width >= 0)
+    for_width = MAX (0, for_width - padding.left - padding.right);
+
+  mnb_clipboard_view_validate_layout (view, for_width);
+
+  n_visible = priv->n_pinned_visible + priv->n_visible;
+
+  height = priv->pinned_height + priv->layout_height;
+  if (n_visible > 1)
+    height += (n_visible - 1) * ROW_SPACING;
+
+  height += padding.top + padding.bottom;
+
+  if (min_height_p)
+    *min_height_p = height;
+
+  if (natural_height_p)
+    *natural_height_p = height;
+}
+
+static void
+mnb_clipboard_view_allocate (ClutterActor           *actor,
+                             const ClutterActorBox  *box,
+                             ClutterAllocationFlags  flags)
+{
+  MnbClipboardView *view = MNB_CLIPBOARD_VIEW (actor);
+  MnbClipboardViewPrivate *priv = view->priv;
+  ClutterActorClass *widget_class;
+  MxAdjustment *v_adjustment = NULL;
+  MxPadding padding;
+  gfloat avail_width, avail_height, y;
+  GQueue *sections[2];
+  GList *l;
+  guint i;
+
+  /* skip the BoxLayout implementation, it would lay out the children */
+  widget_class = g_type_class_peek (MX_TYPE_WIDGET);
+  widget_class->allocate (actor, box, flags);
+
+  mx_widget_get_padding (MX_WIDGET (actor), &padding);
+
+  avail_width = MAX (0, (box->x2 - box->x1) - padding.left - padding.right);
+  avail_height = box->y2 - box->y1;
+
+  mnb_clipboard_view_validate_layout (view, avail_width);
+
+  y = padding.top;
+
+  /* the pinned section first, then the history */
+  sections[0] = priv->pinned;
+  sections[1] = priv->rows;
+
+  for (i = 0; i < G_N_ELEMENTS (sections); i++)
+    for (l = sections[i]->head; l != NULL; l = l->next)
+      {
+        ViewRow *row = l->data;
+        ClutterActorBox child_box;
+
+        if (!CLUTTER_ACTOR_IS_VISIBLE (row->item))
+          continue;
+
+        child_box.x1 = padding.left;
+        child_box.y1 = y;
+        child_box.x2 = padding.left + avail_width;
+        child_box.y2 = y + view_row_get_height (row, avail_width);
+
+        clutter_actor_allocate (CLUTTER_ACTOR (row->item), &child_box, flags);
+
+        y = child_box.y2 + ROW_SPACING;
+      }
+
+  if (priv->n_pinned_visible + priv->n_visible > 0)
+    y -= ROW_SPACING;
+
+  y += padding.bottom;
+
+  mx_scrollable_get_adjustments (MX_SCROLLABLE (actor), NULL, &v_adjustment);
+  if (v_adjustment != NULL)
+    {
+      gdouble upper = MAX (y, avail_height);
+      gdouble value;
+
+      value = mx_adjustment_get_value (v_adjustment);
+      value = CLAMP (value, 0, upper - avail_height);
+
+      mx_adjustment_set_values (v_adjustment,
+                                value,
+                                0, upper,
+                                avail_height / 6,
+                                avail_height - avail_height / 6,
+                                avail_height);
     }
 }
 
@@ -200,6 +1052,7 @@ on_store_item_added (MnbClipboardStore    *store,
  *
  *  - paint the background
  *  - paint the first row with a different background color
+ *  - paint the pinned rows before the history
  *  - paint the children
  *
  * so: KEEP IN SYNC WITH MxBoxLayout::paint
@@ -208,9 +1061,12 @@ static void
 mnb_clipboard_view_paint (ClutterActor *actor)
 {
   MxAdjustment *h_adjustment, *v_adjustment;
+  MnbClipboardViewPrivate *priv = MNB_CLIPBOARD_VIEW (actor)->priv;
   ClutterActorBox box_b;
-  GList *children, *l;
+  GQueue *sections[2];
+  GList *l;
   gdouble x, y;
+  guint i;
 
   h_adjustment = v_adjustment = NULL;
   mx_scrollable_get_adjustments (MX_SCROLLABLE (actor),
@@ -235,37 +1091,104 @@ mnb_clipboard_view_paint (ClutterActor *actor)
   box_b.y2 = (box_b.y2 - box_b.y1) + y;
   box_b.y1 = y;
 
-  children = clutter_container_get_children (CLUTTER_CONTAINER (actor));
-  for (l = children; l != NULL; l = l->next)
+  sections[0] = priv->pinned;
+  sections[1] = priv->rows;
+
+  for (i = 0; i < G_N_ELEMENTS (sections); i++)
+    for (l = sections[i]->head; l != NULL; l = l->next)
+      {
+        ViewRow *row = l->data;
+        ClutterActor *child = CLUTTER_ACTOR (row->item);
+        ClutterActorBox child_b;
+
+        if (!CLUTTER_ACTOR_IS_VISIBLE (child))
+          continue;
+
+        clutter_actor_get_allocation_box (child, &child_b);
+
+        if ((child_b.x1 < box_b.x2) &&
+            (child_b.x2 > box_b.x1) &&
+            (child_b.y1 < box_b.y2) &&
+            (child_b.y2 > box_b.y1))
+          {
+            /* draw a background on the head row, to mark it as the
+             * current paste target
+             */
+            if (row == priv->head)
+              {
+                cogl_set_source_color4ub (0xef, 0xef, 0xef, 255);
+                cogl_rectangle (child_b.x1, child_b.y1,
+                                child_b.x2, child_b.y2);
+              }
+
+            clutter_actor_paint (child);
+          }
+      }
+}
+
+static void
+mnb_clipboard_view_dispose (GObject *gobject)
+{
+  MnbClipboardViewPrivate *priv = MNB_CLIPBOARD_VIEW (gobject)->priv;
+
+  if (priv->rebuild_id != 0)
     {
-      ClutterActor *child = l->data;
-      ClutterActorBox child_b;
+      g_source_remove (priv->rebuild_id);
+      priv->rebuild_id = 0;
+    }
 
-      if (!CLUTTER_ACTOR_IS_VISIBLE (child))
-        continue;
+  if (priv->match_cancellable != NULL)
+    {
+      g_cancellable_cancel (priv->match_cancellable);
+      g_object_unref (priv->match_cancellable);
+      priv->match_cancellable = NULL;
+    }
+
+  mnb_clipboard_view_drop_rows (MNB_CLIPBOARD_VIEW (gobject));
+  mnb_clipboard_view_drain_pool (MNB_CLIPBOARD_VIEW (gobject));
+
+  G_OBJECT_CLASS (mnb_clipboard_view_parent_class)->dispose (gobject);
+}
 
-      clutter_actor_get_allocation_box (child, &child_b);
+/* the first step under memory pressure: the shaped layouts can be
+ * created again, so we shrink their cache until the pressure goes
+ * away
+ */
+static void
+on_store_pressure_level_changed (MnbClipboardStore *store,
+                                 GParamSpec        *pspec,
+                                 MnbClipboardView  *view)
+{
+  MnbClipboardViewPrivate *priv = view->priv;
+  MnbClipboardLayoutCache *cache = mnb_clipboard_layout_cache_get_default ();
 
-      if ((child_b.x1 < box_b.x2) &&
-          (child_b.x2 > box_b.x1) &&
-          (child_b.y1 < box_b.y2) &&
-          (child_b.y2 > box_b.y1))
+  if (mnb_clipboard_store_get_pressure_level (store) >= MNB_CLIPBOARD_PRESSURE_LOW)
+    {
+      if (priv->saved_cache_size == 0)
         {
-          /* draw a background on the first row, to mark it as the
-           * current paste target
-           */
-          if (l == children)
-            {
-              cogl_set_source_color4ub (0xef, 0xef, 0xef, 255);
-              cogl_rectangle (child_b.x1, child_b.y1,
-                              child_b.x2, child_b.y2);
-            }
+          priv->saved_cache_size =
+            mnb_clipboard_layout_cache_get_max_entries (cache);
 
-          clutter_actor_paint (child);
+          mnb_clipboard_layout_cache_set_max_entries (cache,
+                                                      PRESSURE_LAYOUT_CACHE_SIZE);
+
+          /* the pooled rows only save some time on the next resume */
+          mnb_clipboard_view_drain_pool (view);
         }
-    }
 
-  g_list_free (children);
+      if (priv->is_suspended)
+        {
+          mnb_clipboard_layout_cache_trim (cache, 0);
+          mnb_clipboard_file_cache_trim (mnb_clipboard_file_cache_get_default (),
+                                         0);
+        }
+    }
+  else if (priv->saved_cache_size != 0)
+    {
+      mnb_clipboard_layout_cache_set_max_entries (cache,
+                                                  priv->saved_cache_size);
+      priv->saved_cache_size = 0;
+    }
 }
 
 static void
@@ -275,8 +1198,16 @@ mnb_clipboard_view_finalize (GObject *gobject)
 
   g_signal_handler_disconnect (priv->store, priv->add_id);
   g_signal_handler_disconnect (priv->store, priv->remove_id);
+  g_signal_handler_disconnect (priv->store, priv->changed_id);
+  g_signal_handler_disconnect (priv->store, priv->pressure_id);
   g_object_unref (priv->store);
 
+  g_slist_free (priv->dirty_rows);
+  g_hash_table_destroy (priv->rows_by_serial);
+  g_queue_free (priv->rows);
+  g_queue_free (priv->pinned);
+  g_queue_free (priv->row_pool);
+
   G_OBJECT_CLASS (mnb_clipboard_view_parent_class)->finalize (gobject);
 }
 
@@ -305,6 +1236,18 @@ mnb_clipboard_view_set_property (GObject      *gobject,
               priv->remove_id = 0;
             }
 
+          if (priv->changed_id != 0)
+            {
+              g_signal_handler_disconnect (priv->store, priv->changed_id);
+              priv->changed_id = 0;
+            }
+
+          if (priv->pressure_id != 0)
+            {
+              g_signal_handler_disconnect (priv->store, priv->pressure_id);
+              priv->pressure_id = 0;
+            }
+
           g_object_unref (priv->store);
         }
 
@@ -313,12 +1256,19 @@ mnb_clipboard_view_set_property (GObject      *gobject,
       else
         priv->store = mnb_clipboard_store_new ();
 
-      priv->add_id = g_signal_connect (priv->store, "item-added",
-                                       G_CALLBACK (on_store_item_added),
+      priv->add_id = g_signal_connect (priv->store, "items-added",
+                                       G_CALLBACK (on_store_items_added),
                                        gobject);
-      priv->remove_id = g_signal_connect (priv->store, "item-removed",
-                                          G_CALLBACK (on_store_item_removed),
+      priv->remove_id = g_signal_connect (priv->store, "items-removed",
+                                          G_CALLBACK (on_store_items_removed),
                                           gobject);
+      priv->changed_id = g_signal_connect (priv->store, "item-changed",
+                                           G_CALLBACK (on_store_item_changed),
+                                           gobject);
+      priv->pressure_id =
+        g_signal_connect (priv->store, "notify::pressure-level",
+                          G_CALLBACK (on_store_pressure_level_changed),
+                          gobject);
       break;
 
     default:
@@ -358,8 +1308,11 @@ mnb_clipboard_view_class_init (MnbClipboardViewClass *klass)
 
   gobject_class->set_property = mnb_clipboard_view_set_property;
   gobject_class->get_property = mnb_clipboard_view_get_property;
+  gobject_class->dispose = mnb_clipboard_view_dispose;
   gobject_class->finalize = mnb_clipboard_view_finalize;
 
+  actor_class->get_preferred_height = mnb_clipboard_view_get_preferred_height;
+  actor_class->allocate = mnb_clipboard_view_allocate;
   actor_class->paint = mnb_clipboard_view_paint;
 
   pspec = g_param_spec_object ("store",
@@ -374,10 +1327,18 @@ mnb_clipboard_view_class_init (MnbClipboardViewClass *klass)
 static void
 mnb_clipboard_view_init (MnbClipboardView *view)
 {
-  view->priv = MNB_CLIPBOARD_VIEW_GET_PRIVATE (view);
+  MnbClipboardViewPrivate *priv;
+
+  view->priv = priv = MNB_CLIPBOARD_VIEW_GET_PRIVATE (view);
+
+  priv->rows = g_queue_new ();
+  priv->pinned = g_queue_new ();
+  priv->row_pool = g_queue_new ();
+  priv->rows_by_serial = g_hash_table_new (g_int64_hash, g_int64_equal);
+  priv->layout_width = -1;
 
   mx_box_layout_set_orientation (MX_BOX_LAYOUT (view), MX_ORIENTATION_VERTICAL);
-  mx_box_layout_set_spacing (MX_BOX_LAYOUT (view), 2);
+  mx_box_layout_set_spacing (MX_BOX_LAYOUT (view), ROW_SPACING);
 }
 
 MxWidget *
@@ -398,6 +1359,75 @@ mnb_clipboard_view_get_store (MnbClipboardView *view)
   return view->priv->store;
 }
 
+/* shows the rows of @serials and hides the others; all the rows are
+ * shown if @serials is %NULL
+ */
+static void
+mnb_clipboard_view_show_matches (MnbClipboardView *view,
+                                 GArray           *serials)
+{
+  MnbClipboardViewPrivate *priv = view->priv;
+  GHashTable *matches = NULL;
+  GQueue *queues[2];
+  GList *l;
+  gint i;
+
+  if (serials != NULL)
+    {
+      matches = g_hash_table_new (g_int64_hash, g_int64_equal);
+      for (i = 0; i < serials->len; i++)
+        g_hash_table_insert (matches,
+                             &g_array_index (serials, gint64, i),
+                             GINT_TO_POINTER (1));
+    }
+
+  queues[0] = priv->pinned;
+  queues[1] = priv->rows;
+
+  for (i = 0; i < G_N_ELEMENTS (queues); i++)
+    for (l = queues[i]->head; l != NULL; l = l->next)
+      {
+        ViewRow *row = l->data;
+
+        if (matches != NULL &&
+            g_hash_table_lookup (matches, &row->serial) == NULL)
+          clutter_actor_hide (CLUTTER_ACTOR (row->item));
+        else
+          clutter_actor_show (CLUTTER_ACTOR (row->item));
+      }
+
+  if (matches != NULL)
+    g_hash_table_destroy (matches);
+
+  /* the visible rows changed, but their heights are still cached */
+  priv->pinned_valid = FALSE;
+  mnb_clipboard_view_invalidate_layout (view);
+}
+
+static void
+on_store_match_ready (MnbClipboardStore *store,
+                      GArray            *serials,
+                      gpointer           user_data)
+{
+  MnbClipboardView *view = user_data;
+  MnbClipboardViewPrivate *priv = view->priv;
+
+  g_object_unref (priv->match_cancellable);
+  priv->match_cancellable = NULL;
+
+  mnb_clipboard_view_show_matches (view, serials);
+}
+
+/**
+ * mnb_clipboard_view_filter:
+ * @view: a #MnbClipboardView
+ * @filter: (allow-none): the text to look for, or %NULL
+ *
+ * Shows only the rows of @view matching @filter, or all of them if
+ * @filter is %NULL or empty. The store might search in another
+ * process: the rows change when it answers, and a newer filter
+ * cancels the search in progress.
+ */
 void
 mnb_clipboard_view_filter (MnbClipboardView *view,
                            const gchar      *filter)
@@ -408,32 +1438,111 @@ mnb_clipboard_view_filter (MnbClipboardView *view,
 
   priv = view->priv;
 
-  if (priv->rows == NULL)
+  if (priv->match_cancellable != NULL)
+    {
+      g_cancellable_cancel (priv->match_cancellable);
+      g_object_unref (priv->match_cancellable);
+      priv->match_cancellable = NULL;
+    }
+
+  if (g_queue_is_empty (priv->rows) && g_queue_is_empty (priv->pinned))
     return;
 
   if (filter == NULL || *filter == '\0')
-    g_slist_foreach (priv->rows, (GFunc) clutter_actor_show, NULL);
-  else
     {
-      gchar *needle;
-      GSList *l;
+      mnb_clipboard_view_show_matches (view, NULL);
+      return;
+    }
 
-      needle = g_utf8_strdown (filter, -1);
+  /* the store might answer right away, clearing the cancellable */
+  priv->match_cancellable = g_cancellable_new ();
+  mnb_clipboard_store_match_async (priv->store, filter,
+                                   priv->match_cancellable,
+                                   on_store_match_ready,
+                                   view);
+}
 
-      for (l = priv->rows; l != NULL; l = l->next)
-        {
-          MnbClipboardItem *row = l->data;
-          const gchar *contents;
-
-          contents = mnb_clipboard_item_get_filter_contents (row);
-          if (strstr (contents, needle) == NULL)
-            clutter_actor_hide (CLUTTER_ACTOR (row));
-          else
-            clutter_actor_show (CLUTTER_ACTOR (row));
-        }
+/**
+ * mnb_clipboard_view_suspend:
+ * @view: a #MnbClipboardView
+ *
+ * Tears down the rows of @view and drops the shaped layouts above a
+ * small budget; the store keeps capturing in the meantime. Used while
+ * the panel is hidden. A few of the text rows are kept aside, emptied,
+ * so that the next resume does not create all of its actors again.
+ */
+void
+mnb_clipboard_view_suspend (MnbClipboardView *view)
+{
+  MnbClipboardViewPrivate *priv;
+
+  g_return_if_fail (MNB_IS_CLIPBOARD_VIEW (view));
+
+  priv = view->priv;
+
+  if (priv->is_suspended)
+    return;
 
-      g_free (needle);
+  priv->is_suspended = TRUE;
+
+  if (priv->rebuild_id != 0)
+    {
+      g_source_remove (priv->rebuild_id);
+      priv->rebuild_id = 0;
     }
 
-  clutter_actor_queue_relayout (CLUTTER_ACTOR (view));
+  mnb_clipboard_view_drop_rows (view);
+
+  mnb_clipboard_layout_cache_trim (mnb_clipboard_layout_cache_get_default (),
+                                   SUSPENDED_LAYOUT_CACHE_SIZE);
+}
+
+/**
+ * mnb_clipboard_view_resume:
+ * @view: a #MnbClipboardView
+ *
+ * Rebuilds the rows of @view from the store: the pinned rows and the
+ * first rows of the history are created immediately, the remaining
+ * ones when idle.
+ */
+void
+mnb_clipboard_view_resume (MnbClipboardView *view)
+{
+  MnbClipboardViewPrivate *priv;
+  guint i, n_pinned;
+
+  g_return_if_fail (MNB_IS_CLIPBOARD_VIEW (view));
+
+  priv = view->priv;
+
+  if (!priv->is_suspended)
+    return;
+
+  priv->is_suspended = FALSE;
+  priv->rebuild_row = 0;
+
+  /* there are only a few pinned items, and they are at the top */
+  n_pinned = mnb_clipboard_store_get_n_pinned (priv->store);
+  for (i = 0; i < n_pinned; i++)
+    {
+      MnbClipboardItemType item_type = MNB_CLIPBOARD_ITEM_INVALID;
+      gchar *preview = NULL;
+      gint64 serial = 0;
+
+      if (mnb_clipboard_store_get_pinned_row (priv->store, i,
+                                              &item_type,
+                                              &serial,
+                                              NULL,
+                                              &preview))
+        mnb_clipboard_view_insert_row (view, item_type, serial, preview,
+                                       TRUE, FALSE);
+
+      g_free (preview);
+    }
+
+  if (mnb_clipboard_view_rebuild_rows (view, RESUME_ROWS))
+    priv->rebuild_id = g_idle_add_full (G_PRIORITY_LOW,
+                                        rebuild_rows_idle,
+                                        view,
+                                        NULL);
 }
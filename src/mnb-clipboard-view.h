@@ -57,6 +57,9 @@ MnbClipboardStore *mnb_clipboard_view_get_store (MnbClipboardView *view);
 void mnb_clipboard_view_filter (MnbClipboardView *view,
                                 const gchar      *filter);
 
+void mnb_clipboard_view_suspend (MnbClipboardView *view);
+void mnb_clipboard_view_resume  (MnbClipboardView *view);
+
 G_END_DECLS
 
 #endif /* __MNB_CLIPBOARD_VIEW_H__ */
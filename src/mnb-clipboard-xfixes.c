@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2008 - 2009 Intel Corporation.
+ *
+ * Author: Emmanuele Bassi <ebassi@linux.intel.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * MnbClipboardXFixes: the owner changes of the selections, straight
+ * from XFixes
+ *
+ * GtkClipboard reports the owner changes too, but every capture then
+ * goes through its generic machinery. Here we subscribe to the XFixes
+ * notifications of CLIPBOARD and PRIMARY ourselves, and pass on the
+ * time each owner took its selection; an owner that asserts the same
+ * selection again, with the same time, is skipped.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <gdk/gdkx.h>
+
+#ifdef HAVE_XFIXES
+#include <X11/extensions/Xfixes.h>
+#endif
+
+#include "mnb-clipboard-xfixes.h"
+
+#ifdef HAVE_XFIXES
+
+#define N_SELECTIONS    (2)
+
+struct _MnbClipboardXFixes
+{
+  GdkWindow *window;
+
+  gint event_base;
+
+  /* CLIPBOARD and PRIMARY, and their last owner */
+  Atom selections[N_SELECTIONS];
+  Window owners[N_SELECTIONS];
+  Time times[N_SELECTIONS];
+
+  MnbClipboardOwnerFunc func;
+  gpointer user_data;
+};
+
+static GdkFilterReturn
+xfixes_filter (GdkXEvent *gdk_xevent,
+               GdkEvent  *event,
+               gpointer   data)
+{
+  MnbClipboardXFixes *xfixes = data;
+  XFixesSelectionNotifyEvent *xevent = gdk_xevent;
+  gboolean is_gone;
+  gint i;
+
+  if (xevent->type != xfixes->event_base + XFixesSelectionNotify)
+    return GDK_FILTER_CONTINUE;
+
+  for (i = 0; i < N_SELECTIONS; i++)
+    if (xevent->selection == xfixes->selections[i])
+      break;
+
+  if (i == N_SELECTIONS)
+    return GDK_FILTER_CONTINUE;
+
+  is_gone = xevent->subtype != XFixesSetSelectionOwnerNotify;
+
+  /* nothing changed since the last notification */
+  if (!is_gone &&
+      xevent->owner == xfixes->owners[i] &&
+      xevent->selection_timestamp == xfixes->times[i])
+    return GDK_FILTER_REMOVE;
+
+  xfixes->owners[i] = is_gone ? None : xevent->owner;
+  xfixes->times[i] = xevent->selection_timestamp;
+
+  xfixes->func (gdk_x11_xatom_to_atom (xevent->selection),
+                xfixes->owners[i],
+                xevent->selection_timestamp,
+                is_gone,
+                xfixes->user_data);
+
+  return GDK_FILTER_REMOVE;
+}
+
+/*
+ * mnb_clipboard_xfixes_new:
+ * @func: called for every owner change
+ * @user_data: data for @func
+ *
+ * Starts watching CLIPBOARD and PRIMARY.
+ *
+ * Return value: the watcher, or %NULL if the X server does not have
+ *   the XFixes extension
+ */
+MnbClipboardXFixes *
+mnb_clipboard_xfixes_new (MnbClipboardOwnerFunc func,
+                          gpointer              user_data)
+{
+  MnbClipboardXFixes *xfixes;
+  GdkWindowAttr attributes;
+  Display *xdisplay;
+  gint event_base, error_base, i;
+
+  g_return_val_if_fail (func != NULL, NULL);
+
+  xdisplay = GDK_DISPLAY_XDISPLAY (gdk_display_get_default ());
+
+  if (!XFixesQueryExtension (xdisplay, &event_base, &error_base))
+    return NULL;
+
+  memset (&attributes, 0, sizeof (GdkWindowAttr));
+  attributes.x = -100;
+  attributes.y = -100;
+  attributes.width = 1;
+  attributes.height = 1;
+  attributes.window_type = GDK_WINDOW_TOPLEVEL;
+  attributes.wclass = GDK_INPUT_ONLY;
+  attributes.override_redirect = TRUE;
+
+  xfixes = g_slice_new0 (MnbClipboardXFixes);
+  xfixes->window = gdk_window_new (NULL, &attributes,
+                                   GDK_WA_X | GDK_WA_Y | GDK_WA_NOREDIR);
+  xfixes->event_base = event_base;
+  xfixes->selections[0] = gdk_x11_get_xatom_by_name ("CLIPBOARD");
+  xfixes->selections[1] = gdk_x11_get_xatom_by_name ("PRIMARY");
+  xfixes->func = func;
+  xfixes->user_data = user_data;
+
+  gdk_window_add_filter (xfixes->window, xfixes_filter, xfixes);
+
+  for (i = 0; i < N_SELECTIONS; i++)
+    XFixesSelectSelectionInput (xdisplay,
+                                GDK_WINDOW_XID (xfixes->window),
+                                xfixes->selections[i],
+                                XFixesSetSelectionOwnerNotifyMask |
+                                XFixesSelectionWindowDestroyNotifyMask |
+                                XFixesSelectionClientCloseNotifyMask);
+
+  return xfixes;
+}
+
+void
+mnb_clipboard_xfixes_free (MnbClipboardXFixes *xfixes)
+{
+  if (xfixes == NULL)
+    return;
+
+  gdk_window_remove_filter (xfixes->window, xfixes_filter, xfixes);
+  gdk_window_destroy (xfixes->window);
+
+  g_slice_free (MnbClipboardXFixes, xfixes);
+}
+
+#else /* !HAVE_XFIXES */
+
+MnbClipboardXFixes *
+mnb_clipboard_xfixes_new (MnbClipboardOwnerFunc func,
+                          gpointer              user_data)
+{
+  return NULL;
+}
+
+void
+mnb_clipboard_xfixes_free (MnbClipboardXFixes *xfixes)
+{
+}
+
+#endif /* HAVE_XFIXES */
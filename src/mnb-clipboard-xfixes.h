@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2008 - 2009 Intel Corporation.
+ *
+ * Author: Emmanuele Bassi <ebassi@linux.intel.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __MNB_CLIPBOARD_XFIXES_H__
+#define __MNB_CLIPBOARD_XFIXES_H__
+
+#include <gdk/gdk.h>
+
+G_BEGIN_DECLS
+
+typedef struct _MnbClipboardXFixes      MnbClipboardXFixes;
+
+/* @owner is the window owning the selection, and @time_ the time it
+ * took it; @is_gone is set when the owner went away instead of being
+ * replaced
+ */
+typedef void (* MnbClipboardOwnerFunc) (GdkAtom   selection,
+                                        guint32   owner,
+                                        guint32   time_,
+                                        gboolean  is_gone,
+                                        gpointer  user_data);
+
+MnbClipboardXFixes *mnb_clipboard_xfixes_new  (MnbClipboardOwnerFunc  func,
+                                               gpointer               user_data);
+void                mnb_clipboard_xfixes_free (MnbClipboardXFixes    *xfixes);
+
+G_END_DECLS
+
+#endif /* __MNB_CLIPBOARD_XFIXES_H__ */
@@ -0,0 +1,1060 @@
+/*
+ * Copyright (C) 2008 - 2009 Intel Corporation.
+ *
+ * Author: Emmanuele Bassi <ebassi@linux.intel.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * MnbPasteboardService: exports a MnbClipboardStore on the session bus
+ *
+ * The history is listed in pages of previews, newest first; the full
+ * contents of an item are only sent by Get(), and large contents are
+ * passed as a file descriptor instead of going through the bus daemon:
+ * long texts are copied into a sealed file, while images are passed as
+ * their stored PNG file, opened read-only.
+ *
+ * The changes of the store are coalesced and emitted once per main
+ * loop iteration by the ItemsChanged signal.
+ */
+
+/* for memfd_create() */
+#define _GNU_SOURCE
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef HAVE_MEMFD_CREATE
+#include <sys/mman.h>
+#endif
+
+#include <glib/gstdio.h>
+#include <gio/gunixfdlist.h>
+
+#include "mnb-pasteboard-service.h"
+
+/* contents bigger than this are passed as a file descriptor */
+#define INLINE_PAYLOAD_MAX      (16 * 1024)
+
+/* upper bound for the items returned by a single call */
+#define MAX_ITEMS_PER_CALL      (512)
+
+#define MNB_PASTEBOARD_SERVICE_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), MNB_TYPE_PASTEBOARD_SERVICE, MnbPasteboardServicePrivate))
+
+struct _MnbPasteboardServicePrivate
+{
+  MnbClipboardStore *store;
+
+  GDBusConnection *connection;
+  guint registration_id;
+
+  gulong added_id;
+  gulong removed_id;
+  gulong changed_id;
+  gulong selection_id;
+
+  /* the changes since the last ItemsChanged */
+  GArray *changed_serials;
+  GArray *removed_serials;
+  guint flush_id;
+};
+
+enum
+{
+  PROP_0,
+
+  PROP_STORE
+};
+
+static const gchar introspection_xml[] =
+  "<node>"
+  "  <interface name='" MNB_PASTEBOARD_DBUS_INTERFACE "'>"
+  "    <method name='ListItems'>"
+  "      <arg type='x' name='first_serial' direction='in'/>"
+  "      <arg type='x' name='last_serial' direction='in'/>"
+  "      <arg type='u' name='max_items' direction='in'/>"
+  "      <arg type='a(ixxsb)' name='items' direction='out'/>"
+  "    </method>"
+  "    <method name='ListPinned'>"
+  "      <arg type='a(ixxsb)' name='items' direction='out'/>"
+  "    </method>"
+  "    <method name='Search'>"
+  "      <arg type='s' name='query' direction='in'/>"
+  "      <arg type='u' name='max_items' direction='in'/>"
+  "      <arg type='ax' name='serials' direction='out'/>"
+  "    </method>"
+  "    <method name='Get'>"
+  "      <arg type='x' name='serial' direction='in'/>"
+  "      <arg type='i' name='type' direction='out'/>"
+  "      <arg type='x' name='mtime' direction='out'/>"
+  "      <arg type='b' name='pinned' direction='out'/>"
+  "      <arg type='s' name='mime_type' direction='out'/>"
+  "      <arg type='s' name='text' direction='out'/>"
+  "      <arg type='h' name='contents' direction='out'/>"
+  "    </method>"
+  "    <method name='GetSelection'>"
+  "      <arg type='s' name='preview' direction='out'/>"
+  "    </method>"
+  "    <method name='Remove'>"
+  "      <arg type='x' name='serial' direction='in'/>"
+  "    </method>"
+  "    <method name='RemoveItems'>"
+  "      <arg type='ax' name='serials' direction='in'/>"
+  "    </method>"
+  "    <method name='Pin'>"
+  "      <arg type='x' name='serial' direction='in'/>"
+  "      <arg type='b' name='pinned' direction='in'/>"
+  "    </method>"
+  "    <method name='CopyBack'>"
+  "      <arg type='x' name='serial' direction='in'/>"
+  "    </method>"
+  "    <method name='SaveSelection'/>"
+  "    <method name='Clear'/>"
+  "    <method name='GetStats'>"
+  "      <arg type='a{sv}' name='stats' direction='out'/>"
+  "    </method>"
+  "    <signal name='ItemsChanged'>"
+  "      <arg type='a(ixxsb)' name='items'/>"
+  "      <arg type='ax' name='removed'/>"
+  "    </signal>"
+  "    <signal name='SelectionChanged'>"
+  "      <arg type='s' name='preview'/>"
+  "    </signal>"
+  "  </interface>"
+  "</node>";
+
+static GDBusNodeInfo *introspection_data = NULL;
+
+G_DEFINE_TYPE (MnbPasteboardService, mnb_pasteboard_service, G_TYPE_OBJECT);
+
+static void
+mnb_pasteboard_service_emit (MnbPasteboardService *service,
+                             const gchar          *signal_name,
+                             GVariant             *parameters)
+{
+  MnbPasteboardServicePrivate *priv = service->priv;
+  GError *error = NULL;
+
+  if (priv->registration_id == 0)
+    {
+      g_variant_unref (g_variant_ref_sink (parameters));
+      return;
+    }
+
+  g_dbus_connection_emit_signal (priv->connection,
+                                 NULL,
+                                 MNB_PASTEBOARD_DBUS_PATH,
+                                 MNB_PASTEBOARD_DBUS_INTERFACE,
+                                 signal_name,
+                                 parameters,
+                                 &error);
+  if (error != NULL)
+    {
+      g_warning ("Unable to emit the %s signal: %s",
+                 signal_name,
+                 error->message);
+      g_error_free (error);
+    }
+}
+
+static gint
+compare_serials (gconstpointer a,
+                 gconstpointer b)
+{
+  gint64 serial_a = *((const gint64 *) a);
+  gint64 serial_b = *((const gint64 *) b);
+
+  /* newest first */
+  if (serial_a > serial_b)
+    return -1;
+
+  if (serial_a < serial_b)
+    return 1;
+
+  return 0;
+}
+
+static gboolean
+mnb_pasteboard_service_flush (gpointer data)
+{
+  MnbPasteboardService *service = data;
+  MnbPasteboardServicePrivate *priv = service->priv;
+  GVariantBuilder items, removed;
+  gint64 last_serial = 0;
+  guint i;
+
+  priv->flush_id = 0;
+
+  g_variant_builder_init (&items, G_VARIANT_TYPE ("a(ixxsb)"));
+  g_variant_builder_init (&removed, G_VARIANT_TYPE ("ax"));
+
+  g_array_sort (priv->changed_serials, compare_serials);
+
+  for (i = 0; i < priv->changed_serials->len; i++)
+    {
+      gint64 serial = g_array_index (priv->changed_serials, gint64, i);
+      MnbClipboardItemType item_type = MNB_CLIPBOARD_ITEM_INVALID;
+      gchar *preview = NULL;
+      gboolean is_pinned = FALSE;
+      gint64 mtime = 0;
+
+      if (serial == last_serial)
+        continue;
+
+      last_serial = serial;
+
+      /* the item might have been removed in the meantime */
+      if (!mnb_clipboard_store_get_item (priv->store, serial,
+                                         &item_type,
+                                         &mtime,
+                                         &preview,
+                                         &is_pinned))
+        continue;
+
+      g_variant_builder_add (&items, "(ixxsb)",
+                             item_type,
+                             serial,
+                             mtime,
+                             preview != NULL ? preview : "",
+                             is_pinned);
+
+      g_free (preview);
+    }
+
+  for (i = 0; i < priv->removed_serials->len; i++)
+    g_variant_builder_add (&removed, "x",
+                           g_array_index (priv->removed_serials, gint64, i));
+
+  g_array_set_size (priv->changed_serials, 0);
+  g_array_set_size (priv->removed_serials, 0);
+
+  mnb_pasteboard_service_emit (service, "ItemsChanged",
+                               g_variant_new ("(a(ixxsb)ax)",
+                                              &items,
+                                              &removed));
+
+  return FALSE;
+}
+
+/* nobody can be listening before the object is registered */
+static void
+mnb_pasteboard_service_queue_change (MnbPasteboardService *service,
+                                     GArray               *serials,
+                                     gint64                serial)
+{
+  MnbPasteboardServicePrivate *priv = service->priv;
+
+  if (priv->registration_id == 0)
+    return;
+
+  g_array_append_val (serials, serial);
+
+  if (priv->flush_id == 0)
+    priv->flush_id = g_idle_add_full (G_PRIORITY_DEFAULT,
+                                      mnb_pasteboard_service_flush,
+                                      service,
+                                      NULL);
+}
+
+static void
+on_store_items_added (MnbClipboardStore    *store,
+                      GArray               *serials,
+                      MnbPasteboardService *service)
+{
+  guint i;
+
+  for (i = 0; i < serials->len; i++)
+    mnb_pasteboard_service_queue_change (service,
+                                         service->priv->changed_serials,
+                                         g_array_index (serials, gint64, i));
+}
+
+static void
+on_store_item_changed (MnbClipboardStore    *store,
+                       gint64                serial,
+                       MnbPasteboardService *service)
+{
+  mnb_pasteboard_service_queue_change (service,
+                                       service->priv->changed_serials,
+                                       serial);
+}
+
+static void
+on_store_items_removed (MnbClipboardStore    *store,
+                        GArray               *serials,
+                        MnbPasteboardService *service)
+{
+  guint i;
+
+  for (i = 0; i < serials->len; i++)
+    mnb_pasteboard_service_queue_change (service,
+                                         service->priv->removed_serials,
+                                         g_array_index (serials, gint64, i));
+}
+
+static void
+on_store_selection_changed (MnbClipboardStore    *store,
+                            const gchar          *preview,
+                            MnbPasteboardService *service)
+{
+  mnb_pasteboard_service_emit (service, "SelectionChanged",
+                               g_variant_new ("(s)",
+                                              preview != NULL ? preview : ""));
+}
+
+/* the items with first_serial <= serial <= last_serial, newest first;
+ * a last_serial of 0 means "up to the newest item". The serials grow
+ * with the history, so the first row is looked up rather than scanned
+ * for, and each row is read once
+ */
+static GVariant *
+mnb_pasteboard_service_list_items (MnbPasteboardService *service,
+                                   gint64                first_serial,
+                                   gint64                last_serial,
+                                   guint                 max_items)
+{
+  MnbClipboardStore *store = service->priv->store;
+  GVariantBuilder builder;
+  guint i, n_items, n_added;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(ixxsb)"));
+
+  max_items = CLAMP (max_items, 1, MAX_ITEMS_PER_CALL);
+  n_items = mnb_clipboard_store_get_n_items (store);
+
+  if (last_serial <= 0)
+    i = 0;
+  else
+    i = mnb_clipboard_store_find_row (store, last_serial);
+
+  for (n_added = 0; i < n_items && n_added < max_items; i++)
+    {
+      MnbClipboardItemType item_type = MNB_CLIPBOARD_ITEM_INVALID;
+      gchar *preview = NULL;
+      gboolean is_pinned = FALSE;
+      gint64 serial = 0, mtime = 0;
+
+      if (!mnb_clipboard_store_get_row (store, i,
+                                        &item_type,
+                                        &serial,
+                                        &mtime,
+                                        &preview,
+                                        &is_pinned))
+        break;
+
+      if (serial < first_serial)
+        {
+          g_free (preview);
+          break;
+        }
+
+      g_variant_builder_add (&builder, "(ixxsb)",
+                             item_type,
+                             serial,
+                             mtime,
+                             preview != NULL ? preview : "",
+                             is_pinned);
+
+      g_free (preview);
+      n_added += 1;
+    }
+
+  return g_variant_new ("(a(ixxsb))", &builder);
+}
+
+/* the pinned items are not part of the history, and there are only
+ * a few of them, so they come in a single call
+ */
+static GVariant *
+mnb_pasteboard_service_list_pinned (MnbPasteboardService *service)
+{
+  MnbClipboardStore *store = service->priv->store;
+  GVariantBuilder builder;
+  guint i, n_items;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(ixxsb)"));
+
+  n_items = mnb_clipboard_store_get_n_pinned (store);
+
+  for (i = 0; i < n_items; i++)
+    {
+      MnbClipboardItemType item_type = MNB_CLIPBOARD_ITEM_INVALID;
+      gchar *preview = NULL;
+      gint64 serial = 0, mtime = 0;
+
+      if (!mnb_clipboard_store_get_pinned_row (store, i,
+                                               &item_type,
+                                               &serial,
+                                               &mtime,
+                                               &preview))
+        break;
+
+      g_variant_builder_add (&builder, "(ixxsb)",
+                             item_type,
+                             serial,
+                             mtime,
+                             preview != NULL ? preview : "",
+                             TRUE);
+
+      g_free (preview);
+    }
+
+  return g_variant_new ("(a(ixxsb))", &builder);
+}
+
+static GVariant *
+mnb_pasteboard_service_search (MnbPasteboardService *service,
+                               const gchar          *query,
+                               guint                 max_items)
+{
+  GVariantBuilder builder;
+  GArray *matches;
+  guint i;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("ax"));
+
+  max_items = CLAMP (max_items, 1, MAX_ITEMS_PER_CALL);
+
+  matches = mnb_clipboard_store_match (service->priv->store, query);
+  for (i = 0; i < matches->len && i < max_items; i++)
+    g_variant_builder_add (&builder, "x", g_array_index (matches, gint64, i));
+
+  g_array_free (matches, TRUE);
+
+  return g_variant_new ("(ax)", &builder);
+}
+
+/* a sealed, unlinked file holding the text of @serial, written
+ * straight from the store
+ */
+static gint
+create_payload_fd (MnbClipboardStore  *store,
+                   gint64              serial,
+                   GError            **error)
+{
+  gint fd;
+
+#ifdef HAVE_MEMFD_CREATE
+  fd = memfd_create ("pasteboard-item", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (fd == -1)
+    {
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                   "Unable to create the payload: %s",
+                   g_strerror (errno));
+      return -1;
+    }
+#else
+  gchar *path = NULL;
+
+  fd = g_file_open_tmp ("pasteboard-item-XXXXXX", &path, error);
+  if (fd == -1)
+    return -1;
+
+  g_unlink (path);
+  g_free (path);
+#endif /* HAVE_MEMFD_CREATE */
+
+  if (!mnb_clipboard_store_write_text (store, serial, fd, error))
+    {
+      close (fd);
+      return -1;
+    }
+
+  lseek (fd, 0, SEEK_SET);
+
+#ifdef HAVE_MEMFD_CREATE
+  fcntl (fd, F_ADD_SEALS,
+         F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+#endif
+
+  return fd;
+}
+
+/* the stored PNG file of an image, opened read-only */
+static gint
+open_image_fd (const gchar  *image_uri,
+               GError      **error)
+{
+  gchar *path;
+  gint fd;
+
+  path = g_filename_from_uri (image_uri, NULL, error);
+  if (path == NULL)
+    return -1;
+
+  fd = g_open (path, O_RDONLY | O_CLOEXEC, 0);
+  if (fd == -1)
+    g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                 "Unable to open the image '%s': %s",
+                 path,
+                 g_strerror (errno));
+
+  g_free (path);
+
+  return fd;
+}
+
+static void
+mnb_pasteboard_service_get (MnbPasteboardService  *service,
+                            GDBusMethodInvocation *invocation,
+                            gint64                 serial)
+{
+  MnbClipboardStore *store = service->priv->store;
+  GDBusConnection *connection;
+  MnbClipboardItemType item_type = MNB_CLIPBOARD_ITEM_INVALID;
+  GUnixFDList *fd_list = NULL;
+  const gchar *mime_type;
+  gboolean is_pinned = FALSE, can_pass_fd;
+  GError *error = NULL;
+  gint64 mtime = 0;
+  gchar *text = NULL, **uris = NULL;
+  gint fd = -1, fd_index = -1;
+
+  if (!mnb_clipboard_store_get_item (store, serial,
+                                     &item_type,
+                                     &mtime,
+                                     NULL,
+                                     &is_pinned))
+    {
+      g_dbus_method_invocation_return_error (invocation,
+                                             G_DBUS_ERROR,
+                                             G_DBUS_ERROR_INVALID_ARGS,
+                                             "No item with serial %" G_GINT64_FORMAT,
+                                             serial);
+      return;
+    }
+
+  connection = g_dbus_method_invocation_get_connection (invocation);
+  can_pass_fd = (g_dbus_connection_get_capabilities (connection) &
+                 G_DBUS_CAPABILITY_FLAGS_UNIX_FD_PASSING) != 0;
+
+  switch (item_type)
+    {
+    case MNB_CLIPBOARD_ITEM_IMAGE:
+      /* the URI of the stored image is sent anyway, for the clients
+       * that cannot receive the file
+       */
+      mime_type = "image/png";
+      uris = mnb_clipboard_store_get_uris (store, serial);
+      if (uris == NULL || uris[0] == NULL)
+        break;
+
+      text = g_strdup (uris[0]);
+
+      if (can_pass_fd)
+        fd = open_image_fd (uris[0], &error);
+      break;
+
+    case MNB_CLIPBOARD_ITEM_URIS:
+      /* the URIs only have a text if they were also copied as one */
+      mime_type = "text/uri-list";
+      uris = mnb_clipboard_store_get_uris (store, serial);
+      if (uris != NULL && uris[0] != NULL)
+        {
+          gchar *list = g_strjoinv ("\r\n", uris);
+
+          text = g_strconcat (list, "\r\n", NULL);
+          g_free (list);
+        }
+      else
+        text = mnb_clipboard_store_get_text (store, serial);
+      break;
+
+    default:
+      /* a long text goes from the store to the file descriptor,
+       * without being copied in memory first
+       */
+      mime_type = "text/plain;charset=utf-8";
+      if (can_pass_fd &&
+          mnb_clipboard_store_get_text_size (store, serial) > INLINE_PAYLOAD_MAX)
+        fd = create_payload_fd (store, serial, &error);
+      else
+        text = mnb_clipboard_store_get_text (store, serial);
+      break;
+    }
+
+  g_strfreev (uris);
+
+  if (error != NULL)
+    {
+      g_dbus_method_invocation_return_gerror (invocation, error);
+      g_error_free (error);
+      g_free (text);
+      return;
+    }
+
+  if (fd != -1)
+    {
+      fd_list = g_unix_fd_list_new_from_array (&fd, 1);
+      fd_index = 0;
+    }
+
+  g_dbus_method_invocation_return_value_with_unix_fd_list (invocation,
+                                                           g_variant_new ("(ixbssh)",
+                                                                          item_type,
+                                                                          mtime,
+                                                                          is_pinned,
+                                                                          mime_type,
+                                                                          text != NULL ? text : "",
+                                                                          fd_index),
+                                                           fd_list);
+
+  if (fd_list != NULL)
+    g_object_unref (fd_list);
+
+  g_free (text);
+}
+
+/* the number of items of the history each application copied */
+static GVariant *
+mnb_pasteboard_service_get_sources (MnbPasteboardService *service)
+{
+  MnbClipboardStore *store = service->priv->store;
+  GVariantBuilder builder;
+  GHashTableIter iter;
+  GHashTable *counts;
+  gpointer key, value;
+  guint row, n_rows;
+
+  counts = g_hash_table_new (g_str_hash, g_str_equal);
+
+  n_rows = mnb_clipboard_store_get_n_items (store);
+  for (row = 0; row < n_rows; row++)
+    {
+      const gchar *source;
+      gint64 serial;
+
+      if (!mnb_clipboard_store_get_row (store, row,
+                                        NULL, &serial, NULL, NULL, NULL))
+        continue;
+
+      source = mnb_clipboard_store_get_source (store, serial);
+      if (source == NULL)
+        continue;
+
+      value = g_hash_table_lookup (counts, source);
+      g_hash_table_insert (counts, (gpointer) source,
+                           GUINT_TO_POINTER (GPOINTER_TO_UINT (value) + 1));
+    }
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{su}"));
+
+  g_hash_table_iter_init (&iter, counts);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    g_variant_builder_add (&builder, "{su}",
+                           (const gchar *) key,
+                           GPOINTER_TO_UINT (value));
+
+  g_hash_table_destroy (counts);
+
+  return g_variant_builder_end (&builder);
+}
+
+static GVariant *
+mnb_pasteboard_service_get_stats (MnbPasteboardService *service)
+{
+  MnbClipboardStoreStats stats;
+  GVariantBuilder builder;
+  GEnumClass *enum_class;
+  GEnumValue *enum_value;
+
+  mnb_clipboard_store_get_stats (service->priv->store, &stats);
+
+  enum_class = g_type_class_ref (MNB_TYPE_CLIPBOARD_PRESSURE_LEVEL);
+  enum_value = g_enum_get_value (enum_class, stats.pressure_level);
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
+
+  g_variant_builder_add (&builder, "{sv}", "n-items",
+                         g_variant_new_uint32 (stats.n_items));
+  g_variant_builder_add (&builder, "{sv}", "pinned-items",
+                         g_variant_new_uint32 (stats.n_pinned_items));
+  g_variant_builder_add (&builder, "{sv}", "arena-live-bytes",
+                         g_variant_new_uint64 (stats.arena_live_bytes));
+  g_variant_builder_add (&builder, "{sv}", "arena-allocated-bytes",
+                         g_variant_new_uint64 (stats.arena_allocated_bytes));
+  g_variant_builder_add (&builder, "{sv}", "compressed-items",
+                         g_variant_new_uint32 (stats.n_compressed_items));
+  g_variant_builder_add (&builder, "{sv}", "spilled-items",
+                         g_variant_new_uint32 (stats.n_spilled_items));
+  g_variant_builder_add (&builder, "{sv}", "pressure-level",
+                         g_variant_new_string (enum_value != NULL
+                                               ? enum_value->value_nick
+                                               : "none"));
+  g_variant_builder_add (&builder, "{sv}", "cache-drops",
+                         g_variant_new_uint32 (stats.n_cache_drops));
+  g_variant_builder_add (&builder, "{sv}", "compressions",
+                         g_variant_new_uint32 (stats.n_compressed));
+  g_variant_builder_add (&builder, "{sv}", "spills",
+                         g_variant_new_uint32 (stats.n_spilled));
+  g_variant_builder_add (&builder, "{sv}", "evictions",
+                         g_variant_new_uint32 (stats.n_evicted));
+  g_variant_builder_add (&builder, "{sv}", "restores",
+                         g_variant_new_uint32 (stats.n_restored));
+  g_variant_builder_add (&builder, "{sv}", "throttled-captures",
+                         g_variant_new_uint32 (stats.n_throttled));
+  g_variant_builder_add (&builder, "{sv}", "sources",
+                         mnb_pasteboard_service_get_sources (service));
+
+  g_type_class_unref (enum_class);
+
+  return g_variant_new ("(a{sv})", &builder);
+}
+
+static void
+handle_method_call (GDBusConnection       *connection,
+                    const gchar           *sender,
+                    const gchar           *object_path,
+                    const gchar           *interface_name,
+                    const gchar           *method_name,
+                    GVariant              *parameters,
+                    GDBusMethodInvocation *invocation,
+                    gpointer               user_data)
+{
+  MnbPasteboardService *service = user_data;
+  MnbClipboardStore *store = service->priv->store;
+
+  if (g_strcmp0 (method_name, "ListItems") == 0)
+    {
+      gint64 first_serial = 0, last_serial = 0;
+      guint max_items = 0;
+
+      g_variant_get (parameters, "(xxu)",
+                     &first_serial,
+                     &last_serial,
+                     &max_items);
+
+      g_dbus_method_invocation_return_value (invocation,
+                                             mnb_pasteboard_service_list_items (service,
+                                                                                first_serial,
+                                                                                last_serial,
+                                                                                max_items));
+    }
+  else if (g_strcmp0 (method_name, "ListPinned") == 0)
+    {
+      g_dbus_method_invocation_return_value (invocation,
+                                             mnb_pasteboard_service_list_pinned (service));
+    }
+  else if (g_strcmp0 (method_name, "Search") == 0)
+    {
+      const gchar *query = NULL;
+      guint max_items = 0;
+
+      g_variant_get (parameters, "(&su)", &query, &max_items);
+
+      g_dbus_method_invocation_return_value (invocation,
+                                             mnb_pasteboard_service_search (service,
+                                                                            query,
+                                                                            max_items));
+    }
+  else if (g_strcmp0 (method_name, "Get") == 0)
+    {
+      gint64 serial = 0;
+
+      g_variant_get (parameters, "(x)", &serial);
+
+      mnb_pasteboard_service_get (service, invocation, serial);
+    }
+  else if (g_strcmp0 (method_name, "RemoveItems") == 0)
+    {
+      GVariant *serials;
+      const gint64 *values;
+      gsize n_values = 0;
+
+      serials = g_variant_get_child_value (parameters, 0);
+      values = g_variant_get_fixed_array (serials, &n_values, sizeof (gint64));
+
+      mnb_clipboard_store_remove_items (store, values, n_values);
+
+      g_variant_unref (serials);
+
+      g_dbus_method_invocation_return_value (invocation, NULL);
+    }
+  else if (g_strcmp0 (method_name, "Pin") == 0)
+    {
+      gboolean is_pinned = FALSE;
+      gint64 serial = 0;
+
+      g_variant_get (parameters, "(xb)", &serial, &is_pinned);
+
+      if (serial > 0)
+        mnb_clipboard_store_set_pinned (store, serial, is_pinned);
+
+      g_dbus_method_invocation_return_value (invocation, NULL);
+    }
+  else if (g_strcmp0 (method_name, "GetSelection") == 0)
+    {
+      gchar *preview = mnb_clipboard_store_get_selection_preview (store);
+
+      g_dbus_method_invocation_return_value (invocation,
+                                             g_variant_new ("(s)",
+                                                            preview != NULL ? preview : ""));
+
+      g_free (preview);
+    }
+  else if (g_strcmp0 (method_name, "Remove") == 0 ||
+           g_strcmp0 (method_name, "CopyBack") == 0)
+    {
+      gint64 serial = 0;
+
+      g_variant_get (parameters, "(x)", &serial);
+
+      if (serial <= 0)
+        {
+          g_dbus_method_invocation_return_error (invocation,
+                                                 G_DBUS_ERROR,
+                                                 G_DBUS_ERROR_INVALID_ARGS,
+                                                 "Invalid serial %" G_GINT64_FORMAT,
+                                                 serial);
+          return;
+        }
+
+      if (g_strcmp0 (method_name, "Remove") == 0)
+        mnb_clipboard_store_remove (store, serial);
+      else
+        mnb_clipboard_store_copy_back (store, serial);
+
+      g_dbus_method_invocation_return_value (invocation, NULL);
+    }
+  else if (g_strcmp0 (method_name, "SaveSelection") == 0)
+    {
+      mnb_clipboard_store_save_selection (store);
+
+      g_dbus_method_invocation_return_value (invocation, NULL);
+    }
+  else if (g_strcmp0 (method_name, "Clear") == 0)
+    {
+      mnb_clipboard_store_clear (store);
+
+      g_dbus_method_invocation_return_value (invocation, NULL);
+    }
+  else if (g_strcmp0 (method_name, "GetStats") == 0)
+    {
+      g_dbus_method_invocation_return_value (invocation,
+                                             mnb_pasteboard_service_get_stats (service));
+    }
+  else
+    g_dbus_method_invocation_return_error (invocation,
+                                           G_DBUS_ERROR,
+                                           G_DBUS_ERROR_UNKNOWN_METHOD,
+                                           "Unknown method '%s'",
+                                           method_name);
+}
+
+static const GDBusInterfaceVTable interface_vtable = {
+  handle_method_call,
+  NULL,
+  NULL
+};
+
+static void
+mnb_pasteboard_service_set_property (GObject      *gobject,
+                                     guint         prop_id,
+                                     const GValue *value,
+                                     GParamSpec   *pspec)
+{
+  MnbPasteboardService *service = MNB_PASTEBOARD_SERVICE (gobject);
+  MnbPasteboardServicePrivate *priv = service->priv;
+
+  switch (prop_id)
+    {
+    case PROP_STORE:
+      priv->store = g_value_dup_object (value);
+
+      priv->added_id =
+        g_signal_connect (priv->store, "items-added",
+                          G_CALLBACK (on_store_items_added),
+                          service);
+      priv->removed_id =
+        g_signal_connect (priv->store, "items-removed",
+                          G_CALLBACK (on_store_items_removed),
+                          service);
+      priv->changed_id =
+        g_signal_connect (priv->store, "item-changed",
+                          G_CALLBACK (on_store_item_changed),
+                          service);
+      priv->selection_id =
+        g_signal_connect (priv->store, "selection-changed",
+                          G_CALLBACK (on_store_selection_changed),
+                          service);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (gobject, prop_id, pspec);
+      break;
+    }
+}
+
+static void
+mnb_pasteboard_service_get_property (GObject    *gobject,
+                                     guint       prop_id,
+                                     GValue     *value,
+                                     GParamSpec *pspec)
+{
+  MnbPasteboardServicePrivate *priv = MNB_PASTEBOARD_SERVICE (gobject)->priv;
+
+  switch (prop_id)
+    {
+    case PROP_STORE:
+      g_value_set_object (value, priv->store);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (gobject, prop_id, pspec);
+      break;
+    }
+}
+
+static void
+mnb_pasteboard_service_dispose (GObject *gobject)
+{
+  MnbPasteboardService *service = MNB_PASTEBOARD_SERVICE (gobject);
+  MnbPasteboardServicePrivate *priv = service->priv;
+
+  mnb_pasteboard_service_unregister (service);
+
+  if (priv->store != NULL)
+    {
+      g_signal_handler_disconnect (priv->store, priv->added_id);
+      g_signal_handler_disconnect (priv->store, priv->removed_id);
+      g_signal_handler_disconnect (priv->store, priv->changed_id);
+      g_signal_handler_disconnect (priv->store, priv->selection_id);
+
+      g_object_unref (priv->store);
+      priv->store = NULL;
+    }
+
+  G_OBJECT_CLASS (mnb_pasteboard_service_parent_class)->dispose (gobject);
+}
+
+static void
+mnb_pasteboard_service_finalize (GObject *gobject)
+{
+  MnbPasteboardServicePrivate *priv = MNB_PASTEBOARD_SERVICE (gobject)->priv;
+
+  g_array_free (priv->changed_serials, TRUE);
+  g_array_free (priv->removed_serials, TRUE);
+
+  G_OBJECT_CLASS (mnb_pasteboard_service_parent_class)->finalize (gobject);
+}
+
+static void
+mnb_pasteboard_service_class_init (MnbPasteboardServiceClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GParamSpec *pspec;
+
+  g_type_class_add_private (klass, sizeof (MnbPasteboardServicePrivate));
+
+  gobject_class->set_property = mnb_pasteboard_service_set_property;
+  gobject_class->get_property = mnb_pasteboard_service_get_property;
+  gobject_class->dispose = mnb_pasteboard_service_dispose;
+  gobject_class->finalize = mnb_pasteboard_service_finalize;
+
+  pspec = g_param_spec_object ("store",
+                               "Store",
+                               "The MnbClipboardStore to export",
+                               MNB_TYPE_CLIPBOARD_STORE,
+                               G_PARAM_READWRITE |
+                               G_PARAM_CONSTRUCT_ONLY);
+  g_object_class_install_property (gobject_class, PROP_STORE, pspec);
+
+  introspection_data = g_dbus_node_info_new_for_xml (introspection_xml, NULL);
+  g_assert (introspection_data != NULL);
+}
+
+static void
+mnb_pasteboard_service_init (MnbPasteboardService *self)
+{
+  MnbPasteboardServicePrivate *priv;
+
+  self->priv = priv = MNB_PASTEBOARD_SERVICE_GET_PRIVATE (self);
+
+  priv->changed_serials = g_array_new (FALSE, FALSE, sizeof (gint64));
+  priv->removed_serials = g_array_new (FALSE, FALSE, sizeof (gint64));
+}
+
+MnbPasteboardService *
+mnb_pasteboard_service_new (MnbClipboardStore *store)
+{
+  g_return_val_if_fail (MNB_IS_CLIPBOARD_STORE (store), NULL);
+
+  return g_object_new (MNB_TYPE_PASTEBOARD_SERVICE,
+                       "store", store,
+                       NULL);
+}
+
+gboolean
+mnb_pasteboard_service_register (MnbPasteboardService  *service,
+                                 GDBusConnection       *connection,
+                                 GError               **error)
+{
+  MnbPasteboardServicePrivate *priv;
+
+  g_return_val_if_fail (MNB_IS_PASTEBOARD_SERVICE (service), FALSE);
+  g_return_val_if_fail (G_IS_DBUS_CONNECTION (connection), FALSE);
+
+  priv = service->priv;
+
+  g_return_val_if_fail (priv->registration_id == 0, FALSE);
+
+  priv->registration_id =
+    g_dbus_connection_register_object (connection,
+                                       MNB_PASTEBOARD_DBUS_PATH,
+                                       introspection_data->interfaces[0],
+                                       &interface_vtable,
+                                       service,
+                                       NULL,
+                                       error);
+  if (priv->registration_id == 0)
+    return FALSE;
+
+  priv->connection = g_object_ref (connection);
+
+  return TRUE;
+}
+
+void
+mnb_pasteboard_service_unregister (MnbPasteboardService *service)
+{
+  MnbPasteboardServicePrivate *priv;
+
+  g_return_if_fail (MNB_IS_PASTEBOARD_SERVICE (service));
+
+  priv = service->priv;
+
+  if (priv->registration_id == 0)
+    return;
+
+  if (priv->flush_id != 0)
+    {
+      g_source_remove (priv->flush_id);
+      priv->flush_id = 0;
+    }
+
+  g_array_set_size (priv->changed_serials, 0);
+  g_array_set_size (priv->removed_serials, 0);
+
+  g_dbus_connection_unregister_object (priv->connection,
+                                       priv->registration_id);
+  priv->registration_id = 0;
+
+  g_object_unref (priv->connection);
+  priv->connection = NULL;
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2008 - 2009 Intel Corporation.
+ *
+ * Author: Emmanuele Bassi <ebassi@linux.intel.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __MNB_PASTEBOARD_SERVICE_H__
+#define __MNB_PASTEBOARD_SERVICE_H__
+
+#include <gio/gio.h>
+#include "mnb-clipboard-store.h"
+
+G_BEGIN_DECLS
+
+/* the name owned by the pasteboard daemon */
+#define MNB_PASTEBOARD_DBUS_NAME                "com.meego.UX.Pasteboard"
+#define MNB_PASTEBOARD_DBUS_PATH                "/com/meego/UX/Pasteboard"
+#define MNB_PASTEBOARD_DBUS_INTERFACE           "com.meego.UX.Pasteboard"
+
+#define MNB_TYPE_PASTEBOARD_SERVICE             (mnb_pasteboard_service_get_type ())
+#define MNB_PASTEBOARD_SERVICE(obj)             (G_TYPE_CHECK_INSTANCE_CAST ((obj), MNB_TYPE_PASTEBOARD_SERVICE, MnbPasteboardService))
+#define MNB_IS_PASTEBOARD_SERVICE(obj)          (G_TYPE_CHECK_INSTANCE_TYPE ((obj), MNB_TYPE_PASTEBOARD_SERVICE))
+#define MNB_PASTEBOARD_SERVICE_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST ((klass), MNB_TYPE_PASTEBOARD_SERVICE, MnbPasteboardServiceClass))
+#define MNB_IS_PASTEBOARD_SERVICE_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE ((klass), MNB_TYPE_PASTEBOARD_SERVICE))
+#define MNB_PASTEBOARD_SERVICE_GET_CLASS(obj)   (G_TYPE_INSTANCE_GET_CLASS ((obj), MNB_TYPE_PASTEBOARD_SERVICE, MnbPasteboardServiceClass))
+
+typedef struct _MnbPasteboardService            MnbPasteboardService;
+typedef struct _MnbPasteboardServicePrivate     MnbPasteboardServicePrivate;
+typedef struct _MnbPasteboardServiceClass       MnbPasteboardServiceClass;
+
+struct _MnbPasteboardService
+{
+  GObject parent_instance;
+
+  MnbPasteboardServicePrivate *priv;
+};
+
+struct _MnbPasteboardServiceClass
+{
+  GObjectClass parent_class;
+};
+
+GType mnb_pasteboard_service_get_type (void) G_GNUC_CONST;
+
+MnbPasteboardService *mnb_pasteboard_service_new (MnbClipboardStore *store);
+
+gboolean mnb_pasteboard_service_register   (MnbPasteboardService  *service,
+                                            GDBusConnection       *connection,
+                                            GError               **error);
+void     mnb_pasteboard_service_unregister (MnbPasteboardService  *service);
+
+G_END_DECLS
+
+#endif /* __MNB_PASTEBOARD_SERVICE_H__ */